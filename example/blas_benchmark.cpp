@@ -0,0 +1,143 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+// Microbenchmark of the internal BLAS sgemm, every instruction set path against the SSE one, using the shapes of the
+// FullyConnected layers found in a .vpunn model. Both the plain and the prepacked weights GEMM are timed
+
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core/profiling.h"
+#include "core/tensors.h"
+#include "kernels/vpunn_blas.h"
+#include "vpunn_generated.h"
+
+constexpr char usage_message[]{" < model.vpunn > <batch sizes, optional, e.g. 1,16,100 >"};
+
+struct DenseShape {
+    int output_channels;
+    int input_channels;
+};
+
+/// @brief extracts the weight shapes of all FullyConnected layers in the model
+std::vector<DenseShape> dense_shapes(const std::string& filename) {
+    std::vector<DenseShape> shapes;
+    std::ifstream myFile(filename, std::ios::binary | std::ios::in);
+    if (myFile.fail()) {
+        return shapes;
+    }
+    const std::vector<char> buf{std::istreambuf_iterator<char>(myFile), std::istreambuf_iterator<char>()};
+    flatbuffers::Verifier verifier(reinterpret_cast<const uint8_t*>(buf.data()), buf.size());
+    if (!(VPUNN_SCHEMA::VerifyModelBuffer(verifier))) {
+        return shapes;
+    }
+    const auto model = VPUNN_SCHEMA::GetModel(buf.data());
+    const auto layers = model->operators();
+    for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
+        const auto layer = layers->Get(idx);
+        if (layer->implementation_type() == VPUNN_SCHEMA::LayerType_FullyConnectedLayer) {
+            // inputs: activations, weights, bias
+            const auto weights_shape = model->tensors()->Get(layer->inputs()->Get(1))->shape();
+            shapes.push_back({static_cast<int>(weights_shape->Get(0)), static_cast<int>(weights_shape->Get(1))});
+        }
+    }
+    return shapes;
+}
+
+std::vector<int> parse_batches(const std::string& text) {
+    std::vector<int> batches;
+    std::stringstream input(text);
+    for (std::string part; std::getline(input, part, ',');) {
+        batches.push_back(std::stoi(part));
+    }
+    return batches;
+}
+
+/// @brief average time in microseconds of one call of run
+template <class F>
+double time_calls(F run, const int batch, const DenseShape& shape) {
+    const double flops_per_call{2.0 * batch * shape.output_channels * shape.input_channels};
+    const int repetitions{std::max(10, static_cast<int>(2.0e9 / flops_per_call))};
+    run();  // warm up
+    const auto t0 = VPUNN::tick();
+    for (int r = 0; r < repetitions; ++r) {
+        run();
+    }
+    return VPUNN::tock(t0) * 1000.0 / repetitions;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage %s %s\n", argv[0], usage_message);
+        return 0;
+    }
+    const auto shapes = dense_shapes(argv[1]);
+    if (shapes.empty()) {
+        printf("Error! No FullyConnected layers found in %s\n", argv[1]);
+        return 1;
+    }
+    const auto batches = parse_batches((argc > 2) ? argv[2] : "1,16,100");
+
+    const VPUNN_BLAS_ISA detected{vpunn_blas_detected_isa()};
+    printf("Detected instruction set: %s\n\n", vpunn_blas_isa_name(detected));
+    printf("%-12s %-8s %-8s %14s %10s %10s %14s %10s %10s\n", "shape(OxI)", "batch", "isa", "time[us]", "GFLOP/s",
+           "vs SSE", "packed[us]", "GFLOP/s", "vs SSE");
+
+    for (const auto& shape : shapes) {
+        const auto weights = VPUNN::random_uniform<float>(
+                {static_cast<unsigned int>(shape.output_channels), static_cast<unsigned int>(shape.input_channels)},
+                -1.0f, 1.0f);
+        std::vector<float> packed(vpunn_sgemm_packed_size(shape.output_channels, shape.input_channels));
+        vpunn_sgemm_pack(shape.output_channels, shape.input_channels, weights.c_ptr(), shape.input_channels,
+                         packed.data());
+        for (const int batch : batches) {
+            const auto activations = VPUNN::random_uniform<float>(
+                    {static_cast<unsigned int>(batch), static_cast<unsigned int>(shape.input_channels)}, -1.0f, 1.0f);
+            auto output = VPUNN::zeros<float>(
+                    {static_cast<unsigned int>(batch), static_cast<unsigned int>(shape.output_channels)});
+
+            // Dense() style: C = A * W^T
+            auto plain = [&]() {
+                cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, batch, shape.output_channels,
+                            shape.input_channels, 1.0F, activations.c_ptr(), shape.input_channels, weights.c_ptr(),
+                            shape.input_channels, 0.0F, output.data(), shape.output_channels);
+            };
+            auto prepacked = [&]() {
+                vpunn_sgemm_packed(batch, shape.output_channels, shape.input_channels, activations.c_ptr(),
+                                   shape.input_channels, packed.data(), output.data(), shape.output_channels);
+            };
+
+            const double flops{2.0 * batch * shape.output_channels * shape.input_channels};
+            double sse_time{0.0};
+            double sse_packed_time{0.0};
+            for (int isa = VpunnBlasScalar; isa <= detected; ++isa) {
+                vpunn_blas_select_isa(static_cast<VPUNN_BLAS_ISA>(isa));
+                const double t{time_calls(plain, batch, shape)};
+                const double t_packed{time_calls(prepacked, batch, shape)};
+                if (isa == VpunnBlasSSE) {
+                    sse_time = t;
+                    sse_packed_time = t;  // the packed one is compared to the plain SSE
+                }
+                const std::string shape_txt{std::to_string(shape.output_channels) + "x" +
+                                            std::to_string(shape.input_channels)};
+                printf("%-12s %-8d %-8s %14.3f %10.2f %10.2fx %13.3f %10.2f %10.2fx\n", shape_txt.c_str(), batch,
+                       vpunn_blas_isa_name(static_cast<VPUNN_BLAS_ISA>(isa)), t, flops / (t * 1000.0),
+                       (sse_time > 0.0) ? sse_time / t : 0.0, t_packed, flops / (t_packed * 1000.0),
+                       (sse_packed_time > 0.0) ? sse_packed_time / t_packed : 0.0);
+            }
+        }
+    }
+    vpunn_blas_select_isa(detected);
+    return 0;
+}
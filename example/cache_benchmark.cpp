@@ -0,0 +1,98 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+// Contention of the shared workload cache (SharedLRUCache) with the number of threads, from 1 to 64, for one shard
+// (a single lock) and for the given number of shards. Each thread looks up keys drawn from a skewed distribution and
+// adds the missing ones, like cost models sharing the cache do
+
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/fingerprint.h"
+#include "core/profiling.h"
+#include "core/shared_cache.h"
+
+constexpr char usage_message[]{
+        "<lookups per thread, optional, default 200000> <distinct workloads, optional, default 50000> "
+        "<cache size, optional, default 16384> <shards, optional, default 64>"};
+
+/// @brief time of all the threads doing their lookups on the cache, milliseconds. hits receives the hit count
+double run(VPUNN::SharedLRUCache<float>& cache, const unsigned int threads, const std::vector<uint64_t>& keys,
+           size_t& hits) {
+    std::vector<size_t> thread_hits(threads, 0);
+    std::vector<std::thread> workers;
+    const auto t0 = VPUNN::tick();
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            // each thread its own part of the sequence, wrapping around
+            const size_t start{(keys.size() / threads) * t};
+            size_t found{0};
+            float value{0.0f};
+            for (size_t idx = 0; idx < keys.size(); ++idx) {
+                const uint64_t key{keys[(start + idx) % keys.size()]};
+                if (cache.get(key, value)) {
+                    ++found;
+                } else {
+                    cache.add(key, static_cast<float>(key & 0xFFFF));
+                }
+            }
+            thread_hits[t] = found;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const double elapsed{VPUNN::tock(t0)};
+    hits = 0;
+    for (const auto count : thread_hits) {
+        hits += count;
+    }
+    return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--help") {
+        printf("Usage %s %s\n", argv[0], usage_message);
+        return 0;
+    }
+    const size_t lookups{(argc > 1) ? std::stoul(argv[1]) : 200000};
+    const size_t distinct{(argc > 2) ? std::stoul(argv[2]) : 50000};
+    const size_t cache_size{(argc > 3) ? std::stoul(argv[3]) : 16384};
+    const size_t shards{(argc > 4) ? std::stoul(argv[4]) : 64};
+
+    // few workloads are very frequent, like the repeated tiles of a network
+    std::mt19937 generator(42);
+    std::vector<double> weights(distinct);
+    for (size_t idx = 0; idx < distinct; ++idx) {
+        weights[idx] = 1.0 / static_cast<double>(idx + 1);
+    }
+    std::discrete_distribution<size_t> workload(weights.begin(), weights.end());
+    std::vector<uint64_t> keys(lookups);
+    for (auto& key : keys) {
+        key = VPUNN::fingerprint(std::vector<float>{static_cast<float>(workload(generator))});
+    }
+
+    printf("%zu lookups per thread, %zu distinct workloads, cache of %zu\n\n", lookups, distinct, cache_size);
+    printf("%8s %8s %14s %16s %10s\n", "threads", "shards", "total[ms]", "Mlookups/s", "hit rate");
+    for (unsigned int threads = 1; threads <= 64; threads *= 2) {
+        for (const size_t shards_count : {size_t{1}, shards}) {
+            VPUNN::SharedLRUCache<float> cache(cache_size, shards_count);
+            size_t hits{0};
+            const double elapsed{run(cache, threads, keys, hits)};
+            const double total{static_cast<double>(lookups) * threads};
+            printf("%8u %8zu %14.2f %16.2f %9.1f%%\n", threads, cache.shards_count(), elapsed,
+                   total / (elapsed * 1000.0), 100.0 * static_cast<double>(hits) / total);
+        }
+    }
+    return 0;
+}
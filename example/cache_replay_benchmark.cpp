@@ -0,0 +1,143 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+// Hit rates of the workload cache replacement policies (CachePolicy) on the lookups of the tiler, for several cache
+// sizes. The trace is what the workload optimization (DPUTiler) asks the cost model: for each layer, the distinct
+// workloads of all the split variants of all the tiling algorithms and execution modes. Layers are drawn from a skewed
+// distribution, like the repeated layers of the networks being compiled, many of their split variants are rare.
+// A trace file (one key per line) is replayed if it exists, otherwise the generated trace is saved in it
+
+#include <stdio.h>
+#include <array>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "core/cache.h"
+#include "core/profiling.h"
+#include "vpu/optimization/tiler.h"
+#include "vpu/optimization/workload_optimization.h"
+
+constexpr char usage_message[]{
+        "<layers compiled, optional, default 2000> <distinct layers, optional, default 300> "
+        "<DPUs to split for, optional, default 4> <trace file, optional: replayed if it exists, otherwise written>"};
+
+/// @brief the cost model lookups of the tiler for a sequence of convolution layers of VPU_2_7
+std::vector<uint64_t> tiler_trace(const size_t layers_count, const size_t distinct, const unsigned int nDPU) {
+    const VPUNN::VPUDevice device{VPUNN::VPUDevice::VPU_2_7};
+    std::mt19937 random(42);
+    // the shapes of the convolutions of usual CNNs
+    const std::vector<unsigned int> dims{7, 14, 28, 56, 112};
+    const std::vector<unsigned int> channels{16, 32, 64, 96, 128, 256, 512};
+    const std::vector<unsigned int> kernels{1, 3};
+    std::vector<VPUNN::DPULayer> layers;
+    for (size_t idx = 0; idx < distinct; ++idx) {
+        const unsigned int dim{dims[random() % dims.size()]};
+        const unsigned int input_channels{channels[random() % channels.size()]};
+        const unsigned int output_channels{channels[random() % channels.size()]};
+        const unsigned int kernel{kernels[random() % kernels.size()]};
+        layers.emplace_back(device, VPUNN::Operation::CONVOLUTION,
+                            std::array<VPUNN::VPUTensor, 1>{
+                                    VPUNN::VPUTensor(dim, dim, input_channels, 1, VPUNN::DataType::UINT8)},
+                            std::array<VPUNN::VPUTensor, 1>{
+                                    VPUNN::VPUTensor(dim, dim, output_channels, 1, VPUNN::DataType::UINT8)},
+                            std::array<unsigned int, 2>{kernel, kernel}, std::array<unsigned int, 2>{1, 1},
+                            std::array<unsigned int, 4>{kernel / 2, kernel / 2, kernel / 2, kernel / 2});
+    }
+
+    std::vector<double> weights(distinct);
+    for (size_t idx = 0; idx < distinct; ++idx) {
+        weights[idx] = 1.0 / static_cast<double>(idx + 1);
+    }
+    std::discrete_distribution<size_t> layer_of(weights.begin(), weights.end());
+
+    VPUNN::SplitOptions options;
+    options.nDPU = nDPU;
+    std::vector<uint64_t> trace;
+    std::unordered_set<uint64_t> layer_keys;
+    for (size_t idx = 0; idx < layers_count; ++idx) {
+        const VPUNN::DPULayer& layer = layers[layer_of(random)];
+        layer_keys.clear();
+        const auto algorithms = VPUNN::getTilingAlgorithms(layer, options);
+        for (const auto mode : VPUNN::DPULayerModes::getValidExecutionMode(layer)) {
+            for (const auto& algo : algorithms) {
+                for (const auto nWorkloads : algo->generateSplitPool(options.nDPU, mode)) {
+                    try {
+                        for (const auto& workloads : algo->split_tile_in_workloads(mode, nWorkloads)) {
+                            for (const auto& wl : workloads) {
+                                // the repeated tiles of a layer are one query of the batched run_NN
+                                const uint64_t key{VPUNN::fingerprint(wl)};
+                                if (layer_keys.insert(key).second) {
+                                    trace.push_back(key);
+                                }
+                            }
+                        }
+                    } catch (const std::exception&) {
+                        // not a valid split for this layer, the tiler skips it too
+                    }
+                }
+            }
+        }
+    }
+    return trace;
+}
+
+/// @brief the hit rate of a cache replaying the trace: a miss is inferred and added
+double replay(const std::vector<uint64_t>& trace, const size_t cache_size, const VPUNN::CachePolicy policy) {
+    VPUNN::LRUCache<float> cache(cache_size, policy);
+    for (const auto key : trace) {
+        if (cache.get(key) == nullptr) {
+            cache.add(key, 1.0f);
+        }
+    }
+    return cache.statistics().hit_rate();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--help") {
+        printf("Usage %s %s\n", argv[0], usage_message);
+        return 0;
+    }
+    const size_t layers_count{(argc > 1) ? std::stoul(argv[1]) : 2000};
+    const size_t distinct{(argc > 2) ? std::stoul(argv[2]) : 300};
+    const unsigned int nDPU{(argc > 3) ? static_cast<unsigned int>(std::stoul(argv[3])) : 4};
+    const std::string trace_file{(argc > 4) ? argv[4] : ""};
+
+    std::vector<uint64_t> trace;
+    std::ifstream input(trace_file);
+    if (!trace_file.empty() && input.is_open()) {
+        uint64_t key;
+        while (input >> key) {
+            trace.push_back(key);
+        }
+        printf("%zu lookups read from %s\n", trace.size(), trace_file.c_str());
+    } else {
+        const auto t0 = VPUNN::tick();
+        trace = tiler_trace(layers_count, distinct, nDPU);
+        printf("%zu lookups generated in %.2f ms for %zu layers (%zu distinct) split for %u DPUs\n", trace.size(),
+               VPUNN::tock(t0), layers_count, distinct, nDPU);
+        if (!trace_file.empty()) {
+            std::ofstream output(trace_file);
+            for (const auto key : trace) {
+                output << key << "\n";
+            }
+        }
+    }
+
+    printf("\n%12s %12s %12s %12s\n", "cache size", "LRU", "TinyLFU", "gain");
+    for (size_t cache_size = 64; cache_size <= 65536; cache_size *= 4) {
+        const double lru{replay(trace, cache_size, VPUNN::CachePolicy::LRU)};
+        const double tiny_lfu{replay(trace, cache_size, VPUNN::CachePolicy::TINY_LFU)};
+        printf("%12zu %11.1f%% %11.1f%% %+11.1f%%\n", cache_size, 100.0 * lru, 100.0 * tiny_lfu,
+               100.0 * (tiny_lfu - lru));
+    }
+    return 0;
+}
@@ -247,6 +247,26 @@ void stepDPUINFO(std::string name, const std::string& model_path, const VPUNN::V
     }
 }
 
+void stepLayers(const std::string& model_path, const VPUNN::VPUDevice device, std::ofstream& csv) {
+    // STEP 4: where the inference time goes, layer by layer
+    constexpr unsigned int n_workloads = 1000;
+    printf("\n\n STEP 4: per layer profiling, no cache ..... %d workloads\n", n_workloads);
+    csv << std::endl << std::endl << "Step4, per layer profiling (wls = " << n_workloads << " )" << std::endl;
+
+    auto workloads = std::vector<VPUNN::DPUWorkload>(n_workloads);
+    std::generate_n(workloads.begin(), n_workloads, VPUNN::randDPUWorkload(device));
+    for (const unsigned int batch_size : {1U, 100U}) {
+        VPUNN::VPUCostModel model{model_path, true, 0, batch_size};
+        model.DPU(workloads);  // warm up
+        model.nn_runtime()->reset_profiling();
+        model.DPU(workloads);
+
+        const auto report = model.nn_runtime()->profiling_report();
+        std::cout << "   Batch " << batch_size << ":\n" << report << std::endl;
+        csv << "Batch " << batch_size << std::endl << report << std::endl;
+    }
+}
+
 int main(int argc, char* argv[]) {
     try {
         printf("========================================================================\n");
@@ -349,6 +369,9 @@ int main(int argc, char* argv[]) {
         stepDPUINFO("a No cache", model_path, device, csv, 0);
         stepDPUINFO("b With cache", model_path, device, csv, 16384);
 
+        // step 4
+        stepLayers(model_path, device, csv);
+
         csv << "\n Device used  was .... " << VPUNN::VPUDevice_ToText.at(static_cast<int>(device)) << "\n";
 
         csv.close();
@@ -0,0 +1,174 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+// Microbenchmark of the kNN layer, scaling with the database size and the batch. The top-k kernel is timed with one
+// thread and with all the threads against a full sort reference (the same distances GEMM, then a priority queue of all
+// the items per row).
+// The embedding size and the number of neighbours can be taken from the kNN layers of a .vpunn model
+
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/parallel.h"
+#include "core/profiling.h"
+#include "core/tensors.h"
+#include "kernels/kNN.h"
+#include "kernels/vpunn_blas.h"
+#include "vpunn_generated.h"
+
+constexpr char usage_message[]{
+        " <model.vpunn or - for synthetic> <database sizes, optional, e.g. 1000,10000,100000 > "
+        "<batch sizes, optional, e.g. 1,16,100 >"};
+
+struct kNNShape {
+    unsigned int embedding;
+    unsigned int n_neighbours;
+};
+
+/// @brief extracts the embedding size and the neighbours count of all kNN layers in the model
+std::vector<kNNShape> knn_shapes(const std::string& filename) {
+    std::vector<kNNShape> shapes;
+    std::ifstream myFile(filename, std::ios::binary | std::ios::in);
+    if (myFile.fail()) {
+        return shapes;
+    }
+    const std::vector<char> buf{std::istreambuf_iterator<char>(myFile), std::istreambuf_iterator<char>()};
+    flatbuffers::Verifier verifier(reinterpret_cast<const uint8_t*>(buf.data()), buf.size());
+    if (!(VPUNN_SCHEMA::VerifyModelBuffer(verifier))) {
+        return shapes;
+    }
+    const auto model = VPUNN_SCHEMA::GetModel(buf.data());
+    const auto layers = model->operators();
+    for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
+        const auto layer = layers->Get(idx);
+        if (layer->implementation_type() == VPUNN_SCHEMA::LayerType_kNNLayer) {
+            // inputs: activations, weights, targets
+            const auto weights_shape = model->tensors()->Get(layer->inputs()->Get(1))->shape();
+            shapes.push_back({static_cast<unsigned int>(weights_shape->Get(1)),
+                              static_cast<unsigned int>(layer->implementation_as_kNNLayer()->n_neighbors())});
+        }
+    }
+    return shapes;
+}
+
+std::vector<unsigned int> parse_list(const std::string& text) {
+    std::vector<unsigned int> values;
+    std::stringstream input(text);
+    for (std::string part; std::getline(input, part, ',');) {
+        values.push_back(static_cast<unsigned int>(std::stoul(part)));
+    }
+    return values;
+}
+
+/// @brief the kNN as it was before the top-k kernel: all the distances by one GEMM, then all the items of a row in a
+/// priority queue. Same GEMM as the kNN layer, the ratio measures the neighbours selection and the batch parallelism
+void knn_full_sort(const VPUNN::Tensor<float>& weights, const VPUNN::Tensor<float>& targets,
+                   const VPUNN::Tensor<float>& activations, VPUNN::Tensor<float>& output, unsigned int n_neighbours) {
+    const int embedding = static_cast<int>(weights.shape()[1]);
+    const int items = static_cast<int>(weights.shape()[0]);
+    const int batch = static_cast<int>(activations.shape()[0]);
+    // distance = 1 - A * W.T
+    std::vector<float> distances(static_cast<size_t>(batch) * items);
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, batch, items, embedding, 1.0F, activations.c_ptr(), embedding,
+                weights.c_ptr(), embedding, 0.0F, distances.data(), items);
+    for (auto& distance : distances) {
+        distance = 1.0F - distance;
+    }
+    using Item = std::pair<float, unsigned int>;
+    for (int b = 0; b < batch; ++b) {
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+        for (int item = 0; item < items; ++item) {
+            queue.push({distances[static_cast<size_t>(b) * items + item], static_cast<unsigned int>(item)});
+        }
+        float sum = 0, prediction = 0;
+        for (unsigned int n = 0; n < n_neighbours; ++n) {
+            const float weight = 1.0f / (queue.top().first + 1e-12f);
+            prediction += targets.c_ptr()[queue.top().second] * weight;
+            sum += weight;
+            queue.pop();
+        }
+        output.data()[b] = prediction / sum;
+    }
+}
+
+/// @brief average time in microseconds of one call of run
+template <class F>
+double time_calls(F run, const double flops_per_call) {
+    const int repetitions{std::max(3, static_cast<int>(1.0e9 / flops_per_call))};
+    run();  // warm up
+    const auto t0 = VPUNN::tick();
+    for (int r = 0; r < repetitions; ++r) {
+        run();
+    }
+    return VPUNN::tock(t0) * 1000.0 / repetitions;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage %s %s\n", argv[0], usage_message);
+        return 0;
+    }
+    std::vector<kNNShape> shapes;
+    if (std::string(argv[1]) != "-") {
+        shapes = knn_shapes(argv[1]);
+        if (shapes.empty()) {
+            printf("Error! No kNN layers found in %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        shapes.push_back({32, 5});  // synthetic
+    }
+    const auto db_sizes = parse_list((argc > 2) ? argv[2] : "1000,10000,100000");
+    const auto batches = parse_list((argc > 3) ? argv[3] : "1,16,100");
+    const unsigned int max_threads{VPUNN::parallel_max_threads()};
+
+    printf("%10s %10s %4s %6s %16s %16s %16s %10s %10s\n", "items", "embedding", "k", "batch", "full sort[us]",
+           "top-k 1T[us]", "top-k MT[us]", "speedup 1T", "speedup MT");
+    for (const auto& shape : shapes) {
+        for (const auto items : db_sizes) {
+            auto weights = VPUNN::random_uniform<float>({items, shape.embedding}, -1.0f, 1.0f);
+            auto targets = VPUNN::random_uniform<float>({items, 1}, 0.0f, 100.0f);
+            for (const auto batch : batches) {
+                auto input = VPUNN::random_uniform<float>({batch, shape.embedding}, -1.0f, 1.0f);
+                auto output = VPUNN::zeros<float>({batch, 1});
+                const double flops{2.0 * batch * items * shape.embedding};
+
+                const double full_sort{time_calls(
+                        [&]() {
+                            knn_full_sort(weights, targets, input, output, shape.n_neighbours);
+                        },
+                        flops)};
+                VPUNN::set_parallel_max_threads(1);
+                const double single{time_calls(
+                        [&]() {
+                            VPUNN::kNN(&weights, &targets, &input, &output, shape.n_neighbours);
+                        },
+                        flops)};
+                VPUNN::set_parallel_max_threads(max_threads);
+                const double multi{time_calls(
+                        [&]() {
+                            VPUNN::kNN(&weights, &targets, &input, &output, shape.n_neighbours);
+                        },
+                        flops)};
+
+                printf("%10u %10u %4u %6u %16.2f %16.2f %16.2f %9.2fx %9.2fx\n", items, shape.embedding,
+                       shape.n_neighbours, batch, full_sort, single, multi, full_sort / single, full_sort / multi);
+            }
+        }
+    }
+    return 0;
+}
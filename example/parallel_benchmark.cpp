@@ -0,0 +1,76 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+// Scaling of the batched cost model (VPUCostModel::DPU on a vector of workloads) with the number of threads, from 1 to
+// N. Every run is checked to be bit identical to the single thread one
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/parallel.h"
+#include "core/profiling.h"
+#include "vpu/sample_generator/random_task_generator.h"
+#include "vpu_cost_model.h"
+
+constexpr char usage_message[]{
+        " < model.vpunn > <number of workloads, optional, default 20000> <batch, optional, default 100> "
+        "<max threads, optional, default the hardware threads> <device, optional {VPU_2_0,VPU_2_7}, default VPU_2_7>"};
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage %s %s\n", argv[0], usage_message);
+        return 0;
+    }
+    const std::string filename{argv[1]};
+    const size_t n_workloads{(argc > 2) ? std::stoul(argv[2]) : 20000};
+    const unsigned int batch{(argc > 3) ? static_cast<unsigned int>(std::stoul(argv[3])) : 100};
+    const unsigned int max_threads{(argc > 4) ? static_cast<unsigned int>(std::stoul(argv[4]))
+                                              : std::max(1U, std::thread::hardware_concurrency())};
+    const VPUNN::VPUDevice device{(argc > 5 && std::string(argv[5]) == "VPU_2_0") ? VPUNN::VPUDevice::VPU_2_0
+                                                                                   : VPUNN::VPUDevice::VPU_2_7};
+
+    std::vector<VPUNN::DPUWorkload> workloads(n_workloads);
+    std::generate_n(workloads.begin(), n_workloads, VPUNN::randDPUWorkload(device));
+
+    printf("Model: %s, %zu random %s workloads, batch %u\n\n", filename.c_str(), n_workloads,
+           VPUNN::VPUDevice_ToText.at(static_cast<int>(device)).c_str(), batch);
+    printf("%8s %14s %14s %10s %12s\n", "threads", "total[ms]", "time/wl[us]", "speedup", "identical");
+
+    std::vector<VPUNN::CyclesInterfaceType> reference;
+    double single_thread_time{0.0};
+    for (unsigned int threads = 1; threads <= max_threads; ++threads) {
+        VPUNN::set_parallel_max_threads(threads);
+        VPUNN::VPUCostModel model{filename, false, 0, batch};
+        if (!model.nn_initialized()) {
+            printf("Error! Cannot load the model %s\n", filename.c_str());
+            return 1;
+        }
+        model.DPU(workloads);  // warm up, starts the threads
+
+        constexpr int repetitions{3};
+        double best{-1.0};
+        std::vector<VPUNN::CyclesInterfaceType> cycles;
+        for (int r = 0; r < repetitions; ++r) {
+            const auto t0 = VPUNN::tick();
+            cycles = model.DPU(workloads);
+            const double elapsed{VPUNN::tock(t0)};
+            best = (best < 0.0) ? elapsed : std::min(best, elapsed);
+        }
+        if (threads == 1) {
+            reference = cycles;
+            single_thread_time = best;
+        }
+        printf("%8u %14.2f %14.3f %9.2fx %12s\n", threads, best, best * 1000.0 / n_workloads,
+               single_thread_time / best, (cycles == reference) ? "yes" : "NO");
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+// Accuracy vs speed of the reduced precision (FP16, INT8) FC weights against the FP32 reference, on a corpus of random
+// DPU workloads run through a .vpunn model
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "core/profiling.h"
+#include "inference/model.h"
+#include "inference/preprop_factory.h"
+#include "vpu/sample_generator/random_task_generator.h"
+#include "vpu/types.h"
+
+constexpr char usage_message[]{
+        " < model.vpunn > <number of workloads, optional, default 2000> <batch, optional, default 1> "
+        "<device, optional {VPU_2_0,VPU_2_7}, default VPU_2_7>"};
+
+struct PrecisionResult {
+    std::vector<float> outputs;  ///< all the NN outputs for the corpus
+    double time_per_workload_us{0.0};
+    size_t weights_bytes{0};
+};
+
+/// @brief NN descriptors of the workloads, one after the other, padded with zero descriptors to a multiple of batch
+std::vector<float> make_descriptors(VPUNN::InferenceModel& model, const std::vector<VPUNN::DPUWorkload>& workloads,
+                                    const unsigned int batch) {
+    VPUNN::ModelVersion version;
+    version.parse_name(model.network_name());
+    const VPUNN::RuntimeProcessingFactory factory;
+    if (!factory.exists_preprocessing(version.get_input_interface_version())) {
+        return {};
+    }
+    auto preprocessing = factory.make_preprocessing(version.get_input_interface_version());
+    const auto input_size = model.input_tensors()[0]->shape()[1];
+    preprocessing->set_size(input_size);
+
+    const size_t padded{(workloads.size() + batch - 1) / batch * batch};
+    std::vector<float> descriptors(padded * input_size, 0.0F);
+    for (size_t idx = 0; idx < workloads.size(); ++idx) {
+        const auto& descriptor = preprocessing->transform(workloads[idx]);
+        std::copy(descriptor.begin(), descriptor.end(), descriptors.begin() + idx * input_size);
+    }
+    return descriptors;
+}
+
+/// @brief runs the whole corpus with one weights precision, a few times, keeping the best time
+PrecisionResult run_corpus(VPUNN::InferenceModel& model, const std::vector<float>& descriptors,
+                           const size_t n_workloads, const unsigned int batch) {
+    PrecisionResult result;
+    const auto store = model.model_store();
+    for (flatbuffers::uoffset_t idx = 0; idx < store->get_model()->operators()->size(); ++idx) {
+        result.weights_bytes += store->packed_dense_weights(idx).size_in_bytes();
+    }
+
+    const unsigned int input_size{model.input_tensors()[0]->shape()[1]};
+    const unsigned int output_size{model.output_tensors()[0]->shape()[1]};
+    const size_t batches{descriptors.size() / (input_size * batch)};
+    result.outputs.resize(batches * batch * output_size);
+
+    constexpr int repetitions{5};
+    double best{-1.0};
+    for (int r = 0; r < repetitions; ++r) {
+        const auto t0 = VPUNN::tick();
+        for (size_t b = 0; b < batches; ++b) {
+            model.set_inputs(descriptors.data() + b * batch * input_size, batch * input_size);
+            model.predict();
+            const float* outputs = model.get_outputs<float>();
+            std::copy(outputs, outputs + batch * output_size, result.outputs.begin() + b * batch * output_size);
+        }
+        const double elapsed{VPUNN::tock(t0)};
+        best = (best < 0.0) ? elapsed : std::min(best, elapsed);
+    }
+    result.outputs.resize(n_workloads * output_size);
+    result.time_per_workload_us = best * 1000.0 / n_workloads;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage %s %s\n", argv[0], usage_message);
+        return 0;
+    }
+    const std::string filename{argv[1]};
+    const size_t n_workloads{(argc > 2) ? std::stoul(argv[2]) : 2000};
+    const unsigned int batch{(argc > 3) ? static_cast<unsigned int>(std::stoul(argv[3])) : 1};
+    const VPUNN::VPUDevice device{(argc > 4 && std::string(argv[4]) == "VPU_2_0") ? VPUNN::VPUDevice::VPU_2_0
+                                                                                   : VPUNN::VPUDevice::VPU_2_7};
+
+    std::vector<VPUNN::DPUWorkload> workloads(n_workloads);
+    std::generate_n(workloads.begin(), n_workloads, VPUNN::randDPUWorkload(device));
+
+    VPUNN::InferenceModel reference_model(filename.c_str(), true, VPUNN::WeightPrecision::FP32);
+    if (!reference_model.is_initialized()) {
+        printf("Error! Cannot load the model %s\n", filename.c_str());
+        return 1;
+    }
+    reference_model.allocate_tensors(batch);
+    const auto descriptors = make_descriptors(reference_model, workloads, batch);
+    if (descriptors.empty()) {
+        printf("Error! No preprocessing for the model %s\n", filename.c_str());
+        return 1;
+    }
+    const PrecisionResult reference{run_corpus(reference_model, descriptors, n_workloads, batch)};
+
+    printf("Model: %s, %zu random %s workloads, batch %u\n\n", filename.c_str(), n_workloads,
+           VPUNN::VPUDevice_ToText.at(static_cast<int>(device)).c_str(), batch);
+    printf("%-10s %12s %14s %10s %14s %14s %14s %14s\n", "precision", "weights[KB]", "time/wl[us]", "speedup",
+           "max abs err", "mean abs err", "max rel err", "mean rel err");
+
+    const std::vector<std::pair<VPUNN::WeightPrecision, const char*>> precisions{
+            {VPUNN::WeightPrecision::FP32, "FP32"},
+            {VPUNN::WeightPrecision::FP16, "FP16"},
+            {VPUNN::WeightPrecision::INT8, "INT8"}};
+    for (const auto& precision : precisions) {
+        VPUNN::InferenceModel model(filename.c_str(), true, precision.first);
+        model.allocate_tensors(batch);
+        if (model.weight_precision() != precision.first) {
+            printf("%-10s not available with this BLAS\n", precision.second);
+            continue;
+        }
+        const PrecisionResult result{run_corpus(model, descriptors, n_workloads, batch)};
+
+        double max_abs{0.0}, sum_abs{0.0}, max_rel{0.0}, sum_rel{0.0};
+        for (size_t idx = 0; idx < result.outputs.size(); ++idx) {
+            const double value{result.outputs[idx]};
+            const double expected{reference.outputs[idx]};
+            const double abs_err{std::fabs(value - expected)};
+            const double rel_err{abs_err / std::max(std::fabs(expected), 1e-6)};
+            max_abs = std::max(max_abs, abs_err);
+            max_rel = std::max(max_rel, rel_err);
+            sum_abs += abs_err;
+            sum_rel += rel_err;
+        }
+        const double count{static_cast<double>(std::max<size_t>(result.outputs.size(), 1))};
+        printf("%-10s %12.1f %14.3f %9.2fx %14.6g %14.6g %14.6g %14.6g\n", precision.second,
+               result.weights_bytes / 1024.0, result.time_per_workload_us,
+               reference.time_per_workload_us / result.time_per_workload_us, max_abs, sum_abs / count, max_rel,
+               sum_rel / count);
+    }
+    return 0;
+}
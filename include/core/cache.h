@@ -10,90 +10,429 @@
 #ifndef VPUNN_CACHE
 #define VPUNN_CACHE
 
-#include <list>
-#include <map>
-#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <vector>
+#include "core/fingerprint.h"
 
 namespace VPUNN {
 
+/// @brief usage counters of a cache, e.g. to size it from the measured hit rate
+struct CacheStatistics {
+    size_t hits{0};       ///< lookups that found the value
+    size_t misses{0};     ///< lookups that did not find the value
+    size_t inserts{0};    ///< values added, not counting the updates of values already present
+    size_t evictions{0};  ///< values removed to make room for new ones
+    size_t size{0};       ///< values in the cache when the statistics were taken
+    size_t bytes{0};      ///< memory of the values held when the statistics were taken, not the cache object itself
+
+    /// @brief the fraction of the lookups that found the value, 0 if no lookups
+    double hit_rate() const {
+        const size_t lookups{hits + misses};
+        return (lookups > 0) ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+    }
+
+    /// @brief adds the counters of another cache, e.g. the shards of a cache
+    CacheStatistics& operator+=(const CacheStatistics& other) {
+        hits += other.hits;
+        misses += other.misses;
+        inserts += other.inserts;
+        evictions += other.evictions;
+        size += other.size;
+        bytes += other.bytes;
+        return *this;
+    }
+};
+
+/// @brief how a full cache chooses the value to drop
+enum class CachePolicy {
+    LRU,       ///< the least recently used value makes room for the new one
+    TINY_LFU,  ///< W-TinyLFU: a new value enters the main part only if it is used more often than the one it replaces
+};
+
+/**
+ * @brief Approximate count of the recent uses of each key, for the TinyLFU admission
+ * A count-min sketch of 4 bit counters (16 in a word, 4 per key). The counters are halved after 10 uses per cached
+ * entry, so the counts follow the changes of popularity.
+ */
+class FrequencySketch {
+private:
+    std::vector<uint64_t> table;  ///< the counters, a power of 2 words
+    uint64_t mask{0};             ///< table.size() - 1
+    size_t additions{0};          ///< increments since the last halving
+    size_t sample_size{0};        ///< increments between halvings
+
+    /// @brief the word and the shift of the counter of a key in row row
+    void position(const uint64_t key, const unsigned int row, size_t& word, unsigned int& shift) const {
+        static constexpr uint64_t seeds[4]{0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+                                           0xcbf29ce484222325ULL};
+        uint64_t hash{(key + seeds[row]) * seeds[(row + 1) & 3]};
+        hash ^= hash >> 32;
+        word = static_cast<size_t>(hash & mask);
+        shift = static_cast<unsigned int>(((hash >> 40) & 3) * 4 + row) * 4;  // each row in its own counters
+    }
+
+public:
+    /// @brief the words of the table for a cache of capacity entries
+    static size_t words_for(const size_t capacity) {
+        size_t words{1};
+        while (words < capacity) {
+            words *= 2;
+        }
+        return (capacity > 0) ? words : 0;
+    }
+
+    /// @brief a sketch for a cache of capacity entries, 0 for no sketch
+    explicit FrequencySketch(const size_t capacity) {
+        if (capacity > 0) {
+            const size_t words{words_for(capacity)};
+            table.assign(words, 0);
+            mask = words - 1;
+            sample_size = 10 * capacity;
+        }
+    }
+
+    /// @brief counts a use of the key
+    void increment(const uint64_t key) {
+        bool added{false};
+        for (unsigned int row = 0; row < 4; ++row) {
+            size_t word;
+            unsigned int shift;
+            position(key, row, word, shift);
+            if (((table[word] >> shift) & 0xF) < 0xF) {
+                table[word] += uint64_t{1} << shift;
+                added = true;
+            }
+        }
+        if (added && ++additions >= sample_size) {
+            for (auto& counters : table) {
+                counters = (counters >> 1) & 0x7777777777777777ULL;
+            }
+            additions /= 2;
+        }
+    }
+
+    /// @brief the estimated recent uses of the key, at most 15
+    unsigned int frequency(const uint64_t key) const {
+        unsigned int result{0xF};
+        for (unsigned int row = 0; row < 4; ++row) {
+            size_t word;
+            unsigned int shift;
+            position(key, row, word, shift);
+            result = std::min(result, static_cast<unsigned int>((table[word] >> shift) & 0xF));
+        }
+        return result;
+    }
+
+    /// @brief the memory of the counters
+    size_t size_in_bytes() const {
+        return table.capacity() * sizeof(uint64_t);
+    }
+
+    /// @brief forgets all the uses
+    void clear() {
+        std::fill(table.begin(), table.end(), 0);
+        additions = 0;
+    }
+};
+
 /**
- * @brief a workload cache using LRU (least recent used) replacement policy
+ * @brief a workload cache using LRU (least recent used) replacement policy, or W-TinyLFU (see CachePolicy)
+ *
+ * The workloads are identified by the 64 bit fingerprint of their descriptor, the descriptor itself is not stored.
+ * Entries live in a flat array, linked in recency order by indexes, and are found through an open addressing table
+ * (linear probing) of twice the capacity. The memory grows with the number of entries up to about 32 bytes per entry
+ * (for float values), e.g. ~512KB for 16384 entries, a small part of the descriptors themselves. with_max_bytes()
+ * creates a cache bounded by a memory budget instead of an entry count.
+ *
+ * With W-TinyLFU the entries are in three LRU lists: new values enter a small window (1%), those pushed out of it go
+ * to the probation part of the main cache, and a hit there moves them to the protected part (80% of the main cache).
+ * When the cache is full, the oldest value of the window replaces the oldest one of probation only if it was looked
+ * up more often (according to a FrequencySketch of all the lookups), so bursts of one-off workloads, like the split
+ * variants of a tiler sweep, do not evict the working set. The sketch adds 8 bytes per entry.
  *
  * @tparam T workload datatype
  */
 template <class T>
 class LRUCache {
 private:
-    typedef std::list<std::pair<std::vector<T>, T>> List;
-    typedef typename List::iterator List_Iter;
-    typedef std::map<std::vector<T>, List_Iter> Map;
-    typedef typename Map::iterator Map_Iter;
-    List workloads;
-    Map m_table;
-    size_t max_size, size;
+    static constexpr uint32_t none{std::numeric_limits<uint32_t>::max()};  ///< no entry
+
+    /// @brief the LRU lists an entry can be in
+    enum Segment : uint8_t { WINDOW = 0, PROBATION = 1, PROTECTED = 2, SEGMENTS = 3 };
+
+    /// @brief a cached value, linked with the ones used just before and after it
+    struct Entry {
+        uint64_t key;     ///< fingerprint of the workload descriptor
+        T value;          ///< the workload value
+        uint32_t newer;   ///< entry used right after this one, or none
+        uint32_t older;   ///< entry used right before this one, or none
+        Segment segment;  ///< the list it is in, always WINDOW with the LRU policy
+    };
+
+    std::vector<Entry> entries;   ///< the cached values, grows up to max_size
+    std::vector<uint32_t> slots;  ///< hash table, entry index + 1 or 0 for an empty slot
+    uint64_t mask{0};             ///< slots.size() - 1, slots.size() is a power of 2
+    uint32_t newest[SEGMENTS]{none, none, none};  ///< most recently used entry of each list
+    uint32_t oldest[SEGMENTS]{none, none, none};  ///< least recently used entry of each list
+    size_t count[SEGMENTS]{0, 0, 0};              ///< entries in each list
+    size_t max_size;
+    CachePolicy policy;
+    size_t window_size;     ///< the capacity of the window, all the cache for LRU
+    size_t protected_size;  ///< the capacity of the protected list
+    FrequencySketch sketch;    ///< lookups of the keys, for TINY_LFU only
+    CacheStatistics counters;  ///< hits, misses, inserts, evictions since creation or reset_statistics
+
+    /// @brief the slots of the hash table for a capacity: a power of 2, at least twice the capacity
+    static size_t slots_for(const size_t capacity) {
+        size_t table_size{2};
+        while (table_size < 2 * capacity) {
+            table_size *= 2;
+        }
+        return (capacity > 0) ? table_size : 0;
+    }
+
+    /// @brief the slot holding the key, or the empty slot where it would be inserted
+    size_t find_slot(const uint64_t key) const {
+        size_t slot{static_cast<size_t>(key & mask)};
+        while (slots[slot] != 0 && entries[slots[slot] - 1].key != key) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    /// @brief empties a slot, moving back the following ones of the probe sequence so that no lookup stops early
+    void erase_slot(size_t slot) {
+        size_t next{slot};
+        for (;;) {
+            next = (next + 1) & mask;
+            if (slots[next] == 0) {
+                break;
+            }
+            const size_t home{static_cast<size_t>(entries[slots[next] - 1].key & mask)};
+            // can move back only if its home slot is not between the empty slot and its position (cyclically)
+            const bool movable{(slot <= next) ? (home <= slot || home > next) : (home <= slot && home > next)};
+            if (movable) {
+                slots[slot] = slots[next];
+                slot = next;
+            }
+        }
+        slots[slot] = 0;
+    }
+
+    /// @brief removes an entry from its recency list
+    void unlink(const uint32_t index) {
+        Entry& entry = entries[index];
+        const Segment segment{entry.segment};
+        if (entry.newer != none) {
+            entries[entry.newer].older = entry.older;
+        } else {
+            newest[segment] = entry.older;
+        }
+        if (entry.older != none) {
+            entries[entry.older].newer = entry.newer;
+        } else {
+            oldest[segment] = entry.newer;
+        }
+        --count[segment];
+    }
+
+    /// @brief puts an entry at the most recently used end of a list
+    void link_newest(const uint32_t index, const Segment segment) {
+        Entry& entry = entries[index];
+        entry.segment = segment;
+        entry.newer = none;
+        entry.older = newest[segment];
+        if (newest[segment] != none) {
+            entries[newest[segment]].newer = index;
+        } else {
+            oldest[segment] = index;
+        }
+        newest[segment] = index;
+        ++count[segment];
+    }
+
+    /// @brief moves an entry to the most recently used end of a list
+    void move(const uint32_t index, const Segment segment) {
+        if (index != newest[segment]) {
+            unlink(index);
+            link_newest(index, segment);
+        }
+    }
+
+    /// @brief marks an entry as the most recently used. In probation it is promoted to the protected list
+    void touch(const uint32_t index) {
+        const Segment segment{entries[index].segment};
+        if (segment != PROBATION) {
+            move(index, segment);
+            return;
+        }
+        move(index, PROTECTED);
+        if (count[PROTECTED] > protected_size) {
+            move(oldest[PROTECTED], PROBATION);
+        }
+    }
+
+    /// @brief makes room for a new entry in a full cache, returns the index of the entry removed
+    uint32_t evict() {
+        const uint32_t candidate{oldest[WINDOW]};
+        uint32_t victim{(oldest[PROBATION] != none) ? oldest[PROBATION] : oldest[PROTECTED]};
+        if (victim == none) {
+            victim = candidate;  // all in the window, plain LRU
+        } else if (candidate != none && count[WINDOW] >= window_size) {
+            // the new entry pushes the candidate out of the window, only one of them stays
+            if (sketch.frequency(entries[candidate].key) > sketch.frequency(entries[victim].key)) {
+                move(candidate, PROBATION);
+            } else {
+                victim = candidate;
+            }
+        }
+        ++counters.evictions;
+        erase_slot(find_slot(entries[victim].key));
+        unlink(victim);
+        return victim;
+    }
 
 public:
     /**
      * @brief Construct a new LRUCache object
      *
      * @param max_size the maximum size of the LRUCache
+     * @param policy how to choose the value to drop when full
      */
-    LRUCache(size_t max_size): max_size(max_size), size(0) {
+    LRUCache(size_t max_size, const CachePolicy policy = CachePolicy::LRU)
+            : max_size(max_size),
+              policy(policy),
+              window_size((policy == CachePolicy::TINY_LFU) ? std::max<size_t>(1, max_size / 100) : max_size),
+              protected_size((max_size - std::min(window_size, max_size)) * 8 / 10),
+              sketch((policy == CachePolicy::TINY_LFU) ? max_size : 0) {
+        // If max_size == 0 we effectively disable the cache
+        if (max_size > 0) {
+            const size_t table_size{slots_for(max_size)};
+            slots.assign(table_size, 0);
+            mask = table_size - 1;
+        }
     }
 
     /**
-     * @brief Add a new workload descriptor to the cache
+     * @brief The memory used by a full cache, as reported by statistics().bytes: the entries, the hash table and the
+     * sketch. The fixed size of the cache object is not counted, an empty cache uses 0 bytes
      *
-     * @param wl the workload descriptor (key)
-     * @param value the workload value
+     * @param max_size the capacity of the cache
+     * @param policy the replacement policy, TINY_LFU adds the frequency sketch
+     * @return size_t bytes
      */
-    void add(const std::vector<T>& wl, const T& value) {
-        // If max_size == 0 we effectively disable the cache
-        if (max_size == 0)
-            return;
-        // Insert items in the list and map
-        workloads.push_front({wl, value});
-        auto it = workloads.begin();
-        m_table.insert({wl, it});
-        size++;
-
-        while (size > max_size) {
-            // Get the last element.
-            auto last_item = workloads.end();
-            --last_item;
+    static size_t memory_for(const size_t max_size, const CachePolicy policy = CachePolicy::LRU) {
+        const size_t sketch_words{(policy == CachePolicy::TINY_LFU) ? FrequencySketch::words_for(max_size) : 0};
+        return max_size * sizeof(Entry) + slots_for(max_size) * sizeof(uint32_t) + sketch_words * sizeof(uint64_t);
+    }
 
-            // Remove the last element
-            remove(last_item->first);
+    /**
+     * @brief The largest capacity whose memory (see memory_for) fits in a budget
+     *
+     * @param max_bytes the memory budget
+     * @param policy the replacement policy
+     * @return size_t the capacity, 0 if not even one entry fits
+     */
+    static size_t capacity_for_bytes(const size_t max_bytes, const CachePolicy policy = CachePolicy::LRU) {
+        size_t low{0};                                // fits, or nothing does
+        size_t high{max_bytes / sizeof(Entry) + 1};  // does not fit
+        while (high - low > 1) {
+            const size_t middle{low + (high - low) / 2};
+            if (memory_for(middle, policy) <= max_bytes) {
+                low = middle;
+            } else {
+                high = middle;
+            }
         }
+        return low;
     }
 
-private:
     /**
-     * @brief Remove a workload from the cache
+     * @brief A cache bounded by the memory it uses instead of an entry count
+     * The budget covers the entries, the hash table and the sketch, statistics().bytes never exceeds it
      *
-     * @param wl the workload descriptor
+     * @param max_bytes the memory budget
+     * @param policy how to choose the value to drop when full
+     * @return LRUCache with the largest capacity that fits (see capacity_for_bytes)
+     */
+    static LRUCache with_max_bytes(const size_t max_bytes, const CachePolicy policy = CachePolicy::LRU) {
+        return LRUCache(capacity_for_bytes(max_bytes, policy), policy);
+    }
+
+    /**
+     * @brief Add a new workload to the cache, replacing another one (see CachePolicy) if the cache is full
+     *
+     * @param key the fingerprint of the workload descriptor
+     * @param value the workload value
      */
-    void remove(std::vector<T>& wl) {
-        // Remove the workload from the cache
-        auto it = m_table.find(wl);
+    void add(const uint64_t key, const T& value) {
+        if (max_size == 0)
+            return;
+        const size_t slot{find_slot(key)};
+        if (slots[slot] != 0) {
+            // already present, keep the latest value
+            const uint32_t index{slots[slot] - 1};
+            entries[index].value = value;
+            touch(index);
+            return;
+        }
 
-        if (it != m_table.end()) {
-            // Return the value
-            m_table.erase(it->first);
+        uint32_t index;
+        if (entries.size() < max_size) {
+            index = static_cast<uint32_t>(entries.size());
+            if (entries.size() == entries.capacity()) {
+                // grows as usual but never past the capacity, so a full cache has exactly the memory of memory_for
+                entries.reserve(std::min(max_size, std::max<size_t>(16, 2 * entries.capacity())));
+            }
+            entries.push_back({key, value, none, none, WINDOW});
         } else {
-            throw std::out_of_range("VPUNN Cache out of range");
-            ;
+            index = evict();  // reuse the entry removed
+            entries[index].key = key;
+            entries[index].value = value;
         }
+        // the slot found above may have been taken by the shift of the erase
+        slots[find_slot(key)] = index + 1;
+        link_newest(index, WINDOW);
+        ++counters.inserts;
+        // the cache is not full yet: the oldest of the window go to the main cache without competing
+        while (count[WINDOW] > window_size) {
+            move(oldest[WINDOW], PROBATION);
+        }
+    }
 
-        // Remove the last element
-        workloads.pop_back();
+    /**
+     * @brief Add a new workload descriptor to the cache
+     *
+     * @param wl the workload descriptor (key)
+     * @param value the workload value
+     */
+    void add(const std::vector<T>& wl, const T& value) {
+        add(fingerprint(wl), value);
+    }
 
-        // Update the size
-        size--;
+    /**
+     * @brief Get a workload from the cache.
+     *
+     * @param key the fingerprint of the workload descriptor
+     * @return T* a pointer to the workload value stored in the cache, or NULL if not available. Valid until the next
+     * add
+     */
+    T* get(const uint64_t key) {
+        if (policy == CachePolicy::TINY_LFU && max_size > 0) {
+            sketch.increment(key);
+        }
+        const uint32_t found{(max_size > 0) ? slots[find_slot(key)] : 0};
+        if (found == 0) {
+            ++counters.misses;
+            return nullptr;
+        }
+        ++counters.hits;
+        touch(found - 1);
+        return &(entries[found - 1].value);
     }
 
-public:
     /**
      * @brief Get a workload from the cache.
      *
@@ -101,18 +440,54 @@ public:
      * @return T* a pointer to the workload value stored in the cache, or NULL if not available
      */
     T* get(const std::vector<T>& wl) {
-        Map_Iter it = m_table.find(wl);
-        if (it != m_table.end()) {
-            // Move the workload to the beginning of the list
-            workloads.splice(workloads.begin(), workloads, it->second);
-            // Return the value
-            return &(it->second->second);
-        } else {
-            return nullptr;
+        return get(fingerprint(wl));
+    }
+
+    /// @brief the number of workloads in the cache
+    size_t size() const {
+        return entries.size();
+    }
+
+    /// @brief the capacity of the cache
+    size_t capacity() const {
+        return max_size;
+    }
+
+    /// @brief the replacement policy
+    CachePolicy replacement_policy() const {
+        return policy;
+    }
+
+    /// @brief a snapshot of the usage counters, with the current size and memory
+    CacheStatistics statistics() const {
+        CacheStatistics snapshot{counters};
+        snapshot.size = entries.size();
+        snapshot.bytes =
+                entries.capacity() * sizeof(Entry) + slots.capacity() * sizeof(uint32_t) + sketch.size_in_bytes();
+        return snapshot;
+    }
+
+    /// @brief sets the usage counters to zero, the cached workloads stay
+    void reset_statistics() {
+        counters = CacheStatistics{};
+    }
+
+    /// @brief removes all the workloads, e.g. when the values they hold are no longer valid. Counters are kept
+    void clear() {
+        entries.clear();
+        std::fill(slots.begin(), slots.end(), 0);
+        for (unsigned int segment = 0; segment < SEGMENTS; ++segment) {
+            newest[segment] = none;
+            oldest[segment] = none;
+            count[segment] = 0;
         }
+        sketch.clear();
     }
 };
 
+template <class T>
+constexpr uint32_t LRUCache<T>::none;
+
 }  // namespace VPUNN
 
-#endif  // VPUNN_CACHE
\ No newline at end of file
+#endif  // VPUNN_CACHE
@@ -0,0 +1,105 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#ifndef CORE_FINGERPRINT_H
+#define CORE_FINGERPRINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace VPUNN {
+
+/**
+ * @brief 64 bit fingerprint of a sequence of values, e.g. a NN descriptor, used as a cache key
+ * The words are mixed like the blocks of MurmurHash3 and the result goes through its finalizer, so every input bit
+ * affects all the output bits. Two different sequences of the sizes used here have the same fingerprint with a
+ * probability of about 2^-64. Not a cryptographic hash.
+ */
+class Fingerprint {
+private:
+    uint64_t state;
+    uint64_t words{0};
+
+    static uint64_t rotl(const uint64_t x, const int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+public:
+    /// @brief a fingerprint of nothing yet, different seeds give unrelated fingerprints for the same values
+    explicit Fingerprint(const uint64_t seed = 0): state(seed) {
+    }
+
+    /// @brief adds a word to the sequence
+    Fingerprint& add(uint64_t word) {
+        word *= 0x87c37b91114253d5ULL;
+        word = rotl(word, 31);
+        word *= 0x4cf5ad432745937fULL;
+        state ^= word;
+        state = rotl(state, 27) * 5 + 0x52dce729;
+        ++words;
+        return *this;
+    }
+
+    /// @brief adds a float, by value: 0 and -0 are the same
+    Fingerprint& add(const float value) {
+        uint32_t bits{0};
+        if (value != 0.0f) {
+            std::memcpy(&bits, &value, sizeof(bits));
+        }
+        return add(static_cast<uint64_t>(bits));
+    }
+
+    /// @brief the fingerprint of the values added so far
+    uint64_t value() const {
+        uint64_t h{state ^ words};
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+/// @brief the fingerprint of a buffer of bytes, e.g. the contents of a file
+inline uint64_t fingerprint_bytes(const char* data, const size_t length, const uint64_t seed = 0) {
+    Fingerprint result{seed};
+    size_t idx{0};
+    for (; idx + sizeof(uint64_t) <= length; idx += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + idx, sizeof(word));
+        result.add(word);
+    }
+    uint64_t tail{0};
+    std::memcpy(&tail, data + idx, length - idx);
+    result.add(tail).add(static_cast<uint64_t>(length));
+    return result.value();
+}
+
+/// @brief the fingerprint of count values, e.g. a descriptor in a batch
+template <class T>
+uint64_t fingerprint(const T* values, const size_t count, const uint64_t seed = 0) {
+    Fingerprint result{seed};
+    for (size_t idx = 0; idx < count; ++idx) {
+        result.add(values[idx]);
+    }
+    return result.value();
+}
+
+/// @brief the fingerprint of all the values of a descriptor
+template <class T>
+uint64_t fingerprint(const std::vector<T>& values, const uint64_t seed = 0) {
+    return fingerprint(values.data(), values.size(), seed);
+}
+
+}  // namespace VPUNN
+
+#endif  // CORE_FINGERPRINT_H
@@ -0,0 +1,75 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#ifndef CORE_HALF_H
+#define CORE_HALF_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace VPUNN {
+
+/// @brief IEEE half (binary16) bits to float, exact
+inline float half_to_float(const uint16_t h) {
+    const uint32_t sign{static_cast<uint32_t>(h & 0x8000) << 16};
+    uint32_t exponent{static_cast<uint32_t>(h >> 10) & 0x1F};
+    uint32_t mantissa{static_cast<uint32_t>(h) & 0x3FF};
+    uint32_t bits{sign};
+    if (exponent == 0x1F) {  // inf or NaN
+        bits |= 0x7F800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits |= ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {  // subnormal half, normal float
+        exponent = 113;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits |= (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// @brief float to IEEE half (binary16) bits, round to nearest even, like the F16C conversion
+inline uint16_t float_to_half(const float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign{(bits >> 16) & 0x8000};
+    const uint32_t abs{bits & 0x7FFFFFFF};
+    if (abs > 0x7F800000) {  // NaN, kept quiet
+        return static_cast<uint16_t>(sign | 0x7E00 | ((abs >> 13) & 0x3FF));
+    }
+    if (abs >= 0x47800000) {  // 65536 or more, inf
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    if (abs < 0x38800000) {  // below the smallest normal half
+        if (abs <= 0x33000000) {
+            return static_cast<uint16_t>(sign);  // 2^-25 or less rounds to zero
+        }
+        const uint32_t mantissa{(abs & 0x7FFFFF) | 0x800000};
+        const uint32_t shift{126 - (abs >> 23)};
+        const uint32_t half{mantissa >> shift};
+        const uint32_t remainder{mantissa & ((1u << shift) - 1)};
+        const uint32_t halfway{1u << (shift - 1)};
+        const uint32_t round_up{(remainder > halfway || (remainder == halfway && (half & 1))) ? 1u : 0u};
+        return static_cast<uint16_t>(sign | (half + round_up));
+    }
+    uint32_t half{(abs >> 13) - ((127 - 15) << 10)};
+    const uint32_t remainder{abs & 0x1FFF};
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        ++half;  // might carry in the exponent, up to inf, as it should
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+}  // namespace VPUNN
+
+#endif  // CORE_HALF_H
@@ -0,0 +1,61 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#ifndef CORE_MAPPED_FILE_H
+#define CORE_MAPPED_FILE_H
+
+#include <cstddef>
+
+#include "core/vpunn_api.h"
+
+namespace VPUNN {
+
+/**
+ * @brief A file mapped read-only in memory. The mapping lives as long as this object.
+ * The pages are loaded on demand and shared by the OS between all the mappings of the same file.
+ */
+class VPUNN_API(MappedFile) {
+private:
+    const char* _data{nullptr};      ///< start of the mapped memory, null if not mapped
+    size_t _size{0};                 ///< size in bytes of the mapped file
+    void* _mapping_handle{nullptr};  ///< OS handle of the mapping object, where the OS has one (Windows)
+
+public:
+    /**
+     * @brief Maps a file. In case of error (missing file, empty file, OS error) the object is not mapped
+     *
+     * @param filename the file to map
+     */
+    explicit MappedFile(const char* filename);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// @brief unmaps the file
+    ~MappedFile();
+
+    /// @brief true if the file was mapped successfully
+    bool is_mapped() const {
+        return _data != nullptr;
+    }
+
+    /// @brief start of the file contents in memory
+    const char* data() const {
+        return _data;
+    }
+
+    /// @brief size of the file contents in bytes
+    size_t size() const {
+        return _size;
+    }
+};
+
+}  // namespace VPUNN
+
+#endif  // CORE_MAPPED_FILE_H
@@ -0,0 +1,141 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#ifndef CORE_PARALLEL_H
+#define CORE_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/vpunn_api.h"
+
+namespace VPUNN {
+
+/**
+ * @brief The maximum number of threads parallel_for uses, the calling thread included
+ * Multithreading is opt-in: defaults to 1, everything runs in the calling thread
+ *
+ * @return the setting, a reference that can be changed
+ */
+inline std::atomic<unsigned int>& parallel_max_threads() {
+    static std::atomic<unsigned int> max_threads{1};
+    return max_threads;
+}
+
+/**
+ * @brief Sets the maximum number of threads parallel_for uses, 1 makes everything run in the calling thread
+ * The results do not depend on this setting, they are bit identical to the single thread ones
+ *
+ * @param threads the maximum number of threads, zero means the number of hardware threads
+ */
+inline void set_parallel_max_threads(const unsigned int threads) {
+    parallel_max_threads() = (threads > 0) ? threads : std::max(1U, std::thread::hardware_concurrency());
+}
+
+/// @brief the minimum work (multiply-adds) worth a thread, kernels split their rows in chunks of at least this
+constexpr size_t parallel_min_chunk_work{size_t{1} << 18};
+
+/**
+ * @brief A pool of persistent worker threads, shared by all the parallel_for calls of the process
+ * The workers are started on first need and wait for work between the calls, so a parallel region costs a wake up
+ * instead of thread creations. One parallel region runs at a time: a call made while the pool is busy (from another
+ * thread, or from inside a task) runs its tasks in the calling thread.
+ */
+class VPUNN_API(ThreadPool) {
+public:
+    /// @brief the process wide pool
+    static ThreadPool& instance();
+
+    /**
+     * @brief Runs task(0) ... task(tasks - 1) and returns when all are done
+     * The calling thread runs tasks too, up to tasks - 1 workers help it. The task must not throw.
+     *
+     * @param tasks the number of tasks
+     * @param task callable(size_t task_index)
+     */
+    void run(const size_t tasks, const std::function<void(size_t)>& task);
+
+    /// @brief the number of worker threads started so far
+    size_t workers_count() const;
+
+    ThreadPool() = default;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// @brief stops and joins the workers
+    ~ThreadPool();
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex run_mutex;                             ///< held by the thread running a parallel region
+    mutable std::mutex mutex;                         ///< guards the state below
+    std::condition_variable wake;                     ///< workers wait here for tasks
+    std::condition_variable done;                     ///< the caller waits here for the region to end
+    const std::function<void(size_t)>* job{nullptr};  ///< the task of the current region
+    size_t job_tasks{0};                              ///< tasks of the current region
+    size_t next_task{0};                              ///< the next task index to be claimed
+    size_t completed{0};                              ///< tasks finished in the current region
+    bool stop{false};                                 ///< set by the destructor
+
+    /// @brief the worker loop: waits for tasks and runs them, until stopped
+    void worker_loop();
+
+    /// @brief claims and runs tasks of the current region until none is left, the lock is held on entry and exit
+    void run_available(std::unique_lock<std::mutex>& lock);
+};
+
+/**
+ * @brief Runs body(chunk_begin, chunk_end) over [begin, end) split in contiguous chunks, about one chunk per thread
+ * The calling thread runs chunks too, the other ones run in the ThreadPool. Chunks have at least min_chunk elements,
+ * so small ranges run in the calling thread only. Chunk sizes are multiples of alignment (except the last one).
+ * The split depends only on the range and the thread count, each element is processed once by exactly the same code
+ * as in a serial run, so results do not depend on the threads count.
+ * The body must not throw.
+ *
+ * @param begin first element
+ * @param end one past the last element
+ * @param min_chunk the minimum number of elements worth a thread
+ * @param body callable(size_t chunk_begin, size_t chunk_end)
+ * @param alignment the chunk sizes granularity, e.g. the rows a GEMM micro-kernel handles at once
+ */
+template <class F>
+void parallel_for(const size_t begin, const size_t end, const size_t min_chunk, F&& body, const size_t alignment = 1) {
+    if (end <= begin) {
+        return;
+    }
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    body(begin, end);  // no threads in this build
+    return;
+#endif
+    const size_t count{end - begin};
+    const size_t max_chunks{std::max<size_t>(1, count / std::max<size_t>(min_chunk, 1))};
+    const size_t threads{std::min<size_t>(max_chunks, parallel_max_threads().load())};
+    if (threads <= 1) {
+        body(begin, end);
+        return;
+    }
+
+    const size_t granularity{std::max<size_t>(alignment, 1)};
+    const size_t chunk_size{((count + threads - 1) / threads + granularity - 1) / granularity * granularity};
+    const size_t chunks{(count + chunk_size - 1) / chunk_size};
+    ThreadPool::instance().run(chunks, [&body, begin, end, chunk_size](const size_t chunk) {
+        const size_t chunk_begin{begin + chunk * chunk_size};
+        body(chunk_begin, std::min(end, chunk_begin + chunk_size));
+    });
+}
+
+}  // namespace VPUNN
+
+#endif  // CORE_PARALLEL_H
@@ -0,0 +1,148 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#ifndef CORE_PERSISTENT_CACHE_H
+#define CORE_PERSISTENT_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "core/vpunn_api.h"
+
+namespace VPUNN {
+
+/**
+ * @brief Inferred values kept in a file, so that they are known again by the next processes (warm start)
+ *
+ * The file is a header, then records of a key (fingerprint of the model and of the descriptor) and a value, each with
+ * a check word, appended. All the records are read when the file is opened, later lookups are in memory.
+ * Several processes can use the same file: the first one to open it is the writer (it holds an exclusive lock on
+ * the file until it closes it), the others only read, and pick up the records appended by the writer on refresh.
+ * A lookup of an unknown key refreshes at most once per refresh interval, so a reader missing often does not read the
+ * file on every miss. An incomplete or corrupted record ends the valid part of the file, the writer truncates it there.
+ *
+ * Writer handover: when the writer closes the file (or its process exits, the OS releases the lock) a reader opened
+ * as writable takes the lock on its next refresh and becomes the writer, the values it adds from then on are appended.
+ * A header left incomplete (a writer stopped while creating the file) is written again by the next writer, the
+ * readers retry reading it on refresh: is_open becomes true once it is complete.
+ *
+ * Size: the file and the memory hold at most max_records records. The writer compacts the file when it takes it over
+ * with more than half of them, and when it is full: the file is rewritten with the newest half, and a new generation
+ * in the header. The readers see the new generation on refresh and read the file again from the start, keeping only
+ * its records (a value added by a reader is dropped then).
+ * Thread safe, one instance can be used by several cost models of a process.
+ */
+class VPUNN_API(PersistentCache) {
+private:
+    std::unordered_map<uint64_t, float> values;  ///< all the records read or written
+    intptr_t file{-1};                           ///< OS file descriptor/handle, -1 if the file could not be opened
+    bool writer{false};                          ///< this instance holds the write lock of the file
+    bool can_take_over{false};                   ///< opened for writing without the lock, tries to lock on refresh
+    bool valid{false};                           ///< the header is correct, records can be read/appended
+    bool foreign{false};                         ///< the file is not a cache file (wrong header), it is not used
+    uint64_t read_offset{0};                     ///< bytes of the file already read (or written by this instance)
+    uint64_t generation{0};                      ///< of the file contents read, see the header
+    size_t max_records;                          ///< the most records kept in the file and in memory
+    /// @brief the minimum time between two refreshes made by get misses
+    std::chrono::milliseconds refresh_interval{100};
+    /// @brief the earliest time a get miss refreshes again
+    std::chrono::steady_clock::time_point next_refresh{};
+    mutable std::mutex values_mutex;
+
+    /// @brief reads the records appended since the last read, invalid ones end the file. Called with the lock taken
+    size_t read_new_records();
+
+    /// @brief takes the write lock if possible, then reads the new records. Called with the lock taken
+    size_t refresh_records();
+
+    /// @brief with the write lock taken: writes the header if incomplete, reads the records and drops what follows them,
+    /// compacts the file if it has more than half of max_records
+    size_t start_writing();
+
+    /// @brief the number of records in the file, read or written
+    uint64_t file_records() const;
+
+    /// @brief the writer rewrites the file with a new generation header and the records given. false on a file error
+    bool rewrite(const void* records, const size_t count);
+
+    /// @brief the writer rewrites the file with its newest max_records / 2 records, which are then the values in
+    /// memory. false on a file error
+    bool compact();
+
+public:
+    /// @brief default maximum number of records, 16 MB of file
+    static constexpr size_t default_max_records{size_t{1} << 20};
+
+    /**
+     * @brief Opens or creates a cache file
+     * Does not throw: if the file cannot be used (permissions, not a cache file) the cache works in memory only
+     *
+     * @param filename the cache file
+     * @param writable try to be the writer of the file. If another process is, this one only reads
+     * @param max_records the most records kept in the file and in memory (16 bytes each in the file), at least 2
+     */
+    explicit PersistentCache(const std::string& filename, const bool writable = true,
+                             const size_t max_records = default_max_records);
+
+    PersistentCache(const PersistentCache&) = delete;
+    PersistentCache& operator=(const PersistentCache&) = delete;
+
+    /// @brief closes the file, releasing the write lock
+    ~PersistentCache();
+
+    /// @brief true if the file is in use (read, and written if writer). False while the header is incomplete, the
+    /// constructor waits a little for it and refresh retries
+    bool is_open() const {
+        return valid;
+    }
+
+    /// @brief true if the values added are also appended to the file
+    bool is_writer() const {
+        return valid && writer;
+    }
+
+    /**
+     * @brief Get a value from the cache. A reader refreshes if the key is not known and the refresh interval elapsed
+     *
+     * @param key the fingerprint of the model and workload descriptor
+     * @param value [out] the cached value, if available
+     * @return true if the value was available
+     */
+    bool get(const uint64_t key, float& value);
+
+    /**
+     * @brief Add a value to the cache, appended to the file by the writer. A full writer compacts the file first, a
+     * full reader does not keep the value
+     *
+     * @param key the fingerprint of the model and workload descriptor
+     * @param value the value
+     */
+    void add(const uint64_t key, const float value);
+
+    /**
+     * @brief Reads the records appended to the file by the writer since the last read, at once
+     * A reader opened as writable first tries to become the writer, see the writer handover above.
+     *
+     * @return the number of records read
+     */
+    size_t refresh();
+
+    /// @brief sets the minimum time between two refreshes made by get misses, zero refreshes on every miss
+    void set_refresh_interval(const std::chrono::milliseconds interval);
+
+    /// @brief the number of values in the cache
+    size_t size() const;
+};
+
+}  // namespace VPUNN
+
+#endif  // CORE_PERSISTENT_CACHE_H
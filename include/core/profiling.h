@@ -10,7 +10,9 @@
 #ifndef CORE_PROFILING_H
 #define CORE_PROFILING_H
 
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 
 namespace VPUNN {
 
@@ -36,6 +38,45 @@ inline double tock(std::chrono::high_resolution_clock::time_point t1) {
     return ms_double.count();
 }
 
+/**
+ * @brief Cumulative timing statistics of a repeated operation: calls, total, min, average and max time
+ */
+struct ProfileStats {
+    size_t calls{0};       ///< how many times the operation was measured
+    double total_ms{0.0};  ///< the sum of all the measured times, milliseconds
+    double min_ms{0.0};    ///< the shortest time, milliseconds
+    double max_ms{0.0};    ///< the longest time, milliseconds
+
+    /// @brief records one measurement
+    void add(const double ms) {
+        min_ms = (calls == 0) ? ms : std::min(min_ms, ms);
+        max_ms = (calls == 0) ? ms : std::max(max_ms, ms);
+        total_ms += ms;
+        ++calls;
+    }
+
+    /// @brief adds the measurements of another statistics
+    void merge(const ProfileStats& other) {
+        if (other.calls == 0) {
+            return;
+        }
+        min_ms = (calls == 0) ? other.min_ms : std::min(min_ms, other.min_ms);
+        max_ms = (calls == 0) ? other.max_ms : std::max(max_ms, other.max_ms);
+        total_ms += other.total_ms;
+        calls += other.calls;
+    }
+
+    /// @brief the average time, milliseconds. Zero if nothing was measured
+    double average_ms() const {
+        return (calls > 0) ? total_ms / static_cast<double>(calls) : 0.0;
+    }
+
+    /// @brief forgets all the measurements
+    void reset() {
+        *this = ProfileStats{};
+    }
+};
+
 /**
  * @brief Syncronous timeout class
  *
@@ -0,0 +1,174 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#ifndef VPUNN_SHARED_CACHE
+#define VPUNN_SHARED_CACHE
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "core/cache.h"
+
+namespace VPUNN {
+
+/**
+ * @brief A thread safe workload cache, to be shared by several cost models (and threads)
+ *
+ * The keys are spread over independent shards, each one a LRUCache with its own lock, so threads working on different
+ * keys rarely wait for each other. Each shard applies the replacement policy to its own entries, the whole cache
+ * approximately follows it.
+ *
+ * @tparam T workload datatype
+ */
+template <class T>
+class SharedLRUCache {
+private:
+    /// @brief a part of the cache, allocated separately so the locks of different shards are not in the same line
+    struct Shard {
+        std::mutex mutex;
+        LRUCache<T> cache;
+
+        Shard(const size_t max_size, const CachePolicy policy): cache(max_size, policy) {
+        }
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    uint64_t shard_mask;
+
+    /// @brief the shard of a key, from its high bits (the low ones select the slot inside the shard)
+    Shard& shard_of(const uint64_t key) const {
+        return *shards[static_cast<size_t>((key >> 40) & shard_mask)];
+    }
+
+public:
+    /**
+     * @brief Construct a new SharedLRUCache object
+     *
+     * @param max_size the maximum size of the cache, 0 disables it
+     * @param shards_count how many independently locked shards, rounded down to a power of 2. More shards, less
+     * contention but a less precise LRU
+     * @param policy how each shard chooses the value to drop when full
+     */
+    explicit SharedLRUCache(const size_t max_size, const size_t shards_count = 64,
+                            const CachePolicy policy = CachePolicy::LRU) {
+        size_t count{1};
+        while (count * 2 <= shards_count && count * 2 <= max_size) {
+            count *= 2;
+        }
+        // max_size split exactly: the first max_size % count shards hold one more entry
+        for (size_t idx = 0; idx < count; ++idx) {
+            const size_t shard_size{max_size / count + ((idx < max_size % count) ? 1 : 0)};
+            shards.push_back(std::make_unique<Shard>(shard_size, policy));
+        }
+        shard_mask = count - 1;
+    }
+
+    /**
+     * @brief A shared cache bounded by the memory it uses instead of an entry count, see LRUCache::with_max_bytes
+     *
+     * @param max_bytes the memory budget of all the shards together
+     * @param shards_count how many independently locked shards, see the constructor
+     * @param policy how each shard chooses the value to drop when full
+     * @return the cache, to be passed to the cost models (VPUCostModel::share_cache)
+     */
+    static std::shared_ptr<SharedLRUCache> with_max_bytes(const size_t max_bytes, const size_t shards_count = 64,
+                                                          const CachePolicy policy = CachePolicy::LRU) {
+        size_t count{1};
+        while (count * 2 <= shards_count) {
+            count *= 2;
+        }
+        // fewer shards if the budget of each one is too small for an entry
+        size_t shard_size{LRUCache<T>::capacity_for_bytes(max_bytes / count, policy)};
+        while (shard_size == 0 && count > 1) {
+            count /= 2;
+            shard_size = LRUCache<T>::capacity_for_bytes(max_bytes / count, policy);
+        }
+        const size_t max_size{shard_size * count};
+        return std::make_shared<SharedLRUCache>(max_size, count, policy);
+    }
+
+    SharedLRUCache(const SharedLRUCache&) = delete;
+    SharedLRUCache& operator=(const SharedLRUCache&) = delete;
+
+    /**
+     * @brief Get a workload value from the cache
+     *
+     * @param key the fingerprint of the workload descriptor
+     * @param value [out] the cached value, if available
+     * @return true if the value was available
+     */
+    bool get(const uint64_t key, T& value) {
+        Shard& shard = shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const T* const cached = shard.cache.get(key);
+        if (cached == nullptr) {
+            return false;
+        }
+        value = *cached;
+        return true;
+    }
+
+    /**
+     * @brief Add a workload value to the cache
+     *
+     * @param key the fingerprint of the workload descriptor
+     * @param value the workload value
+     */
+    void add(const uint64_t key, const T& value) {
+        Shard& shard = shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.cache.add(key, value);
+    }
+
+    /// @brief the number of workloads in the cache
+    size_t size() const {
+        size_t total{0};
+        for (const auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->cache.size();
+        }
+        return total;
+    }
+
+    /// @brief a snapshot of the usage counters, summed over the shards
+    CacheStatistics statistics() const {
+        CacheStatistics total;
+        for (const auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->cache.statistics();
+        }
+        return total;
+    }
+
+    /// @brief sets the usage counters to zero, the cached workloads stay
+    void reset_statistics() {
+        for (const auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->cache.reset_statistics();
+        }
+    }
+
+    /// @brief the number of shards
+    size_t shards_count() const {
+        return shards.size();
+    }
+
+    /// @brief removes all the workloads
+    void clear() {
+        for (const auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->cache.clear();
+        }
+    }
+};
+
+}  // namespace VPUNN
+
+#endif  // VPUNN_SHARED_CACHE
@@ -12,6 +12,7 @@
 
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <numeric>
 #include <random>
 #include <sstream>  // for error formating
@@ -32,7 +33,9 @@ class VPUNN_API(Tensor) {
 private:
     std::vector<unsigned int> _dimensions;  ///< describes the data  represented as a multidimensional tensor
     int _size;                              ///< number of elements in the _data array
-    T* _data;                               ///< the data array. The instance is the owner of this heap allocated memory
+    int _capacity;                          ///< number of elements allocated, at least _size
+    T* _data;     ///< the data array. Heap allocated and owned by the instance, unless this is a view
+    bool _owner;  ///< false for views: _data is memory owned by somebody else, not released by this instance
 
 public:
     /**
@@ -41,8 +44,9 @@ public:
      *
      * @param dimensions a vector of unsigned integers representing the Tensor's dimensions
      */
-    explicit Tensor(const std::vector<unsigned int>& dimensions): _dimensions(dimensions) {
+    explicit Tensor(const std::vector<unsigned int>& dimensions): _dimensions(dimensions), _owner(true) {
         _size = std::accumulate(begin(dimensions), end(dimensions), 1, std::multiplies<unsigned int>());
+        _capacity = _size;
         _data = new T[_size];
     }
 
@@ -53,8 +57,39 @@ public:
      * @param dimensions a vector of unsigned integers representing the Tensor's dimensions. Must be consistent with
      * what data holds
      */
-    Tensor(T* data, const std::vector<unsigned int>& dimensions): _dimensions(dimensions), _data(data) {
+    Tensor(T* data, const std::vector<unsigned int>& dimensions): _dimensions(dimensions), _data(data), _owner(true) {
         _size = std::accumulate(begin(dimensions), end(dimensions), 1, std::multiplies<unsigned int>());
+        _capacity = _size;
+    }
+
+    /**
+     * @brief Construct a new Tensor object that is a view on existing memory, no allocation or copy is done
+     * The memory is not owned, it must outlive this tensor (and its moved-to instances). Copies of a view are
+     * normal, owning, tensors.
+     *
+     * @param dimensions a vector of unsigned integers representing the Tensor's dimensions. Must be consistent with
+     * what data holds
+     * @param data a pointer to the memory to be viewed as a tensor
+     */
+    static Tensor view(const std::vector<unsigned int>& dimensions, T* data) {
+        Tensor tensor(data, dimensions);
+        tensor._owner = false;
+        return tensor;
+    }
+
+    /**
+     * @brief Construct a read-only Tensor object that is a view on read-only memory, e.g. a file mapped with PROT_READ
+     * Same as view, but only a const tensor is handed out, so the memory cannot be written through it
+     *
+     * @param dimensions a vector of unsigned integers representing the Tensor's dimensions. Must be consistent with
+     * what data holds
+     * @param data a pointer to the memory to be viewed as a tensor, must outlive the tensor
+     * @return the const tensor
+     */
+    static std::unique_ptr<const Tensor> const_view(const std::vector<unsigned int>& dimensions, const T* data) {
+        std::unique_ptr<Tensor> tensor{new Tensor(const_cast<T*>(data), dimensions)};  // never written, see above
+        tensor->_owner = false;
+        return std::unique_ptr<const Tensor>{std::move(tensor)};
     }
 
     /**
@@ -75,6 +110,8 @@ public:
     Tensor(const Tensor& tensor) {
         _dimensions = tensor._dimensions;
         _size = tensor._size;
+        _capacity = tensor._size;  // only the used part is copied
+        _owner = true;
 
         // allocate new memory and then copy
         _data = new T[_size];
@@ -87,12 +124,17 @@ public:
      *
      * @param tensor to move the contents from
      */
-    Tensor(Tensor&& tensor) noexcept: _dimensions{std::move(tensor._dimensions)}, _size{tensor._size} {
-        _data = tensor._data;  // move the data, now we own it
+    Tensor(Tensor&& tensor) noexcept
+            : _dimensions{std::move(tensor._dimensions)},
+              _size{tensor._size},
+              _capacity{tensor._capacity},
+              _owner{tensor._owner} {
+        _data = tensor._data;  // move the data, now we own it (or view it)
 
         // leave the source tensor in a consistent state
         tensor._data = nullptr;  // remove the data from previous owner
         tensor._size = 0;
+        tensor._capacity = 0;
     }
 
     /**
@@ -107,12 +149,14 @@ public:
             return *this;  // self assignment
         }
 
-        if (_data != nullptr) {
+        if (_data != nullptr && _owner) {
             delete[] _data;  // clean up already allocated memory
         }
 
         _dimensions = tensor._dimensions;
         _size = tensor._size;
+        _capacity = tensor._size;
+        _owner = true;
 
         // allocate new memory and then copy
         _data = new T[_size];
@@ -135,6 +179,8 @@ public:
         std::swap(this->_data, tensor._data);  // our data will be deallocated by the tensor's destruction
         std::swap(this->_dimensions, tensor._dimensions);
         std::swap(this->_size, tensor._size);
+        std::swap(this->_capacity, tensor._capacity);
+        std::swap(this->_owner, tensor._owner);
 
         return *this;
     }
@@ -144,7 +190,18 @@ public:
      *
      */
     ~Tensor() {
-        delete[] _data;
+        if (_owner) {
+            delete[] _data;
+        }
+    }
+
+    /**
+     * @brief Check if the tensor is a view on memory it does not own
+     *
+     * @return true if the tensor does not own its data
+     */
+    bool is_view() const {
+        return !_owner;
     }
 
     /**
@@ -248,6 +305,44 @@ public:
         return _dimensions;
     }
 
+    /**
+     * @brief Return the number of elements the tensor memory can hold, the size it had at allocation
+     *
+     * @return int
+     */
+    int capacity() const {
+        return _capacity;
+    }
+
+    /**
+     * @brief Change the first dimension (like the batch) without any reallocation
+     * The memory allocated at creation is reused, so the new shape must fit in it. The content is kept as it is, the
+     * data pointer does not change
+     *
+     * @param first_dimension the new value of the first dimension, must not be zero
+     * @throws runtime_error in case the new shape does not fit in the allocated memory
+     * @return Tensor& self reference
+     */
+    Tensor& resize_first_dimension(const unsigned int first_dimension) {
+        if (_dimensions.empty() || first_dimension == _dimensions[0]) {
+            return *this;
+        }
+        const int new_size{static_cast<int>(
+                std::accumulate(_dimensions.begin() + 1, _dimensions.end(), first_dimension,
+                                std::multiplies<unsigned int>()))};
+        if (first_dimension == 0 || new_size > _capacity) {
+            std::stringstream buffer;
+            buffer << "[ERROR]Tensor::resize_first_dimension(), First dimension: " << first_dimension
+                   << " needs a size of " << new_size << " elements, the allocated memory holds: " << _capacity
+                   << " No resize performed! "
+                   << " File: " << __FILE__ << " Line: " << __LINE__;
+            throw std::runtime_error(buffer.str());
+        }
+        _dimensions[0] = first_dimension;
+        _size = new_size;
+        return *this;
+    }
+
     /**
      * @brief Fill a tensor with a value
      *
@@ -0,0 +1,145 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#ifndef INFERENCE_AOT_MODEL_H
+#define INFERENCE_AOT_MODEL_H
+
+#include <string>
+#include <vector>
+
+#include "core/vpunn_api.h"
+#include "kernels/fully_connected.h"
+#include "kernels/kNN.h"
+
+namespace VPUNN {
+
+/**
+ * @brief Base of the models compiled ahead of time by vpunn_aot (see vpunn_add_aot_model in src/aot/CMakeLists.txt)
+ * A generated model holds its weights as constants in the program, already packed for the FC kernels, and its forward
+ * pass is the list of the model layers with all the shapes known at compile time: there is no model file, no parsing
+ * and no plan at runtime. The interface follows the one of Runtime, results are the same as Runtime with FP32 weights.
+ * An instance owns only its activation buffers and the scratch memory of its kNN layers, allocated once for the maximum
+ * batch: a predict does not allocate.
+ */
+class VPUNN_API(AotModel) {
+public:
+    virtual ~AotModel() = default;
+
+    /// @brief always true, the model is part of the program
+    bool initialized() const {
+        return true;
+    }
+
+    /// @brief name of the network the model was generated from
+    const std::string& network_name() const {
+        return name;
+    }
+
+    /// @brief the maximum batch, the one the activations are allocated for
+    unsigned int max_batch() const {
+        return batch_capacity;
+    }
+
+    /// @brief shape of the input, the first dimension is the maximum batch
+    std::vector<std::vector<unsigned int>> input_shapes() const {
+        return {{batch_capacity, slot_row_sizes[input_slot]}};
+    }
+
+    /// @brief shape of the output, the first dimension is the maximum batch
+    std::vector<std::vector<unsigned int>> output_shapes() const {
+        return {{batch_capacity, slot_row_sizes[output_slot]}};
+    }
+
+    /**
+     * @brief Run the inference
+     * The batch is given by the input size, any number of input rows up to max_batch(), only those rows are computed
+     *
+     * @param input_array input data
+     * @param input_size input data size
+     * @return pointer to the output rows, valid until the next predict
+     * @throws runtime_error if the size is not a whole number of rows fitting in the maximum batch
+     */
+    const float* predict(const float* input_array, const unsigned int input_size);
+
+    /**
+     * @brief Run the inference
+     * The batch is given by the input size, any number of input rows up to max_batch(), only those rows are computed
+     *
+     * @param input_tensor input data
+     * @return the output rows of the batch
+     * @throws runtime_error if the size is not a whole number of rows fitting in the maximum batch
+     */
+    const std::vector<float> predict(const std::vector<float>& input_tensor);
+
+protected:
+    /**
+     * @brief Allocates the activations of a generated model
+     *
+     * @param network the network name
+     * @param batch the maximum batch
+     * @param row_sizes the size of one row of each activation buffer, in floats
+     * @param input the buffer that is the model input
+     * @param output the buffer that is the model output
+     * @param repacked_weights the FC weights layout the model was generated with
+     * @throws runtime_error if the FC weights were generated for a layout other than the one of this build
+     */
+    AotModel(const char* network, const unsigned int batch, std::vector<unsigned int> row_sizes,
+             const unsigned int input, const unsigned int output, const bool repacked_weights);
+
+    /// @brief runs the layers on the first rows of the input buffer
+    virtual void forward(const unsigned int rows) = 0;
+
+    /// @brief an activation buffer, of max_batch() rows
+    float* buffer(const unsigned int slot) {
+        return buffers[slot].data();
+    }
+
+    /// @brief FC layer, with bias and activation fused. The weights are packed as the FC kernels of this build want
+    static void dense(const float* packed_weights, const int output_channels, const int input_channels,
+                      const float* bias, const float* input, const unsigned int rows, float* output,
+                      const DenseActivation activation) {
+        FusedDense(packed_weights, output_channels, input_channels, bias, input, static_cast<int>(rows), output,
+                   activation);
+    }
+
+    /// @brief L2 normalization layer, the input rows are normalized in place then copied to the output
+    static void l2_normalization(float* input, const unsigned int rows, const unsigned int channels, float* output);
+
+    /**
+     * @brief Adds the scratch memory of a kNN layer, sized for max_batch(). Called by the generated constructor
+     *
+     * @param items the items of the kNN database
+     * @param n_neighbours the neighbours considered
+     * @return the index of the workspace, to give to knn
+     */
+    unsigned int add_knn_workspace(const unsigned int items, const unsigned int n_neighbours);
+
+    /// @brief kNN layer on a database [items, embedding] with its targets [items, outputs], in a workspace added by
+    /// add_knn_workspace
+    void knn(const unsigned int workspace, const float* weights, const float* targets, const unsigned int items,
+             const unsigned int embedding, const unsigned int outputs, const unsigned int n_neighbours, float* input,
+             const unsigned int rows, float* output);
+
+    /// @brief the activation of a layer that is not a FC, applied in place
+    static void activate(float* data, const unsigned int size, const DenseActivation activation);
+
+private:
+    std::string name;                          ///< the network name
+    unsigned int batch_capacity;               ///< the maximum batch
+    std::vector<unsigned int> slot_row_sizes;  ///< floats per row of each activation buffer
+    unsigned int input_slot;                   ///< the buffer holding the input
+    unsigned int output_slot;                  ///< the buffer holding the output
+    std::vector<std::vector<float>> buffers;   ///< the activations, max batch rows each
+    std::vector<KNNWorkspace> knn_workspaces;  ///< the scratch memory of each kNN layer, for the max batch
+    unsigned int current_rows{0};              ///< the rows of the last predict
+};
+
+}  // namespace VPUNN
+
+#endif  // INFERENCE_AOT_MODEL_H
@@ -11,15 +11,20 @@
 #define SCHEMA_PARSER_H
 
 #include <stdio.h>
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <string>
 #include <vector>
 
 #include "core/logger.h"
+#include "core/profiling.h"
 #include "core/tensors.h"
 #include "core/vpunn_api.h"
+#include "inference/model_store.h"
 #include "kernels/bias.h"
 #include "kernels/fully_connected.h"
 #include "kernels/kNN.h"
@@ -29,18 +34,64 @@
 #include "vpunn_generated.h"
 
 namespace VPUNN {
+/**
+ * @brief The profiling of one layer of a model
+ */
+struct LayerProfile {
+    unsigned int layer{0};         ///< position of the layer in the model operators
+    std::string operation;         ///< FullyConnected, L2Normalization, kNN or None
+    std::string activation;        ///< None, ReLU or Sigmoid
+    bool fused_activation{false};  ///< the activation is done by the kernel (FC), otherwise in a separate pass
+    ProfileStats kernel;           ///< the layer kernel, the fused activation included
+    ProfileStats activation_pass;  ///< the separate activation pass, never called if fused or None
+};
+
 /**
  * @brief VPUNN inference model
  * After creation can be used only if the model was initialized, otherwise will crash
+ * The model data and weights are in an immutable ModelStore, shared between all instances loaded from the same file
+ * (see ModelRegistry). An instance owns only its activation tensors.
  *
  */
 class VPUNN_API(InferenceModel) {
 private:
-    std::vector<char> buf;
+    /// @brief the operation of a plan step
+    enum class StepOperation { DENSE, L2_NORMALIZATION, KNN, NONE };
+
+    /// @brief one layer of the compiled plan, with all its operands resolved
+    struct PlanStep {
+        StepOperation operation{StepOperation::NONE};
+        Tensor<float>* input{nullptr};                      ///< the activations
+        Tensor<float>* output{nullptr};                     ///< the layer output
+        const Tensor<float>* weights{nullptr};              ///< kNN weights, a constant of the store
+        const Tensor<float>* extra{nullptr};                ///< FC bias (null if none), kNN targets, constants
+        const PackedDenseWeights* packed{nullptr};          ///< FC prepacked weights
+        DenseActivation activation{DenseActivation::NONE};  ///< fused for FC, applied after the others
+        unsigned int n_neighbours{0};                       ///< kNN neighbours
+        KNNWorkspace* workspace{nullptr};                   ///< kNN scratch memory, in knn_workspaces
+    };
+
+    std::shared_ptr<const ModelStore> store;    ///< the model data, weights and prepacked weights. Shared, read only
     const VPUNN_SCHEMA::Model* model{nullptr};  //< the flatbuffer model. todo: make it reference?
-    std::vector<Tensor<float>> tensor_map;
+    std::vector<Tensor<float>> tensor_map;      ///< the activations, in the arena. Constants are only placeholders
+    std::vector<flatbuffers::uoffset_t> batched_tensors;  ///< the activations that have the batch as first dimension
+    std::vector<float> arena;             ///< the memory of all the activations, see plan_arena
+    size_t arena_begin{0};                ///< the first float of arena aligned to arena_alignment bytes
+    size_t arena_size{0};                 ///< the floats of arena used by the activations, from arena_begin
+    unsigned int max_batch{0};            ///< the batch the activations are allocated for
+    unsigned int current_batch{0};        ///< the batch of the next predict, at most max_batch
+    std::vector<PlanStep> plan;           ///< the layers, compiled by allocate_tensors, pointing into tensor_map
+    /// @brief the scratch memory of the kNN steps, one each, sized for max_batch so that predict does not allocate
+    std::vector<KNNWorkspace> knn_workspaces;
+    Tensor<float>* plan_input{nullptr};   ///< the input tensor, in tensor_map
+    Tensor<float>* plan_output{nullptr};  ///< the output tensor, in tensor_map
+    bool profiling{false};                ///< predict measures every step when set
+    bool sparse_first_layer{false};       ///< the first step is a FC reading only the model input, see predict_sparse
+    std::vector<LayerProfile> profiles;   ///< one per plan step
     bool initialized;
-    BiasOp bias;  ///< the bias operation support. Contains the bias buffer.
+
+    /// @brief takes the model from a store, if the store exists
+    void set_store(std::shared_ptr<const ModelStore> model_store);
 
     /// @brief Parse a flatbuffer vector into a std vectors with tensor dimensions
     /// First position is special and treated as batch. may be changed
@@ -61,6 +112,15 @@ private:
         return vv;
     }
 
+    /// @brief a layer operand: the constant of the store (read only), else the activation. Null if no such tensor
+    const Tensor<float>* operand(const int tensor_idx) const {
+        const auto constant = store->constant_tensor(tensor_idx);
+        if (constant != nullptr || tensor_idx < 0 || tensor_idx >= static_cast<int>(tensor_map.size())) {
+            return constant;
+        }
+        return &tensor_map[tensor_idx];
+    }
+
     // Get the tensors from tensor_map from the schema
     template <typename T>
     std::vector<Tensor<float>*> get_tensors_from_index(const flatbuffers::Vector<T>* tensors) {
@@ -72,19 +132,41 @@ private:
         return result;
     }
 
-    // Run an individual layer
-    void run_layer(const VPUNN_SCHEMA::Layer* layer);
+    /// @brief the alignment of each activation in the arena, in bytes (a cache line)
+    static constexpr size_t arena_alignment{64};
 
-    /// @ brief returns the maximum value for dimension zero (the batch size) among all tensors
-    int max_batch_in_tensors() const {
-        int max_dim_zero = 0;
-        for (auto it = tensor_map.begin(); it != tensor_map.end(); ++it) {
-            const int dim_zero = (*it).shape()[0];
-            max_dim_zero = std::max(max_dim_zero, dim_zero);
-        }
-        return max_dim_zero;
+    /**
+     * @brief Places the activations in one arena, the ones never live at the same time share memory
+     * An activation is live from the first layer using it to the last one. The ones not produced by a layer (the model
+     * input) and the model outputs are live during the whole predict, so they are never overwritten.
+     *
+     * @param sizes the size of each tensor in floats, zero for the constants
+     * @return the offset of each activation in the arena, in floats, aligned to arena_alignment
+     */
+    std::vector<size_t> plan_arena(const std::vector<size_t>& sizes);
+
+    /// @brief resolves the model operators into the plan, once the tensors are allocated
+    /// @throws runtime_error if a layer does not have the operands its operation needs
+    void compile_plan();
+
+    /// @brief Run an individual plan step, the kernel then the separate activation pass
+    static void run_step(const PlanStep& step) {
+        run_kernel(step);
+        run_activation(step);
     }
 
+    /// @brief Run the kernel of a plan step, with its activation if fused
+    static void run_kernel(const PlanStep& step);
+
+    /// @brief Run the activation of a plan step, if not fused
+    static void run_activation(const PlanStep& step);
+
+    /// @brief the plan from first_step, with each step measured in profiles
+    void predict_profiled(const size_t first_step = 0);
+
+    /// @brief the FC kernel activation equivalent to the one of a layer
+    static DenseActivation dense_activation(const VPUNN_SCHEMA::ActivationFunctionType activation);
+
 public:
     /**
      * @brief Name of the network stored in the model
@@ -97,18 +179,68 @@ public:
 
     /**
      * @brief Construct a new Inference Model object
+     * The file is loaded only once per process, all instances created from the same file share the model data
      *
      * @param filename .vpunn file
      */
     explicit InferenceModel(const char* filename);
+
+    /**
+     * @brief Construct a new Inference Model object, optionally memory mapping the file
+     * When mapped, the file is not read/copied: the constant tensors are read-only views on the mapped file, shared
+     * with all the other mappings of the same file. The FC weights are packed in the layout of the kernels in memory,
+     * or, if a packed weights directory is given, once into a file there that is mapped too (in memory if it cannot
+     * be written). Nothing is written next to the model. If the mapping fails the file is read as usual.
+     * The mapped file must not be rewritten in place while in use (a truncated mapping raises SIGBUS), a new model
+     * should replace it by renaming.
+     * The file is loaded only once per process, all instances created from the same file share the model data
+     *
+     * @param filename .vpunn file
+     * @param memory_map true to map the file read-only in memory instead of reading it
+     * @param weight_precision the precision the FC weights are stored and computed in, reduced precision trades some
+     * accuracy for a smaller and faster model
+     * @param packed_weights_directory a writable directory for the packed FC weights file of a mapped model, shared by
+     * the processes using it (see ModelStore::from_file). Empty: packed in memory
+     */
+    InferenceModel(const char* filename, const bool memory_map,
+                   const WeightPrecision weight_precision = WeightPrecision::FP32,
+                   const std::string& packed_weights_directory = "");
     /**
      * @brief Construct a new Inference Model object
+     * The model data is private to this instance (and its copies)
      *
      * @param data a pointer to a const char buffer containing the .vpunn model
      * @param length the data buffer length
      * @param with_copy enable/disable memcopy of the original data buffer
+     * @param weight_precision the precision the FC weights are stored and computed in
+     */
+    InferenceModel(const char* data, size_t length, bool with_copy,
+                   const WeightPrecision weight_precision = WeightPrecision::FP32);
+
+    /**
+     * @brief Construct a new Inference Model object on an already loaded model
+     *
+     * @param model_store the model data, can be shared with other instances. Null makes an uninitialized model
      */
-    InferenceModel(const char* data, size_t length, bool with_copy);
+    explicit InferenceModel(std::shared_ptr<const ModelStore> model_store);
+
+    /**
+     * @brief Copy an Inference Model, the copy has its own activations (and plan) on the same shared store
+     *
+     * @param other the model to copy, allocated or not
+     */
+    InferenceModel(const InferenceModel& other);
+
+    /// @brief copy assignment, see the copy constructor
+    InferenceModel& operator=(const InferenceModel& other);
+
+    /// @brief move, the activations memory and the plan pointing in it are moved
+    InferenceModel(InferenceModel&& other) = default;
+
+    /// @brief move assignment
+    InferenceModel& operator=(InferenceModel&& other) = default;
+
+    ~InferenceModel() = default;
 
     /**
      * @brief Check if the NN model is initialized
@@ -121,13 +253,87 @@ public:
     }
 
     /**
-     * @brief Creates/Allocates the activation and weights buffer in memory
+     * @brief Check if the model is memory mapped from its file
+     *
+     * @return true if the model data is a read-only mapping of the file
+     */
+    bool is_memory_mapped() const {
+        return (store != nullptr) && store->is_memory_mapped();
+    }
+
+    /**
+     * @brief The precision the FC weights are stored and computed in
+     *
+     * @return the weights precision, FP32 if the model is not initialized or the BLAS has no reduced precision kernels
+     */
+    WeightPrecision weight_precision() const {
+        return (store != nullptr) ? store->get_precision() : WeightPrecision::FP32;
+    }
+
+    /**
+     * @brief The directory of the packed FC weights file, see the constructor
      *
-     * @param batch the VPUNN inference batch size
+     * @return the directory the model was loaded with, empty if none or the model is not initialized
+     */
+    std::string packed_weights_directory() const {
+        return (store != nullptr) ? store->packed_weights_directory() : std::string{};
+    }
+
+    /**
+     * @brief The model data, weights included, shared with the other instances of the same model
+     *
+     * @return the shared store, null if the model is not initialized
+     */
+    std::shared_ptr<const ModelStore> model_store() const {
+        return store;
+    }
+
+    /**
+     * @brief Creates/Allocates the activation buffers in memory
+     * The weights are not copied, they are views on the shared model store
+     * The activations are views on one aligned arena, packed by their lifetime over the layers (see plan_arena)
+     * The activations are allocated for the maximum batch, any batch up to it can be used later without reallocation
+     * The layers are compiled into a plan with all the operands resolved, predict does no allocation nor model parsing
+     *
+     * @param batch the maximum VPUNN inference batch size, also the initial one
      * @throws runtime_error in case tensors and buffers have a mismatch problem
      */
     void allocate_tensors(const unsigned int batch);
 
+    /**
+     * @brief The memory of the activations, all in one arena where the ones that are not live at the same time share
+     * memory
+     *
+     * @return the arena size in bytes, zero before allocate_tensors
+     */
+    size_t activations_size_in_bytes() const {
+        return arena_size * sizeof(float);
+    }
+
+    /// @brief the start of the activations arena, null before allocate_tensors
+    const float* activations_data() const {
+        return arena.empty() ? nullptr : arena.data() + arena_begin;
+    }
+
+    /**
+     * @brief Changes the batch used by the next predict calls, without any reallocation
+     * Only the rows of the batch are computed
+     *
+     * @param new_batch the new batch, from 1 to the maximum batch given at allocation
+     * @throws runtime_error in case the batch is zero or above the maximum batch
+     */
+    void set_batch(const unsigned int new_batch);
+
+    /// @brief the batch of the next predict
+    unsigned int get_batch() const {
+        return current_batch;
+    }
+
+    /// @brief the maximum batch, the one the activations are allocated for
+    unsigned int get_max_batch() const {
+        return max_batch;
+    }
+
     /**
      * @brief Get the VPUNN input tensors
      *
@@ -148,10 +354,12 @@ public:
 
     /**
      * @brief Set the network inputs tensors values
+     * The batch is deduced from the size: any whole number of input rows up to the maximum batch is accepted
      *
      * @tparam T data buffer datatype
      * @param inputs a data buffer
      * @param size the data buffer size
+     * @throws runtime_error in case the size is not a whole number of rows fitting in the maximum batch
      */
     template <typename T>
     void set_inputs(const T* inputs, const unsigned int size) {
@@ -160,7 +368,13 @@ public:
             throw std::runtime_error("This model has more inputs.Only single input model is valid.");
         }
 
-        tensor_map[model->inputs()->Get(0)].assign(inputs, sizeof(T) * size);
+        auto& input = (plan_input != nullptr) ? *plan_input : tensor_map[model->inputs()->Get(0)];
+        const unsigned int row_size{static_cast<unsigned int>(input.size()) / std::max(input.shape()[0], 1U)};
+        const unsigned int rows{(row_size > 0 && size % row_size == 0) ? size / row_size : 0};
+        if (rows >= 1 && rows <= max_batch) {
+            set_batch(rows);
+        }
+        input.assign(inputs, sizeof(T) * size);  // throws if the size is still not matching
     }
 
     // get network outputs
@@ -176,7 +390,7 @@ public:
             Logger::error() << "Only single output model is valid";
             return nullptr;
         }
-        return tensor_map[model->outputs()->Get(0)].data();
+        return (plan_output != nullptr) ? plan_output->data() : tensor_map[model->outputs()->Get(0)].data();
     }
 
     /**
@@ -191,14 +405,68 @@ public:
             Logger::error() << "Only single output model is valid";
             return {};
         }
-        return tensor_map[model->outputs()->Get(0)].data_vector();
+        return (plan_output != nullptr) ? plan_output->data_vector()
+                                        : tensor_map[model->outputs()->Get(0)].data_vector();
     }
 
     /**
      * @brief Run the inference
+     * Runs the plan compiled by allocate_tensors, with no allocation and no model parsing
      *
      */
     void predict();
+
+    /**
+     * @brief Run the inference on one input row given by its nonzero elements
+     * The NN descriptors are mostly one-hot encodings: when the first layer is a FC the model input is not written,
+     * the FC reads only the weights of the nonzero inputs (see FusedDense). Otherwise, or if the row is not sparse
+     * enough for it to pay off, the row is expanded in the input and predict runs as usual. The batch becomes 1.
+     * The results are the same as predict on the dense row
+     *
+     * @param indexes the positions of the nonzero inputs in the row, increasing
+     * @param values the nonzero inputs
+     * @param nnz number of nonzero inputs
+     * @throws runtime_error if an index is outside the input row
+     */
+    void predict_sparse(const int* indexes, const float* values, const int nnz);
+
+    /// @brief true if predict_sparse skips the zero inputs, false if it expands the row and runs predict
+    bool has_sparse_first_layer() const {
+        return sparse_first_layer;
+    }
+
+    /// @brief the number of steps of the compiled plan, one per model layer. Zero before allocate_tensors
+    size_t plan_size() const {
+        return plan.size();
+    }
+
+    /**
+     * @brief Enables/disables the per layer profiling of predict
+     * When enabled each layer is timed, the statistics are kept (nothing is logged), see layer_profiles()
+     *
+     * @param enable true to measure the layers from now on
+     */
+    void set_profiling(const bool enable) {
+        profiling = enable;
+    }
+
+    /// @brief true if predict measures the layers
+    bool is_profiling() const {
+        return profiling;
+    }
+
+    /// @brief the statistics of every layer, in model order. Empty before allocate_tensors
+    const std::vector<LayerProfile>& layer_profiles() const {
+        return profiles;
+    }
+
+    /// @brief forgets the layer statistics, the profiling stays enabled/disabled
+    void reset_profiling() {
+        for (auto& profile : profiles) {
+            profile.kernel.reset();
+            profile.activation_pass.reset();
+        }
+    }
 };
 
 /// Extracts and keeps  the version out of a NN raw name
@@ -0,0 +1,223 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#ifndef VPUNN_MODEL_STORE_H
+#define VPUNN_MODEL_STORE_H
+
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "core/fingerprint.h"
+#include "core/mapped_file.h"
+#include "core/tensors.h"
+#include "core/vpunn_api.h"
+#include "kernels/fully_connected.h"
+
+#include "vpunn_generated.h"
+
+namespace VPUNN {
+
+/**
+ * @brief The immutable part of a loaded .vpunn model: the flatbuffer, the constant tensors (weights) and the
+ * prepacked FC weights.
+ * The FC weights can be packed in reduced precision (FP16/INT8) for a smaller and faster model. FLOAT16 constant
+ * tensors in the file are converted to float when loaded.
+ * A memory mapped model is not copied: the constants are read-only views on the mapping. Its FC weights are packed in
+ * memory, or, if the caller gives a packed weights directory, once in a file there that is mapped too, by this and the
+ * next processes (nothing is ever written next to the model). If that file cannot be written the FC weights are packed
+ * in memory. Only the FLOAT16 and misaligned constants are copied.
+ * Built once, then only read, so it can be shared (by std::shared_ptr) between any number of InferenceModel instances
+ * and threads. Each InferenceModel keeps only its activation buffers.
+ */
+class VPUNN_API(ModelStore) {
+private:
+    std::vector<char> buf;                              ///< the model bytes, when read or copied
+    std::unique_ptr<const MappedFile> mapped_file;      ///< the model file, when memory mapped
+    std::unique_ptr<const MappedFile> packed_file;      ///< the packed FC weights file, when mapped too
+    std::string packed_filename;                        ///< the name of packed_file, empty if not mapped
+    std::string packed_directory;                       ///< where the packed FC weights file is, empty: in memory
+    const VPUNN_SCHEMA::Model* model{nullptr};          ///< the flatbuffer model, inside buf, the mapping or external
+    std::vector<std::unique_ptr<const Tensor<float>>> constants;  ///< constant tensors by index, null for activations
+    std::vector<PackedDenseWeights> dense_weights;          ///< prepacked FC weights by layer index
+    WeightPrecision precision{WeightPrecision::FP32};       ///< the precision the FC weights are packed in
+    uint64_t content_fingerprint{0};                        ///< fingerprint of the model bytes
+    std::string error;  ///< why the constant tensors could not be created, empty if all went well
+
+    ModelStore() = default;
+
+    /// @brief verifies the flatbuffer and sets the model. False if the data is not a valid model
+    bool set_model(const char* data, size_t length);
+
+    /// @brief creates the constant tensors and packs the FC weights, in the packed weights file if named. Errors are
+    /// kept in error member
+    void prepare_constants(const WeightPrecision weight_precision, const std::string& packed_weights_file);
+
+    /// @brief the weights of a FC layer, null for the other layers
+    const Tensor<float>* dense_layer_weights(const flatbuffers::uoffset_t layer_idx) const;
+
+    /// @brief maps the packed weights file, written first if missing or stale. False if it cannot be used
+    bool map_dense_weights(const std::string& filename, const WeightPrecision weight_precision);
+
+    /// @brief the packed weights file of this model in a directory: the model file name, the model contents
+    /// fingerprint and the precision, so different models packed in the same directory do not replace each other
+    std::string packed_weights_path(const std::string& directory, const std::string& filename,
+                                    const WeightPrecision weight_precision) const;
+
+public:
+    ModelStore(const ModelStore&) = delete;
+    ModelStore& operator=(const ModelStore&) = delete;
+
+    /**
+     * @brief Loads a model from a file
+     *
+     * @param filename .vpunn file
+     * @param memory_map map the file read-only in memory instead of reading it, falls back to reading if not possible
+     * @param weight_precision the precision of the packed FC weights
+     * @param packed_weights_directory where a mapped model keeps its packed FC weights file, written there (atomically,
+     * by rename) by the first process and mapped by the next ones. Empty: packed in memory
+     * @return the store, or null if the file does not exist or is not a valid model
+     */
+    static std::shared_ptr<const ModelStore> from_file(
+            const char* filename, const bool memory_map,
+            const WeightPrecision weight_precision = WeightPrecision::FP32,
+            const std::string& packed_weights_directory = "");
+
+    /**
+     * @brief Loads a model from a buffer
+     *
+     * @param data a pointer to a const char buffer containing the .vpunn model
+     * @param length the data buffer length
+     * @param with_copy copy the buffer, otherwise the buffer must outlive the store
+     * @param weight_precision the precision of the packed FC weights
+     * @return the store, or null if the buffer is not a valid model
+     */
+    static std::shared_ptr<const ModelStore> from_buffer(
+            const char* data, size_t length, bool with_copy,
+            const WeightPrecision weight_precision = WeightPrecision::FP32);
+
+    /// @brief the flatbuffer model
+    const VPUNN_SCHEMA::Model* get_model() const {
+        return model;
+    }
+
+    /// @brief true if the model data is a read-only mapping of the file
+    bool is_memory_mapped() const {
+        return mapped_file != nullptr;
+    }
+
+    /// @brief true if the packed FC weights are a read-only mapping of the packed weights file
+    bool is_dense_weights_mapped() const {
+        return packed_file != nullptr;
+    }
+
+    /// @brief the packed weights file mapped, in the packed weights directory, empty if the FC weights are in memory
+    const std::string& packed_weights_filename() const {
+        return packed_filename;
+    }
+
+    /// @brief the packed weights directory the store was loaded with, empty if none (packed in memory)
+    const std::string& packed_weights_directory() const {
+        return packed_directory;
+    }
+
+    /// @brief the constant tensor with this index, null if the tensor is not a constant (an activation)
+    const Tensor<float>* constant_tensor(const size_t tensor_idx) const {
+        return (tensor_idx < constants.size()) ? constants[tensor_idx].get() : nullptr;
+    }
+
+    /**
+     * @brief Identifies the results of the model: two stores with the same fingerprint infer the same values, e.g.
+     * the same file loaded twice, also in different processes. Made of the model bytes and the weights precision
+     *
+     * @return the 64 bit fingerprint
+     */
+    uint64_t fingerprint() const {
+        return Fingerprint{content_fingerprint}.add(static_cast<uint64_t>(precision)).value();
+    }
+
+    /// @brief the precision the FC weights are packed in (FP32 if the BLAS has no reduced precision kernels)
+    WeightPrecision get_precision() const {
+        return precision;
+    }
+
+    /// @brief the prepacked weights of a FC layer (empty for other layers)
+    const PackedDenseWeights& packed_dense_weights(const size_t layer_idx) const {
+        return dense_weights[layer_idx];
+    }
+
+    /// @brief the problem found when creating the constant tensors, empty if none
+    const std::string& get_error() const {
+        return error;
+    }
+};
+
+/**
+ * @brief Process wide registry of the models loaded from files, so each file is loaded only once.
+ * A file is identified by its name, size, inode and modification/status change times (nanoseconds where the OS
+ * provides them), a changed file is loaded again. The times have the resolution of the OS clock ticks, a rewrite of the
+ * same size within one tick cannot be seen: forget() makes sure the next get() reads the file.
+ * Only weak references are kept, a model is released when the last user goes away.
+ * A file is loaded without holding the registry lock, so the loads of different files run in parallel. The users of a
+ * file being loaded wait for that load instead of starting another one.
+ */
+class VPUNN_API(ModelRegistry) {
+private:
+    /// @brief filename, size, mtime [ns], ctime [ns], inode, device, memory mapped, weights precision, packed weights
+    /// directory
+    using Key = std::tuple<std::string, long long, long long, long long, unsigned long long, unsigned long long, bool,
+                           int, std::string>;
+    /// @brief a model in use, or being loaded
+    struct Entry {
+        std::weak_ptr<const ModelStore> store;                          ///< the loaded model, expired if not in use
+        std::shared_future<std::shared_ptr<const ModelStore>> loading;  ///< the load in progress, if valid
+        unsigned long long load{0};                                     ///< the load in progress, see next_load
+    };
+    std::map<Key, Entry> models;
+    unsigned long long next_load{0};  ///< identifies the loads, a forgotten entry may be loaded again meanwhile
+    mutable std::mutex models_mutex;  ///< for models and next_load, never held during a load
+
+    ModelRegistry() = default;
+
+public:
+    /// @brief the registry of this process
+    static ModelRegistry& instance();
+
+    /**
+     * @brief Provides the store of a model file, loading it only if not already in use. Thread safe
+     *
+     * @param filename .vpunn file
+     * @param memory_map map the file read-only in memory instead of reading it
+     * @param weight_precision the precision of the packed FC weights, each precision is a different store
+     * @param packed_weights_directory see ModelStore::from_file, each directory is a different store
+     * @return the shared store, or null if the file does not exist or is not a valid model
+     */
+    std::shared_ptr<const ModelStore> get(const std::string& filename, const bool memory_map,
+                                          const WeightPrecision weight_precision = WeightPrecision::FP32,
+                                          const std::string& packed_weights_directory = "");
+
+    /**
+     * @brief Forgets the stores of a file, the next get() loads it again. The current users keep their store
+     * Used when the file is known to have changed, e.g. a model reload
+     *
+     * @param filename .vpunn file
+     */
+    void forget(const std::string& filename);
+
+    /// @brief number of models currently loaded and in use
+    size_t size() const;
+};
+
+}  // namespace VPUNN
+
+#endif  // VPUNN_MODEL_STORE_H
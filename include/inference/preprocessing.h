@@ -12,16 +12,31 @@
 
 #include <math.h>
 #include <vpu/types.h>
+#include <algorithm>
+#include <exception>
+#include <memory>
 #include <sstream>  // for error formating
 #include <stdexcept>
 #include <string>
 #include <type_traits>
 #include <vector>
 
+#include "core/parallel.h"
 #include "vpu/validation/dpu_operations_validator.h"
 
 namespace VPUNN {
 
+/**
+ * @brief A NN descriptor given by its nonzero elements, see Preprocessing::sparse
+ *
+ * @tparam T datatype of the descriptor
+ */
+template <class T>
+struct SparseDescriptor {
+    std::vector<int> indexes;  ///< positions of the nonzero elements, increasing
+    std::vector<T> values;     ///< the nonzero elements
+};
+
 /**
  * @brief Class to transform DPUWorkload objects into NN descriptors that can be used by the NN
  *
@@ -35,6 +50,26 @@ protected:
 
     size_t probable_batch_size{1};          ///< most probable batch size
     std::vector<T> batch_processed_output;  ///< descriptor like processed_output, but for batch.
+    SparseDescriptor<T> sparse_output;      ///< the nonzero elements of a descriptor, see sparse()
+
+    /// @brief where the inserters write the descriptor being built: processed_output, or a slot of the batch. Set by
+    /// each transform
+    T* destination{nullptr};
+
+    /// @brief the copies of this preprocessing used by the threads of the batch transform. A copy of the
+    /// preprocessing does not copy them, it makes its own when needed
+    struct WorkerClones {
+        std::vector<std::unique_ptr<Preprocessing<T>>> clones;
+        WorkerClones() = default;
+        WorkerClones(const WorkerClones&) {
+        }
+        WorkerClones& operator=(const WorkerClones&) {
+            return *this;
+        }
+    } workers;
+
+    /// @brief the workloads worth a thread of the batch transform
+    static constexpr size_t parallel_min_workloads{64};
 
     /** @brief verifies that the space available to produce results is at least expected_size
      * @param expected_size minimum size to be OK
@@ -63,11 +98,33 @@ protected:
      */
     virtual const std::vector<T>& generate_descriptor(const DPUWorkload& workload, size_t& debug_offset) = 0;
 
+    /**
+     * @brief Transform a DPUWorkload into a DPUWorkload descriptor written in place, e.g. in its slot of a batch
+     * This default builds the descriptor in processed_output and copies it
+     *
+     * @param workload a DPUWorkload to be transformed
+     * @param slot where the output_size() elements of the descriptor are written, zero filled
+     */
+    virtual void generate_descriptor_into(const DPUWorkload& workload, T* slot) {
+        size_t unused_output_written_offset;
+        const auto& descriptor = generate_descriptor(workload, unused_output_written_offset);
+        std::copy(descriptor.begin(), descriptor.end(), slot);
+    }
+
 public:
     /// @brief provides the interface number this instance implements
     /// @returns the interface version
     virtual int interface_version() const = 0;
 
+    /**
+     * @brief An independent copy of this preprocessing, with its own buffers
+     *
+     * @return the copy, null if this preprocessing cannot be copied
+     */
+    virtual std::unique_ptr<Preprocessing<T>> clone() const {
+        return nullptr;
+    }
+
     /**
      * @brief Construct a new Preprocessing object
      *
@@ -90,6 +147,8 @@ public:
     void set_size(size_t size) {
         processed_output.resize(size, static_cast<T>(0.0));
         zero_vector.resize(size, static_cast<T>(0.0));
+        sparse_output.indexes.reserve(size);
+        sparse_output.values.reserve(size);
     }
     /**
      * @brief reset the DPUWorkload descriptor
@@ -122,12 +181,33 @@ public:
         return generate_descriptor(workload, unsused_output_written_offset);
     };
 
+    /**
+     * @brief The nonzero elements of a descriptor, for a NN first layer that skips the zeros (see
+     * Runtime::predict_sparse). The descriptors are mostly one-hot encodings, only a few elements are not zero
+     *
+     * @param descriptor a descriptor, as made by transform
+     * @return the nonzero elements, valid until the next call
+     */
+    const SparseDescriptor<T>& sparse(const std::vector<T>& descriptor) {
+        sparse_output.indexes.clear();
+        sparse_output.values.clear();
+        for (size_t idx = 0; idx < descriptor.size(); idx++) {
+            if (descriptor[idx] != static_cast<T>(0.0)) {
+                sparse_output.indexes.push_back(static_cast<int>(idx));
+                sparse_output.values.push_back(descriptor[idx]);
+            }
+        }
+        return sparse_output;
+    }
+
     /** @brief default virtual destructor, we need this because this class is abstract
      */
     virtual ~Preprocessing() = default;
 
     /**
      * @brief Transform DPUWorkloads into a DPUWorkload descriptors
+     * Each descriptor is written directly in its slot of the batch. When parallel_max_threads() allows it, the slots
+     * are filled by several threads, each with its own copy of this preprocessing (see clone)
      *
      * @param workloads a vector of DPUWorkloads
      * @param pad the amount of padding to add (default 1), the batch size
@@ -137,14 +217,46 @@ public:
         //<all workloads, normalized
         const auto total_workloads{round_up(static_cast<unsigned int>(workloads.size()), pad)};
 
-        // ensure output is big enough, this will not decrease capacity, but make it empty
+        // ensure output is big enough, this will not decrease capacity. All zero, the padding descriptors stay so
         set_probable_batch(total_workloads);
+        const size_t size{output_size()};
+        batch_processed_output.resize(total_workloads * size, static_cast<T>(0.0));
+        T* const batch = batch_processed_output.data();
+
+        const size_t count{workloads.size()};
+        size_t tasks{std::min<size_t>(count / parallel_min_workloads, parallel_max_threads().load())};
+        while (tasks > 1 && workers.clones.size() + 1 < tasks) {
+            auto worker = clone();
+            if (worker == nullptr) {
+                tasks = workers.clones.size() + 1;
+                break;
+            }
+            workers.clones.push_back(std::move(worker));
+        }
+        if (tasks <= 1) {
+            for (size_t idx = 0; idx < count; ++idx) {
+                generate_descriptor_into(workloads[idx], batch + idx * size);
+            }
+            return batch_processed_output;
+        }
 
-        for (long unsigned int idx = 0; idx < total_workloads; ++idx) {
-            const auto& one_descriptor{(idx < workloads.size()) ? transform(workloads[idx]) : zero_vector};
-            assert(one_descriptor.size() == output_size());
-            // copy this result into the big batch descriptor
-            std::copy(one_descriptor.begin(), one_descriptor.end(), std::back_inserter(batch_processed_output));
+        // contiguous ranges of workloads, the tasks must not throw: errors are passed to the caller after the run
+        const size_t per_task{(count + tasks - 1) / tasks};
+        std::vector<std::exception_ptr> errors(tasks);
+        ThreadPool::instance().run(tasks, [&](const size_t task) {
+            Preprocessing<T>& worker = (task == 0) ? *this : *workers.clones[task - 1];
+            try {
+                for (size_t idx = task * per_task; idx < std::min(count, (task + 1) * per_task); ++idx) {
+                    worker.generate_descriptor_into(workloads[idx], batch + idx * size);
+                }
+            } catch (...) {
+                errors[task] = std::current_exception();
+            }
+        });
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
         }
         return batch_processed_output;
     }
@@ -236,7 +348,7 @@ protected:
                 const std::string details = buffer.str();
                 throw std::out_of_range(details);
             }
-            this->processed_output[offset] = data;
+            this->destination[offset] = data;
         }
         return offset + 1;
     }
@@ -286,8 +398,28 @@ public:
         this->reset();                                                          // all on zero
         this->check_and_throw_size(static_cast<D*>(this)->size_of_descriptor);  // will throw in case not enough space
 
+        this->destination = this->processed_output.data();
         return static_cast<D*>(this)->template transformOnly<false>(workload, debug_offset);
     };
+
+    /**
+     * @brief Transform a DPUWorkload into a DPUWorkload descriptor written in place, no copy
+     *
+     * @param workload a DPUWorkload
+     * @param slot where the output_size() elements of the descriptor are written, zero filled
+     */
+    void generate_descriptor_into(const DPUWorkload& workload, T* slot) override {
+        this->check_and_throw_size(static_cast<D*>(this)->size_of_descriptor);  // will throw in case not enough space
+
+        size_t unused_output_written_offset;
+        this->destination = slot;
+        static_cast<D*>(this)->template transformOnly<false>(workload, unused_output_written_offset);
+    }
+
+    /// @brief an independent copy of the concrete preprocessing, with its own buffers
+    std::unique_ptr<Preprocessing<T>> clone() const override {
+        return std::make_unique<D>(static_cast<const D&>(*this));
+    }
 };
 /// @brief enum for NN descriptor versions (input versions)
 enum class NNVersions : int {
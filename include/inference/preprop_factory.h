@@ -14,6 +14,8 @@
 #include <vpu/compatibility/types01.h>  // detailed implementations
 #include <vpu/compatibility/types11.h>  // detailed implementations
 #include <vpu/types.h>
+#include <map>
+#include <memory>
 #include <sstream>  // for error formating
 #include <stdexcept>
 #include <string>
@@ -24,18 +26,20 @@ namespace VPUNN {
 /**
  * @brief Provides processing related objects based on context
  *
- * The provided objects may be bounded(lifespan) to this instance
+ * The factory holds one prototype of each preprocessor, that is never used to transform: every request gets an
+ * independent copy. The factory is only read after construction, so it can be shared by any number of threads (see
+ * instance()).
  */
 class RuntimeProcessingFactory {
 private:
     using PrepropType = Preprocessing<float>;
-    using PreprocessingMap = std::map<int, PrepropType&>;
+    using PreprocessingMap = std::map<int, const PrepropType&>;
 
     // a simple and not optimum (allocates all static)
-    PreprocessingLatest<float> pp_v00_latest;
-    Preprocessing_Interface01<float> pp_v01_base;
-    Preprocessing_Interface10<float> pp_v10;
-    Preprocessing_Interface11<float> pp_v11;
+    const PreprocessingLatest<float> pp_v00_latest;
+    const Preprocessing_Interface01<float> pp_v01_base;
+    const Preprocessing_Interface10<float> pp_v10;
+    const Preprocessing_Interface11<float> pp_v11;
 
     /// @brief the map of versions mapped to preprocessing concrete objects
     const PreprocessingMap pp_map{
@@ -46,22 +50,33 @@ private:
     };
 
 public:
+    RuntimeProcessingFactory() = default;
+
+    /// @brief a copy is a new factory, the map must refer to its own prototypes (all factories are equal)
+    RuntimeProcessingFactory(const RuntimeProcessingFactory&): RuntimeProcessingFactory() {
+    }
+
+    /// @brief the factory shared by the whole process, e.g. by all the cost models
+    static const RuntimeProcessingFactory& instance() {
+        static const RuntimeProcessingFactory factory;
+        return factory;
+    }
+
     /// @brief True if a preprocessor exists for required/interrogated version
     bool exists_preprocessing(int input_version) const noexcept {
         auto found = pp_map.find(input_version);
         return (found != pp_map.cend());
     }
-    /** @brief provides a preprocessor for the required interface
-     * The provided preprocessor is owned by this class.
-     * For NOW multiple requests for the same version will provide the same object, the factory just shares the
-     * preprocessors , does not create a new one for each request
+    /** @brief creates a preprocessor for the required interface
+     * Each request gets a new, independent, preprocessor with its own buffers, owned by the caller. Different
+     * preprocessors can be used from different threads at the same time, with no locking.
      * @param version desired interface version
-     * @return the preprocessor object to be used (shared)
+     * @return the preprocessor object to be used
      * @throws out_of_range in case the version is not supported
      */
-    Preprocessing<float>& make_preprocessing(int version) const {
+    std::unique_ptr<Preprocessing<float>> make_preprocessing(int version) const {
         if (exists_preprocessing(version)) {
-            return pp_map.at(version);
+            return pp_map.at(version).clone();
         }
 
         // throw
@@ -10,6 +10,9 @@
 #ifndef KERNELS_FC_H
 #define KERNELS_FC_H
 
+#include <cstdint>
+#include <vector>
+
 #include "core/tensors.h"
 
 namespace VPUNN {
@@ -24,6 +27,222 @@ namespace VPUNN {
 VPUNN_API(void)
 Dense(const VPUNN::Tensor<float>* weights, const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output);
 
+/// @brief storage precision of the FC weights. Activations and accumulation are always float
+enum class WeightPrecision { FP32, FP16, INT8 };
+
+/**
+ * @brief FC layer weights prepared once (at model load) for the Dense kernel
+ * With the internal BLAS the weights are repacked in register blocked panels, with an external BLAS (MKL/OpenBLAS)
+ * they are kept as they are.
+ * The weights can be stored in reduced precision: FP16, or INT8 quantized per output channel (symmetric, one scale
+ * per channel). An external BLAS has no such kernels, with it the weights always stay FP32.
+ * The packed weights are either owned (pack) or a view on memory that outlives this object (view), e.g. a mapped file
+ * of weights packed once by pack_to.
+ */
+class VPUNN_API(PackedDenseWeights) {
+private:
+    WeightPrecision precision{WeightPrecision::FP32};
+    std::vector<float> packed;         ///< the weights in the layout the GEMM consumes, FP32
+    std::vector<uint16_t> packed_f16;  ///< the weights in the layout the GEMM consumes, FP16
+    std::vector<int8_t> packed_s8;     ///< the weights in the layout the GEMM consumes, INT8
+    std::vector<float> scales;         ///< dequantization scale of each output channel, INT8 only
+    const void* viewed_weights{nullptr};  ///< the packed weights of a view, null if owned
+    const float* viewed_scales{nullptr};  ///< the scales of a view, INT8 only
+    int output_channels{0};
+    int input_channels{0};
+
+    /// @brief the packed weights, owned or viewed
+    const void* weights_data() const {
+        if (viewed_weights != nullptr) {
+            return viewed_weights;
+        }
+        return (precision == WeightPrecision::FP16)   ? static_cast<const void*>(packed_f16.data())
+               : (precision == WeightPrecision::INT8) ? static_cast<const void*>(packed_s8.data())
+                                                      : static_cast<const void*>(packed.data());
+    }
+
+public:
+    /**
+     * @brief Packs the weights of a FC layer
+     *
+     * @param weights a VPUNN::Tensor containing the FC layer weights [output_channels, input_channels]
+     * @param weight_precision how the weights are stored
+     */
+    void pack(const VPUNN::Tensor<float>* weights, const WeightPrecision weight_precision = WeightPrecision::FP32);
+
+    /**
+     * @brief The precision the weights are stored in when this precision is asked for
+     *
+     * @param weight_precision the precision asked for
+     * @return the same precision, or FP32 with an external BLAS (no reduced precision kernels)
+     */
+    static WeightPrecision supported_precision(const WeightPrecision weight_precision);
+
+    /**
+     * @brief The memory needed by the weights of a FC layer packed by pack_to: the INT8 scales then the weights
+     *
+     * @param output_channels number of output channels
+     * @param input_channels number of input channels
+     * @param weight_precision the precision asked for, see supported_precision
+     * @return the size in bytes, a multiple of sizeof(float)
+     */
+    static size_t storage_size(const int output_channels, const int input_channels,
+                               const WeightPrecision weight_precision);
+
+    /**
+     * @brief Packs the weights of a FC layer into external memory, e.g. to be saved in a file and used by view
+     *
+     * @param weights a VPUNN::Tensor containing the FC layer weights [output_channels, input_channels]
+     * @param weight_precision the precision asked for, see supported_precision
+     * @param storage memory of storage_size bytes, aligned for float
+     */
+    static void pack_to(const VPUNN::Tensor<float>* weights, const WeightPrecision weight_precision, void* storage);
+
+    /**
+     * @brief Uses weights already packed (by pack_to, in a build with the same layout_id) without copying them
+     *
+     * @param out_channels number of output channels
+     * @param in_channels number of input channels
+     * @param weight_precision the precision asked for when packing, see supported_precision
+     * @param storage the packed weights, storage_size bytes aligned for float. Must outlive this object
+     */
+    void view(const int out_channels, const int in_channels, const WeightPrecision weight_precision,
+              const void* storage);
+
+    /**
+     * @brief Identifies the packed layout of this build: weights packed by pack_to can be viewed only by a build with
+     * the same layout
+     *
+     * @return the layout identifier
+     */
+    static uint32_t layout_id();
+
+    /// @brief true if no weights were packed
+    bool empty() const {
+        return viewed_weights == nullptr && packed.empty() && packed_f16.empty() && packed_s8.empty();
+    }
+
+    /// @brief true if the weights are a view on external memory, not owned
+    bool is_view() const {
+        return viewed_weights != nullptr;
+    }
+
+    /// @brief the precision the weights are stored in
+    WeightPrecision get_precision() const {
+        return precision;
+    }
+
+    /// @brief the packed weights, FP32
+    const float* c_ptr() const {
+        return static_cast<const float*>(weights_data());
+    }
+
+    /// @brief the packed weights, FP16 bits
+    const uint16_t* c_ptr_f16() const {
+        return static_cast<const uint16_t*>(weights_data());
+    }
+
+    /// @brief the packed weights, INT8
+    const int8_t* c_ptr_s8() const {
+        return static_cast<const int8_t*>(weights_data());
+    }
+
+    /// @brief the dequantization scales of the INT8 weights, one per output channel
+    const float* c_ptr_scales() const {
+        return (viewed_weights != nullptr) ? viewed_scales : scales.data();
+    }
+
+    /// @brief memory used by the packed weights (and scales), in bytes, owned or viewed
+    size_t size_in_bytes() const {
+        return empty() ? 0 : storage_size(output_channels, input_channels, precision);
+    }
+
+    /// @brief number of output channels (first dimension of the source weights)
+    int get_output_channels() const {
+        return output_channels;
+    }
+
+    /// @brief number of input channels (second dimension of the source weights)
+    int get_input_channels() const {
+        return input_channels;
+    }
+
+    /**
+     * @brief The layout of the FP32 packed weights in this build
+     *
+     * @return true if the weights are repacked in panels (internal BLAS), false if they stay [output, input] row major
+     */
+    static bool repacked_layout();
+
+    /// @brief true if the FC can take its input as sparse (see FusedDense with indexes): FP32 weights only
+    bool sparse_input() const {
+        return !empty() && precision == WeightPrecision::FP32;
+    }
+};
+
+/**
+ * @brief Floating point FC layer (float), with prepacked weights
+ *
+ * @param weights the FC layer weights, packed
+ * @param activations the input tensor
+ * @param output the output tensor
+ */
+VPUNN_API(void)
+Dense(const PackedDenseWeights& weights, const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output);
+
+/// @brief activation functions that can be fused in the FC layer
+enum class DenseActivation { NONE, RELU, SIGMOID };
+
+/**
+ * @brief Floating point FC layer (float), with prepacked weights, bias and activation done in one pass.
+ * Same results as Dense followed by Bias and the activation
+ *
+ * @param weights the FC layer weights, packed
+ * @param bias a VPUNN::Tensor containing the bias, can be null
+ * @param activations the input tensor
+ * @param output the output tensor
+ * @param activation the activation function applied on the output
+ */
+VPUNN_API(void)
+FusedDense(const PackedDenseWeights& weights, const VPUNN::Tensor<float>* bias, const VPUNN::Tensor<float>* activations,
+           VPUNN::Tensor<float>* output, const DenseActivation activation);
+
+/**
+ * @brief FusedDense on raw memory, FP32 weights already in the packed layout of this build (see
+ * PackedDenseWeights::repacked_layout), e.g. weights packed ahead of time into generated code
+ *
+ * @param packed_weights the FC layer weights, as PackedDenseWeights::c_ptr() holds them
+ * @param output_channels number of outputs
+ * @param input_channels number of inputs
+ * @param bias the bias, output_channels values, can be null
+ * @param activations the input rows [batch_size, input_channels]
+ * @param batch_size number of rows
+ * @param output the output rows [batch_size, output_channels]
+ * @param activation the activation function applied on the output
+ */
+VPUNN_API(void)
+FusedDense(const float* packed_weights, const int output_channels, const int input_channels, const float* bias,
+           const float* activations, const int batch_size, float* output, const DenseActivation activation);
+
+/**
+ * @brief FusedDense for one input row given by its nonzero elements, e.g. a descriptor made of one-hot encodings
+ * Only the weights of the nonzero input channels are read, the cost is proportional to nnz instead of the input size.
+ * With the internal BLAS the results are the same as FusedDense on the dense row (the skipped terms are the products
+ * by zero)
+ *
+ * @param weights the FC layer weights, packed, must be FP32 (see PackedDenseWeights::sparse_input)
+ * @param bias a VPUNN::Tensor containing the bias, can be null
+ * @param indexes the input channels of the nonzero inputs, increasing
+ * @param values the nonzero inputs
+ * @param nnz number of nonzero inputs
+ * @param output the output tensor, its first row is written
+ * @param activation the activation function applied on the output
+ * @throws runtime_error if the weights are not FP32 or an index is not an input channel
+ */
+VPUNN_API(void)
+FusedDense(const PackedDenseWeights& weights, const VPUNN::Tensor<float>* bias, const int* indexes,
+           const float* values, const int nnz, VPUNN::Tensor<float>* output, const DenseActivation activation);
+
 }  // namespace VPUNN
 
 #endif  // KERNELS_FC_H
\ No newline at end of file
@@ -10,22 +10,65 @@
 #ifndef KERNELS_KNN_H
 #define KERNELS_KNN_H
 
+#include <algorithm>
+#include <utility>
+#include <vector>
 #include "core/tensors.h"
 
 namespace VPUNN {
 
+/**
+ * @brief The scratch memory of kNN, kept between the calls so that a predict does not allocate
+ * Every batch row has its own slice of both buffers, so the rows split between threads share one workspace.
+ */
+struct VPUNN_API(KNNWorkspace) {
+    std::vector<float> distances;                            ///< [batch, items] distance of each row to each item
+    std::vector<std::pair<float, unsigned int>> neighbours;  ///< [batch, n_neighbours] (distance, item) heap per row
+
+    /**
+     * @brief Grows the buffers to the needs of a batch, never shrinks them
+     *
+     * @param batch the rows of the activations
+     * @param items the items of the kNN database
+     * @param n_neighbours the neighbours considered
+     */
+    void reserve(const size_t batch, const size_t items, const size_t n_neighbours) {
+        distances.resize(std::max(distances.size(), batch * items));
+        neighbours.resize(std::max(neighbours.size(), batch * std::min(n_neighbours, items)));
+    }
+};
+
 /**
  * @brief Floating point k-Nearest-Neighbor (kNN) layer (float)
+ * The distance between an input row and a database item is 1 - dot(input, item) (cosine distance for normalized
+ * embeddings). Each output row is the average of the targets of the closest n_neighbours items, weighted by the
+ * inverse distance. Batch rows are computed in parallel when the database is big enough, results are the same.
+ *
+ * @param weights a VPUNN::Tensor containing the kNN layer weights, the database [items, embedding]
+ * @param targets a VPUNN::Tensor containing the kNN layer targets [items, outputs]
+ * @param activations the input tensor [batch, embedding]
+ * @param output the output tensor [batch, outputs]
+ * @param n_neighbours number of neighbors to consider. must be >=1, at most all the items are used
+ */
+VPUNN_API(void)
+kNN(const VPUNN::Tensor<float>* weights, const VPUNN::Tensor<float>* targets,
+    const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output, unsigned int n_neighbours = 1);
+
+/**
+ * @brief Floating point k-Nearest-Neighbor (kNN) layer (float), using a workspace for its scratch memory
+ * Same results as the kNN above. The workspace grows if too small for this batch, so it allocates only the first time
  *
- * @param weights a VPUNN::Tensor containing the kNN layer weights
- * @param targets a VPUNN::Tensor containing the kNN layer targets
- * @param activations the input tensor
- * @param output the output tensor
- * @param n_neighbours number of neighbors to consider. must be >=1
+ * @param weights a VPUNN::Tensor containing the kNN layer weights, the database [items, embedding]
+ * @param targets a VPUNN::Tensor containing the kNN layer targets [items, outputs]
+ * @param activations the input tensor [batch, embedding]
+ * @param output the output tensor [batch, outputs]
+ * @param n_neighbours number of neighbors to consider. must be >=1, at most all the items are used
+ * @param workspace the scratch memory, see KNNWorkspace::reserve
  */
 VPUNN_API(void)
-kNN(VPUNN::Tensor<float>* weights, VPUNN::Tensor<float>* targets, VPUNN::Tensor<float>* activations,
-    VPUNN::Tensor<float>* output, unsigned int n_neighbours = 1);
+kNN(const VPUNN::Tensor<float>* weights, const VPUNN::Tensor<float>* targets,
+    const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output, unsigned int n_neighbours,
+    KNNWorkspace& workspace);
 
 }  // namespace VPUNN
 
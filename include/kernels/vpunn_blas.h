@@ -15,6 +15,8 @@
 #if defined(USE_OPENBLAS) || defined(USE_MKL)
 #include <cblas.h>
 #else
+#include <stdint.h>
+
 typedef enum CBLAS_LAYOUT { CblasRowMajor = 101, CblasColMajor = 102 } CBLAS_LAYOUT;
 typedef enum CBLAS_TRANSPOSE { CblasNoTrans = 111, CblasTrans = 112, CblasConjTrans = 113 } CBLAS_TRANSPOSE;
 
@@ -26,6 +28,68 @@ void cblas_sscal(const int N, const float alpha, float* X, const int incX);
 void cblas_sgemm(const CBLAS_LAYOUT layout, const CBLAS_TRANSPOSE TransA, const CBLAS_TRANSPOSE TransB, const int M,
                  const int N, const int K, const float alpha, const float* A, const int lda, const float* B,
                  const int ldb, const float beta, float* C, const int ldc);
+
+// Instruction set families the internal BLAS kernels are available for. Ordered, a higher one implies the lower ones
+typedef enum VPUNN_BLAS_ISA {
+    VpunnBlasScalar = 0,
+    VpunnBlasSSE = 1,
+    VpunnBlasAVX2 = 2,
+    VpunnBlasAVX512 = 3
+} VPUNN_BLAS_ISA;
+
+// The best instruction set supported by both the build and the CPU. The kernels for it are selected at first use
+VPUNN_BLAS_ISA vpunn_blas_detected_isa();
+// The instruction set of the kernels currently in use
+VPUNN_BLAS_ISA vpunn_blas_active_isa();
+// Forces the kernels of an instruction set (clamped to the detected one), meant for tests/benchmarks. Thread safe: the
+// calls already running finish with the kernels they started with, the packed weights layout is the same for all
+VPUNN_BLAS_ISA vpunn_blas_select_isa(const VPUNN_BLAS_ISA isa);
+// Printable name of an instruction set
+const char* vpunn_blas_isa_name(const VPUNN_BLAS_ISA isa);
+
+// Number of floats needed to hold B (N x K, row major, like the FC weights) packed by vpunn_sgemm_pack
+int vpunn_sgemm_packed_size(const int N, const int K);
+// Repacks B (N x K, row major) in the register blocked panel layout used by vpunn_sgemm_packed. Done once per B
+void vpunn_sgemm_pack(const int N, const int K, const float* B, const int ldb, float* packed);
+// C = A * B^T (CblasRowMajor, CblasNoTrans, CblasTrans, alpha==1, beta==0) with B already packed
+void vpunn_sgemm_packed(const int M, const int N, const int K, const float* A, const int lda, const float* packed,
+                        float* C, const int ldc);
+
+// Activation functions that can be fused in the epilogue of vpunn_sgemm_packed_bias_act
+typedef enum VPUNN_BLAS_ACTIVATION {
+    VpunnBlasNoActivation = 0,
+    VpunnBlasReLU = 1,
+    VpunnBlasSigmoid = 2
+} VPUNN_BLAS_ACTIVATION;
+
+// C = activation(A * B^T + bias), with B already packed and bias of N elements (or null). Bias and activation are
+// applied on each output tile while it is still in registers/L1, results are the same as separate passes
+void vpunn_sgemm_packed_bias_act(const int M, const int N, const int K, const float* A, const int lda,
+                                 const float* packed, const float* bias, const VPUNN_BLAS_ACTIVATION activation,
+                                 float* C, const int ldc);
+// vpunn_sgemm_packed_bias_act for a single row of A given by its nnz nonzero elements (indexes increasing, values).
+// Only the weights of those input channels are read, results are the same as on the dense row
+void vpunn_sgemv_sparse_packed_bias_act(const int N, const int K, const int nnz, const int* indexes,
+                                       const float* values, const float* packed, const float* bias,
+                                       const VPUNN_BLAS_ACTIVATION activation, float* C);
+
+// Reduced precision weights. Same panel layout and element count (vpunn_sgemm_packed_size) as the float packing, the
+// activations and the accumulation stay in float. Halves/quarters the memory traffic of the weights
+// Repacks B as IEEE half floats (round to nearest even)
+void vpunn_sgemm_pack_f16(const int N, const int K, const float* B, const int ldb, uint16_t* packed);
+// Repacks B as symmetric INT8, quantized per row of B (output channel). scales receives the N dequantization scales
+void vpunn_sgemm_pack_s8(const int N, const int K, const float* B, const int ldb, int8_t* packed, float* scales);
+// vpunn_sgemm_packed_bias_act with the weights packed by vpunn_sgemm_pack_f16
+void vpunn_sgemm_packed_f16_bias_act(const int M, const int N, const int K, const float* A, const int lda,
+                                     const uint16_t* packed, const float* bias, const VPUNN_BLAS_ACTIVATION activation,
+                                     float* C, const int ldc);
+// vpunn_sgemm_packed_bias_act with the weights packed by vpunn_sgemm_pack_s8, scales applied before the bias
+void vpunn_sgemm_packed_s8_bias_act(const int M, const int N, const int K, const float* A, const int lda,
+                                    const int8_t* packed, const float* scales, const float* bias,
+                                    const VPUNN_BLAS_ACTIVATION activation, float* C, const int ldc);
+// Scalar float <-> IEEE half conversions, same results as the F16C instructions
+uint16_t vpunn_float_to_half(const float value);
+float vpunn_half_to_float(const uint16_t value);
 #endif
 
 #endif  // VPUNN_BLAS_H
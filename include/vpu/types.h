@@ -16,6 +16,7 @@
 #include <limits>
 #include <numeric>
 #include <vector>
+#include "core/fingerprint.h"
 #include "utils.h"
 
 #include <cmath>
@@ -651,6 +652,58 @@ struct DPUWorkload {
     }
 };
 
+/// @brief adds the description of a tensor (shape, strides, datatype, layout, sparsity) to a fingerprint
+inline Fingerprint& fingerprint_tensor(Fingerprint& result, const VPUTensor& tensor) {
+    for (const auto dim : tensor.get_shape()) {
+        result.add(static_cast<uint64_t>(dim));
+    }
+    result.add(static_cast<uint64_t>(tensor.sx())).add(static_cast<uint64_t>(tensor.sy()));
+    result.add(static_cast<uint64_t>(tensor.sz())).add(static_cast<uint64_t>(tensor.sb()));
+    result.add(static_cast<uint64_t>(tensor.get_dtype()));
+    result.add(static_cast<uint64_t>(tensor.get_layout()));
+    return result.add(static_cast<uint64_t>(tensor.get_sparsity()));
+}
+
+/**
+ * @brief 64 bit fingerprint of the fields of a workload that can influence its cost, used as a cache key
+ *
+ * Equal workloads have the same fingerprint, all their fields are used except the offsets (position in the parent
+ * layer), so the equal tiles of a layer share it. The offsets are not a cost input: no preprocessing interface puts
+ * them in the NN descriptor (tested for all of them), and the sanitization does not read them (its DPUOperation does
+ * not copy them). The tensors strides are used, even if today they follow from the shape, datatype and layout. The
+ * sparsity rates are taken exactly, not with the tolerance of operator==, so give the workload sanitized, like the
+ * inference will see it. Different workloads can have the same fingerprint (64 bits): the workload cache of
+ * VPUCostModel checks its hits with a second fingerprint of another seed, a 128 bit key in total.
+ *
+ * @param wl the workload
+ * @param seed different seeds give unrelated fingerprints of the same workload
+ * @return uint64_t the fingerprint
+ */
+inline uint64_t fingerprint(const DPUWorkload& wl, const uint64_t seed = 0) {
+    Fingerprint result{seed};
+    result.add(static_cast<uint64_t>(wl.device)).add(static_cast<uint64_t>(wl.op));
+    fingerprint_tensor(result, wl.inputs[0]);
+    fingerprint_tensor(result, wl.outputs[0]);
+    for (const auto value : wl.kernels) {
+        result.add(static_cast<uint64_t>(value));
+    }
+    for (const auto value : wl.strides) {
+        result.add(static_cast<uint64_t>(value));
+    }
+    for (const auto value : wl.padding) {
+        result.add(static_cast<uint64_t>(value));
+    }
+    result.add(static_cast<uint64_t>(wl.execution_order)).add(static_cast<uint64_t>(wl.activation_function));
+    result.add(wl.act_sparsity).add(wl.weight_sparsity);
+    for (const auto swizzling : wl.input_swizzling) {
+        result.add(static_cast<uint64_t>(swizzling));
+    }
+    result.add(static_cast<uint64_t>(wl.output_swizzling[0]));
+    result.add(static_cast<uint64_t>(wl.output_write_tiles)).add(static_cast<uint64_t>(wl.isi_strategy));
+    result.add(static_cast<uint64_t>(wl.weight_sparsity_enabled));
+    return result.value();
+}
+
 inline std::ostream& operator<<(std::ostream& stream, const VPUNN::VPUTensor& d) {
     stream << "VPUTensor: \n"                                //
            << " shape: \t{" << d.x() << "," << d.y() << ","  //
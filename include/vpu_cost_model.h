@@ -11,15 +11,23 @@
 #define VPU_COST_MODEL_H
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "core/cache.h"
+#include "core/shared_cache.h"
 #include "core/logger.h"
+#include "core/persistent_cache.h"
 
 #include "inference/preprocessing.h"
 #include "inference/preprop_factory.h"
@@ -39,6 +47,15 @@
 
 namespace VPUNN {
 
+/// @brief Usage of the caches of a VPUCostModel, see VPUCostModel::cache_statistics()
+/// A query is answered by the first of: workload cache, descriptor cache, persistent cache, NN inference
+struct CostModelCacheStatistics {
+    CacheStatistics workloads;    ///< the cache keyed on the workloads, looked up first
+    CacheStatistics descriptors;  ///< the cache keyed on the NN descriptors, the shared one if in use
+    size_t persistent_hits{0};    ///< descriptors found in the persistent cache file
+    size_t inferences{0};         ///< descriptors inferred by the NN, found in no cache
+};
+
 /// @brief L1API info for a DPUWorkload.
 /// intention is to obtain all info at once, in a more efficient way.
 /// Zero values means either error or value could not be obtained
@@ -93,10 +110,25 @@ inline std::ostream& operator<<(std::ostream& stream, const VPUNN::DPUInfoPack&
  */
 class VPUNN_API(VPUCostModel): public VPUNNPerformanceModel {
 private:
-    const RuntimeProcessingFactory preprocessing_factory;  ///< provides Preprocessing objects
-    Runtime vpunn_runtime;                ///< the loaded inference model is here, used for FW propagation
-    Preprocessing<float>& preprocessing;  ///< prepares the input vector for the runtime, configured at ctor
-    LRUCache<float> cache;                ///< cache for inferred values, used only for single workload, not for batches
+    std::shared_ptr<Runtime> vpunn_runtime;  ///< the loaded inference model, used for FW propagation. Swapped by reload
+    std::unique_ptr<Preprocessing<float>> preprocessing;  ///< prepares the input vector for the runtime, own instance
+    LRUCache<float> cache;  ///< cache for inferred values, keyed on the NN descriptor
+    std::shared_ptr<SharedLRUCache<float>> common_cache;  ///< used instead of cache if set, see share_cache
+    std::shared_ptr<PersistentCache> file_cache;  ///< values kept across processes, if set, see use_persistent_cache
+    size_t persistent_hits{0};                    ///< descriptors found in file_cache, see cache_statistics
+    size_t inferences{0};                         ///< descriptors inferred by the NN, see cache_statistics
+    /// @brief a value of the workload cache, with a second fingerprint of its workload: the 64 bit key alone could
+    /// collide, the two make a 128 bit key
+    struct WorkloadValue {
+        uint64_t check;  ///< fingerprint of the workload with workload_check_seed
+        float value;     ///< the NN output
+    };
+    static constexpr uint64_t workload_check_seed{0x9e3779b97f4a7c15ULL};  ///< seed of WorkloadValue::check
+    LRUCache<WorkloadValue> workload_cache;  ///< same values keyed on the workload itself, a hit skips preprocessing
+    const unsigned int nn_batch;                 ///< the maximum batch of the runtime, also of the reloaded ones
+    std::atomic<unsigned int> model_generation;  ///< incremented by every reload, see nn_model_generation()
+    unsigned int cache_generation{0};            ///< the model generation the cached values were inferred with
+    std::mutex reload_mutex;                     ///< one reload at a time
     const PostProcessSupport results_config;  ///< in case we have a deprecated version with hw_overhead, the ouptut
                                               ///< support should false and the response should be unused
 
@@ -104,21 +136,37 @@ private:
 
     const size_t prealloc_results{1000};          ///< how much results buffer to pre-alloc
     std::vector<float> workloads_results_buffer;  ///< buffer dedicated for workloads. avoids reallocation.
+
+    /// @brief buffers of the batch run_NN, kept to avoid reallocation
+    struct BatchBuffers {
+        static constexpr size_t none{std::numeric_limits<size_t>::max()};  ///< resolved by a cache
+
+        std::vector<size_t> distinct_of;        ///< for each workload of the batch its distinct workload, or none
+        std::vector<DPUWorkload> workloads;     ///< the distinct workloads not found in the workload cache
+        std::vector<uint64_t> workload_keys;    ///< their keys, see workload_key
+        std::vector<uint64_t> workload_checks;  ///< their second fingerprints, see WorkloadValue
+        std::vector<float> values;              ///< their values
+        std::vector<size_t> row_of;             ///< for each distinct workload its row to infer, or none
+        std::vector<uint64_t> row_keys;         ///< fingerprint of the descriptor of each row
+        std::vector<float> rows;                ///< the distinct descriptors not found in the cache
+        std::vector<float> inferred;            ///< the NN output of each row
+        std::unordered_map<uint64_t, size_t> positions;  ///< key -> position, to find the duplicates
+    } batch;
     const float default_NN_output{-1.0F};      ///< this is the value used in no NN output is present (like not loaded).
     const VPUPowerFactorLUT power_factor_lut;  /// < this is the lookup table for power factors.
 
     const ShaveConfiguration shave_gen_2;  ///< second generation of shaves
 
-    /// @brief obtains the actual preprocessing instance from factory. The factory must live longer than the instance
-    /// created. warning: Throws if not possible
-    static Preprocessing<float>& init_preproc(const RuntimeProcessingFactory& factory,
-                                              const ModelVersion& version_service, const std::string& filename) {
+    /// @brief creates the preprocessing instance of this cost model, from the shared factory.
+    /// warning: Throws if not possible
+    static std::unique_ptr<Preprocessing<float>> init_preproc(const RuntimeProcessingFactory& factory,
+                                                              const ModelVersion& version_service,
+                                                              const std::string& filename) {
         // let's initialize the preproc aspects based on input version
         const int input_version = version_service.get_input_interface_version();
         //  checking if either we have some preprocess or we have a unsupported version
         if (factory.exists_preprocessing(input_version)) {
-            auto& preproc = factory.make_preprocessing(input_version);
-            return preproc;
+            return factory.make_preprocessing(input_version);
         } else {
             std::stringstream buffer;
             buffer << "Cannot create preprocessing stage!.Preprocessing with version (" << input_version
@@ -205,17 +253,22 @@ protected:
     }
 
 private:
+    /// @brief the runtime in use, the caller keeps it alive even if a reload swaps it meanwhile
+    std::shared_ptr<Runtime> current_runtime() const {
+        return std::atomic_load(&vpunn_runtime);
+    }
+
     /// @brief  check and try to make the preprocessing output to be the same as what model expects
     /// This mechanism is unsafe at this moment and lets you change the preprocessing output to a bigger or smaller size
     /// The result may be impossibility to run (if smaller) or leaving empty zeros at the end (only partial fill)
     ///
     void correlate_preprocessor_with_model_inputs() {
-        const auto model_input_size = vpunn_runtime.input_tensors()[0]->shape()[1];
-        const auto preprocessing_output_size = preprocessing.output_size();
+        const auto model_input_size = vpunn_runtime->input_tensors()[0]->shape()[1];
+        const auto preprocessing_output_size = preprocessing->output_size();
         if (model_input_size != preprocessing_output_size) {
             Logger::warning() << "Changing preprocessing output size (" << preprocessing_output_size
                               << ") to the model input size (" << model_input_size << ")";
-            preprocessing.set_size(model_input_size);
+            preprocessing->set_size(model_input_size);
         }
     }
 
@@ -254,23 +307,27 @@ public:
      * @param filename the name of the .vpunn model
      * @param profile enable/disable profiling
      * @param cache_size the size of the LRUCache
-     * @param batch_size model batch size
+     * @param batch_size maximum model batch size, batches of workloads are run in chunks of up to this size
      */
     explicit VPUCostModel(const std::string& filename = "", bool profile = false, const unsigned int cache_size = 16384,
                           const unsigned int batch_size = 1)
-            : vpunn_runtime(filename, batch_size, profile),
-              preprocessing(init_preproc(preprocessing_factory, vpunn_runtime.model_version_info(), filename)),
+            : vpunn_runtime(std::make_shared<Runtime>(filename, batch_size, profile)),
+              preprocessing(init_preproc(RuntimeProcessingFactory::instance(), vpunn_runtime->model_version_info(),
+                                         filename)),
               cache(cache_size),
-              results_config(vpunn_runtime.model_version_info().get_output_interface_version()) {
+              workload_cache(cache_size),
+              nn_batch(batch_size),
+              model_generation(0),
+              results_config(vpunn_runtime->model_version_info().get_output_interface_version()) {
         Logger::initialize();
-        check_post_config(vpunn_runtime.model_version_info());
+        check_post_config(vpunn_runtime->model_version_info());
 
-        if (!vpunn_runtime.initialized()) {
+        if (!vpunn_runtime->initialized()) {
             return;
         }
 
         correlate_preprocessor_with_model_inputs();
-        preprocessing.set_probable_batch(batch_size);
+        preprocessing->set_probable_batch(batch_size);
         workloads_results_buffer.reserve(prealloc_results);
     }
     // VPUCostModel(const VPUCostModel&) = delete;
@@ -284,22 +341,27 @@ public:
      * @param copy_model_data enable/disable the memcopy of the buffer
      * @param profile enable/disable profiling
      * @param cache_size the size of the LRUCache
-     * @param batch_size model batch size
+     * @param batch_size maximum model batch size, batches of workloads are run in chunks of up to this size
      */
     explicit VPUCostModel(const char* model_data, size_t model_data_length, bool copy_model_data, bool profile = false,
                           const unsigned int cache_size = 16384, const unsigned int batch_size = 1)
-            : vpunn_runtime(model_data, model_data_length, copy_model_data, batch_size, profile),
-              preprocessing(init_preproc(preprocessing_factory, vpunn_runtime.model_version_info(), "ConstCharInit")),
+            : vpunn_runtime(std::make_shared<Runtime>(model_data, model_data_length, copy_model_data, batch_size,
+                                                      profile)),
+              preprocessing(init_preproc(RuntimeProcessingFactory::instance(), vpunn_runtime->model_version_info(),
+                                         "ConstCharInit")),
               cache(cache_size),
-              results_config(vpunn_runtime.model_version_info().get_output_interface_version()) {
+              workload_cache(cache_size),
+              nn_batch(batch_size),
+              model_generation(0),
+              results_config(vpunn_runtime->model_version_info().get_output_interface_version()) {
         Logger::initialize();
-        check_post_config(vpunn_runtime.model_version_info());
+        check_post_config(vpunn_runtime->model_version_info());
 
-        if (!vpunn_runtime.initialized()) {
+        if (!vpunn_runtime->initialized()) {
             return;
         }
         correlate_preprocessor_with_model_inputs();
-        preprocessing.set_probable_batch(batch_size);
+        preprocessing->set_probable_batch(batch_size);
         workloads_results_buffer.reserve(prealloc_results);
     }
 
@@ -322,10 +384,77 @@ protected:
         return result.is_usable();
     }
 
+    /// @brief empties the caches if their values were inferred by a model that was reloaded since. The keys of the
+    /// shared cache include the model, it does not need it
+    void sync_caches(const unsigned int generation) {
+        if (generation != cache_generation) {
+            cache.clear();
+            workload_cache.clear();
+            cache_generation = generation;
+        }
+    }
+
+    /// @brief the key of a workload in the workload cache, its fingerprint
+    uint64_t workload_key(const DPUWorkload& workload) const {
+        return fingerprint(workload);
+    }
+
+    /// @brief looks up a descriptor in the descriptor cache (the shared one if set), then in the persistent cache.
+    /// true if the value was found
+    bool find_cached(const uint64_t key, float& value) {
+        if (common_cache != nullptr) {
+            if (common_cache->get(key, value)) {
+                return true;
+            }
+        } else {
+            const float* const cached_value = cache.get(key);
+            if (cached_value != nullptr) {
+                value = *cached_value;
+                return true;
+            }
+        }
+        if (file_cache != nullptr && file_cache->get(key, value)) {
+            ++persistent_hits;
+            add_to_memory(key, value);
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief adds the value of a descriptor to the descriptor cache (the shared one if set)
+    void add_to_memory(const uint64_t key, const float value) {
+        if (common_cache != nullptr) {
+            common_cache->add(key, value);
+        } else {
+            cache.add(key, value);
+        }
+    }
+
+    /// @brief adds an inferred value of a descriptor to the descriptor cache and to the persistent cache
+    void add_cached(const uint64_t key, const float value) {
+        add_to_memory(key, value);
+        if (file_cache != nullptr) {
+            file_cache->add(key, value);
+        }
+    }
+
+protected:
+    /// @brief the value of a workload in the workload cache, null if not there. A hit of another workload with the
+    /// same key (a fingerprint collision) is a miss, the descriptor path then gives the value of this one
+    const float* find_workload(const uint64_t key, const uint64_t check) {
+        const WorkloadValue* const known = workload_cache.get(key);
+        return (known != nullptr && known->check == check) ? &known->value : nullptr;
+    }
+
+    /// @brief adds the value of a workload to the workload cache, replacing the one of any workload with the same key
+    void add_workload(const uint64_t key, const uint64_t check, const float value) {
+        workload_cache.add(key, WorkloadValue{check, value});
+    }
+
 public:
     /**
      * @brief Compute the NN Output of a specific DPUWorkload
-     * takes in consideration the cache
+     * takes in consideration the cache: first the one keyed on the workload, then the one keyed on the descriptor
      * no sanitation is done
      * no check if network exists
      *
@@ -333,22 +462,39 @@ public:
      * @return float the NN raw output, not filtered
      */
     float run_NN(const DPUWorkload& workload) {
-        const auto& vector = preprocessing.transform(workload);
-        // Check for cache hit
-        const float* const cached_value = cache.get(vector);
-        if (cached_value == nullptr) {
-            // run the model in case of a cache miss
-            const auto infered_value = vpunn_runtime.predict<float>(vector)[0];
+        const unsigned int generation{model_generation.load()};  // before the runtime, see reload()
+        const auto runtime = current_runtime();
+        sync_caches(generation);
+
+        // the same workload again, no need to build its descriptor
+        const uint64_t key_of_workload{workload_key(workload)};
+        const uint64_t check{fingerprint(workload, workload_check_seed)};
+        const float* const known_value = find_workload(key_of_workload, check);
+        if (known_value != nullptr) {
+            return *known_value;
+        }
+
+        const auto& vector = preprocessing->transform(workload);
+        // Check for cache hit, e.g. a workload differing only in fields that are not part of the descriptor
+        const uint64_t key{fingerprint(vector, runtime->model_fingerprint())};
+        float value;
+        if (!find_cached(key, value)) {
+            // run the model in case of a cache miss, the first layer skips the zeros of the (one-hot) descriptor
+            const auto& sparse = preprocessing->sparse(vector);
+            value = runtime->predict_sparse(sparse.indexes.data(), sparse.values.data(),
+                                            static_cast<int>(sparse.indexes.size()))[0];
+            ++inferences;
             // Add result to the cache
-            cache.add(vector, infered_value);
-            return infered_value;
+            add_cached(key, value);
         }
-        return *cached_value;
+        add_workload(key_of_workload, check, value);
+        return value;
     }
 
     /**
      * @brief Compute the NN Output of multiple DPUWorkloads
-     * NOT taking in consideration the cache
+     * takes in consideration the cache, like for a single workload. Only the distinct workloads not found in the
+     * caches are inferred, the repeated ones (e.g. equal tiles of a split) are computed once
      * no sanitation is done
      * no check if network exists
      *
@@ -358,30 +504,86 @@ public:
     const std::vector<float>& run_NN(const std::vector<DPUWorkload>& workloads) {
         workloads_results_buffer.resize(workloads.size());
 
-        if (!nn_initialized()) {  // do not run for bad NN
+        const unsigned int generation{model_generation.load()};  // before the runtime, see reload()
+        const auto runtime = current_runtime();  // the same model for the whole batch, even if reloaded meanwhile
+        if (!runtime->initialized()) {           // do not run for bad NN
             std::fill(workloads_results_buffer.begin(), workloads_results_buffer.end(), default_NN_output);
             return workloads_results_buffer;
         }
+        sync_caches(generation);
+
+        // the workloads already known, and the distinct ones among the others
+        batch.distinct_of.resize(workloads.size());
+        batch.workloads.clear();
+        batch.workload_keys.clear();
+        batch.workload_checks.clear();
+        batch.positions.clear();
+        for (size_t idx = 0; idx < workloads.size(); ++idx) {
+            const uint64_t key{workload_key(workloads[idx])};
+            const uint64_t check{fingerprint(workloads[idx], workload_check_seed)};
+            const float* const known_value = find_workload(key, check);
+            if (known_value != nullptr) {
+                workloads_results_buffer[idx] = *known_value;
+                batch.distinct_of[idx] = BatchBuffers::none;
+                continue;
+            }
+            const auto position = batch.positions.emplace(key, batch.workloads.size());
+            if (position.second || batch.workload_checks[position.first->second] != check) {
+                // new, or colliding with another workload of the batch: computed on its own
+                batch.distinct_of[idx] = batch.workloads.size();
+                batch.workloads.push_back(workloads[idx]);
+                batch.workload_keys.push_back(key);
+                batch.workload_checks.push_back(check);
+                continue;
+            }
+            batch.distinct_of[idx] = position.first->second;
+        }
+        if (batch.workloads.empty()) {
+            return workloads_results_buffer;
+        }
 
-        // Pre-process the workloads to generate descriptors
-        const auto model_batch_size{vpunn_runtime.input_tensors()[0]->shape()[0]};  // how many wlds in a batch
-        // transforms all at once, potential optimization is to do batch by batch
-        const auto& vector = preprocessing.transform(workloads, model_batch_size);
-
-        const auto descriptor_size{preprocessing.output_size()};
-        const auto inputs_to_process_in_batch{descriptor_size * model_batch_size};
-
-        for (unsigned int wl_idx = 0; wl_idx < workloads.size(); wl_idx += model_batch_size) {
-            // Slice the workload descriptors and predict on a single batch
-            const float* hw_overhead_arr =
-                    vpunn_runtime.predict(&(vector[wl_idx * descriptor_size]), inputs_to_process_in_batch);
+        // Pre-process the distinct workloads, their descriptors are looked up in the cache and also deduplicated
+        const auto& descriptors = preprocessing->transform(batch.workloads);
+        const size_t size{preprocessing->output_size()};
+        const size_t distinct{batch.workloads.size()};
+        batch.values.resize(distinct);
+        batch.row_of.resize(distinct);
+        batch.row_keys.clear();
+        batch.rows.clear();
+        batch.positions.clear();
+        for (size_t idx = 0; idx < distinct; ++idx) {
+            const float* const descriptor = descriptors.data() + idx * size;
+            const uint64_t key{fingerprint(descriptor, size, runtime->model_fingerprint())};
+            if (find_cached(key, batch.values[idx])) {
+                batch.row_of[idx] = BatchBuffers::none;
+                continue;
+            }
+            const auto position = batch.positions.emplace(key, batch.row_keys.size());
+            if (position.second) {
+                batch.row_keys.push_back(key);
+                batch.rows.insert(batch.rows.end(), descriptor, descriptor + size);
+            }
+            batch.row_of[idx] = position.first->second;
+        }
 
-            const auto complete_batch_end_idx{wl_idx + model_batch_size};
-            auto end_idx{(complete_batch_end_idx > workloads.size()) ? workloads.size() : complete_batch_end_idx};
+        // batches of at most the model batch, spread over threads if enabled (see set_parallel_max_threads)
+        if (!batch.row_keys.empty()) {
+            runtime->predict_rows(batch.rows.data(), batch.row_keys.size(), batch.inferred);
+            inferences += batch.row_keys.size();
+            for (size_t row = 0; row < batch.row_keys.size(); ++row) {
+                add_cached(batch.row_keys[row], batch.inferred[row]);
+            }
+        }
+        for (size_t idx = 0; idx < distinct; ++idx) {
+            if (batch.row_of[idx] != BatchBuffers::none) {
+                batch.values[idx] = batch.inferred[batch.row_of[idx]];
+            }
+            add_workload(batch.workload_keys[idx], batch.workload_checks[idx], batch.values[idx]);
+        }
 
-            // fill into result the data for this batch
-            for (unsigned int idx = wl_idx; idx < end_idx; ++idx) {
-                workloads_results_buffer[idx] = hw_overhead_arr[idx - wl_idx];
+        for (size_t idx = 0; idx < workloads.size(); ++idx) {
+            if (batch.distinct_of[idx] != BatchBuffers::none) {
+                workloads_results_buffer[idx] = batch.values[batch.distinct_of[idx]];
             }
         }
         return workloads_results_buffer;
@@ -395,7 +597,188 @@ public:
      * @return false the VPUNN neural network is not initialized
      */
     bool nn_initialized() const {
-        return vpunn_runtime.initialized();
+        return current_runtime()->initialized();
+    }
+
+    /**
+     * @brief The NN runtime, e.g. for its profiling (set_profiling, layer_profiles, profiling_report)
+     *
+     * @return the runtime running the NN of this cost model. A snapshot: it stays valid after a reload, but the cost
+     * model then runs another runtime
+     */
+    std::shared_ptr<Runtime> nn_runtime() {
+        return current_runtime();
+    }
+
+    /**
+     * @brief Uses a cache shared with other cost models for the values of the NN descriptors, instead of the own one
+     * The shared cache is thread safe, each cost model can be used by another thread. Its keys include the model
+     * contents (see Runtime::model_fingerprint), so it can be shared also by cost models with different or reloaded
+     * models, each finds only its own values. The cache keyed on the workloads stays private.
+     *
+     * @param shared the cache to use from now on, null to go back to the own cache
+     */
+    void share_cache(std::shared_ptr<SharedLRUCache<float>> shared) {
+        common_cache = std::move(shared);
+    }
+
+    /// @brief the shared cache in use, null if none. @sa share_cache
+    std::shared_ptr<SharedLRUCache<float>> shared_cache() const {
+        return common_cache;
+    }
+
+    /**
+     * @brief Changes the replacement policy of the own caches, e.g. TINY_LFU when long sweeps of one-off workloads
+     * (tiler split variants) evict the values used again and again. The caches are emptied and their counters reset.
+     * Not thread safe, to be set before the queries. A shared cache gets its policy at creation
+     *
+     * @param policy the policy of the caches keyed on the workloads and on the descriptors
+     */
+    void set_cache_policy(const CachePolicy policy) {
+        workload_cache = LRUCache<WorkloadValue>(workload_cache.capacity(), policy);
+        cache = LRUCache<float>(cache.capacity(), policy);
+    }
+
+    /**
+     * @brief Bounds the own caches by a memory budget instead of the entry count given at construction, half of it
+     * for the cache keyed on the workloads and half for the one keyed on the descriptors (see
+     * LRUCache::with_max_bytes). The entries of the first are bigger (a 128 bit key), it holds fewer values. The
+     * caches are emptied and their counters reset, the policy is kept.
+     * Not thread safe, to be set before the queries. A shared cache gets its budget at creation
+     *
+     * @param max_bytes the memory budget of the two caches
+     */
+    void set_cache_memory(const size_t max_bytes) {
+        workload_cache = LRUCache<WorkloadValue>::with_max_bytes(max_bytes / 2, workload_cache.replacement_policy());
+        cache = LRUCache<float>::with_max_bytes(max_bytes / 2, cache.replacement_policy());
+    }
+
+    /// @brief the replacement policy of the own caches. @sa set_cache_policy
+    CachePolicy cache_policy() const {
+        return cache.replacement_policy();
+    }
+
+    /**
+     * @brief A snapshot of the usage of the caches since the creation or the last reset_cache_statistics, e.g. to size
+     * the caches from the measured hit rates. A shared cache (see share_cache) reports the usage by all its users
+     *
+     * @return the counters, the sizes and the approximate memory of the caches
+     */
+    CostModelCacheStatistics cache_statistics() const {
+        CostModelCacheStatistics snapshot;
+        snapshot.workloads = workload_cache.statistics();
+        snapshot.descriptors = (common_cache != nullptr) ? common_cache->statistics() : cache.statistics();
+        snapshot.persistent_hits = persistent_hits;
+        snapshot.inferences = inferences;
+        return snapshot;
+    }
+
+    /// @brief sets the cache usage counters of this cost model to zero. Those of a shared cache are not changed, they
+    /// can be reset with shared_cache()->reset_statistics()
+    void reset_cache_statistics() {
+        workload_cache.reset_statistics();
+        cache.reset_statistics();
+        persistent_hits = 0;
+        inferences = 0;
+    }
+
+    /**
+     * @brief Keeps the inferred values in a file, for the next processes (warm start). Looked up after the memory
+     * caches, the values found there are not inferred again. The keys include the model contents, a file can be
+     * used with any models. The cost models of a process should use the same instance, it is thread safe.
+     *
+     * @param persistent the cache file to use from now on (see PersistentCache), null to stop using one
+     */
+    void use_persistent_cache(std::shared_ptr<PersistentCache> persistent) {
+        file_cache = std::move(persistent);
+    }
+
+    /**
+     * @brief Opens a cache file and uses it, see use_persistent_cache(std::shared_ptr<PersistentCache>)
+     *
+     * @param filename the cache file, created if missing
+     * @param writable try to be the writer of the file, otherwise only read it
+     * @return false if the file cannot be used (the cost model works without it)
+     */
+    bool use_persistent_cache(const std::string& filename, const bool writable = true) {
+        auto persistent = std::make_shared<PersistentCache>(filename, writable);
+        if (!persistent->is_open()) {
+            return false;
+        }
+        use_persistent_cache(std::move(persistent));
+        return true;
+    }
+
+    /// @brief the persistent cache in use, null if none. @sa use_persistent_cache
+    std::shared_ptr<PersistentCache> persistent_cache() const {
+        return file_cache;
+    }
+
+    /**
+     * @brief Replaces the NN with the one in another .vpunn file, keeping the cache size, the preprocessing and all
+     * the configuration of this cost model
+     * The new model is loaded and checked before being used: it must have the same input and output interface
+     * versions and input size as the current one (see ModelVersion). If it does not, or cannot be loaded, the current
+     * model stays in use. The swap is atomic, it can be done from another thread while this cost model answers queries:
+     * a query uses the model that was current when it started, and the cache is emptied before the first query using
+     * the new model. The model comes from the ModelRegistry: a file changed since it was loaded (size, times, inode) is
+     * read again, an unchanged one in use by others shares their store. The new runtime has the same maximum batch,
+     * profiling setting, loading mode (memory mapped or read), weights precision and packed weights directory.
+     *
+     * @param filename the .vpunn model to use from now on
+     * @throws runtime_error if the model cannot be loaded or its interface is not the one of the current model
+     */
+    void reload(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(reload_mutex);
+        const auto current = current_runtime();
+        auto candidate = std::make_shared<Runtime>(filename, nn_batch, current->is_profiling(),
+                                                   current->is_memory_mapped(),
+                                                   current->weight_precision(),
+                                                   current->packed_weights_directory());  // might throw
+
+        std::stringstream buffer;
+        if (!candidate->initialized()) {
+            buffer << "cannot load the model";
+        } else if (candidate->model_version_info().get_input_interface_version() !=
+                           current->model_version_info().get_input_interface_version() ||
+                   candidate->model_version_info().get_output_interface_version() !=
+                           current->model_version_info().get_output_interface_version()) {
+            buffer << "the model interface version (raw): " << candidate->model_version_info().get_raw_name()
+                   << " is not the one of the current model: " << current->model_version_info().get_raw_name();
+        } else if (candidate->input_tensors()[0]->shape()[1] != preprocessing->output_size()) {
+            buffer << "the model input size " << candidate->input_tensors()[0]->shape()[1]
+                   << " is not the preprocessing output size " << preprocessing->output_size();
+        }
+        const std::string problem{buffer.str()};
+        if (!problem.empty()) {
+            std::stringstream details;
+            details << "[ERROR]VPUCostModel::reload(), " << problem << ". The current model stays in use. Filename: "
+                    << filename << " File: " << __FILE__ << " Line: " << __LINE__;
+            Logger::error() << details.str();
+            throw std::runtime_error(details.str());
+        }
+
+        // the runtime first, then the generation: a query seeing the new generation runs the new runtime
+        std::atomic_store(&vpunn_runtime, std::move(candidate));
+        ++model_generation;
+    }
+
+    /**
+     * @brief Same as reload(), the new model is loaded and checked in a background thread
+     * This cost model must outlive the returned future (its destructor waits for the reload to end)
+     *
+     * @param filename the .vpunn model to use from now on
+     * @return the future of the reload, get() rethrows its errors
+     */
+    std::future<void> reload_async(const std::string& filename) {
+        return std::async(std::launch::async, [this, filename]() {
+            reload(filename);
+        });
+    }
+
+    /// @brief how many times the NN was reloaded, the values computed with a different generation may differ
+    unsigned int nn_model_generation() const {
+        return model_generation.load();
     }
 
     /**
@@ -10,7 +10,13 @@
 #ifndef VPUNN_H
 #define VPUNN_H
 
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
 #include <string>
+#include <vector>
+#include "core/parallel.h"
 #include "core/profiling.h"
 #include "inference/model.h"
 
@@ -23,23 +29,39 @@ namespace VPUNN {
  */
 class Runtime {
 private:
-    InferenceModel model;  ///< the NN loaded from a file/buffer (flatbuffer)
-    const bool profile;
-    ModelVersion model_version;  ///< holds the version info about the loaded model
+    InferenceModel model;                  ///< the NN loaded from a file/buffer (flatbuffer)
+    std::vector<InferenceModel> replicas;  ///< copies of model (same weights) used by the threads of predict_rows
+    bool profile;                          ///< per layer and per inference call timing statistics are kept
+    ProfileStats inference_stats;          ///< the time of each inference call
+    ModelVersion model_version;            ///< holds the version info about the loaded model
+    uint64_t identity{0};                  ///< the fingerprint of the loaded model, see model_fingerprint()
 
 public:
     /**
      * @brief Construct a new Runtime object
      *
      * @param filename .vpunn model
-     * @param batch model batch size
-     * @param profile enable/disable profiling
+     * @param batch maximum model batch size, each predict can use any batch up to it
+     * @param profile enable/disable profiling, see set_profiling()
+     * @param memory_map opt-in: map the model file read-only instead of reading it. The constants are used in place,
+     * the FC weights are packed in memory, or in packed_weights_directory. Nothing is written next to the model. The
+     * file must not be rewritten in place while mapped (a truncated mapping raises SIGBUS): replace it with a new file
+     * (rename) instead
+     * @param weight_precision the precision the FC weights are stored and computed in (FP32, FP16, INT8)
+     * @param packed_weights_directory opt-in, with memory_map: a writable directory where the FC weights are packed
+     * once into a file that is mapped too, by this and the next processes (in memory if it cannot be written)
      */
-    explicit Runtime(const std::string& filename, const unsigned int batch = 1, bool profile = false)
-            : model(filename.c_str()), profile(profile), model_version() {
+    explicit Runtime(const std::string& filename, const unsigned int batch = 1, bool profile = false,
+                     bool memory_map = false, const WeightPrecision weight_precision = WeightPrecision::FP32,
+                     const std::string& packed_weights_directory = "")
+            : model(filename.c_str(), memory_map, weight_precision, packed_weights_directory),
+              profile(profile),
+              model_version() {
         if (initialized()) {
             model.allocate_tensors(batch);  // might throw
+            model.set_profiling(profile);
             model_version.parse_name(model.network_name());
+            identity = model.model_store()->fingerprint();
         }
     }
 
@@ -59,18 +81,34 @@ public:
      * @param model_data .vpunn model buffer
      * @param model_data_length buffer size
      * @param copy_model_data enable/disable memcopy of the module buffer
-     * @param batch model batch size
-     * @param profile enable/disable profiling
+     * @param batch maximum model batch size, each predict can use any batch up to it
+     * @param profile enable/disable profiling, see set_profiling()
+     * @param weight_precision the precision the FC weights are stored and computed in (FP32, FP16, INT8)
      */
     explicit Runtime(const char* model_data, size_t model_data_length, bool copy_model_data,
-                     const unsigned int batch = 1, bool profile = false)
-            : model(model_data, model_data_length, copy_model_data), profile(profile), model_version() {
+                     const unsigned int batch = 1, bool profile = false,
+                     const WeightPrecision weight_precision = WeightPrecision::FP32)
+            : model(model_data, model_data_length, copy_model_data, weight_precision),
+              profile(profile),
+              model_version() {
         if (initialized()) {
             model.allocate_tensors(batch);  // might throw
+            model.set_profiling(profile);
             model_version.parse_name(model.network_name());
+            identity = model.model_store()->fingerprint();
         }
     }
 
+    /**
+     * @brief Identifies the loaded model by its contents and weights precision, e.g. to share inferred values between
+     * runtimes of the same model. See ModelStore::fingerprint()
+     *
+     * @return the model fingerprint, 0 if the model is not initialized
+     */
+    uint64_t model_fingerprint() const {
+        return identity;
+    }
+
     /**
      * @brief Check if the NN model is initialized
      *
@@ -81,6 +119,144 @@ public:
         return model.is_initialized();
     }
 
+    /**
+     * @brief The precision the FC weights are stored and computed in
+     *
+     * @return the weights precision in use
+     */
+    WeightPrecision weight_precision() const {
+        return model.weight_precision();
+    }
+
+    /**
+     * @brief Check if the model file is memory mapped, see the memory_map parameter of the constructor
+     *
+     * @return true if the model data is a read-only mapping of the file
+     */
+    bool is_memory_mapped() const {
+        return model.is_memory_mapped();
+    }
+
+    /**
+     * @brief The directory of the packed FC weights file, see the packed_weights_directory parameter of the
+     * constructor
+     *
+     * @return the directory the model was loaded with, empty if the FC weights are packed in memory
+     */
+    std::string packed_weights_directory() const {
+        return model.packed_weights_directory();
+    }
+
+    /**
+     * @brief The maximum batch a predict can run, the activations are allocated for it
+     *
+     * @return the maximum batch size
+     */
+    unsigned int max_batch() const {
+        return model.get_max_batch();
+    }
+
+    /**
+     * @brief Enables/disables the profiling
+     * When enabled, every inference call and every layer of the model are timed. Nothing is logged, the statistics are
+     * kept and can be read with inference_profile(), layer_profiles() or profiling_report()
+     *
+     * @param enable true to measure from now on
+     */
+    void set_profiling(const bool enable) {
+        profile = enable;
+        model.set_profiling(enable);
+        for (auto& replica : replicas) {
+            replica.set_profiling(enable);
+        }
+    }
+
+    /// @brief true if the inference is measured
+    bool is_profiling() const {
+        return profile;
+    }
+
+    /// @brief the timing of the inference calls (predict, predict_rows)
+    const ProfileStats& inference_profile() const {
+        return inference_stats;
+    }
+
+    /**
+     * @brief The timing of every layer, in model order
+     * The threads of predict_rows run their own copy of the model, their statistics are added together
+     *
+     * @return the layers statistics
+     */
+    std::vector<LayerProfile> layer_profiles() const {
+        auto profiles = model.layer_profiles();
+        for (const auto& replica : replicas) {
+            const auto& replica_profiles = replica.layer_profiles();
+            for (size_t idx = 0; idx < std::min(profiles.size(), replica_profiles.size()); ++idx) {
+                profiles[idx].kernel.merge(replica_profiles[idx].kernel);
+                profiles[idx].activation_pass.merge(replica_profiles[idx].activation_pass);
+            }
+        }
+        return profiles;
+    }
+
+    /// @brief forgets all the measurements, the profiling stays enabled/disabled
+    void reset_profiling() {
+        inference_stats.reset();
+        model.reset_profiling();
+        for (auto& replica : replicas) {
+            replica.reset_profiling();
+        }
+    }
+
+    /**
+     * @brief A readable table of the profiling: every layer, then the time by operation
+     * The separate activation passes are reported as their own operation (e.g. Sigmoid after a kNN)
+     *
+     * @return the report, one line per layer/operation
+     */
+    std::string profiling_report() const {
+        std::stringstream report;
+        report << std::fixed << std::setprecision(3);
+        report << "Inference calls: " << inference_stats.calls << ", total: " << inference_stats.total_ms
+               << " ms, avg: " << inference_stats.average_ms() << " ms, min: " << inference_stats.min_ms
+               << " ms, max: " << inference_stats.max_ms << " ms\n";
+
+        const auto profiles = layer_profiles();
+        double layers_total{0.0};
+        std::map<std::string, ProfileStats> by_operation;
+        for (const auto& layer : profiles) {
+            layers_total += layer.kernel.total_ms + layer.activation_pass.total_ms;
+            by_operation[layer.operation].merge(layer.kernel);
+            by_operation[layer.activation].merge(layer.activation_pass);
+        }
+        const double share_base{(layers_total > 0.0) ? layers_total / 100.0 : 1.0};
+
+        report << std::left << std::setw(6) << "layer" << std::setw(18) << "operation" << std::setw(16)
+               << "activation" << std::right << std::setw(10) << "calls" << std::setw(14) << "total[ms]"
+               << std::setw(12) << "avg[us]" << std::setw(12) << "min[us]" << std::setw(12) << "max[us]"
+               << std::setw(9) << "share%" << "\n";
+        auto print_line = [&](const std::string& first, const std::string& second, const std::string& third,
+                              const ProfileStats& stats) {
+            report << std::left << std::setw(6) << first << std::setw(18) << second << std::setw(16) << third
+                   << std::right << std::setw(10) << stats.calls << std::setw(14) << stats.total_ms << std::setw(12)
+                   << stats.average_ms() * 1000.0 << std::setw(12) << stats.min_ms * 1000.0 << std::setw(12)
+                   << stats.max_ms * 1000.0 << std::setw(9) << stats.total_ms / share_base << "\n";
+        };
+        for (const auto& layer : profiles) {
+            const std::string activation{layer.activation + (layer.fused_activation ? " (fused)" : "")};
+            print_line(std::to_string(layer.layer), layer.operation, activation, layer.kernel);
+            if (layer.activation_pass.calls > 0) {
+                print_line(std::to_string(layer.layer), layer.activation, "", layer.activation_pass);
+            }
+        }
+        for (const auto& operation : by_operation) {
+            if (operation.second.calls > 0) {
+                print_line("all", operation.first, "", operation.second);
+            }
+        }
+        return report.str();
+    }
+
     /**
      * @brief Get the model input tensors
      *
@@ -127,6 +303,7 @@ public:
 
     /**
      * @brief Run the inference
+     * The batch is given by the input size, any number of input rows up to max_batch(), only those rows are computed
      *
      * @tparam T input input_array datatype
      * @param input_array input data
@@ -139,18 +316,18 @@ public:
         auto t1 = tick();
         model.predict();
         if (profile) {
-            auto delta = tock(t1);
-            Logger::info() << "Execution time: " << delta << " ms";
+            inference_stats.add(tock(t1));
         }
         return model.get_outputs<T>();
     }
 
     /**
      * @brief Run the inference
+     * The batch is given by the input size, any number of input rows up to max_batch(), only those rows are computed
      *
      * @tparam T input input_array datatype
      * @param input_tensor input data
-     * @return one or more values containing the inference result
+     * @return one or more values containing the inference result, for the rows of the batch
      */
     template <class T>
     const std::vector<T> predict(const std::vector<T>& input_tensor) {
@@ -159,11 +336,74 @@ public:
         auto t1 = tick();
         model.predict();
         if (profile) {
-            auto delta = tock(t1);
-            Logger::info() << "Execution time: " << delta << " ms";
+            inference_stats.add(tock(t1));
         }
         return model.get_outputs_vector<T>();
     }
+
+    /**
+     * @brief Run the inference on one input row given by its nonzero elements, see InferenceModel::predict_sparse
+     * Same results as predict on the dense row, the zero inputs are skipped by the first FC
+     *
+     * @param indexes the positions of the nonzero inputs in the row, increasing
+     * @param values the nonzero inputs
+     * @param nnz number of nonzero inputs
+     * @return pointer to the inference result of the row
+     */
+    const float* predict_sparse(const int* indexes, const float* values, const int nnz) {
+        auto t1 = tick();
+        model.predict_sparse(indexes, values, nnz);  // might throw if an index is outside the input
+        if (profile) {
+            inference_stats.add(tock(t1));
+        }
+        return model.get_outputs<float>();
+    }
+
+    /**
+     * @brief Run the inference on any number of rows, in batches of at most max_batch()
+     * When parallel_max_threads() allows it, the batches are spread over threads, each one running its own copy of the
+     * model (sharing the weights). Each batch is computed as in a serial run, the results are the same.
+     *
+     * @param input_array the input rows, one after the other
+     * @param rows how many rows
+     * @param output [out] the output rows, resized to rows * the output size of one row
+     */
+    void predict_rows(const float* input_array, const size_t rows, std::vector<float>& output) {
+        const auto& input_tensor = *model.input_tensors()[0];
+        const auto& output_tensor = *model.output_tensors()[0];
+        const size_t input_row{input_tensor.size() / std::max(input_tensor.shape()[0], 1U)};
+        const size_t output_row{output_tensor.size() / std::max(output_tensor.shape()[0], 1U)};
+        const size_t batch{model.get_max_batch()};
+        const size_t batches{(rows + batch - 1) / batch};
+        output.resize(rows * output_row);
+
+        auto t1 = tick();
+        const size_t tasks{std::min<size_t>(batches, parallel_max_threads().load())};
+        while (replicas.size() + 1 < tasks) {
+            replicas.push_back(model);  // own activations, shared weights
+        }
+        const size_t batches_per_task{(tasks > 0) ? (batches + tasks - 1) / tasks : 0};
+        auto run_batches = [&](const size_t task) {
+            auto& task_model = (task == 0) ? model : replicas[task - 1];
+            const size_t last{std::min(batches, (task + 1) * batches_per_task)};
+            for (size_t b = task * batches_per_task; b < last; ++b) {
+                const size_t batch_rows{std::min(batch, rows - b * batch)};
+                task_model.set_inputs(input_array + b * batch * input_row,
+                                      static_cast<unsigned int>(batch_rows * input_row));
+                task_model.predict();
+                const float* result = task_model.get_outputs<float>();
+                std::copy(result, result + batch_rows * output_row, output.begin() + b * batch * output_row);
+            }
+        };
+        if (tasks > 1) {
+            ThreadPool::instance().run(tasks, run_batches);
+        } else if (tasks == 1) {
+            run_batches(0);
+        }
+        if (profile) {
+            inference_stats.add(tock(t1));
+        }
+    }
 };
 
 }  // namespace VPUNN
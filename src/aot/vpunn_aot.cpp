@@ -0,0 +1,316 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+// Ahead-of-time compiler of a .vpunn model into C++ source: <ClassName>.h and <ClassName>.cpp, a VPUNN::AotModel with
+// the weights as constants (the FC ones already packed for this build's kernels) and the forward pass as the list of
+// the model layers, with all the shapes as constants. Used by vpunn_add_aot_model() in CMake.
+// Supported layers: FullyConnected, L2Normalization and kNN, with activations having the batch as first dimension.
+
+#include <stdio.h>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "inference/model_store.h"
+#include "kernels/fully_connected.h"
+#include "vpunn_generated.h"
+
+constexpr char usage_message[]{" <model.vpunn> <output directory> <class name>"};
+
+namespace {
+
+/// @brief the source of a float literal that reads back as exactly the same float
+std::string float_literal(const float value) {
+    if (!std::isfinite(value)) {
+        throw std::runtime_error("the model has a constant that is not a finite number");
+    }
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", static_cast<double>(value));
+    std::string literal{text};
+    if (literal.find_first_of(".e") == std::string::npos) {
+        literal += ".0";
+    }
+    return literal + "F";
+}
+
+/// @brief the source of a C++ string literal
+std::string string_literal(const std::string& text) {
+    std::string literal{"\""};
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            literal += '\\';
+        }
+        literal += c;
+    }
+    return literal + "\"";
+}
+
+/// @brief the kernel activation of a layer
+std::string activation_name(const VPUNN_SCHEMA::ActivationFunctionType activation) {
+    switch (activation) {
+    case VPUNN_SCHEMA::ActivationFunctionType_RELU:
+        return "DenseActivation::RELU";
+    case VPUNN_SCHEMA::ActivationFunctionType_SIGMOID:
+        return "DenseActivation::SIGMOID";
+    default:
+        return "DenseActivation::NONE";
+    }
+}
+
+/// @brief generates the source of one model
+class AotGenerator {
+private:
+    std::shared_ptr<const VPUNN::ModelStore> store;
+    const VPUNN_SCHEMA::Model* model;
+    std::string class_name;
+    std::map<flatbuffers::uoffset_t, unsigned int> slots;  ///< activation tensor index -> buffer
+    std::vector<unsigned int> row_sizes;                   ///< floats per row of each buffer
+    std::stringstream constants;                           ///< the weights definitions
+    std::stringstream forward;                             ///< the forward pass body
+    std::stringstream setup;                               ///< the constructor body
+    unsigned int knn_layers{0};                            ///< the kNN workspaces added by setup
+    std::map<std::string, bool> emitted;                   ///< the constants already defined
+
+    static void fail(const std::string& message) {
+        throw std::runtime_error(message);
+    }
+
+    /// @brief defines a constant array once, named name
+    void emit_constant(const std::string& name, const float* data, const size_t size) {
+        if (emitted[name]) {
+            return;
+        }
+        emitted[name] = true;
+        constants << "alignas(64) constexpr float " << name << "[" << size << "]{";
+        for (size_t idx = 0; idx < size; idx++) {
+            constants << ((idx % 8 == 0) ? "\n        " : " ") << float_literal(data[idx])
+                      << ((idx + 1 < size) ? "," : "");
+        }
+        constants << "};\n\n";
+    }
+
+    /// @brief the name of a constant tensor of the model, defined on first use
+    std::string constant(const flatbuffers::uoffset_t tensor_idx) {
+        const auto tensor = store->constant_tensor(tensor_idx);
+        if (tensor == nullptr) {
+            fail("tensor " + std::to_string(tensor_idx) + " is used as a constant but has no data");
+        }
+        const std::string name{"tensor_" + std::to_string(tensor_idx)};
+        emit_constant(name, tensor->c_ptr(), static_cast<size_t>(tensor->size()));
+        return name;
+    }
+
+    /// @brief the buffer of an activation tensor of the model
+    unsigned int slot(const flatbuffers::uoffset_t tensor_idx) const {
+        const auto it = slots.find(tensor_idx);
+        if (it == slots.end()) {
+            fail("tensor " + std::to_string(tensor_idx) + " is used as an activation but is not one");
+        }
+        return it->second;
+    }
+
+    /// @brief the dimension dim of a constant tensor, with the expected rank
+    unsigned int dimension(const flatbuffers::uoffset_t tensor_idx, const unsigned int dim) const {
+        const auto shape = model->tensors()->Get(tensor_idx)->shape();
+        if (shape->size() != 2) {
+            fail("tensor " + std::to_string(tensor_idx) + " is not two dimensional");
+        }
+        return static_cast<unsigned int>(shape->Get(dim));
+    }
+
+    void check_row(const unsigned int buffer, const unsigned int expected, const flatbuffers::uoffset_t layer) const {
+        if (row_sizes[buffer] != expected) {
+            fail("layer " + std::to_string(layer) + " has an activation of " + std::to_string(row_sizes[buffer]) +
+                 " values per row, the layer works on " + std::to_string(expected));
+        }
+    }
+
+    void add_activations() {
+        const auto tensors = model->tensors();
+        for (flatbuffers::uoffset_t idx = 0; idx < tensors->size(); idx++) {
+            if (store->constant_tensor(idx) != nullptr) {
+                continue;
+            }
+            const auto shape = tensors->Get(idx)->shape();
+            if (shape->size() < 1 || shape->Get(0) != 1) {
+                fail("activation " + std::to_string(idx) + " does not have the batch as first dimension");
+            }
+            unsigned int row_size{1};
+            for (flatbuffers::uoffset_t dim = 1; dim < shape->size(); dim++) {
+                row_size *= static_cast<unsigned int>(shape->Get(dim));
+            }
+            slots[idx] = static_cast<unsigned int>(row_sizes.size());
+            row_sizes.push_back(row_size);
+        }
+    }
+
+    void add_layer(const flatbuffers::uoffset_t idx) {
+        const auto layer = model->operators()->Get(idx);
+        const auto inputs = layer->inputs();
+        const auto outputs = layer->outputs();
+        if (inputs->size() < 1 || outputs->size() != 1) {
+            fail("layer " + std::to_string(idx) + " does not have one input activation and one output");
+        }
+        const unsigned int in{slot(inputs->Get(0))};
+        const unsigned int out{slot(outputs->Get(0))};
+        const std::string activation{activation_name(layer->activation_function())};
+
+        switch (layer->implementation_type()) {
+        case VPUNN_SCHEMA::LayerType_FullyConnectedLayer: {
+            // inputs: activations, weights, bias. The weights are emitted packed, as the FC kernels consume them
+            const auto& packed = store->packed_dense_weights(idx);
+            const std::string weights{"layer_" + std::to_string(idx) + "_packed_weights"};
+            emit_constant(weights, packed.c_ptr(), packed.size_in_bytes() / sizeof(float));
+            const std::string bias{(inputs->size() > 2) ? constant(inputs->Get(2)) : "nullptr"};
+            check_row(in, static_cast<unsigned int>(packed.get_input_channels()), idx);
+            check_row(out, static_cast<unsigned int>(packed.get_output_channels()), idx);
+            forward << "    dense(" << weights << ", " << packed.get_output_channels() << ", "
+                    << packed.get_input_channels() << ", " << bias << ", buffer(" << in << "), rows, buffer(" << out
+                    << "), " << activation << ");\n";
+            return;  // the activation is fused
+        }
+        case VPUNN_SCHEMA::LayerType_L2NormalizationLayer:
+            check_row(out, row_sizes[in], idx);
+            forward << "    l2_normalization(buffer(" << in << "), rows, " << row_sizes[in] << ", buffer(" << out
+                    << "));\n";
+            break;
+        case VPUNN_SCHEMA::LayerType_kNNLayer: {
+            // inputs: activations, weights, targets
+            if (inputs->size() < 3) {
+                fail("kNN layer " + std::to_string(idx) + " does not have weights and targets");
+            }
+            const unsigned int items{dimension(inputs->Get(1), 0)};
+            const unsigned int embedding{dimension(inputs->Get(1), 1)};
+            const unsigned int targets{dimension(inputs->Get(2), 1)};
+            check_row(in, embedding, idx);
+            check_row(out, targets, idx);
+            const std::string weights_name{constant(inputs->Get(1))};
+            const std::string targets_name{constant(inputs->Get(2))};
+            const unsigned int n_neighbours{layer->implementation_as_kNNLayer()->n_neighbors()};
+            // its scratch memory is allocated once, by the constructor
+            setup << "    add_knn_workspace(" << items << ", " << n_neighbours << ");\n";
+            forward << "    knn(" << knn_layers++ << ", " << weights_name << ", " << targets_name << ", " << items
+                    << ", " << embedding << ", " << targets << ", " << n_neighbours << ", buffer(" << in
+                    << "), rows, buffer(" << out << "));\n";
+            break;
+        }
+        default:
+            fail("layer " + std::to_string(idx) + " is of a type that cannot be compiled ahead of time");
+        }
+        if (activation != "DenseActivation::NONE") {
+            forward << "    activate(buffer(" << out << "), rows * " << row_sizes[out] << ", " << activation << ");\n";
+        }
+    }
+
+public:
+    AotGenerator(std::shared_ptr<const VPUNN::ModelStore> model_store, std::string name)
+            : store(std::move(model_store)), model(store->get_model()), class_name(std::move(name)) {
+    }
+
+    /// @brief generates the source, throws if the model cannot be compiled
+    void generate() {
+        if (store->get_precision() != VPUNN::WeightPrecision::FP32) {
+            fail("only FP32 weights can be compiled ahead of time");
+        }
+        if (model->inputs()->size() != 1 || model->outputs()->size() != 1) {
+            fail("only models with one input and one output can be compiled ahead of time");
+        }
+        add_activations();
+        for (flatbuffers::uoffset_t idx = 0; idx < model->operators()->size(); idx++) {
+            add_layer(idx);
+        }
+    }
+
+    std::string header(const std::string& source_name) const {
+        std::stringstream text;
+        text << "// Generated by vpunn_aot from " << source_name << ", do not edit\n\n"
+             << "#ifndef VPUNN_AOT_" << class_name << "_H\n"
+             << "#define VPUNN_AOT_" << class_name << "_H\n\n"
+             << "#include \"inference/aot_model.h\"\n\n"
+             << "namespace VPUNN {\n\n"
+             << "/// @brief the network " << std::string(model->name()->c_str()) << ", compiled ahead of time\n"
+             << "class " << class_name << " : public AotModel {\n"
+             << "public:\n"
+             << "    /// @brief allocates the activations for a maximum batch\n"
+             << "    explicit " << class_name << "(const unsigned int batch = 1);\n\n"
+             << "protected:\n"
+             << "    void forward(const unsigned int rows) override;\n"
+             << "};\n\n"
+             << "}  // namespace VPUNN\n\n"
+             << "#endif  // VPUNN_AOT_" << class_name << "_H\n";
+        return text.str();
+    }
+
+    std::string source(const std::string& source_name) const {
+        std::stringstream text;
+        text << "// Generated by vpunn_aot from " << source_name << ", do not edit\n\n"
+             << "#include \"" << class_name << ".h\"\n\n"
+             << "namespace VPUNN {\n\n"
+             << "namespace {\n\n"
+             << constants.str() << "}  // namespace\n\n"
+             << class_name << "::" << class_name << "(const unsigned int batch)\n"
+             << "        : AotModel(" << string_literal(std::string(model->name()->c_str())) << ", batch, {";
+        for (size_t idx = 0; idx < row_sizes.size(); idx++) {
+            text << ((idx > 0) ? ", " : "") << row_sizes[idx];
+        }
+        text << "}, " << slot(model->inputs()->Get(0)) << ", " << slot(model->outputs()->Get(0)) << ", "
+             << (VPUNN::PackedDenseWeights::repacked_layout() ? "true" : "false") << ") {\n"
+             << setup.str() << "}\n\n"
+             << "void " << class_name << "::forward(const unsigned int rows) {\n"
+             << forward.str() << "}\n\n"
+             << "}  // namespace VPUNN\n";
+        return text.str();
+    }
+};
+
+bool write_file(const std::string& filename, const std::string& content) {
+    std::ofstream file(filename, std::ios::out | std::ios::trunc);
+    file << content;
+    return static_cast<bool>(file);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        printf("Usage %s %s\n", argv[0], usage_message);
+        return 1;
+    }
+    const std::string filename{argv[1]};
+    const std::string output_dir{argv[2]};
+    const std::string class_name{argv[3]};
+
+    const auto store = VPUNN::ModelStore::from_file(filename.c_str(), false);
+    if (store == nullptr || !store->get_error().empty()) {
+        printf("Error! Cannot load the model %s %s\n", filename.c_str(),
+               (store != nullptr) ? store->get_error().c_str() : "");
+        return 1;
+    }
+
+    const std::string source_name{filename.substr(filename.find_last_of("/\\") + 1)};
+    AotGenerator generator(store, class_name);
+    try {
+        generator.generate();
+    } catch (const std::exception& e) {
+        printf("Error! Cannot compile the model %s: %s\n", filename.c_str(), e.what());
+        return 1;
+    }
+
+    if (!write_file(output_dir + "/" + class_name + ".h", generator.header(source_name)) ||
+        !write_file(output_dir + "/" + class_name + ".cpp", generator.source(source_name))) {
+        printf("Error! Cannot write the sources of %s in %s\n", class_name.c_str(), output_dir.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#include "core/mapped_file.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VPUNN {
+
+#if defined(_WIN32)
+MappedFile::MappedFile(const char* filename) {
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0) {
+        CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);  // the mapping keeps the file open
+    if (mapping == nullptr) {
+        return;
+    }
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return;
+    }
+    _data = static_cast<const char*>(view);
+    _size = static_cast<size_t>(file_size.QuadPart);
+    _mapping_handle = mapping;
+}
+
+MappedFile::~MappedFile() {
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+        CloseHandle(static_cast<HANDLE>(_mapping_handle));
+    }
+}
+#else
+MappedFile::MappedFile(const char* filename) {
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat file_status;
+    if (fstat(fd, &file_status) != 0 || file_status.st_size <= 0) {
+        close(fd);
+        return;
+    }
+    const size_t size = static_cast<size_t>(file_status.st_size);
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps the file open
+    if (view == MAP_FAILED) {
+        return;
+    }
+    _data = static_cast<const char*>(view);
+    _size = size;
+}
+
+MappedFile::~MappedFile() {
+    if (_data != nullptr) {
+        munmap(const_cast<char*>(_data), _size);
+    }
+}
+#endif
+
+}  // namespace VPUNN
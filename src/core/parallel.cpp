@@ -0,0 +1,98 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#include "core/parallel.h"
+
+namespace VPUNN {
+
+namespace {
+/// @brief true in the pool workers and in a thread running a parallel region: a nested region runs serially
+thread_local bool inside_region{false};
+}  // namespace
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::workers_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return workers.size();
+}
+
+void ThreadPool::run(const size_t tasks, const std::function<void(size_t)>& task) {
+    std::unique_lock<std::mutex> region(run_mutex, std::defer_lock);
+    if (inside_region || tasks <= 1 || !region.try_lock()) {
+        // nested call or busy with a region of another thread: serial, same results
+        for (size_t idx = 0; idx < tasks; ++idx) {
+            task(idx);
+        }
+        return;
+    }
+    inside_region = true;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (workers.size() < tasks - 1) {  // started once, then reused
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+    job = &task;
+    job_tasks = tasks;
+    next_task = 0;
+    completed = 0;
+    wake.notify_all();
+
+    run_available(lock);
+    done.wait(lock, [this]() {
+        return completed == job_tasks;
+    });
+    job = nullptr;
+    job_tasks = 0;
+    next_task = 0;
+    inside_region = false;
+}
+
+void ThreadPool::run_available(std::unique_lock<std::mutex>& lock) {
+    while (next_task < job_tasks) {
+        const size_t idx{next_task++};
+        const auto* task = job;
+        lock.unlock();
+        (*task)(idx);
+        lock.lock();
+        if (++completed == job_tasks) {
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::worker_loop() {
+    inside_region = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() {
+            return stop || next_task < job_tasks;
+        });
+        if (stop) {
+            return;
+        }
+        run_available(lock);
+    }
+}
+
+}  // namespace VPUNN
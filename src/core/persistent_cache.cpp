@@ -0,0 +1,374 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#include "core/persistent_cache.h"
+#include "core/fingerprint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VPUNN {
+
+namespace {
+
+/// @brief start of the file
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t generation;  ///< changes each time the file is rewritten (created, compacted)
+};
+
+/// @brief one cached value
+struct Record {
+    uint64_t key;
+    float value;
+    uint32_t check;  ///< detects the incomplete/corrupted records
+};
+
+static_assert(sizeof(Header) == 24, "packed header expected");
+static_assert(sizeof(Record) == 16, "packed record expected");
+
+constexpr char cache_magic[8]{'V', 'P', 'U', 'N', 'N', 'P', 'C', '\0'};
+constexpr uint32_t cache_version{2};
+
+Header make_header(const uint64_t generation) {
+    Header header;
+    std::memcpy(header.magic, cache_magic, sizeof(header.magic));
+    header.version = cache_version;
+    header.record_size = sizeof(Record);
+    header.generation = generation;
+    return header;
+}
+
+/// @brief true if the header is one of this format, whatever its generation
+bool is_cache_header(const Header& header) {
+    const Header expected{make_header(header.generation)};
+    return std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+           header.version == expected.version && header.record_size == expected.record_size;
+}
+
+/// @brief a generation different from the ones the file had before, also when written by another process
+uint64_t new_generation() {
+    static std::atomic<uint64_t> counter{0};
+    return Fingerprint{static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count())}
+            .add(static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()))
+            .add(++counter)
+            .value();
+}
+
+uint32_t record_check(const uint64_t key, const float value) {
+    return static_cast<uint32_t>(Fingerprint{key}.add(value).value());
+}
+
+#if defined(_WIN32)
+/// @brief opens for reading and writing if writable, falls back to reading only. writable reports what was opened
+intptr_t open_file(const std::string& filename, bool& writable) {
+    HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ | (writable ? GENERIC_WRITE : 0),
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE && writable) {
+        writable = false;
+        return open_file(filename, writable);
+    }
+    return (handle == INVALID_HANDLE_VALUE) ? -1 : reinterpret_cast<intptr_t>(handle);
+}
+
+void close_file(const intptr_t file) {
+    CloseHandle(reinterpret_cast<HANDLE>(file));
+}
+
+/// @brief locks a byte far beyond the data, the locks of Windows would otherwise block the readers
+bool lock_for_writing(const intptr_t file) {
+    OVERLAPPED position{};
+    position.Offset = 0;
+    position.OffsetHigh = 0x7FFFFFFF;
+    return LockFileEx(reinterpret_cast<HANDLE>(file), LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0,
+                      &position) != 0;
+}
+
+uint64_t file_size(const intptr_t file) {
+    LARGE_INTEGER size;
+    return GetFileSizeEx(reinterpret_cast<HANDLE>(file), &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+}
+
+bool read_at(const intptr_t file, const uint64_t offset, void* data, const size_t length) {
+    OVERLAPPED position{};
+    position.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD done{0};
+    return ReadFile(reinterpret_cast<HANDLE>(file), data, static_cast<DWORD>(length), &done, &position) &&
+           done == length;
+}
+
+bool append(const intptr_t file, const void* data, const size_t length) {
+    OVERLAPPED position{};  // all ones: write at the end of the file
+    position.Offset = 0xFFFFFFFF;
+    position.OffsetHigh = 0xFFFFFFFF;
+    DWORD done{0};
+    return WriteFile(reinterpret_cast<HANDLE>(file), data, static_cast<DWORD>(length), &done, &position) &&
+           done == length;
+}
+
+bool truncate_file(const intptr_t file, const uint64_t length) {
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(length);
+    return SetFilePointerEx(reinterpret_cast<HANDLE>(file), position, nullptr, FILE_BEGIN) &&
+           SetEndOfFile(reinterpret_cast<HANDLE>(file));
+}
+#else
+/// @brief opens for reading and writing if writable, falls back to reading only. writable reports what was opened
+intptr_t open_file(const std::string& filename, bool& writable) {
+    int fd{writable ? open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644) : -1};
+    if (fd < 0) {
+        writable = false;
+        fd = open(filename.c_str(), O_RDONLY);
+    }
+    return fd;
+}
+
+void close_file(const intptr_t file) {
+    close(static_cast<int>(file));  // releases the lock
+}
+
+bool lock_for_writing(const intptr_t file) {
+    return flock(static_cast<int>(file), LOCK_EX | LOCK_NB) == 0;
+}
+
+uint64_t file_size(const intptr_t file) {
+    struct stat file_status;
+    return (fstat(static_cast<int>(file), &file_status) == 0) ? static_cast<uint64_t>(file_status.st_size) : 0;
+}
+
+bool read_at(const intptr_t file, const uint64_t offset, void* data, const size_t length) {
+    size_t done{0};
+    while (done < length) {
+        const ssize_t count{pread(static_cast<int>(file), static_cast<char*>(data) + done, length - done,
+                                  static_cast<off_t>(offset + done))};
+        if (count <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool append(const intptr_t file, const void* data, const size_t length) {
+    // one write of a whole record: O_APPEND places it at the end of the file atomically
+    return write(static_cast<int>(file), data, length) == static_cast<ssize_t>(length);
+}
+
+bool truncate_file(const intptr_t file, const uint64_t length) {
+    return ftruncate(static_cast<int>(file), static_cast<off_t>(length)) == 0;
+}
+#endif
+
+}  // namespace
+
+PersistentCache::PersistentCache(const std::string& filename, const bool writable, const size_t max_records)
+        : max_records(std::max(max_records, size_t{2})) {
+    bool opened_writable{writable};
+    file = open_file(filename, opened_writable);
+    if (file < 0) {
+        return;
+    }
+    can_take_over = opened_writable;
+    std::lock_guard<std::mutex> lock(values_mutex);
+    refresh_records();
+    // the writer creating the file writes the header right after opening it, wait a little for it
+    constexpr int header_retries{20};
+    for (int retry = 0; retry < header_retries && !valid && !foreign && !writer; ++retry) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        refresh_records();
+    }
+}
+
+PersistentCache::~PersistentCache() {
+    if (file >= 0) {
+        close_file(file);
+    }
+}
+
+size_t PersistentCache::read_new_records() {
+    if (file < 0 || foreign) {
+        return 0;
+    }
+    const uint64_t size{file_size(file)};
+    Header header;
+    if (size < sizeof(header) || !read_at(file, 0, &header, sizeof(header))) {
+        return 0;  // the writer has not written it yet, or is rewriting it
+    }
+    if (!is_cache_header(header)) {
+        foreign = !valid;  // once valid, only a header being rewritten, read again on refresh
+        return 0;
+    }
+    if (!valid || header.generation != generation) {
+        // a new file, or rewritten by the writer: read from the start, only what is in the file is kept
+        values.clear();
+        generation = header.generation;
+        read_offset = sizeof(header);
+        valid = true;
+    }
+
+    constexpr size_t chunk{4096};
+    std::vector<Record> records;
+    size_t added{0};
+    while (read_offset + sizeof(Record) <= size) {
+        const size_t count{static_cast<size_t>(std::min<uint64_t>((size - read_offset) / sizeof(Record), chunk))};
+        records.resize(count);
+        if (!read_at(file, read_offset, records.data(), count * sizeof(Record))) {
+            break;
+        }
+        for (const auto& record : records) {
+            if (record.check != record_check(record.key, record.value)) {
+                return added;  // incomplete or corrupted, the valid part of the file ends here
+            }
+            if (values.size() < max_records) {
+                values[record.key] = record.value;
+            }
+            read_offset += sizeof(Record);
+            ++added;
+        }
+    }
+    return added;
+}
+
+size_t PersistentCache::start_writing() {
+    writer = true;
+    if (file_size(file) < sizeof(Header)) {
+        // new file, or a partial header left by a writer stopped while creating it
+        writer = rewrite(nullptr, 0);
+    }
+    const size_t added{read_new_records()};
+    // drops what follows the valid records, e.g. a record interrupted by a crash, so appends stay aligned
+    writer = writer && valid && (file_size(file) == read_offset || truncate_file(file, read_offset));
+    if (writer && file_records() > max_records / 2) {
+        writer = compact();
+    }
+    return added;
+}
+
+uint64_t PersistentCache::file_records() const {
+    return valid ? (read_offset - sizeof(Header)) / sizeof(Record) : 0;
+}
+
+bool PersistentCache::rewrite(const void* records, const size_t count) {
+    // the readers that see the new generation read the file again, even if it is still being written
+    const Header header{make_header(new_generation())};
+    if (!truncate_file(file, 0) || !append(file, &header, sizeof(header))) {
+        return false;
+    }
+    constexpr size_t chunk{4096};
+    for (size_t done = 0; done < count; done += chunk) {
+        const size_t length{std::min(chunk, count - done) * sizeof(Record)};
+        if (!append(file, static_cast<const char*>(records) + done * sizeof(Record), length)) {
+            return false;
+        }
+    }
+    generation = header.generation;
+    read_offset = sizeof(header) + count * sizeof(Record);
+    valid = true;
+    return true;
+}
+
+bool PersistentCache::compact() {
+    const size_t kept{static_cast<size_t>(std::min<uint64_t>(file_records(), max_records / 2))};
+    std::vector<Record> newest(kept);
+    if (kept > 0 && !read_at(file, read_offset - kept * sizeof(Record), newest.data(), kept * sizeof(Record))) {
+        return false;
+    }
+    if (!rewrite(newest.data(), kept)) {
+        return false;
+    }
+    values.clear();
+    for (const auto& record : newest) {
+        values[record.key] = record.value;
+    }
+    return true;
+}
+
+size_t PersistentCache::refresh_records() {
+    next_refresh = std::chrono::steady_clock::now() + refresh_interval;
+    if (writer || foreign) {
+        return 0;
+    }
+    if (can_take_over && lock_for_writing(file)) {
+        can_take_over = false;  // the lock is kept until the file is closed
+        return start_writing();
+    }
+    return read_new_records();
+}
+
+bool PersistentCache::get(const uint64_t key, float& value) {
+    std::lock_guard<std::mutex> lock(values_mutex);
+    auto found = values.find(key);
+    if (found == values.end() && !writer && std::chrono::steady_clock::now() >= next_refresh &&
+        refresh_records() > 0) {
+        found = values.find(key);
+    }
+    if (found == values.end()) {
+        return false;
+    }
+    value = found->second;
+    return true;
+}
+
+void PersistentCache::add(const uint64_t key, const float value) {
+    std::lock_guard<std::mutex> lock(values_mutex);
+    if (values.find(key) != values.end()) {
+        return;  // already known, the value of a key does not change
+    }
+    if (writer && (file_records() >= max_records || values.size() >= max_records)) {
+        writer = compact();  // stops writing on a file error
+    }
+    if (values.size() >= max_records) {
+        return;
+    }
+    values.emplace(key, value);
+    if (writer) {
+        const Record record{key, value, record_check(key, value)};
+        writer = append(file, &record, sizeof(record));  // stops writing on a file error
+        if (writer) {
+            read_offset += sizeof(record);
+        }
+    }
+}
+
+size_t PersistentCache::refresh() {
+    std::lock_guard<std::mutex> lock(values_mutex);
+    return refresh_records();
+}
+
+void PersistentCache::set_refresh_interval(const std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(values_mutex);
+    refresh_interval = interval;
+    next_refresh = std::chrono::steady_clock::now() + refresh_interval;
+}
+
+size_t PersistentCache::size() const {
+    std::lock_guard<std::mutex> lock(values_mutex);
+    return values.size();
+}
+
+}  // namespace VPUNN
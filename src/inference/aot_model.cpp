@@ -0,0 +1,106 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#include "inference/aot_model.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "core/tensors.h"
+#include "kernels/kNN.h"
+#include "kernels/l2_normalization.h"
+#include "kernels/sigmoid.h"
+
+namespace VPUNN {
+
+AotModel::AotModel(const char* network, const unsigned int batch, std::vector<unsigned int> row_sizes,
+                   const unsigned int input, const unsigned int output, const bool repacked_weights)
+        : name(network),
+          batch_capacity(std::max(batch, 1U)),
+          slot_row_sizes(std::move(row_sizes)),
+          input_slot(input),
+          output_slot(output) {
+    if (repacked_weights != PackedDenseWeights::repacked_layout()) {
+        std::stringstream buffer;
+        buffer << "[ERROR]AotModel::AotModel(), the model " << name << " was generated for "
+               << (repacked_weights ? "the internal BLAS" : "an external BLAS")
+               << " FC weights layout, this build uses the other one, generate it again with this build's vpunn_aot"
+               << " File: " << __FILE__ << " Line: " << __LINE__;
+        throw std::runtime_error(buffer.str());
+    }
+    buffers.reserve(slot_row_sizes.size());
+    for (const auto row_size : slot_row_sizes) {
+        buffers.emplace_back(static_cast<size_t>(batch_capacity) * row_size, 0.0f);
+    }
+}
+
+const float* AotModel::predict(const float* input_array, const unsigned int input_size) {
+    const unsigned int row_size{slot_row_sizes[input_slot]};
+    const unsigned int rows{(row_size > 0 && input_size % row_size == 0) ? input_size / row_size : 0};
+    if (rows == 0 || rows > batch_capacity) {
+        std::stringstream buffer;
+        buffer << "[ERROR]AotModel::predict(), input size " << input_size << " is not a whole number of rows of "
+               << row_size << " values, from 1 to the maximum batch " << batch_capacity << " File: " << __FILE__
+               << " Line: " << __LINE__;
+        throw std::runtime_error(buffer.str());
+    }
+    std::copy_n(input_array, input_size, buffers[input_slot].begin());
+    current_rows = rows;
+    forward(rows);
+    return buffers[output_slot].data();
+}
+
+const std::vector<float> AotModel::predict(const std::vector<float>& input_tensor) {
+    const float* output{predict(input_tensor.data(), static_cast<unsigned int>(input_tensor.size()))};
+    return std::vector<float>(output, output + static_cast<size_t>(current_rows) * slot_row_sizes[output_slot]);
+}
+
+void AotModel::l2_normalization(float* input, const unsigned int rows, const unsigned int channels, float* output) {
+    auto in = Tensor<float>::view({rows, channels}, input);
+    auto out = Tensor<float>::view({rows, channels}, output);
+    L2Normalization(&in, &out);
+}
+
+unsigned int AotModel::add_knn_workspace(const unsigned int items, const unsigned int n_neighbours) {
+    knn_workspaces.emplace_back();
+    knn_workspaces.back().reserve(batch_capacity, items, n_neighbours);
+    return static_cast<unsigned int>(knn_workspaces.size() - 1);
+}
+
+void AotModel::knn(const unsigned int workspace, const float* weights, const float* targets, const unsigned int items,
+                   const unsigned int embedding, const unsigned int outputs, const unsigned int n_neighbours,
+                   float* input, const unsigned int rows, float* output) {
+    // the database is in the generated read-only data: read-only views
+    const auto database = Tensor<float>::const_view({items, embedding}, weights);
+    const auto database_targets = Tensor<float>::const_view({items, outputs}, targets);
+    auto in = Tensor<float>::view({rows, embedding}, input);
+    auto out = Tensor<float>::view({rows, outputs}, output);
+    kNN(database.get(), database_targets.get(), &in, &out, n_neighbours, knn_workspaces[workspace]);
+}
+
+void AotModel::activate(float* data, const unsigned int size, const DenseActivation activation) {
+    switch (activation) {
+    case DenseActivation::RELU:
+        for (unsigned int idx = 0; idx < size; idx++) {
+            if (data[idx] < 0)
+                data[idx] = 0;
+        }
+        break;
+    case DenseActivation::SIGMOID: {
+        auto tensor = Tensor<float>::view({size}, data);
+        Sigmoid(&tensor);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+}  // namespace VPUNN
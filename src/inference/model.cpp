@@ -9,121 +9,399 @@
 
 #include "inference/model.h"
 
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <utility>
+
 namespace VPUNN {
 
-InferenceModel::InferenceModel(const char* filename): initialized(false) {
-    std::ifstream myFile;
+InferenceModel::InferenceModel(const char* filename): InferenceModel(filename, false) {
+}
+
+InferenceModel::InferenceModel(const char* filename, const bool memory_map, const WeightPrecision weight_precision,
+                               const std::string& packed_weights_directory)
+        : initialized(false) {
+    set_store(ModelRegistry::instance().get(filename, memory_map, weight_precision, packed_weights_directory));
+}
+
+InferenceModel::InferenceModel(const char* data, size_t length, bool with_copy,
+                               const WeightPrecision weight_precision)
+        : initialized(false) {
+    set_store(ModelStore::from_buffer(data, length, with_copy, weight_precision));
+}
+
+InferenceModel::InferenceModel(std::shared_ptr<const ModelStore> model_store): initialized(false) {
+    set_store(std::move(model_store));
+}
+
+InferenceModel::InferenceModel(const InferenceModel& other)
+        : store(other.store), model(other.model), profiling(other.profiling), initialized(other.initialized) {
+    if (other.max_batch == 0) {
+        return;  // nothing allocated yet
+    }
+    allocate_tensors(other.max_batch);
+    set_batch(other.current_batch);
+    // same model and batch, same arena layout: the activations are copied at once
+    std::copy_n(other.activations_data(), arena_size, arena.data() + arena_begin);
+}
+
+InferenceModel& InferenceModel::operator=(const InferenceModel& other) {
+    if (this != &other) {
+        *this = InferenceModel(other);
+    }
+    return *this;
+}
 
-    myFile.open(filename, std::ios::binary | std::ios::in);
-    if (myFile.fail()) {
-        // File does not exist code here
+void InferenceModel::set_store(std::shared_ptr<const ModelStore> model_store) {
+    if (model_store == nullptr) {
         return;
     }
-    myFile.seekg(0, std::ios::end);
-    const auto length = myFile.tellg();
-    myFile.seekg(0, std::ios::beg);
+    store = std::move(model_store);
+    model = store->get_model();
+    initialized = true;
+}
 
-    buf.resize(static_cast<size_t>(length));
+void InferenceModel::allocate_tensors(const unsigned int batch) {
+    if (!store->get_error().empty()) {
+        throw std::runtime_error(store->get_error());
+    }
 
-    myFile.read(buf.data(), length);
-    myFile.close();
+    auto tensors = model->tensors();
+    tensor_map.clear();
+    tensor_map.reserve(tensors->size());
+    batched_tensors.clear();
+    max_batch = std::max(batch, 1U);
 
-    flatbuffers::Verifier verifier(reinterpret_cast<const uint8_t*>(buf.data()), buf.size());
-    if (!(VPUNN_SCHEMA::VerifyModelBuffer(verifier))) {
-        return;
+    // Batch only activations
+    // we use the batch only for buffers that are not stored in model (dynamic tensors)
+    std::vector<std::vector<unsigned int>> shapes(tensors->size());
+    std::vector<size_t> sizes(tensors->size(), 0);
+    for (flatbuffers::uoffset_t idx = 0; idx < tensors->size(); idx++) {
+        if (store->constant_tensor(idx) != nullptr) {
+            continue;
+        }
+        shapes[idx] = parse_vector(tensors->Get(idx)->shape(), max_batch);
+        sizes[idx] = std::accumulate(shapes[idx].begin(), shapes[idx].end(), size_t{1}, std::multiplies<size_t>());
+        const auto model_shape = tensors->Get(idx)->shape();
+        if (model_shape->size() > 0 && model_shape->Get(0) == 1) {
+            batched_tensors.push_back(idx);
+        }
     }
 
-    model = VPUNN_SCHEMA::GetModel(buf.data());
-    initialized = true;
+    const auto offsets = plan_arena(sizes);
+    constexpr size_t alignment_floats{arena_alignment / sizeof(float)};
+    arena.assign(arena_size + alignment_floats, 0.0f);  // zeros, as the activations were always initialized
+    const auto misalignment = reinterpret_cast<std::uintptr_t>(arena.data()) % arena_alignment;
+    arena_begin = (misalignment == 0) ? 0 : (arena_alignment - misalignment) / sizeof(float);
+    float* const base{arena.data() + arena_begin};
+
+    for (flatbuffers::uoffset_t idx = 0; idx < tensors->size(); idx++) {
+        const auto constant = store->constant_tensor(idx);
+        if (constant != nullptr) {
+            // the layers read the constants from the store (see operand), read only. No memory behind the placeholder
+            tensor_map.emplace_back(Tensor<float>::view(constant->shape(), nullptr));
+        } else {
+            tensor_map.emplace_back(Tensor<float>::view(shapes[idx], base + offsets[idx]));
+        }
+    }
+    current_batch = max_batch;
+    compile_plan();
 }
 
-InferenceModel::InferenceModel(const char* data, size_t length, bool with_copy): initialized(false) {
-    flatbuffers::Verifier verifier(reinterpret_cast<const uint8_t*>(data), length);
-    if (!(VPUNN_SCHEMA::VerifyModelBuffer(verifier))) {
-        return;
+std::vector<size_t> InferenceModel::plan_arena(const std::vector<size_t>& sizes) {
+    // lifetime of each activation, in layer positions: -1 is before the first layer, layers count after the last one
+    const auto layers = model->operators();
+    const int end_of_predict{static_cast<int>(layers->size())};
+    std::vector<int> first_use(sizes.size(), end_of_predict + 1);
+    std::vector<int> last_use(sizes.size(), -1);
+    std::vector<bool> produced(sizes.size(), false);
+    auto use = [&](const int tensor_idx, const int position) {
+        if (tensor_idx >= 0 && tensor_idx < static_cast<int>(sizes.size())) {
+            first_use[tensor_idx] = std::min(first_use[tensor_idx], position);
+            last_use[tensor_idx] = std::max(last_use[tensor_idx], position);
+        }
+    };
+    for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
+        const auto layer = layers->Get(idx);
+        for (auto it = layer->inputs()->begin(); it != layer->inputs()->end(); ++it) {
+            use(*it, static_cast<int>(idx));
+        }
+        for (auto it = layer->outputs()->begin(); it != layer->outputs()->end(); ++it) {
+            use(*it, static_cast<int>(idx));
+            if (*it >= 0 && *it < static_cast<int>(sizes.size())) {
+                produced[*it] = true;
+            }
+        }
+    }
+    for (auto it = model->outputs()->begin(); it != model->outputs()->end(); ++it) {
+        use(*it, end_of_predict);
+    }
+    for (size_t idx = 0; idx < sizes.size(); idx++) {
+        if (!produced[idx] || last_use[idx] < 0) {
+            // the inputs, and anything not written by a layer, keep their content for the whole predict
+            first_use[idx] = -1;
+            last_use[idx] = end_of_predict;
+        }
     }
 
-    if (with_copy) {
-        buf.assign(data, data + length);
-        model = VPUNN_SCHEMA::GetModel(buf.data());
-    } else {
-        model = VPUNN_SCHEMA::GetModel(data);
+    // greedy by size: the biggest activations are placed first, each one at the lowest offset where it does not
+    // overlap an already placed activation that is live at the same time
+    constexpr size_t alignment_floats{arena_alignment / sizeof(float)};
+    std::vector<size_t> order;
+    for (size_t idx = 0; idx < sizes.size(); idx++) {
+        if (sizes[idx] > 0) {
+            order.push_back(idx);
+        }
     }
+    std::stable_sort(order.begin(), order.end(), [&sizes](const size_t a, const size_t b) {
+        return sizes[a] > sizes[b];
+    });
 
-    initialized = true;
+    std::vector<size_t> offsets(sizes.size(), 0);
+    std::vector<size_t> placed;
+    arena_size = 0;
+    for (const auto idx : order) {
+        const size_t size{(sizes[idx] + alignment_floats - 1) / alignment_floats * alignment_floats};
+        // the memory taken by the placed activations live together with this one, by offset
+        std::vector<std::pair<size_t, size_t>> taken;
+        for (const auto other : placed) {
+            if (first_use[other] <= last_use[idx] && first_use[idx] <= last_use[other]) {
+                taken.emplace_back(offsets[other], offsets[other] + sizes[other]);
+            }
+        }
+        std::sort(taken.begin(), taken.end());
+        size_t offset{0};
+        for (const auto& range : taken) {
+            if (offset + size <= range.first) {
+                break;  // fits in the gap before this range
+            }
+            offset = std::max(offset, (range.second + alignment_floats - 1) / alignment_floats * alignment_floats);
+        }
+        offsets[idx] = offset;
+        placed.push_back(idx);
+        arena_size = std::max(arena_size, offset + size);
+    }
+    return offsets;
 }
 
-void InferenceModel::allocate_tensors(const unsigned int batch) {
-    auto tensors = model->tensors();
-    auto buffers = model->buffers();
-    for (auto flatbuffer_tensor = tensors->begin(); flatbuffer_tensor != tensors->end(); ++flatbuffer_tensor) {
-        const uint32_t buffer_ID = flatbuffer_tensor->buffer();
-        constexpr uint32_t NOT_EXISTING{0};
-        const bool buffer_is_present{buffer_ID != NOT_EXISTING};
-        // Batch only activations
-        // we use the batch only for buffers that are not stored in model (dynamic tensors)
-        const uint32_t forced_batch{(buffer_is_present) ? 1 : batch};
-
-        const auto tensor_shape{parse_vector(flatbuffer_tensor->shape(), forced_batch)};
-
-        {  // Create/Fill the new tensor structure
-            Tensor<float> tensor{tensor_shape};
-            if (buffer_is_present) {  // in this case, copy the existing data(the buffer) into tensor's memory
-                const auto array = buffers->Get(buffer_ID)->data();
-                tensor.assign((const float*)(array->data()),
-                              array->size());  // will throw if buffer mismatch with tensor shape
-            } else {
-                tensor.fill(0);  // Fill with zeros the tensor's memory
+void InferenceModel::compile_plan() {
+    const auto layers = model->operators();
+    plan.clear();
+    plan.reserve(layers->size());
+    profiles.clear();
+    profiles.reserve(layers->size());
+    knn_workspaces.clear();
+    knn_workspaces.reserve(layers->size());  // never reallocated, the steps point into it
+    for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
+        const auto layer = layers->Get(idx);
+        const auto inputs = get_tensors_from_index(layer->inputs());
+        const auto outputs = get_tensors_from_index(layer->outputs());
+
+        PlanStep step;
+        step.input = inputs.empty() ? nullptr : inputs[0];
+        step.output = outputs.empty() ? nullptr : outputs[0];
+        step.activation = dense_activation(layer->activation_function());
+        size_t needed_inputs{1};
+        switch (layer->implementation_type()) {
+        case VPUNN_SCHEMA::LayerType_FullyConnectedLayer:
+            // inputs: activations, weights, bias. Weights are used in their prepacked form
+            step.operation = StepOperation::DENSE;
+            step.packed = &store->packed_dense_weights(idx);
+            step.extra = (layer->inputs()->size() > 2) ? operand(layer->inputs()->Get(2)) : nullptr;
+            break;
+        case VPUNN_SCHEMA::LayerType_L2NormalizationLayer:
+            step.operation = StepOperation::L2_NORMALIZATION;
+            break;
+        case VPUNN_SCHEMA::LayerType_kNNLayer:
+            // inputs: activations, weights, targets
+            step.operation = StepOperation::KNN;
+            needed_inputs = 3;
+            step.n_neighbours = layer->implementation_as_kNNLayer()->n_neighbors();
+            if (inputs.size() >= needed_inputs) {
+                step.weights = operand(layer->inputs()->Get(1));
+                step.extra = operand(layer->inputs()->Get(2));
+                knn_workspaces.emplace_back();
+                knn_workspaces.back().reserve(step.input->shape()[0], step.weights->shape()[0], step.n_neighbours);
+                step.workspace = &knn_workspaces.back();
             }
-            tensor_map.emplace_back(std::move(tensor));
+            break;
+        default:
+            step.operation = StepOperation::NONE;  // only the activation, if any
+            needed_inputs = 0;
+            break;
+        }
+
+        if (inputs.size() < needed_inputs || (step.operation != StepOperation::NONE && step.output == nullptr)) {
+            plan.clear();
+            profiles.clear();
+            std::stringstream buffer;
+            buffer << "[ERROR]InferenceModel::compile_plan(), layer " << idx << " has " << inputs.size()
+                   << " inputs and " << outputs.size() << " outputs, its operation needs " << needed_inputs
+                   << " inputs and one output"
+                   << " File: " << __FILE__ << " Line: " << __LINE__;
+            throw std::runtime_error(buffer.str());
         }
+        plan.push_back(step);
+
+        LayerProfile profile;
+        profile.layer = idx;
+        profile.operation = (step.operation == StepOperation::DENSE)              ? "FullyConnected"
+                            : (step.operation == StepOperation::L2_NORMALIZATION) ? "L2Normalization"
+                            : (step.operation == StepOperation::KNN)              ? "kNN"
+                                                                                  : "None";
+        profile.activation = (step.activation == DenseActivation::RELU)      ? "ReLU"
+                             : (step.activation == DenseActivation::SIGMOID) ? "Sigmoid"
+                                                                             : "None";
+        profile.fused_activation = (step.operation == StepOperation::DENSE);
+        profiles.push_back(profile);
     }
 
-    bias.reserve_bias_space(this->max_batch_in_tensors());
+    const auto model_inputs = get_tensors_from_index(model->inputs());
+    const auto model_outputs = get_tensors_from_index(model->outputs());
+    plan_input = (model_inputs.size() == 1) ? model_inputs[0] : nullptr;
+    plan_output = (model_outputs.size() == 1) ? model_outputs[0] : nullptr;
+
+    // the sparse input goes straight to the first FC, so no other layer may read the (not written) model input
+    sparse_first_layer = (plan_input != nullptr) && !plan.empty() && plan.front().operation == StepOperation::DENSE &&
+                         plan.front().input == plan_input && plan.front().packed->sparse_input() &&
+                         plan_output != plan_input;
+    for (size_t idx = 1; idx < plan.size(); idx++) {
+        if (plan[idx].input == plan_input || plan[idx].weights == plan_input || plan[idx].extra == plan_input) {
+            sparse_first_layer = false;
+        }
+    }
 }
 
-void InferenceModel::predict() {
-    auto layers = model->operators();
+void InferenceModel::set_batch(const unsigned int new_batch) {
+    if (new_batch == current_batch) {
+        return;
+    }
+    if (new_batch == 0 || new_batch > max_batch) {
+        std::stringstream buffer;
+        buffer << "[ERROR]InferenceModel::set_batch(), batch " << new_batch
+               << " is not possible, the tensors are allocated for a maximum batch of " << max_batch
+               << " File: " << __FILE__ << " Line: " << __LINE__;
+        throw std::runtime_error(buffer.str());
+    }
+    for (const auto idx : batched_tensors) {
+        tensor_map[idx].resize_first_dimension(new_batch);
+    }
+    current_batch = new_batch;
+}
 
-    for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
-        // Create the new tensor structure
-        run_layer(layers->Get(idx));
+DenseActivation InferenceModel::dense_activation(const VPUNN_SCHEMA::ActivationFunctionType activation) {
+    switch (activation) {
+    case VPUNN_SCHEMA::ActivationFunctionType_RELU:
+        return DenseActivation::RELU;
+    case VPUNN_SCHEMA::ActivationFunctionType_SIGMOID:
+        return DenseActivation::SIGMOID;
+    default:
+        return DenseActivation::NONE;
     }
 }
 
-void InferenceModel::run_layer(const VPUNN_SCHEMA::Layer* layer) {
-    const auto inputs = get_tensors_from_index(layer->inputs());
-    auto outputs = get_tensors_from_index(layer->outputs());
+void InferenceModel::predict() {
+    if (profiling) {
+        predict_profiled();
+        return;
+    }
+    for (const auto& step : plan) {
+        run_step(step);
+    }
+}
 
-    switch (layer->implementation_type()) {
-    case VPUNN_SCHEMA::LayerType_FullyConnectedLayer:
-        // inputs: activations, weights, bias
-        Dense(inputs[1], inputs[0], outputs[0]);
+void InferenceModel::predict_sparse(const int* indexes, const float* values, const int nnz) {
+    if (plan_input == nullptr) {
+        std::stringstream buffer;
+        buffer << "[ERROR]InferenceModel::predict_sparse(), only single input models can be run"
+               << " File: " << __FILE__ << " Line: " << __LINE__;
+        throw std::runtime_error(buffer.str());
+    }
+    set_batch(1);
+    const unsigned int row_size{static_cast<unsigned int>(plan_input->size())};
+    for (int i = 0; i < nnz; ++i) {
+        if (indexes[i] < 0 || static_cast<unsigned int>(indexes[i]) >= row_size) {
+            std::stringstream buffer;
+            buffer << "[ERROR]InferenceModel::predict_sparse(), index " << indexes[i] << " is outside the input row of "
+                   << row_size << " values"
+                   << " File: " << __FILE__ << " Line: " << __LINE__;
+            throw std::runtime_error(buffer.str());
+        }
+    }
 
-        if (inputs.size() > 2) {
-            bias.Bias(inputs[2], outputs[0]);
+    // gathering a weight column costs about as much as a dense input, worth it only on mostly zero rows
+    if (!sparse_first_layer || static_cast<unsigned int>(nnz) * 2 > row_size) {
+        float* input = plan_input->data();
+        std::fill(input, input + row_size, 0.0f);
+        for (int i = 0; i < nnz; ++i) {
+            input[indexes[i]] = values[i];
         }
+        predict();
+        return;
+    }
+
+    const auto& first = plan.front();
+    if (profiling) {
+        const auto t0 = tick();
+        FusedDense(*first.packed, first.extra, indexes, values, nnz, first.output, first.activation);
+        profiles.front().kernel.add(tock(t0));
+        predict_profiled(1);
+        return;
+    }
+    FusedDense(*first.packed, first.extra, indexes, values, nnz, first.output, first.activation);
+    for (size_t idx = 1; idx < plan.size(); idx++) {
+        run_step(plan[idx]);
+    }
+}
+
+void InferenceModel::predict_profiled(const size_t first_step) {
+    for (size_t idx = first_step; idx < plan.size(); idx++) {
+        const auto& step = plan[idx];
+        auto& profile = profiles[idx];
+        const auto t0 = tick();
+        run_kernel(step);
+        profile.kernel.add(tock(t0));
+        if (!profile.fused_activation && step.activation != DenseActivation::NONE) {
+            const auto t1 = tick();
+            run_activation(step);
+            profile.activation_pass.add(tock(t1));
+        }
+    }
+}
+
+void InferenceModel::run_kernel(const PlanStep& step) {
+    switch (step.operation) {
+    case StepOperation::DENSE:
+        // bias and activation are applied by the FC kernel, while the output is still hot
+        FusedDense(*step.packed, step.extra, step.input, step.output, step.activation);
         break;
-    case VPUNN_SCHEMA::LayerType_L2NormalizationLayer:
-        L2Normalization(inputs[0], outputs[0]);
+    case StepOperation::L2_NORMALIZATION:
+        L2Normalization(step.input, step.output);
         break;
-    case VPUNN_SCHEMA::LayerType_kNNLayer:
+    case StepOperation::KNN:
         // weights, targets, activations
-        kNN(inputs[1], inputs[2], inputs[0], outputs[0], layer->implementation_as_kNNLayer()->n_neighbors());
+        kNN(step.weights, step.extra, step.input, step.output, step.n_neighbours, *step.workspace);
         break;
     default:
         break;
     }
+}
 
-    switch (layer->activation_function()) {
-    case VPUNN_SCHEMA::ActivationFunctionType_RELU:
-        for (int idx = 0; idx < outputs[0]->size(); idx++) {
-            if ((*outputs[0])[idx] < 0)
-                (*outputs[0])[idx] = 0;
+void InferenceModel::run_activation(const PlanStep& step) {
+    if (step.operation == StepOperation::DENSE || step.output == nullptr) {
+        return;  // fused in the FC kernel, or nothing to activate
+    }
+    switch (step.activation) {
+    case DenseActivation::RELU:
+        for (int idx = 0; idx < step.output->size(); idx++) {
+            if ((*step.output)[idx] < 0)
+                (*step.output)[idx] = 0;
         }
         break;
-    case VPUNN_SCHEMA::ActivationFunctionType_SIGMOID:
-        Sigmoid(outputs[0]);
+    case DenseActivation::SIGMOID:
+        Sigmoid(step.output);
+        break;
     default:
         break;
     }
@@ -0,0 +1,451 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+#include "inference/model_store.h"
+#include "core/half.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <sstream>
+
+namespace VPUNN {
+
+bool ModelStore::set_model(const char* data, size_t length) {
+    flatbuffers::Verifier verifier(reinterpret_cast<const uint8_t*>(data), length);
+    if (!(VPUNN_SCHEMA::VerifyModelBuffer(verifier))) {
+        return false;
+    }
+    model = VPUNN_SCHEMA::GetModel(data);
+    content_fingerprint = fingerprint_bytes(data, length);
+    return true;
+}
+
+namespace {
+
+/// @brief start of the packed weights file
+struct PackedWeightsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;     ///< PackedDenseWeights::layout_id of the build that packed them
+    uint64_t model;      ///< fingerprint of the model bytes the weights were packed from
+    uint64_t precision;  ///< the weights precision
+    uint64_t size;       ///< bytes of the whole file
+    uint64_t contents;   ///< fingerprint of the packed weights, detects a damaged file
+};
+
+constexpr char packed_weights_magic[8]{'V', 'P', 'U', 'N', 'N', 'P', 'W', '\0'};
+constexpr uint32_t packed_weights_version{1};
+/// @brief alignment of the header end and of the weights of each layer in the file, a cache line
+constexpr size_t packed_weights_alignment{64};
+
+size_t aligned_size(const size_t size) {
+    return (size + packed_weights_alignment - 1) / packed_weights_alignment * packed_weights_alignment;
+}
+
+/// @brief the fingerprint of the packed weights in a mapped file, what follows the header
+uint64_t packed_contents(const MappedFile& file) {
+    const size_t begin{aligned_size(sizeof(PackedWeightsHeader))};
+    return (file.is_mapped() && file.size() >= begin) ? fingerprint_bytes(file.data() + begin, file.size() - begin)
+                                                      : 0;
+}
+
+/// @brief true if the mapped file has the expected header (but for the contents) and undamaged contents
+bool is_packed_weights_file(const MappedFile& file, const PackedWeightsHeader& expected) {
+    PackedWeightsHeader header;
+    if (!file.is_mapped() || file.size() != expected.size || file.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    return std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+           header.version == expected.version && header.layout == expected.layout && header.model == expected.model &&
+           header.precision == expected.precision && header.size == expected.size &&
+           header.contents == packed_contents(file);
+}
+
+}  // namespace
+
+const Tensor<float>* ModelStore::dense_layer_weights(const flatbuffers::uoffset_t layer_idx) const {
+    const auto layer = model->operators()->Get(layer_idx);
+    // inputs: activations, weights, bias
+    if (layer->implementation_type() != VPUNN_SCHEMA::LayerType_FullyConnectedLayer || layer->inputs()->size() < 2) {
+        return nullptr;
+    }
+    return constant_tensor(layer->inputs()->Get(1));
+}
+
+std::string ModelStore::packed_weights_path(const std::string& directory, const std::string& filename,
+                                            const WeightPrecision weight_precision) const {
+    const char* precision_name{(weight_precision == WeightPrecision::FP16)   ? "fp16"
+                               : (weight_precision == WeightPrecision::INT8) ? "int8"
+                                                                             : "fp32"};
+    const size_t name_begin{filename.find_last_of("/\\")};
+    const std::string name{(name_begin == std::string::npos) ? filename : filename.substr(name_begin + 1)};
+    const bool separated{directory.back() == '/' || directory.back() == '\\'};
+    std::stringstream path;
+    path << directory << (separated ? "" : "/") << name << "." << std::hex << content_fingerprint << "."
+         << precision_name << ".packed";
+    return path.str();
+}
+
+bool ModelStore::map_dense_weights(const std::string& filename, const WeightPrecision weight_precision) {
+    // the place of the weights of each FC layer in the file, in layer order
+    const auto layers = model->operators();
+    std::vector<size_t> offsets(layers->size(), 0);
+    size_t size{aligned_size(sizeof(PackedWeightsHeader))};
+    for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
+        const auto weights = dense_layer_weights(idx);
+        if (weights != nullptr) {
+            offsets[idx] = size;
+            size += aligned_size(PackedDenseWeights::storage_size(weights->shape()[0], weights->shape()[1],
+                                                                  weight_precision));
+        }
+    }
+    PackedWeightsHeader header;
+    std::memcpy(header.magic, packed_weights_magic, sizeof(header.magic));
+    header.version = packed_weights_version;
+    header.layout = PackedDenseWeights::layout_id();
+    header.model = content_fingerprint;
+    header.precision = static_cast<uint64_t>(weight_precision);
+    header.size = size;
+    header.contents = 0;
+
+    std::unique_ptr<const MappedFile> file{new MappedFile(filename.c_str())};
+    if (!is_packed_weights_file(*file, header)) {
+        // missing or stale: packed now in a new file, the current one (mapped by others maybe) is replaced, not changed
+        file.reset();
+        std::stringstream unique;
+        unique << filename << ".tmp" << std::hex
+               << Fingerprint{content_fingerprint}
+                          .add(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)))
+                          .add(static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()))
+                          .value();
+        const std::string temporary{unique.str()};
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            std::vector<char> padding(packed_weights_alignment, 0);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(padding.data(), aligned_size(sizeof(header)) - sizeof(header));
+            for (flatbuffers::uoffset_t idx = 0; idx < layers->size() && out; idx++) {
+                const auto weights = dense_layer_weights(idx);
+                if (weights == nullptr) {
+                    continue;
+                }
+                // one layer at a time, the whole packed model is never in memory
+                const size_t layer_size{PackedDenseWeights::storage_size(weights->shape()[0], weights->shape()[1],
+                                                                         weight_precision)};
+                std::vector<float> packed(aligned_size(layer_size) / sizeof(float), 0.0f);
+                PackedDenseWeights::pack_to(weights, weight_precision, packed.data());
+                out.write(reinterpret_cast<const char*>(packed.data()), packed.size() * sizeof(float));
+            }
+            out.close();
+            if (!out) {
+                std::remove(temporary.c_str());
+                return false;  // e.g. a read-only folder
+            }
+        }
+        {  // the contents fingerprint, now that they are written
+            const MappedFile written(temporary.c_str());
+            header.contents = packed_contents(written);
+        }
+        {
+            std::fstream out(temporary, std::ios::binary | std::ios::in | std::ios::out);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.close();
+            if (!out) {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+            // where renaming does not replace an existing file (Windows)
+            std::remove(filename.c_str());
+            if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        file.reset(new MappedFile(filename.c_str()));
+        if (!is_packed_weights_file(*file, header)) {
+            return false;  // replaced meanwhile by a different file
+        }
+    }
+
+    for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
+        const auto weights = dense_layer_weights(idx);
+        if (weights != nullptr) {
+            dense_weights[idx].view(weights->shape()[0], weights->shape()[1], weight_precision,
+                                    file->data() + offsets[idx]);
+        }
+    }
+    packed_file = std::move(file);
+    packed_filename = filename;
+    return true;
+}
+
+void ModelStore::prepare_constants(const WeightPrecision weight_precision, const std::string& packed_weights_file) {
+    const auto tensors = model->tensors();
+    const auto buffers = model->buffers();
+    constants.resize(tensors->size());
+    try {
+        for (flatbuffers::uoffset_t idx = 0; idx < tensors->size(); idx++) {
+            const auto flatbuffer_tensor = tensors->Get(idx);
+            const uint32_t buffer_ID = flatbuffer_tensor->buffer();
+            constexpr uint32_t NOT_EXISTING{0};
+            if (buffer_ID == NOT_EXISTING) {
+                continue;  // an activation, allocated by each InferenceModel
+            }
+            std::vector<unsigned int> shape;
+            for (auto it = flatbuffer_tensor->shape()->begin(); it != flatbuffer_tensor->shape()->end(); ++it) {
+                shape.push_back(*it);
+            }
+            const auto array = buffers->Get(buffer_ID)->data();
+
+            if (flatbuffer_tensor->type() == VPUNN_SCHEMA::TensorType_FLOAT16) {
+                // converted once to float, the kernels work on float tensors
+                std::unique_ptr<Tensor<float>> tensor{new Tensor<float>(shape)};
+                const unsigned int expected_size_in_bytes{
+                        static_cast<unsigned int>(tensor->size() * sizeof(uint16_t))};
+                if (array->size() != expected_size_in_bytes) {
+                    std::stringstream buffer;
+                    buffer << "[ERROR]ModelStore::prepare_constants(), FLOAT16 buffer " << buffer_ID
+                           << " has a different size: " << array->size()
+                           << ", this is inconsistent with the tensor shape. Expected size is: "
+                           << expected_size_in_bytes << " File: " << __FILE__ << " Line: " << __LINE__;
+                    throw std::runtime_error(buffer.str());
+                }
+                for (int i = 0; i < tensor->size(); ++i) {
+                    uint16_t half;
+                    std::memcpy(&half, array->data() + i * sizeof(uint16_t), sizeof(half));
+                    tensor->data()[i] = half_to_float(half);
+                }
+                constants[idx] = std::move(tensor);
+            } else if (reinterpret_cast<uintptr_t>(array->data()) % alignof(float) == 0) {
+                // the buffer is used where it is, read only: the store is immutable and lives as long as the model data
+                auto tensor = Tensor<float>::const_view(shape, reinterpret_cast<const float*>(array->data()));
+                const unsigned int expected_size_in_bytes{static_cast<unsigned int>(tensor->size() * sizeof(float))};
+                if (array->size() != expected_size_in_bytes) {
+                    std::stringstream buffer;
+                    buffer << "[ERROR]ModelStore::prepare_constants(), Buffer " << buffer_ID
+                           << " has a different size: " << array->size()
+                           << ", this is inconsistent with the tensor shape. Expected size is: "
+                           << expected_size_in_bytes << " File: " << __FILE__ << " Line: " << __LINE__;
+                    throw std::runtime_error(buffer.str());
+                }
+                constants[idx] = std::move(tensor);
+            } else {  // copy the existing data(the buffer) into tensor's memory
+                std::unique_ptr<Tensor<float>> tensor{new Tensor<float>(shape)};
+                tensor->assign((const float*)(array->data()),
+                               array->size());  // will throw if buffer mismatch with tensor shape
+                constants[idx] = std::move(tensor);
+            }
+        }
+
+        const auto layers = model->operators();
+        dense_weights.resize(layers->size());
+        // the requested one, as far as the BLAS supports it: the same for all the FC layers, whichever path packs them
+        precision = PackedDenseWeights::supported_precision(weight_precision);
+        if (!PackedDenseWeights::repacked_layout()) {
+            // the GEMM takes the weights as they are in the model: no packing, no copy
+            for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
+                const auto weights = dense_layer_weights(idx);
+                if (weights != nullptr) {
+                    dense_weights[idx].view(weights->shape()[0], weights->shape()[1], weight_precision,
+                                            weights->c_ptr());
+                }
+            }
+            return;
+        }
+        if (!packed_weights_file.empty() && map_dense_weights(packed_weights_file, weight_precision)) {
+            return;
+        }
+        for (flatbuffers::uoffset_t idx = 0; idx < layers->size(); idx++) {
+            const auto weights = dense_layer_weights(idx);
+            if (weights != nullptr) {
+                dense_weights[idx].pack(weights, weight_precision);
+            }
+        }
+    } catch (const std::exception& e) {
+        error = e.what();  // reported when the model tensors are allocated
+    }
+}
+
+std::shared_ptr<const ModelStore> ModelStore::from_file(const char* filename, const bool memory_map,
+                                                        const WeightPrecision weight_precision,
+                                                        const std::string& packed_weights_directory) {
+    std::shared_ptr<ModelStore> store{new ModelStore()};
+    store->packed_directory = packed_weights_directory;
+    if (memory_map) {
+        std::unique_ptr<const MappedFile> mapping{new MappedFile(filename)};
+        if (mapping->is_mapped()) {
+            if (!store->set_model(mapping->data(), mapping->size())) {
+                return nullptr;
+            }
+            store->mapped_file = std::move(mapping);
+            store->prepare_constants(weight_precision,
+                                     packed_weights_directory.empty()
+                                             ? ""
+                                             : store->packed_weights_path(packed_weights_directory, filename,
+                                                                          weight_precision));
+            return store;
+        }
+        // could not map, fall back to reading the file
+    }
+
+    std::ifstream myFile;
+    myFile.open(filename, std::ios::binary | std::ios::in);
+    if (myFile.fail()) {
+        // File does not exist code here
+        return nullptr;
+    }
+    myFile.seekg(0, std::ios::end);
+    const auto length = myFile.tellg();
+    myFile.seekg(0, std::ios::beg);
+
+    store->buf.resize(static_cast<size_t>(length));
+
+    myFile.read(store->buf.data(), length);
+    myFile.close();
+
+    if (!store->set_model(store->buf.data(), store->buf.size())) {
+        return nullptr;
+    }
+    store->prepare_constants(weight_precision, "");
+    return store;
+}
+
+std::shared_ptr<const ModelStore> ModelStore::from_buffer(const char* data, size_t length, bool with_copy,
+                                                          const WeightPrecision weight_precision) {
+    std::shared_ptr<ModelStore> store{new ModelStore()};
+    if (with_copy) {
+        store->buf.assign(data, data + length);
+        data = store->buf.data();
+    }
+    if (!store->set_model(data, length)) {
+        return nullptr;
+    }
+    store->prepare_constants(weight_precision, "");
+    return store;
+}
+
+namespace {
+/// @brief the modification and status change times of a file, nanoseconds where the OS provides them
+void file_times(const struct stat& file_status, long long& modified, long long& changed) {
+    constexpr long long ns_per_s{1000000000LL};
+#if defined(__APPLE__)
+    modified = file_status.st_mtimespec.tv_sec * ns_per_s + file_status.st_mtimespec.tv_nsec;
+    changed = file_status.st_ctimespec.tv_sec * ns_per_s + file_status.st_ctimespec.tv_nsec;
+#elif defined(__unix__)
+    modified = file_status.st_mtim.tv_sec * ns_per_s + file_status.st_mtim.tv_nsec;
+    changed = file_status.st_ctim.tv_sec * ns_per_s + file_status.st_ctim.tv_nsec;
+#else
+    modified = static_cast<long long>(file_status.st_mtime) * ns_per_s;
+    changed = static_cast<long long>(file_status.st_ctime) * ns_per_s;
+#endif
+}
+}  // namespace
+
+ModelRegistry& ModelRegistry::instance() {
+    static ModelRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<const ModelStore> ModelRegistry::get(const std::string& filename, const bool memory_map,
+                                                     const WeightPrecision weight_precision,
+                                                     const std::string& packed_weights_directory) {
+    struct stat file_status;
+    if (stat(filename.c_str(), &file_status) != 0) {
+        return nullptr;  // File does not exist
+    }
+    long long modified{0}, changed{0};
+    file_times(file_status, modified, changed);
+    const Key key{filename,
+                  static_cast<long long>(file_status.st_size),
+                  modified,
+                  changed,
+                  static_cast<unsigned long long>(file_status.st_ino),
+                  static_cast<unsigned long long>(file_status.st_dev),
+                  memory_map,
+                  static_cast<int>(weight_precision),
+                  packed_weights_directory};
+
+    std::unique_lock<std::mutex> lock(models_mutex);
+    auto found = models.find(key);
+    if (found != models.end()) {
+        if (auto store = found->second.store.lock()) {
+            return store;
+        }
+        if (found->second.loading.valid()) {
+            // another thread is loading this file: wait for its result, the registry stays available
+            const auto loading = found->second.loading;
+            lock.unlock();
+            return loading.get();
+        }
+    }
+
+    // drop the models nobody uses anymore, then load this one without holding the lock
+    for (auto it = models.begin(); it != models.end();) {
+        it = (it->second.store.expired() && !it->second.loading.valid()) ? models.erase(it) : std::next(it);
+    }
+    std::promise<std::shared_ptr<const ModelStore>> loaded;
+    const unsigned long long load{++next_load};
+    Entry& entry = models[key];
+    entry.loading = loaded.get_future().share();
+    entry.load = load;
+    lock.unlock();
+
+    // publishes the result, unless the entry was forgotten (and maybe loaded again) meanwhile
+    const auto finish = [this, &key, load](const std::shared_ptr<const ModelStore>& result) {
+        std::lock_guard<std::mutex> relock(models_mutex);
+        auto loading = models.find(key);
+        if (loading == models.end() || loading->second.load != load) {
+            return;
+        }
+        if (result == nullptr) {
+            models.erase(loading);
+            return;
+        }
+        loading->second.store = result;
+        loading->second.loading = {};
+    };
+    std::shared_ptr<const ModelStore> store;
+    try {
+        store = ModelStore::from_file(filename.c_str(), memory_map, weight_precision, packed_weights_directory);
+    } catch (...) {
+        loaded.set_exception(std::current_exception());
+        finish(nullptr);
+        throw;
+    }
+    loaded.set_value(store);
+    finish(store);
+    return store;
+}
+
+void ModelRegistry::forget(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(models_mutex);
+    for (auto it = models.begin(); it != models.end();) {
+        it = (std::get<0>(it->first) == filename) ? models.erase(it) : std::next(it);
+    }
+}
+
+size_t ModelRegistry::size() const {
+    std::lock_guard<std::mutex> lock(models_mutex);
+    size_t in_use{0};
+    for (const auto& model : models) {
+        in_use += model.second.store.expired() ? 0 : 1;
+    }
+    return in_use;
+}
+
+}  // namespace VPUNN
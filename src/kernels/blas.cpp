@@ -9,14 +9,15 @@
 
 #include <math.h>
 #include "kernels/vpunn_blas.h"
+#include "core/half.h"
 
 #include <stdint.h>
 #include <algorithm>  // for std::min
+#include <atomic>
+#include <cmath>      // for std::exp
 #include <cstring>    // for memset
-
-inline bool is_aligned(const float* p) {
-    return !(reinterpret_cast<uintptr_t>(p) % 16);
-}
+#include <type_traits>
+#include <vector>
 
 #if defined(__SSE__) && defined(__SSE3__)
 #define USE_SIMD
@@ -26,23 +27,304 @@ inline bool is_aligned(const float* p) {
 #include <immintrin.h>
 #endif
 
-inline float dot(const float* A, const float* B, const int N, const int offset_a, const int offset_b) {
-// if USE_SIMD is defined I need also to check that the vectors are aligned
-#ifdef USE_SIMD
-    if (!(is_aligned(A + offset_a) && is_aligned(B + offset_b))) {
+// AVX2/AVX-512 kernels are compiled for their own target only (no global -mavx flags), and are selected at runtime
+// based on what the CPU reports. Only x86 builds with vector instructions enabled have them.
+#if defined(USE_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define USE_ISA_DISPATCH
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define VPUNN_TARGET_AVX2
+#define VPUNN_TARGET_AVX512
+#else
+#include <cpuid.h>
+#define VPUNN_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define VPUNN_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#endif
 #endif
-        float result = 0.0;
-        for (int k = 0; k < N; k++) {
-            // Compute the dot product between A and B
-            result += A[k + offset_a] * B[k + offset_b];
+
+namespace {
+
+using dot_kernel = float (*)(const float* A, const float* B, const int N);
+using sgemm_ntt_kernel = void (*)(const int M, const int N, const int K, const float* A, const int lda, const float* B,
+                                  const int ldb, float* C, const int ldc);
+/// @brief packed GEMM with weights stored as WT (float, FP16 bits or INT8), scales are null for float and FP16
+template <typename WT>
+using sgemm_packed_kernel = void (*)(const int M, const int N, const int K, const float* A, const int lda,
+                                     const WT* packed, const float* scales, const float* bias,
+                                     const VPUNN_BLAS_ACTIVATION activation, float* C, const int ldc);
+/// @brief packed GEMV of a row of A given by its nonzero elements
+using sgemv_sparse_kernel = void (*)(const int N, const int K, const int nnz, const int* indexes, const float* values,
+                                     const float* packed, const float* bias, const VPUNN_BLAS_ACTIVATION activation,
+                                     float* C);
+/// @brief adds values[i] * panel row indexes[i] to the panel_width accumulators of one panel, in order of i
+using sparse_panel_kernel = void (*)(const int nnz, const int* indexes, const float* values, const float* panel,
+                                     float* acc);
+
+/// @brief the set of kernels for one instruction set
+struct BlasKernels {
+    VPUNN_BLAS_ISA isa;
+    dot_kernel dot;
+    sgemm_ntt_kernel sgemm_rm_ntt_10;  ///< CblasRowMajor, CblasNoTrans, CblasTrans, alpha==1 and beta==0
+    sgemm_packed_kernel<float> sgemm_packed;  ///< same operation, B prepacked with vpunn_sgemm_pack, fused epilogue
+    sgemm_packed_kernel<uint16_t> sgemm_packed_f16;  ///< B prepacked with vpunn_sgemm_pack_f16
+    sgemm_packed_kernel<int8_t> sgemm_packed_s8;     ///< B prepacked with vpunn_sgemm_pack_s8, per channel scales
+    sgemv_sparse_kernel sgemv_sparse;                ///< one sparse row of A, B prepacked with vpunn_sgemm_pack
+};
+
+/// @brief a packed weight as float, whatever its storage type
+inline float weight_value(const float w) {
+    return w;
+}
+inline float weight_value(const uint16_t w) {
+    return VPUNN::half_to_float(w);
+}
+inline float weight_value(const int8_t w) {
+    return static_cast<float>(w);
+}
+
+float dot_scalar(const float* A, const float* B, const int N) {
+    float result = 0.0;
+    for (int k = 0; k < N; k++) {
+        // Compute the dot product between A and B
+        result += A[k] * B[k];
+    }
+    return result;
+}
+
+// The version that needs optimization is the one with CblasRowMajor, CblasNoTrans, CblasTrans, alpha==1 and beta==0
+template <dot_kernel DOT>
+void sgemm_rm_ntt_10_dot(const int M, const int N, const int K, const float* A, const int lda, const float* B,
+                         const int ldb, float* C, const int ldc) {
+    for (int i = 0; i < N; ++i) {
+        const auto b_idx = i * ldb;
+        for (int j = 0; j < M; ++j) {
+            const auto a_idx = j * lda;
+            C[i + j * ldc] = DOT(A + a_idx, B + b_idx, K);
+        }
+    }
+}
+
+// Packed GEMM: B (N x K) is stored as panels of panel_width rows, each panel interleaved by K ([K][panel_width]) and
+// zero padded. A micro-kernel computes MR rows of A against NP panels keeping the whole output tile in registers, one
+// accumulator per output, summed in K order. The result of one output does not depend on the batch size or blocking.
+// The bias and the ReLU are applied on the registers before the tile is stored, the sigmoid right after the store.
+// Same operations, in the same order, as separate Dense, Bias and activation passes, so the results are identical.
+// Reduced precision weights (FP16, INT8) are converted to float, the accumulation stays in float: in registers when
+// loaded by the AVX micro-kernels, once per group of panels before the rows of A go through it for the scalar and SSE
+// ones. INT8 weights are quantized per output channel, the channel scale is applied on the accumulator, before the bias.
+constexpr int panel_width{16};
+
+/// @brief the per column values (bias, scales) of an output tile, copied zero padded if the tile is partial so full
+/// vectors can be loaded
+inline const float* tile_values(const float* values, const int cols, const int tile_width, float* padded) {
+    if (values == nullptr || cols == tile_width) {
+        return values;
+    }
+    std::memset(padded, 0, tile_width * sizeof(float));
+    std::memcpy(padded, values, cols * sizeof(float));
+    return padded;
+}
+
+/// @brief sigmoid of a row of the stored output tile, same formula as the Sigmoid layer
+inline void sigmoid_row(float* C, const int cols) {
+    for (int j = 0; j < cols; ++j) {
+        C[j] = 1 / (1 + std::exp(-C[j]));
+    }
+}
+
+/// @brief how many panels a micro-kernel of MR rows handles at once. The register budget of the full size micro-kernel
+/// is reused when there are fewer rows (like batch 1), up to 4 panels
+constexpr int panels_for_rows(const int max_rows, const int panels, const int MR) {
+    return (panels * max_rows / MR >= 4) ? 4 : ((panels * max_rows / MR >= 2) ? 2 : 1);
+}
+
+/// @brief a per thread buffer of at least count floats, reused by the following calls
+inline float* conversion_buffer(const size_t count) {
+    thread_local std::vector<float> buffer;
+    if (buffer.size() < count) {
+        buffer.resize(count);
+    }
+    return buffer.data();
+}
+
+/// @brief the weights of count contiguous packed elements as the micro-kernel reads them. Float ones, and the reduced
+/// precision ones of the micro-kernels that convert in registers, are used in place
+template <class MICRO, typename WT>
+typename std::enable_if<std::is_same<WT, float>::value || MICRO::converts_weights, const WT*>::type micro_weights(
+        const WT* packed, const int) {
+    return packed;
+}
+
+/// @brief the other micro-kernels get them converted to float once, before going through the rows of A, instead of
+/// once per MR rows inside the K loop
+template <class MICRO, typename WT>
+typename std::enable_if<!(std::is_same<WT, float>::value || MICRO::converts_weights), const float*>::type
+micro_weights(const WT* packed, const int count) {
+    float* values{conversion_buffer(count)};
+    MICRO::to_float(packed, count, values);
+    return values;
+}
+
+/// @brief all the columns for a group of rows of A (a multiple of MR). Each group of panels stays in cache while the
+/// rows of A go through it
+template <class MICRO, int MR, typename WT>
+void sgemm_packed_rows(const int rows, const int N, const int K, const float* A, const int lda, const WT* packed,
+                       const float* scales, const float* bias, const VPUNN_BLAS_ACTIVATION activation, float* C,
+                       const int ldc) {
+    constexpr int NP{panels_for_rows(MICRO::max_rows, MICRO::panels, MR)};
+    const int panel_stride{K * panel_width};
+    int n0 = 0;
+    for (; n0 + NP * panel_width <= N; n0 += NP * panel_width) {
+        const auto panels = micro_weights<MICRO>(packed + (n0 / panel_width) * panel_stride, NP * panel_stride);
+        const float* scales_n0 = (scales != nullptr) ? scales + n0 : nullptr;
+        const float* bias_n0 = (bias != nullptr) ? bias + n0 : nullptr;
+        for (int m = 0; m < rows; m += MR) {
+            MICRO::template run<MR, NP>(K, A + m * lda, lda, panels, panel_stride, scales_n0, bias_n0, activation,
+                                        C + m * ldc + n0, ldc, NP * panel_width);
+        }
+    }
+    // the remaining panels one by one, the last one might be partial
+    for (; n0 < N; n0 += panel_width) {
+        const auto panel = micro_weights<MICRO>(packed + (n0 / panel_width) * panel_stride, panel_stride);
+        const float* scales_n0 = (scales != nullptr) ? scales + n0 : nullptr;
+        const float* bias_n0 = (bias != nullptr) ? bias + n0 : nullptr;
+        for (int m = 0; m < rows; m += MR) {
+            MICRO::template run<MR, 1>(K, A + m * lda, lda, panel, panel_stride, scales_n0, bias_n0, activation,
+                                       C + m * ldc + n0, ldc, std::min(panel_width, N - n0));
+        }
+    }
+}
+
+/// @brief C = act(A * B^T + bias) with B packed, rows of A are taken in blocks that fit in L2 together with a group
+/// of panels
+template <class MICRO, typename WT>
+void sgemm_packed_blocked(const int M, const int N, const int K, const float* A, const int lda, const WT* packed,
+                          const float* scales, const float* bias, const VPUNN_BLAS_ACTIVATION activation, float* C,
+                          const int ldc) {
+    constexpr int max_rows{MICRO::max_rows};
+    const int row_block{std::max(max_rows, (32768 / std::max(K, 1)) / max_rows * max_rows)};
+    for (int m0 = 0; m0 < M; m0 += row_block) {
+        const int rows{std::min(row_block, M - m0)};
+        const int full_rows{rows / max_rows * max_rows};
+        if (full_rows > 0) {
+            sgemm_packed_rows<MICRO, max_rows>(full_rows, N, K, A + m0 * lda, lda, packed, scales, bias, activation,
+                                               C + m0 * ldc, ldc);
+        }
+        const float* a = A + (m0 + full_rows) * lda;
+        float* c = C + (m0 + full_rows) * ldc;
+        switch (rows - full_rows) {
+        case 3:
+            sgemm_packed_rows<MICRO, 3>(3, N, K, a, lda, packed, scales, bias, activation, c, ldc);
+            break;
+        case 2:
+            sgemm_packed_rows<MICRO, 2>(2, N, K, a, lda, packed, scales, bias, activation, c, ldc);
+            break;
+        case 1:
+            sgemm_packed_rows<MICRO, 1>(1, N, K, a, lda, packed, scales, bias, activation, c, ldc);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Sparse packed GEMV: the row of A is given by its nonzero elements, only the panel rows (weights of the input
+// channels) of those are read. The accumulators of each panel get the same products, in the same K order and with the
+// same instructions as the micro-kernel of the instruction set, the skipped terms are the products by zero that leave
+// them unchanged: results are identical to the dense kernel on the dense row.
+/// @brief C = act(a * B^T + bias) for a single row a of nnz nonzero elements, B packed as float
+template <sparse_panel_kernel ACCUMULATE>
+void sgemv_sparse_packed(const int N, const int K, const int nnz, const int* indexes, const float* values,
+                         const float* packed, const float* bias, const VPUNN_BLAS_ACTIVATION activation, float* C) {
+    const int panel_stride{K * panel_width};
+    for (int n0 = 0; n0 < N; n0 += panel_width) {
+        alignas(64) float acc[panel_width];
+        ACCUMULATE(nnz, indexes, values, packed + (n0 / panel_width) * panel_stride, acc);
+        const int cols{std::min(panel_width, N - n0)};
+        // the epilogue of the scalar micro-kernel, same results as the vector ones
+        for (int j = 0; j < cols; ++j) {
+            float value = acc[j];
+            if (bias != nullptr) {
+                value += bias[n0 + j];
+            }
+            if (activation == VpunnBlasReLU && value < 0) {
+                value = 0;
+            }
+            C[n0 + j] = value;
+        }
+        if (activation == VpunnBlasSigmoid) {
+            sigmoid_row(C + n0, cols);
+        }
+    }
+}
+
+/// @brief micro-kernel: MR rows of A against NP panels, writes the first cols columns of the output tile. scales and
+/// bias point to the values of the first column of the tile, or are null
+struct MicroScalar {
+    static constexpr int max_rows{4};
+    static constexpr int panels{1};
+    static constexpr bool converts_weights{false};  // FP16 and INT8 panels are given to run() as float
+
+    /// @brief count packed weights as floats
+    template <typename WT>
+    static void to_float(const WT* weights, const int count, float* values) {
+        for (int i = 0; i < count; ++i) {
+            values[i] = weight_value(weights[i]);
         }
-        return result;
-#ifdef USE_SIMD
     }
 
-    const __m128* _A = reinterpret_cast<const __m128*>(A + offset_a);
-    const __m128* _B = reinterpret_cast<const __m128*>(B + offset_b);
+    template <int MR, int NP>
+    static void run(const int K, const float* A, const int lda, const float* B, const int panel_stride,
+                    const float* scales, const float* bias, const VPUNN_BLAS_ACTIVATION activation, float* C,
+                    const int ldc, const int cols) {
+        float acc[MR][NP * panel_width] = {};
+        for (int k = 0; k < K; ++k) {
+            for (int r = 0; r < MR; ++r) {
+                const float a = A[r * lda + k];
+                for (int p = 0; p < NP; ++p) {
+                    const float* b = B + p * panel_stride + k * panel_width;
+                    for (int j = 0; j < panel_width; ++j) {
+                        acc[r][p * panel_width + j] += a * b[j];
+                    }
+                }
+            }
+        }
+        for (int r = 0; r < MR; ++r) {
+            for (int j = 0; j < cols; ++j) {
+                float value = acc[r][j];
+                if (scales != nullptr) {
+                    value *= scales[j];
+                }
+                if (bias != nullptr) {
+                    value += bias[j];
+                }
+                if (activation == VpunnBlasReLU && value < 0) {
+                    value = 0;
+                }
+                C[r * ldc + j] = value;
+            }
+            if (activation == VpunnBlasSigmoid) {
+                sigmoid_row(C + r * ldc, cols);
+            }
+        }
+    }
+};
 
+void sparse_panel_scalar(const int nnz, const int* indexes, const float* values, const float* panel, float* acc) {
+    for (int j = 0; j < panel_width; ++j) {
+        acc[j] = 0;
+    }
+    for (int i = 0; i < nnz; ++i) {
+        const float a = values[i];
+        const float* b = panel + indexes[i] * panel_width;
+        for (int j = 0; j < panel_width; ++j) {
+            acc[j] += a * b[j];
+        }
+    }
+}
+
+#ifdef USE_SIMD
+float dot_sse(const float* A, const float* B, const int N) {
     __m128 res_v = _mm_setzero_ps();
     float res = 0;
     constexpr unsigned int step = 8;
@@ -54,11 +336,17 @@ inline float dot(const float* A, const float* B, const int N, const int offset_a
         // _mm_mul_ps multiplies two 128-bit vectors of [4 x float] and returns the results of the multiplication.
         // Every iteration I take 8 inputs from A and B do elementwise multiplication and sum
         // After this step I've 4 elements that then I accumulate with the original vector
-        const auto base = step * idx;
-        auto v1 = _mm_add_ps(_mm_mul_ps(_A[base], _B[base]), _mm_mul_ps(_A[base + 1], _B[base + 1]));
-        auto v2 = _mm_add_ps(_mm_mul_ps(_A[base + 2], _B[base + 2]), _mm_mul_ps(_A[base + 3], _B[base + 3]));
-        auto v3 = _mm_add_ps(_mm_mul_ps(_A[base + 4], _B[base + 4]), _mm_mul_ps(_A[base + 5], _B[base + 5]));
-        auto v4 = _mm_add_ps(_mm_mul_ps(_A[base + 6], _B[base + 6]), _mm_mul_ps(_A[base + 7], _B[base + 7]));
+        // Unaligned loads have no penalty on aligned data, so there is no need for a scalar fallback
+        const float* a = A + idx * N_elements;
+        const float* b = B + idx * N_elements;
+        auto v1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)),
+                             _mm_mul_ps(_mm_loadu_ps(a + 4), _mm_loadu_ps(b + 4)));
+        auto v2 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + 8), _mm_loadu_ps(b + 8)),
+                             _mm_mul_ps(_mm_loadu_ps(a + 12), _mm_loadu_ps(b + 12)));
+        auto v3 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + 16), _mm_loadu_ps(b + 16)),
+                             _mm_mul_ps(_mm_loadu_ps(a + 20), _mm_loadu_ps(b + 20)));
+        auto v4 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + 24), _mm_loadu_ps(b + 24)),
+                             _mm_mul_ps(_mm_loadu_ps(a + 28), _mm_loadu_ps(b + 28)));
         v1 = _mm_add_ps(v1, v2);
         v3 = _mm_add_ps(v3, v4);
         v1 = _mm_add_ps(v1, v3);
@@ -71,18 +359,684 @@ inline float dot(const float* A, const float* B, const int N, const int offset_a
     _mm_store_ss(&res, res_v);          // store the result that now is in the 0th element
 
     // as well as the elements that are left outside the loop
-    for (int idx = 0; idx < N % N_elements; idx++) {
-        res += A[idx + offset_a + N_smid_loops * N_elements] * B[idx + offset_b + N_smid_loops * N_elements];
+    for (int idx = N_smid_loops * N_elements; idx < N; idx++) {
+        res += A[idx] * B[idx];
     }
     return res;
+}
+
+/// @brief 4 FP16 values as floats without F16C, same results as half_to_float. Normal halves are rebiased, inf and NaN
+/// rebiased once more to the all ones exponent, zeros and subnormals are their mantissa times 2^-24 (exact)
+inline __m128 half4_to_float_sse(const uint16_t* h) {
+    const __m128i bits{_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(h)), _mm_setzero_si128())};
+    const __m128i sign{_mm_slli_epi32(_mm_and_si128(bits, _mm_set1_epi32(0x8000)), 16)};
+    const __m128i magnitude{_mm_and_si128(bits, _mm_set1_epi32(0x7FFF))};
+    const __m128i exponent{_mm_and_si128(bits, _mm_set1_epi32(0x7C00))};
+    const __m128i rebias{_mm_set1_epi32(112 << 23)};
+    const __m128i is_special{_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7C00))};
+    const __m128i normal{_mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(magnitude, 13), rebias),
+                                       _mm_and_si128(is_special, rebias))};
+    const __m128 subnormal{_mm_mul_ps(_mm_cvtepi32_ps(magnitude), _mm_set1_ps(5.9604644775390625e-8f))};
+    const __m128 is_subnormal{_mm_castsi128_ps(_mm_cmpeq_epi32(exponent, _mm_setzero_si128()))};
+    const __m128 value{_mm_or_ps(_mm_and_ps(is_subnormal, subnormal),
+                                 _mm_andnot_ps(is_subnormal, _mm_castsi128_ps(normal)))};
+    return _mm_or_ps(value, _mm_castsi128_ps(sign));
+}
+
+struct MicroSSE {
+    static constexpr int max_rows{2};  // 8 accumulators out of the 16 registers
+    static constexpr int panels{1};
+    static constexpr bool converts_weights{false};  // FP16 and INT8 panels are given to run() as float
+
+    /// @brief count packed weights as floats, count is a multiple of the panel width
+    template <typename WT>
+    static void to_float(const WT* weights, const int count, float* values) {
+        MicroScalar::to_float(weights, count, values);
+    }
+    static void to_float(const uint16_t* weights, const int count, float* values) {
+        for (int i = 0; i < count; i += 4) {
+            _mm_storeu_ps(values + i, half4_to_float_sse(weights + i));
+        }
+    }
+
+    template <int MR, int NP>
+    static void run(const int K, const float* A, const int lda, const float* B, const int panel_stride,
+                    const float* scales, const float* bias, const VPUNN_BLAS_ACTIVATION activation, float* C,
+                    const int ldc, const int cols) {
+        constexpr int V{panel_width / 4};  // vectors per panel
+        __m128 acc[MR][NP * V];
+        for (int r = 0; r < MR; ++r) {
+            for (int j = 0; j < NP * V; ++j) {
+                acc[r][j] = _mm_setzero_ps();
+            }
+        }
+        for (int k = 0; k < K; ++k) {
+            __m128 a[MR];
+            for (int r = 0; r < MR; ++r) {
+                a[r] = _mm_set1_ps(A[r * lda + k]);
+            }
+            for (int p = 0; p < NP; ++p) {
+                const float* b = B + p * panel_stride + k * panel_width;
+                for (int v = 0; v < V; ++v) {
+                    const __m128 bv = _mm_loadu_ps(b + v * 4);
+                    for (int r = 0; r < MR; ++r) {
+                        acc[r][p * V + v] = _mm_add_ps(acc[r][p * V + v], _mm_mul_ps(a[r], bv));
+                    }
+                }
+            }
+        }
+        alignas(16) float padded_scales[NP * panel_width];
+        const float* ts = tile_values(scales, cols, NP * panel_width, padded_scales);
+        alignas(16) float padded_bias[NP * panel_width];
+        const float* tb = tile_values(bias, cols, NP * panel_width, padded_bias);
+        const __m128 zero = _mm_setzero_ps();
+        for (int r = 0; r < MR; ++r) {
+            for (int j = 0; j < NP * V; ++j) {
+                if (ts != nullptr) {
+                    acc[r][j] = _mm_mul_ps(acc[r][j], _mm_loadu_ps(ts + j * 4));
+                }
+                if (tb != nullptr) {
+                    acc[r][j] = _mm_add_ps(acc[r][j], _mm_loadu_ps(tb + j * 4));
+                }
+                if (activation == VpunnBlasReLU) {
+                    acc[r][j] = _mm_max_ps(zero, acc[r][j]);  // operands order keeps NaN and -0 as the scalar code
+                }
+            }
+            if (cols == NP * panel_width) {
+                for (int j = 0; j < NP * V; ++j) {
+                    _mm_storeu_ps(C + r * ldc + j * 4, acc[r][j]);
+                }
+            } else {
+                alignas(16) float tile[NP * panel_width];
+                for (int j = 0; j < NP * V; ++j) {
+                    _mm_store_ps(tile + j * 4, acc[r][j]);
+                }
+                std::memcpy(C + r * ldc, tile, cols * sizeof(float));
+            }
+            if (activation == VpunnBlasSigmoid) {
+                sigmoid_row(C + r * ldc, cols);
+            }
+        }
+    }
+};
+
+void sparse_panel_sse(const int nnz, const int* indexes, const float* values, const float* panel, float* acc) {
+    constexpr int V{panel_width / 4};
+    __m128 sum[V];
+    for (int v = 0; v < V; ++v) {
+        sum[v] = _mm_setzero_ps();
+    }
+    for (int i = 0; i < nnz; ++i) {
+        const __m128 a = _mm_set1_ps(values[i]);
+        const float* b = panel + indexes[i] * panel_width;
+        for (int v = 0; v < V; ++v) {
+            sum[v] = _mm_add_ps(sum[v], _mm_mul_ps(a, _mm_loadu_ps(b + v * 4)));
+        }
+    }
+    for (int v = 0; v < V; ++v) {
+        _mm_store_ps(acc + v * 4, sum[v]);
+    }
+}
 #endif  // #ifdef USE_SIMD
+
+#ifdef USE_ISA_DISPATCH
+/// @brief sums each of the 4 accumulators horizontally. Result is [sum(a0), sum(a1), sum(a2), sum(a3)]
+VPUNN_TARGET_AVX2 inline __m128 hsum4_avx2(__m256 a0, __m256 a1, __m256 a2, __m256 a3) {
+    const __m256 s01 = _mm256_hadd_ps(a0, a1);
+    const __m256 s23 = _mm256_hadd_ps(a2, a3);
+    const __m256 s = _mm256_hadd_ps(s01, s23);
+    return _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+}
+
+VPUNN_TARGET_AVX2 float dot_avx2(const float* A, const float* B, const int N) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int k = 0;
+    for (; k + 16 <= N; k += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(A + k), _mm256_loadu_ps(B + k), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(A + k + 8), _mm256_loadu_ps(B + k + 8), acc1);
+    }
+    for (; k + 8 <= N; k += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(A + k), _mm256_loadu_ps(B + k), acc0);
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 r = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    r = _mm_hadd_ps(r, r);
+    r = _mm_hadd_ps(r, r);
+    float res = _mm_cvtss_f32(r);
+    for (; k < N; ++k) {
+        res += A[k] * B[k];
+    }
+    return res;
+}
+
+/// @brief one row of A against 4 rows of B at a time, the A values are loaded once for the 4 outputs
+VPUNN_TARGET_AVX2 void sgemm_rm_ntt_10_avx2(const int M, const int N, const int K, const float* A, const int lda,
+                                            const float* B, const int ldb, float* C, const int ldc) {
+    for (int j = 0; j < M; ++j) {
+        const float* a = A + j * lda;
+        float* c = C + j * ldc;
+        int i = 0;
+        for (; i + 4 <= N; i += 4) {
+            const float* b0 = B + i * ldb;
+            const float* b1 = b0 + ldb;
+            const float* b2 = b1 + ldb;
+            const float* b3 = b2 + ldb;
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            __m256 acc2 = _mm256_setzero_ps();
+            __m256 acc3 = _mm256_setzero_ps();
+            int k = 0;
+            for (; k + 8 <= K; k += 8) {
+                const __m256 av = _mm256_loadu_ps(a + k);
+                acc0 = _mm256_fmadd_ps(av, _mm256_loadu_ps(b0 + k), acc0);
+                acc1 = _mm256_fmadd_ps(av, _mm256_loadu_ps(b1 + k), acc1);
+                acc2 = _mm256_fmadd_ps(av, _mm256_loadu_ps(b2 + k), acc2);
+                acc3 = _mm256_fmadd_ps(av, _mm256_loadu_ps(b3 + k), acc3);
+            }
+            float res[4];
+            _mm_storeu_ps(res, hsum4_avx2(acc0, acc1, acc2, acc3));
+            for (; k < K; ++k) {
+                res[0] += a[k] * b0[k];
+                res[1] += a[k] * b1[k];
+                res[2] += a[k] * b2[k];
+                res[3] += a[k] * b3[k];
+            }
+            c[i] = res[0];
+            c[i + 1] = res[1];
+            c[i + 2] = res[2];
+            c[i + 3] = res[3];
+        }
+        for (; i < N; ++i) {
+            c[i] = dot_avx2(a, B + i * ldb, K);
+        }
+    }
+}
+
+/// @brief reduces a 512 bit accumulator to a 256 bit one (AVX512F only, no DQ extension needed)
+/// Goes through memory: the lane extract intrinsics trip -Wuninitialized in some GCC versions
+VPUNN_TARGET_AVX512 inline __m256 fold512(__m512 a) {
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, a);
+    return _mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8));
+}
+
+VPUNN_TARGET_AVX512 float dot_avx512(const float* A, const float* B, const int N) {
+    __m512 acc = _mm512_setzero_ps();
+    int k = 0;
+    for (; k + 16 <= N; k += 16) {
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(A + k), _mm512_loadu_ps(B + k), acc);
+    }
+    const __m256 acc8 = fold512(acc);
+    __m128 r = _mm_add_ps(_mm256_castps256_ps128(acc8), _mm256_extractf128_ps(acc8, 1));
+    r = _mm_hadd_ps(r, r);
+    r = _mm_hadd_ps(r, r);
+    float res = _mm_cvtss_f32(r);
+    for (; k < N; ++k) {
+        res += A[k] * B[k];
+    }
+    return res;
+}
+
+/// @brief same blocking as the AVX2 kernel, 16 lanes per FMA
+VPUNN_TARGET_AVX512 void sgemm_rm_ntt_10_avx512(const int M, const int N, const int K, const float* A, const int lda,
+                                                const float* B, const int ldb, float* C, const int ldc) {
+    for (int j = 0; j < M; ++j) {
+        const float* a = A + j * lda;
+        float* c = C + j * ldc;
+        int i = 0;
+        for (; i + 4 <= N; i += 4) {
+            const float* b0 = B + i * ldb;
+            const float* b1 = b0 + ldb;
+            const float* b2 = b1 + ldb;
+            const float* b3 = b2 + ldb;
+            __m512 acc0 = _mm512_setzero_ps();
+            __m512 acc1 = _mm512_setzero_ps();
+            __m512 acc2 = _mm512_setzero_ps();
+            __m512 acc3 = _mm512_setzero_ps();
+            int k = 0;
+            for (; k + 16 <= K; k += 16) {
+                const __m512 av = _mm512_loadu_ps(a + k);
+                acc0 = _mm512_fmadd_ps(av, _mm512_loadu_ps(b0 + k), acc0);
+                acc1 = _mm512_fmadd_ps(av, _mm512_loadu_ps(b1 + k), acc1);
+                acc2 = _mm512_fmadd_ps(av, _mm512_loadu_ps(b2 + k), acc2);
+                acc3 = _mm512_fmadd_ps(av, _mm512_loadu_ps(b3 + k), acc3);
+            }
+            float res[4];
+            _mm_storeu_ps(res, hsum4_avx2(fold512(acc0), fold512(acc1), fold512(acc2), fold512(acc3)));
+            for (; k < K; ++k) {
+                res[0] += a[k] * b0[k];
+                res[1] += a[k] * b1[k];
+                res[2] += a[k] * b2[k];
+                res[3] += a[k] * b3[k];
+            }
+            c[i] = res[0];
+            c[i + 1] = res[1];
+            c[i + 2] = res[2];
+            c[i + 3] = res[3];
+        }
+        for (; i < N; ++i) {
+            c[i] = dot_avx512(a, B + i * ldb, K);
+        }
+    }
+}
+
+/// @brief 8 packed weights as floats, the FP16 ones converted by F16C, the INT8 ones sign extended
+VPUNN_TARGET_AVX2 inline __m256 load_weights_avx2(const float* b) {
+    return _mm256_loadu_ps(b);
+}
+VPUNN_TARGET_AVX2 inline __m256 load_weights_avx2(const uint16_t* b) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+}
+VPUNN_TARGET_AVX2 inline __m256 load_weights_avx2(const int8_t* b) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b))));
+}
+
+struct MicroAVX2 {
+    static constexpr int max_rows{4};  // 8 accumulators, the B vectors and the broadcasts fit in the 16 registers
+    static constexpr int panels{1};
+    static constexpr bool converts_weights{true};  // F16C and sign extension on the loaded vectors
+
+    template <int MR, int NP, typename WT>
+    VPUNN_TARGET_AVX2 static void run(const int K, const float* A, const int lda, const WT* B,
+                                      const int panel_stride, const float* scales, const float* bias,
+                                      const VPUNN_BLAS_ACTIVATION activation, float* C, const int ldc,
+                                      const int cols) {
+        constexpr int V{panel_width / 8};
+        __m256 acc[MR][NP * V];
+        for (int r = 0; r < MR; ++r) {
+            for (int j = 0; j < NP * V; ++j) {
+                acc[r][j] = _mm256_setzero_ps();
+            }
+        }
+        for (int k = 0; k < K; ++k) {
+            __m256 b[NP * V];
+            for (int p = 0; p < NP; ++p) {
+                for (int v = 0; v < V; ++v) {
+                    b[p * V + v] = load_weights_avx2(B + p * panel_stride + k * panel_width + v * 8);
+                }
+            }
+            for (int r = 0; r < MR; ++r) {
+                const __m256 a = _mm256_broadcast_ss(A + r * lda + k);
+                for (int j = 0; j < NP * V; ++j) {
+                    acc[r][j] = _mm256_fmadd_ps(a, b[j], acc[r][j]);
+                }
+            }
+        }
+        alignas(32) float padded_scales[NP * panel_width];
+        const float* ts = tile_values(scales, cols, NP * panel_width, padded_scales);
+        alignas(32) float padded_bias[NP * panel_width];
+        const float* tb = tile_values(bias, cols, NP * panel_width, padded_bias);
+        const __m256 zero = _mm256_setzero_ps();
+        for (int r = 0; r < MR; ++r) {
+            for (int j = 0; j < NP * V; ++j) {
+                if (ts != nullptr) {
+                    acc[r][j] = _mm256_mul_ps(acc[r][j], _mm256_loadu_ps(ts + j * 8));
+                }
+                if (tb != nullptr) {
+                    acc[r][j] = _mm256_add_ps(acc[r][j], _mm256_loadu_ps(tb + j * 8));
+                }
+                if (activation == VpunnBlasReLU) {
+                    acc[r][j] = _mm256_max_ps(zero, acc[r][j]);
+                }
+            }
+            if (cols == NP * panel_width) {
+                for (int j = 0; j < NP * V; ++j) {
+                    _mm256_storeu_ps(C + r * ldc + j * 8, acc[r][j]);
+                }
+            } else {
+                alignas(32) float tile[NP * panel_width];
+                for (int j = 0; j < NP * V; ++j) {
+                    _mm256_store_ps(tile + j * 8, acc[r][j]);
+                }
+                std::memcpy(C + r * ldc, tile, cols * sizeof(float));
+            }
+            if (activation == VpunnBlasSigmoid) {
+                sigmoid_row(C + r * ldc, cols);
+            }
+        }
+    }
+};
+
+VPUNN_TARGET_AVX2 void sparse_panel_avx2(const int nnz, const int* indexes, const float* values, const float* panel,
+                                         float* acc) {
+    constexpr int V{panel_width / 8};
+    __m256 sum[V];
+    for (int v = 0; v < V; ++v) {
+        sum[v] = _mm256_setzero_ps();
+    }
+    for (int i = 0; i < nnz; ++i) {
+        const __m256 a = _mm256_broadcast_ss(values + i);
+        const float* b = panel + indexes[i] * panel_width;
+        for (int v = 0; v < V; ++v) {
+            sum[v] = _mm256_fmadd_ps(a, _mm256_loadu_ps(b + v * 8), sum[v]);
+        }
+    }
+    for (int v = 0; v < V; ++v) {
+        _mm256_store_ps(acc + v * 8, sum[v]);
+    }
+}
+
+/// @brief mask of all the lanes. AVX-512 conversions/max use the masked forms with it: the plain ones pass an undefined
+/// vector to the builtin, which GCC 12 reports as maybe-uninitialized
+constexpr __mmask16 all_lanes_avx512{0xFFFF};
+
+/// @brief a panel row (16 packed weights) as floats
+VPUNN_TARGET_AVX512 inline __m512 load_weights_avx512(const float* b) {
+    return _mm512_loadu_ps(b);
+}
+VPUNN_TARGET_AVX512 inline __m512 load_weights_avx512(const uint16_t* b) {
+    return _mm512_maskz_cvtph_ps(all_lanes_avx512, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+}
+VPUNN_TARGET_AVX512 inline __m512 load_weights_avx512(const int8_t* b) {
+    const __m512i values{
+            _mm512_maskz_cvtepi8_epi32(all_lanes_avx512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)))};
+    return _mm512_maskz_cvtepi32_ps(all_lanes_avx512, values);
+}
+
+struct MicroAVX512 {
+    static constexpr int max_rows{4};
+    static constexpr int panels{2};  // 8 accumulators out of the 32 registers
+    static constexpr bool converts_weights{true};
+
+    template <int MR, int NP, typename WT>
+    VPUNN_TARGET_AVX512 static void run(const int K, const float* A, const int lda, const WT* B,
+                                        const int panel_stride, const float* scales, const float* bias,
+                                        const VPUNN_BLAS_ACTIVATION activation, float* C, const int ldc,
+                                        const int cols) {
+        __m512 acc[MR][NP];
+        for (int r = 0; r < MR; ++r) {
+            for (int p = 0; p < NP; ++p) {
+                acc[r][p] = _mm512_setzero_ps();
+            }
+        }
+        for (int k = 0; k < K; ++k) {
+            __m512 b[NP];
+            for (int p = 0; p < NP; ++p) {
+                b[p] = load_weights_avx512(B + p * panel_stride + k * panel_width);
+            }
+            for (int r = 0; r < MR; ++r) {
+                const __m512 a = _mm512_set1_ps(A[r * lda + k]);
+                for (int p = 0; p < NP; ++p) {
+                    acc[r][p] = _mm512_fmadd_ps(a, b[p], acc[r][p]);
+                }
+            }
+        }
+        alignas(64) float padded_scales[NP * panel_width];
+        const float* ts = tile_values(scales, cols, NP * panel_width, padded_scales);
+        alignas(64) float padded_bias[NP * panel_width];
+        const float* tb = tile_values(bias, cols, NP * panel_width, padded_bias);
+        const __m512 zero = _mm512_setzero_ps();
+        for (int r = 0; r < MR; ++r) {
+            for (int p = 0; p < NP; ++p) {
+                if (ts != nullptr) {
+                    acc[r][p] = _mm512_mul_ps(acc[r][p], _mm512_loadu_ps(ts + p * panel_width));
+                }
+                if (tb != nullptr) {
+                    acc[r][p] = _mm512_add_ps(acc[r][p], _mm512_loadu_ps(tb + p * panel_width));
+                }
+                if (activation == VpunnBlasReLU) {
+                    acc[r][p] = _mm512_maskz_max_ps(all_lanes_avx512, zero, acc[r][p]);
+                }
+            }
+            if (cols == NP * panel_width) {
+                for (int p = 0; p < NP; ++p) {
+                    _mm512_storeu_ps(C + r * ldc + p * panel_width, acc[r][p]);
+                }
+            } else {
+                alignas(64) float tile[NP * panel_width];
+                for (int p = 0; p < NP; ++p) {
+                    _mm512_store_ps(tile + p * panel_width, acc[r][p]);
+                }
+                std::memcpy(C + r * ldc, tile, cols * sizeof(float));
+            }
+            if (activation == VpunnBlasSigmoid) {
+                sigmoid_row(C + r * ldc, cols);
+            }
+        }
+    }
+};
+
+VPUNN_TARGET_AVX512 void sparse_panel_avx512(const int nnz, const int* indexes, const float* values,
+                                             const float* panel, float* acc) {
+    __m512 sum = _mm512_setzero_ps();
+    for (int i = 0; i < nnz; ++i) {
+        sum = _mm512_fmadd_ps(_mm512_set1_ps(values[i]), _mm512_loadu_ps(panel + indexes[i] * panel_width), sum);
+    }
+    _mm512_store_ps(acc, sum);
+}
+
+/// @brief asks the CPU (and the OS, for the extended register state) what is supported
+VPUNN_BLAS_ISA detect_isa() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 0);
+    const int max_leaf = regs[0];
+    __cpuid(regs, 1);
+    const bool fma = (regs[2] & (1 << 12)) != 0;
+    const bool f16c = (regs[2] & (1 << 29)) != 0;
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!(osxsave && avx && f16c) || max_leaf < 7) {
+        return VpunnBlasSSE;
+    }
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(regs, 7, 0);
+    const bool avx2 = (regs[1] & (1 << 5)) != 0;
+    const bool avx512f = (regs[1] & (1 << 16)) != 0;
+    if (avx512f && ((xcr0 & 0xE6) == 0xE6)) {
+        return VpunnBlasAVX512;
+    }
+    if (avx2 && fma && ((xcr0 & 0x6) == 0x6)) {
+        return VpunnBlasAVX2;
+    }
+    return VpunnBlasSSE;
+#else
+    __builtin_cpu_init();
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0 || (ecx & bit_F16C) == 0) {
+        return VpunnBlasSSE;  // the AVX kernels convert the FP16 weights with F16C
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        return VpunnBlasAVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return VpunnBlasAVX2;
+    }
+    return VpunnBlasSSE;
+#endif
+}
+#endif  // #ifdef USE_ISA_DISPATCH
+
+BlasKernels kernels_for(const VPUNN_BLAS_ISA isa) {
+    switch (isa) {
+#ifdef USE_ISA_DISPATCH
+    case VpunnBlasAVX512:
+        return {VpunnBlasAVX512,
+                dot_avx512,
+                sgemm_rm_ntt_10_avx512,
+                sgemm_packed_blocked<MicroAVX512, float>,
+                sgemm_packed_blocked<MicroAVX512, uint16_t>,
+                sgemm_packed_blocked<MicroAVX512, int8_t>,
+                sgemv_sparse_packed<sparse_panel_avx512>};
+    case VpunnBlasAVX2:
+        return {VpunnBlasAVX2,
+                dot_avx2,
+                sgemm_rm_ntt_10_avx2,
+                sgemm_packed_blocked<MicroAVX2, float>,
+                sgemm_packed_blocked<MicroAVX2, uint16_t>,
+                sgemm_packed_blocked<MicroAVX2, int8_t>,
+                sgemv_sparse_packed<sparse_panel_avx2>};
+#endif
+#ifdef USE_SIMD
+    case VpunnBlasSSE:
+        return {VpunnBlasSSE,
+                dot_sse,
+                sgemm_rm_ntt_10_dot<dot_sse>,
+                sgemm_packed_blocked<MicroSSE, float>,
+                sgemm_packed_blocked<MicroSSE, uint16_t>,
+                sgemm_packed_blocked<MicroSSE, int8_t>,
+                sgemv_sparse_packed<sparse_panel_sse>};
+#endif
+    default:
+        return {VpunnBlasScalar,
+                dot_scalar,
+                sgemm_rm_ntt_10_dot<dot_scalar>,
+                sgemm_packed_blocked<MicroScalar, float>,
+                sgemm_packed_blocked<MicroScalar, uint16_t>,
+                sgemm_packed_blocked<MicroScalar, int8_t>,
+                sgemv_sparse_packed<sparse_panel_scalar>};
+    }
+}
+
+/// @brief the kernels of an instruction set, one immutable table each for the whole process
+const BlasKernels* kernels_table(const VPUNN_BLAS_ISA isa) {
+    static const BlasKernels tables[]{kernels_for(VpunnBlasScalar), kernels_for(VpunnBlasSSE),
+                                      kernels_for(VpunnBlasAVX2), kernels_for(VpunnBlasAVX512)};
+    return &tables[std::min(std::max(isa, VpunnBlasScalar), VpunnBlasAVX512)];
+}
+
+/// @brief the table of the kernels in use, picked at first use based on the detected CPU capabilities.
+/// Only the pointer changes (vpunn_blas_select_isa), a call loads it once and runs with the kernels it got
+std::atomic<const BlasKernels*>& active_table() {
+    static std::atomic<const BlasKernels*> table{kernels_table(vpunn_blas_detected_isa())};
+    return table;
+}
+
+/// @brief the kernels in use
+const BlasKernels& active_kernels() {
+    return *active_table().load(std::memory_order_acquire);
+}
+
+}  // namespace
+
+VPUNN_BLAS_ISA vpunn_blas_detected_isa() {
+#if defined(USE_ISA_DISPATCH)
+    static const VPUNN_BLAS_ISA detected{detect_isa()};
+    return detected;
+#elif defined(USE_SIMD)
+    return VpunnBlasSSE;
+#else
+    return VpunnBlasScalar;
+#endif
+}
+
+VPUNN_BLAS_ISA vpunn_blas_active_isa() {
+    return active_kernels().isa;
+}
+
+VPUNN_BLAS_ISA vpunn_blas_select_isa(const VPUNN_BLAS_ISA isa) {
+    const VPUNN_BLAS_ISA supported{std::min(isa, vpunn_blas_detected_isa())};
+    const BlasKernels* kernels{kernels_table(supported)};
+    active_table().store(kernels, std::memory_order_release);
+    return kernels->isa;
+}
+
+const char* vpunn_blas_isa_name(const VPUNN_BLAS_ISA isa) {
+    switch (isa) {
+    case VpunnBlasScalar:
+        return "scalar";
+    case VpunnBlasSSE:
+        return "SSE";
+    case VpunnBlasAVX2:
+        return "AVX2";
+    case VpunnBlasAVX512:
+        return "AVX512";
+    default:
+        return "unknown";
+    }
+}
+
+int vpunn_sgemm_packed_size(const int N, const int K) {
+    return (N + panel_width - 1) / panel_width * panel_width * K;
+}
+
+namespace {
+/// @brief packs B in panels, each weight stored as convert(row, value). Padding is the stored zero
+template <typename WT, class F>
+void pack_panels(const int N, const int K, const float* B, const int ldb, WT* packed, F convert) {
+    const int panels{(N + panel_width - 1) / panel_width};
+    for (int p = 0; p < panels; ++p) {
+        for (int k = 0; k < K; ++k) {
+            WT* dst = packed + (p * K + k) * panel_width;
+            for (int j = 0; j < panel_width; ++j) {
+                const int n{p * panel_width + j};
+                dst[j] = (n < N) ? convert(n, B[n * ldb + k]) : WT{0};
+            }
+        }
+    }
+}
+}  // namespace
+
+void vpunn_sgemm_pack(const int N, const int K, const float* B, const int ldb, float* packed) {
+    pack_panels(N, K, B, ldb, packed, [](const int, const float value) {
+        return value;
+    });
+}
+
+void vpunn_sgemm_pack_f16(const int N, const int K, const float* B, const int ldb, uint16_t* packed) {
+    pack_panels(N, K, B, ldb, packed, [](const int, const float value) {
+        return VPUNN::float_to_half(value);
+    });
+}
+
+void vpunn_sgemm_pack_s8(const int N, const int K, const float* B, const int ldb, int8_t* packed, float* scales) {
+    // symmetric, per output channel: the largest magnitude of the channel maps to 127
+    for (int n = 0; n < N; ++n) {
+        float max_abs{0.0F};
+        for (int k = 0; k < K; ++k) {
+            max_abs = std::max(max_abs, std::fabs(B[n * ldb + k]));
+        }
+        scales[n] = (max_abs > 0.0F) ? max_abs / 127.0F : 1.0F;
+    }
+    pack_panels(N, K, B, ldb, packed, [scales](const int n, const float value) {
+        const float q{std::nearbyint(value / scales[n])};
+        return static_cast<int8_t>(std::min(127.0F, std::max(-127.0F, q)));
+    });
+}
+
+void vpunn_sgemm_packed(const int M, const int N, const int K, const float* A, const int lda, const float* packed,
+                        float* C, const int ldc) {
+    active_kernels().sgemm_packed(M, N, K, A, lda, packed, nullptr, nullptr, VpunnBlasNoActivation, C, ldc);
+}
+
+void vpunn_sgemm_packed_bias_act(const int M, const int N, const int K, const float* A, const int lda,
+                                 const float* packed, const float* bias, const VPUNN_BLAS_ACTIVATION activation,
+                                 float* C, const int ldc) {
+    active_kernels().sgemm_packed(M, N, K, A, lda, packed, nullptr, bias, activation, C, ldc);
+}
+
+void vpunn_sgemv_sparse_packed_bias_act(const int N, const int K, const int nnz, const int* indexes,
+                                       const float* values, const float* packed, const float* bias,
+                                       const VPUNN_BLAS_ACTIVATION activation, float* C) {
+    active_kernels().sgemv_sparse(N, K, nnz, indexes, values, packed, bias, activation, C);
+}
+
+void vpunn_sgemm_packed_f16_bias_act(const int M, const int N, const int K, const float* A, const int lda,
+                                     const uint16_t* packed, const float* bias, const VPUNN_BLAS_ACTIVATION activation,
+                                     float* C, const int ldc) {
+    active_kernels().sgemm_packed_f16(M, N, K, A, lda, packed, nullptr, bias, activation, C, ldc);
+}
+
+void vpunn_sgemm_packed_s8_bias_act(const int M, const int N, const int K, const float* A, const int lda,
+                                    const int8_t* packed, const float* scales, const float* bias,
+                                    const VPUNN_BLAS_ACTIVATION activation, float* C, const int ldc) {
+    active_kernels().sgemm_packed_s8(M, N, K, A, lda, packed, scales, bias, activation, C, ldc);
+}
+
+uint16_t vpunn_float_to_half(const float value) {
+    return VPUNN::float_to_half(value);
+}
+
+float vpunn_half_to_float(const uint16_t value) {
+    return VPUNN::half_to_float(value);
 }
 
 // Computes the L2 norm (Euclidean length) of a vector
 float cblas_snrm2(const int N, const float* X, const int incX) {
     float norm = 0;
     if (incX == 1) {
-        norm = dot(X, X, N, 0, 0);
+        norm = active_kernels().dot(X, X, N);
     } else {
         for (auto idx = 0; idx < N; idx++) {
             norm += powf(X[idx * incX], 2);
@@ -98,25 +1052,13 @@ void cblas_sscal(const int N, const float alpha, float* X, const int incX) {
     }
 }
 
-// The version that needs optimization is the one with CblasRowMajor, CblasNoTrans, CblasTrans, alpha==1 and beta==0
-void inline cblas_sgemm_rm_ntt_10(const int M, const int N, const int K, const float* A, const int lda, const float* B,
-                                  const int ldb, float* C, const int ldc) {
-    for (int i = 0; i < N; ++i) {
-        const auto b_idx = i * ldb;
-        for (int j = 0; j < M; ++j) {
-            const auto a_idx = j * lda;
-            C[i + j * ldc] = dot(A, B, K, a_idx, b_idx);
-        }
-    }
-}
-
 // todo: check if compiler can optimize better if helped.
 void cblas_sgemm(const CBLAS_LAYOUT layout, const CBLAS_TRANSPOSE TransA, const CBLAS_TRANSPOSE TransB, const int M,
                  const int N, const int K, const float alpha, const float* A, const int lda, const float* B,
                  const int ldb, const float beta, float* C, const int ldc) {
     if (layout == CblasRowMajor && TransA == CblasNoTrans && TransB == CblasTrans && alpha == 1 && beta == 0) {
-        // Highly optimized GEMM for our specific use case
-        cblas_sgemm_rm_ntt_10(M, N, K, A, lda, B, ldb, C, ldc);
+        // Highly optimized GEMM for our specific use case, best instruction set available
+        active_kernels().sgemm_rm_ntt_10(M, N, K, A, lda, B, ldb, C, ldc);
         return;
     }
     // naive implementation
@@ -146,4 +1088,4 @@ void cblas_sgemm(const CBLAS_LAYOUT layout, const CBLAS_TRANSPOSE TransA, const
         }
     }
     return;
-}
\ No newline at end of file
+}
@@ -8,6 +8,12 @@
 // Software Package for additional details.
 
 #include "kernels/fully_connected.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include "core/parallel.h"
 #include "kernels/vpunn_blas.h"
 
 void VPUNN::Dense(const VPUNN::Tensor<float>* weights, const VPUNN::Tensor<float>* activations,
@@ -22,3 +28,291 @@ void VPUNN::Dense(const VPUNN::Tensor<float>* weights, const VPUNN::Tensor<float
                 activations->c_ptr(), input_channels, weights->c_ptr(), input_channels, 0.0F, output->data(),
                 output_channels);
 }
+
+void VPUNN::PackedDenseWeights::pack(const VPUNN::Tensor<float>* weights, const WeightPrecision weight_precision) {
+    precision = supported_precision(weight_precision);
+    output_channels = weights->shape()[0];
+    input_channels = weights->shape()[1];
+    viewed_weights = nullptr;
+    viewed_scales = nullptr;
+    packed.clear();
+    packed_f16.clear();
+    packed_s8.clear();
+    scales.clear();
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    packed.assign(weights->c_ptr(), weights->c_ptr() + weights->size());
+#else
+    const int size{vpunn_sgemm_packed_size(output_channels, input_channels)};
+    switch (precision) {
+    case WeightPrecision::FP16:
+        packed_f16.resize(size);
+        vpunn_sgemm_pack_f16(output_channels, input_channels, weights->c_ptr(), input_channels, packed_f16.data());
+        break;
+    case WeightPrecision::INT8:
+        packed_s8.resize(size);
+        scales.resize(output_channels);
+        vpunn_sgemm_pack_s8(output_channels, input_channels, weights->c_ptr(), input_channels, packed_s8.data(),
+                            scales.data());
+        break;
+    default:
+        packed.resize(size);
+        vpunn_sgemm_pack(output_channels, input_channels, weights->c_ptr(), input_channels, packed.data());
+        break;
+    }
+#endif
+}
+
+VPUNN::WeightPrecision VPUNN::PackedDenseWeights::supported_precision(const WeightPrecision weight_precision) {
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    (void)weight_precision;
+    return WeightPrecision::FP32;  // no reduced precision kernels in the external BLAS
+#else
+    return weight_precision;
+#endif
+}
+
+size_t VPUNN::PackedDenseWeights::storage_size(const int output_channels, const int input_channels,
+                                               const WeightPrecision weight_precision) {
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    (void)weight_precision;
+    return static_cast<size_t>(output_channels) * input_channels * sizeof(float);
+#else
+    const size_t size{static_cast<size_t>(vpunn_sgemm_packed_size(output_channels, input_channels))};
+    switch (weight_precision) {
+    case WeightPrecision::FP16:
+        return (size * sizeof(uint16_t) + sizeof(float) - 1) / sizeof(float) * sizeof(float);
+    case WeightPrecision::INT8:
+        return output_channels * sizeof(float) + (size + sizeof(float) - 1) / sizeof(float) * sizeof(float);
+    default:
+        return size * sizeof(float);
+    }
+#endif
+}
+
+void VPUNN::PackedDenseWeights::pack_to(const VPUNN::Tensor<float>* weights, const WeightPrecision weight_precision,
+                                        void* storage) {
+    const int output_channels = weights->shape()[0];
+    const int input_channels = weights->shape()[1];
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    (void)weight_precision;
+    std::memcpy(storage, weights->c_ptr(), storage_size(output_channels, input_channels, WeightPrecision::FP32));
+#else
+    switch (weight_precision) {
+    case WeightPrecision::FP16:
+        vpunn_sgemm_pack_f16(output_channels, input_channels, weights->c_ptr(), input_channels,
+                             static_cast<uint16_t*>(storage));
+        break;
+    case WeightPrecision::INT8: {
+        float* channel_scales = static_cast<float*>(storage);
+        vpunn_sgemm_pack_s8(output_channels, input_channels, weights->c_ptr(), input_channels,
+                            reinterpret_cast<int8_t*>(channel_scales + output_channels), channel_scales);
+        break;
+    }
+    default:
+        vpunn_sgemm_pack(output_channels, input_channels, weights->c_ptr(), input_channels,
+                         static_cast<float*>(storage));
+        break;
+    }
+#endif
+}
+
+void VPUNN::PackedDenseWeights::view(const int out_channels, const int in_channels,
+                                     const WeightPrecision weight_precision, const void* storage) {
+    precision = supported_precision(weight_precision);
+    output_channels = out_channels;
+    input_channels = in_channels;
+    packed.clear();
+    packed_f16.clear();
+    packed_s8.clear();
+    scales.clear();
+    if (precision == WeightPrecision::INT8) {
+        viewed_scales = static_cast<const float*>(storage);
+        viewed_weights = viewed_scales + output_channels;
+    } else {
+        viewed_scales = nullptr;
+        viewed_weights = storage;
+    }
+}
+
+uint32_t VPUNN::PackedDenseWeights::layout_id() {
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    return 0;  // row major, as in the model
+#else
+    return static_cast<uint32_t>(vpunn_sgemm_packed_size(1, 1));  // the panel width
+#endif
+}
+
+bool VPUNN::PackedDenseWeights::repacked_layout() {
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    return false;
+#else
+    return true;
+#endif
+}
+
+#if !(defined(USE_OPENBLAS) || defined(USE_MKL))
+namespace {
+/// @brief the rows of the batch handled together by the GEMM micro-kernels, thread chunks are multiples of it
+constexpr size_t gemm_row_alignment{4};
+
+/// @brief the BLAS epilogue activation of a FC activation
+VPUNN_BLAS_ACTIVATION blas_activation(const VPUNN::DenseActivation activation) {
+    return (activation == VPUNN::DenseActivation::RELU)      ? VpunnBlasReLU
+           : (activation == VPUNN::DenseActivation::SIGMOID) ? VpunnBlasSigmoid
+                                                             : VpunnBlasNoActivation;
+}
+
+/// @brief the packed GEMM with the fused epilogue, for the precision the weights are stored in, rows [begin, end)
+void packed_gemm_rows(const VPUNN::PackedDenseWeights& weights, const float* bias,
+                      const VPUNN_BLAS_ACTIVATION activation, const VPUNN::Tensor<float>* activations,
+                      VPUNN::Tensor<float>* output, const size_t row_begin, const size_t row_end) {
+    const int output_channels = weights.get_output_channels();
+    const int input_channels = weights.get_input_channels();
+    const int rows = static_cast<int>(row_end - row_begin);
+    const float* A = activations->c_ptr() + row_begin * input_channels;
+    float* C = output->data() + row_begin * output_channels;
+
+    switch (weights.get_precision()) {
+    case VPUNN::WeightPrecision::FP16:
+        vpunn_sgemm_packed_f16_bias_act(rows, output_channels, input_channels, A, input_channels, weights.c_ptr_f16(),
+                                        bias, activation, C, output_channels);
+        break;
+    case VPUNN::WeightPrecision::INT8:
+        vpunn_sgemm_packed_s8_bias_act(rows, output_channels, input_channels, A, input_channels, weights.c_ptr_s8(),
+                                       weights.c_ptr_scales(), bias, activation, C, output_channels);
+        break;
+    default:
+        vpunn_sgemm_packed_bias_act(rows, output_channels, input_channels, A, input_channels, weights.c_ptr(), bias,
+                                    activation, C, output_channels);
+        break;
+    }
+}
+
+/// @brief the packed GEMM over the whole batch, the rows are split between threads when there is enough work.
+/// Every output row is computed by the same code whatever the split, results do not depend on the threads
+void packed_gemm(const VPUNN::PackedDenseWeights& weights, const float* bias, const VPUNN_BLAS_ACTIVATION activation,
+                 const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output) {
+    const size_t batch_size = activations->shape()[0];
+    const size_t row_work{std::max<size_t>(
+            1, static_cast<size_t>(weights.get_output_channels()) * weights.get_input_channels())};
+    const size_t min_rows{std::max<size_t>(1, VPUNN::parallel_min_chunk_work / row_work)};
+    VPUNN::parallel_for(
+            0, batch_size, min_rows,
+            [&](const size_t row_begin, const size_t row_end) {
+                packed_gemm_rows(weights, bias, activation, activations, output, row_begin, row_end);
+            },
+            gemm_row_alignment);
+}
+}  // namespace
+#endif
+
+void VPUNN::Dense(const VPUNN::PackedDenseWeights& weights, const VPUNN::Tensor<float>* activations,
+                  VPUNN::Tensor<float>* output) {
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    const int output_channels = weights.get_output_channels();
+    const int input_channels = weights.get_input_channels();
+    const int batch_size = activations->shape()[0];
+
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, batch_size, output_channels, input_channels, 1.0F,
+                activations->c_ptr(), input_channels, weights.c_ptr(), input_channels, 0.0F, output->data(),
+                output_channels);
+#else
+    packed_gemm(weights, nullptr, VpunnBlasNoActivation, activations, output);
+#endif
+}
+
+void VPUNN::FusedDense(const VPUNN::PackedDenseWeights& weights, const VPUNN::Tensor<float>* bias,
+                       const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output,
+                       const VPUNN::DenseActivation activation) {
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    FusedDense(weights.c_ptr(), weights.get_output_channels(), weights.get_input_channels(),
+               (bias != nullptr) ? bias->c_ptr() : nullptr, activations->c_ptr(),
+               static_cast<int>(activations->shape()[0]), output->data(), activation);
+#else
+    packed_gemm(weights, (bias != nullptr) ? bias->c_ptr() : nullptr, blas_activation(activation), activations,
+                output);
+#endif
+}
+
+void VPUNN::FusedDense(const float* packed_weights, const int output_channels, const int input_channels,
+                       const float* bias, const float* activations, const int batch_size, float* output,
+                       const VPUNN::DenseActivation activation) {
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, batch_size, output_channels, input_channels, 1.0F,
+                activations, input_channels, packed_weights, input_channels, 0.0F, output, output_channels);
+
+    // the external BLAS has no epilogue, bias and activation are done after the GEMM, row by row
+    float* out = output;
+    for (int row = 0; row < batch_size; ++row, out += output_channels) {
+        for (int idx = 0; idx < output_channels; ++idx) {
+            if (bias != nullptr) {
+                out[idx] += bias[idx];
+            }
+            if (activation == DenseActivation::RELU && out[idx] < 0) {
+                out[idx] = 0;
+            } else if (activation == DenseActivation::SIGMOID) {
+                out[idx] = 1 / (1 + std::exp(-out[idx]));
+            }
+        }
+    }
+#else
+    const VPUNN_BLAS_ACTIVATION act{blas_activation(activation)};
+    const size_t row_work{std::max<size_t>(1, static_cast<size_t>(output_channels) * input_channels)};
+    const size_t min_rows{std::max<size_t>(1, VPUNN::parallel_min_chunk_work / row_work)};
+    VPUNN::parallel_for(
+            0, static_cast<size_t>(batch_size), min_rows,
+            [&](const size_t row_begin, const size_t row_end) {
+                vpunn_sgemm_packed_bias_act(static_cast<int>(row_end - row_begin), output_channels, input_channels,
+                                            activations + row_begin * input_channels, input_channels,
+                                            packed_weights, bias, act, output + row_begin * output_channels,
+                                            output_channels);
+            },
+            gemm_row_alignment);
+#endif
+}
+
+void VPUNN::FusedDense(const VPUNN::PackedDenseWeights& weights, const VPUNN::Tensor<float>* bias, const int* indexes,
+                       const float* values, const int nnz, VPUNN::Tensor<float>* output,
+                       const VPUNN::DenseActivation activation) {
+    const int output_channels = weights.get_output_channels();
+    const int input_channels = weights.get_input_channels();
+    if (!weights.sparse_input()) {
+        std::stringstream buffer;
+        buffer << "[ERROR]FusedDense(), a sparse input needs FP32 weights, these are stored in reduced precision"
+               << " File: " << __FILE__ << " Line: " << __LINE__;
+        throw std::runtime_error(buffer.str());
+    }
+    for (int i = 0; i < nnz; ++i) {
+        if (indexes[i] < 0 || indexes[i] >= input_channels) {
+            std::stringstream buffer;
+            buffer << "[ERROR]FusedDense(), sparse input index " << indexes[i] << " is not one of the "
+                   << input_channels << " input channels"
+                   << " File: " << __FILE__ << " Line: " << __LINE__;
+            throw std::runtime_error(buffer.str());
+        }
+    }
+    const float* bias_data = (bias != nullptr) ? bias->c_ptr() : nullptr;
+    float* out = output->data();
+#if defined(USE_OPENBLAS) || defined(USE_MKL)
+    // the weights are [output, input] row major: gather the column of each nonzero input
+    const float* w = weights.c_ptr();
+    for (int idx = 0; idx < output_channels; ++idx) {
+        float value = 0;
+        for (int i = 0; i < nnz; ++i) {
+            value += values[i] * w[idx * input_channels + indexes[i]];
+        }
+        if (bias_data != nullptr) {
+            value += bias_data[idx];
+        }
+        if (activation == DenseActivation::RELU && value < 0) {
+            value = 0;
+        } else if (activation == DenseActivation::SIGMOID) {
+            value = 1 / (1 + std::exp(-value));
+        }
+        out[idx] = value;
+    }
+#else
+    vpunn_sgemv_sparse_packed_bias_act(output_channels, input_channels, nnz, indexes, values, weights.c_ptr(),
+                                       bias_data, blas_activation(activation), out);
+#endif
+}
@@ -8,71 +8,101 @@
 // Software Package for additional details.
 
 #include "kernels/kNN.h"
-#include <queue>
+#include <algorithm>
+#include <utility>
 #include <vector>
+#include "core/parallel.h"
 #include "kernels/vpunn_blas.h"
 
-// Find the smallest N items in an array
-void n_index(int n_index, float* data, unsigned int* index, unsigned int size) {
-    std::priority_queue<std::pair<float, unsigned int>, std::vector<std::pair<float, unsigned int>>,
-                        std::greater<std::pair<float, unsigned int>>>
-            q;
-    for (unsigned int i = 0; i < size; ++i) {
-        q.push(std::pair<float, unsigned int>(data[i], i));
+namespace {
+
+using Neighbour = std::pair<float, unsigned int>;  ///< distance, item index. Ordered by distance, then by index
+
+/// @brief the n closest items of one row of distances, sorted by (distance, index), in heap[0 .. n)
+/// A max heap of size n is kept, an item enters it only if closer than the farthest kept one: O(items * log n)
+void closest_items(const unsigned int n, const float* distances, const unsigned int items, Neighbour* heap) {
+    Neighbour* const heap_end{heap + n};
+    for (unsigned int i = 0; i < n; ++i) {
+        heap[i] = Neighbour{distances[i], i};
     }
-    for (int i = 0; i < n_index; ++i) {
-        int ki = q.top().second;
-        index[i] = ki;
-        q.pop();
+    std::make_heap(heap, heap_end);
+    for (unsigned int i = n; i < items; ++i) {
+        const Neighbour candidate{distances[i], i};
+        if (candidate < heap[0]) {
+            std::pop_heap(heap, heap_end);
+            heap_end[-1] = candidate;
+            std::push_heap(heap, heap_end);
+        }
     }
+    std::sort_heap(heap, heap_end);
 }
 
-void neighbours_idx(VPUNN::Tensor<float>* weights, VPUNN::Tensor<float>* activations, int n_neighbours,
-                    VPUNN::Tensor<unsigned int>& indexes, VPUNN::Tensor<float>& distances) {
+/// @brief kNN for the rows [row_begin, row_end) of the batch, in the slices of these rows of the workspace
+void kNN_rows(const VPUNN::Tensor<float>* weights, const VPUNN::Tensor<float>* targets,
+              const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output, const unsigned int n_neighbours,
+              const size_t row_begin, const size_t row_end, VPUNN::KNNWorkspace& workspace) {
     // activations is of the shape [Batch, embedding]
     // weights is of the shape [items, embedding]
-    unsigned int embedding_shape = weights->shape()[1];
-    unsigned int batch_size = activations->shape()[0];
-    unsigned int items = weights->shape()[0];
+    // targets is of the shape [items, outputs], output of the shape [Batch, outputs]
+    const int embedding = static_cast<int>(weights->shape()[1]);
+    const int items = static_cast<int>(weights->shape()[0]);
+    const int outputs = static_cast<int>(targets->size()) / std::max(items, 1);
+    const int rows = static_cast<int>(row_end - row_begin);
+
+    // distance = 1 - A * W.T, A is [rows, embedding] and W is [items, embedding], both row major
+    float* const distances{workspace.distances.data() + row_begin * items};
+    const size_t distances_size{static_cast<size_t>(rows) * items};
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, rows, items, embedding, 1.0F,
+                activations->c_ptr() + row_begin * embedding, embedding, weights->c_ptr(), embedding, 0.0F, distances,
+                items);
+    for (size_t idx = 0; idx < distances_size; ++idx) {
+        distances[idx] = 1.0F - distances[idx];
+    }
 
-    // compute the matmul between activations and weights: 1 - A * W.T
-    // A is of shape [batch, embeddings] => shape: m, k
-    // W.t is of shape [embeddings, items] => shape: k, n
-    // output is of shape [batch, items] => shape: m, n
-    // m = batch, k = embeddings, n = items
-    cblas_sgemm(CblasColMajor, CblasNoTrans, CblasTrans, batch_size, items, embedding_shape, -1.0, activations->c_ptr(),
-                batch_size, weights->c_ptr(), items, 1.0, distances.data(), batch_size);
+    for (int row = 0; row < rows; ++row) {
+        const float* row_distances = distances + static_cast<size_t>(row) * items;
+        Neighbour* const neighbours{workspace.neighbours.data() + (row_begin + row) * n_neighbours};
+        closest_items(n_neighbours, row_distances, items, neighbours);
 
-    // This piece of code is hideous, I think it can be parallelized at least for batch exploration
-    for (unsigned int b_idx = 0; b_idx < batch_size; b_idx++) {
-        n_index(n_neighbours, &(distances[b_idx * items]), indexes.data() + b_idx * n_neighbours, items);
+        // Compute the weighted average of the targets of the neighbours, closest first
+        float* out = output->data() + (row_begin + row) * outputs;
+        for (int o = 0; o < outputs; ++o) {
+            float sum = 0, prediction = 0;
+            for (unsigned int k = 0; k < n_neighbours; ++k) {
+                const Neighbour& neighbour{neighbours[k]};
+                const float weight = 1.0f / (neighbour.first + 1e-12f);
+                prediction += targets->c_ptr()[neighbour.second * outputs + o] * weight;
+                sum += weight;
+            }
+            out[o] = prediction / sum;
+        }
     }
 }
 
-void VPUNN::kNN(VPUNN::Tensor<float>* weights, VPUNN::Tensor<float>* targets, VPUNN::Tensor<float>* activations,
-                VPUNN::Tensor<float>* output, unsigned int n_neighbours) {
-    if (n_neighbours < 1) {
+}  // namespace
+
+void VPUNN::kNN(const VPUNN::Tensor<float>* weights, const VPUNN::Tensor<float>* targets,
+                const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output, unsigned int n_neighbours) {
+    KNNWorkspace workspace;
+    kNN(weights, targets, activations, output, n_neighbours, workspace);
+}
+
+void VPUNN::kNN(const VPUNN::Tensor<float>* weights, const VPUNN::Tensor<float>* targets,
+                const VPUNN::Tensor<float>* activations, VPUNN::Tensor<float>* output, unsigned int n_neighbours,
+                KNNWorkspace& workspace) {
+    const unsigned int items = weights->shape()[0];
+    if (n_neighbours < 1 || items < 1) {
         // precondition not met!
         return;
     }
+    n_neighbours = std::min(n_neighbours, items);
 
-    const unsigned int batch_size = activations->shape()[0];
-    const unsigned int items = weights->shape()[0];
-
-    // Tensor containing all the index of
-    auto indexes = VPUNN::Tensor<unsigned int>({batch_size, n_neighbours});
-    // Initialize the distance vector to be all 1's
-    auto distances = VPUNN::Tensor<float>({batch_size, items}, 1.0);
-    neighbours_idx(weights, activations, n_neighbours, indexes, distances);
-
-    // Compute the weighted average of the distances
-    for (unsigned int b_idx = 0; b_idx < batch_size; b_idx++) {
-        float sum = 0, prediction = 0;
-        for (unsigned int idx = 0; idx < n_neighbours; idx++) {
-            const float weight = 1.0f / (distances[indexes[idx]] + 1e-12f);
-            prediction += targets->c_ptr()[indexes[idx]] * weight;
-            sum += weight;
-        }
-        output->data()[b_idx * n_neighbours] = prediction / sum;
-    }
+    // the batch rows are independent, they are split between threads when there is enough work for it
+    const size_t batch_size = activations->shape()[0];
+    workspace.reserve(batch_size, items, n_neighbours);
+    const size_t row_work{std::max<size_t>(1, static_cast<size_t>(items) * weights->shape()[1])};
+    const size_t min_rows{std::max<size_t>(1, VPUNN::parallel_min_chunk_work / row_work)};
+    VPUNN::parallel_for(0, batch_size, min_rows, [&](const size_t row_begin, const size_t row_end) {
+        kNN_rows(weights, targets, activations, output, n_neighbours, row_begin, row_end, workspace);
+    });
 }
@@ -5901,7 +5901,7 @@ void bind_VPUNN_25(std::function< pybind11::module &(std::string const &namespac
 		cl.def( pybind11::init( [](VPUNN::RuntimeProcessingFactory const &o){ return new VPUNN::RuntimeProcessingFactory(o); } ) );
 		cl.def( pybind11::init( [](){ return new VPUNN::RuntimeProcessingFactory(); } ) );
 		cl.def("exists_preprocessing", (bool (VPUNN::RuntimeProcessingFactory::*)(int) const) &VPUNN::RuntimeProcessingFactory::exists_preprocessing, "True if a preprocessor exists for required/interrogated version\n\nC++: VPUNN::RuntimeProcessingFactory::exists_preprocessing(int) const --> bool", pybind11::arg("input_version"));
-		cl.def("make_preprocessing", (class VPUNN::Preprocessing<float> & (VPUNN::RuntimeProcessingFactory::*)(int) const) &VPUNN::RuntimeProcessingFactory::make_preprocessing, "provides a preprocessor for the required interface\n The provided preprocessor is owned by this class.\n For NOW multiple requests for the same version will provide the same object, the factory just shares the\n preprocessors , does not create a new one for each request\n \n\n desired interface version\n \n\n the preprocessor object to be used (shared)\n \n\n out_of_range in case the version is not supported\n\nC++: VPUNN::RuntimeProcessingFactory::make_preprocessing(int) const --> class VPUNN::Preprocessing<float> &", pybind11::return_value_policy::automatic, pybind11::arg("version"));
+		cl.def("make_preprocessing", [](VPUNN::RuntimeProcessingFactory const &o, int const & a0) -> std::shared_ptr<VPUNN::Preprocessing<float>> { return o.make_preprocessing(a0); }, "creates a preprocessor for the required interface\n Each request gets a new, independent, preprocessor with its own buffers, owned by the caller. Different\n preprocessors can be used from different threads at the same time, with no locking.\n \n\n desired interface version\n \n\n the preprocessor object to be used\n \n\n out_of_range in case the version is not supported\n\nC++: VPUNN::RuntimeProcessingFactory::make_preprocessing(int) const --> class std::unique_ptr<class VPUNN::Preprocessing<float> >", pybind11::arg("version"));
 	}
 	{ // VPUNN::FirstDegreeEquation file: line:32
 		pybind11::class_<VPUNN::FirstDegreeEquation, std::shared_ptr<VPUNN::FirstDegreeEquation>> cl(M("VPUNN"), "FirstDegreeEquation", "Defines the structure of the first degree equation of the line for each shave operation.\n The ecuation is slope_ * size + intercept_\n \n\n is defined by time in us divided by size of output bytes\n \n\n is defined  by time in us");
@@ -8988,7 +8988,7 @@ void bind_VPUNN_34(std::function< pybind11::module &(std::string const &namespac
 
 	// VPUNN::kNN(class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, unsigned int) file: line:27
 	M("VPUNN").def("kNN", [](class VPUNN::Tensor<float> * a0, class VPUNN::Tensor<float> * a1, class VPUNN::Tensor<float> * a2, class VPUNN::Tensor<float> * a3) -> void { return VPUNN::kNN(a0, a1, a2, a3); }, "", pybind11::arg("weights"), pybind11::arg("targets"), pybind11::arg("activations"), pybind11::arg("output"));
-	M("VPUNN").def("kNN", (void (*)(class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, unsigned int)) &VPUNN::kNN, "Floating point k-Nearest-Neighbor (kNN) layer (float)\n\n \n a VPUNN::Tensor containing the kNN layer weights\n \n\n a VPUNN::Tensor containing the kNN layer targets\n \n\n the input tensor\n \n\n the output tensor\n \n\n number of neighbors to consider. must be >=1\n\nC++: VPUNN::kNN(class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, unsigned int) --> void", pybind11::arg("weights"), pybind11::arg("targets"), pybind11::arg("activations"), pybind11::arg("output"), pybind11::arg("n_neighbours"));
+	M("VPUNN").def("kNN", (void (*)(const class VPUNN::Tensor<float> *, const class VPUNN::Tensor<float> *, const class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, unsigned int)) &VPUNN::kNN, "Floating point k-Nearest-Neighbor (kNN) layer (float)\n\n \n a VPUNN::Tensor containing the kNN layer weights\n \n\n a VPUNN::Tensor containing the kNN layer targets\n \n\n the input tensor\n \n\n the output tensor\n \n\n number of neighbors to consider. must be >=1\n\nC++: VPUNN::kNN(class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *, unsigned int) --> void", pybind11::arg("weights"), pybind11::arg("targets"), pybind11::arg("activations"), pybind11::arg("output"), pybind11::arg("n_neighbours"));
 
 	// VPUNN::L2Normalization(class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *) file: line:23
 	M("VPUNN").def("L2Normalization", (void (*)(class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *)) &VPUNN::L2Normalization, "Floating point L2 normalization layer (float)\n\n \n the input tensor\n \n\n the output tensor\n\nC++: VPUNN::L2Normalization(class VPUNN::Tensor<float> *, class VPUNN::Tensor<float> *) --> void", pybind11::arg("activations"), pybind11::arg("output"));
@@ -9032,6 +9032,8 @@ void bind_VPUNN_35(std::function< pybind11::module &(std::string const &namespac
 		pybind11::class_<VPUNN::InferenceModel, std::shared_ptr<VPUNN::InferenceModel>> cl(M("VPUNN"), "InferenceModel", "VPUNN inference model\n After creation can be used only if the model was initialized, otherwise will crash\n\n ");
 		cl.def( pybind11::init<const char *>(), pybind11::arg("filename") );
 
+		cl.def( pybind11::init<const char *, const bool>(), pybind11::arg("filename"), pybind11::arg("memory_map") );
+
 		cl.def( pybind11::init<const char *, unsigned long, bool>(), pybind11::arg("data"), pybind11::arg("length"), pybind11::arg("with_copy") );
 
 		cl.def( pybind11::init( [](VPUNN::InferenceModel const &o){ return new VPUNN::InferenceModel(o); } ) );
@@ -9077,7 +9079,8 @@ void bind_VPUNN_35(std::function< pybind11::module &(std::string const &namespac
 		pybind11::class_<VPUNN::Runtime, std::shared_ptr<VPUNN::Runtime>> cl(M("VPUNN"), "Runtime", "VPUNN runtime model\n\n ");
 		cl.def( pybind11::init( [](const std::string & a0){ return new VPUNN::Runtime(a0); } ), "doc" , pybind11::arg("filename"));
 		cl.def( pybind11::init( [](const std::string & a0, const unsigned int & a1){ return new VPUNN::Runtime(a0, a1); } ), "doc" , pybind11::arg("filename"), pybind11::arg("batch"));
-		cl.def( pybind11::init<const std::string &, const unsigned int, bool>(), pybind11::arg("filename"), pybind11::arg("batch"), pybind11::arg("profile") );
+		cl.def( pybind11::init( [](const std::string & a0, const unsigned int & a1, bool const & a2){ return new VPUNN::Runtime(a0, a1, a2); } ), "doc" , pybind11::arg("filename"), pybind11::arg("batch"), pybind11::arg("profile"));
+		cl.def( pybind11::init<const std::string &, const unsigned int, bool, bool>(), pybind11::arg("filename"), pybind11::arg("batch"), pybind11::arg("profile"), pybind11::arg("memory_map") );
 
 		cl.def( pybind11::init( [](const char * a0, unsigned long const & a1, bool const & a2){ return new VPUNN::Runtime(a0, a1, a2); } ), "doc" , pybind11::arg("model_data"), pybind11::arg("model_data_length"), pybind11::arg("copy_model_data"));
 		cl.def( pybind11::init( [](const char * a0, unsigned long const & a1, bool const & a2, const unsigned int & a3){ return new VPUNN::Runtime(a0, a1, a2, a3); } ), "doc" , pybind11::arg("model_data"), pybind11::arg("model_data_length"), pybind11::arg("copy_model_data"), pybind11::arg("batch"));
@@ -9088,6 +9091,7 @@ void bind_VPUNN_35(std::function< pybind11::module &(std::string const &namespac
 		cl.def("predict", (const class std::vector<float> (VPUNN::Runtime::*)(const class std::vector<float> &)) &VPUNN::Runtime::predict<float>, "C++: VPUNN::Runtime::predict(const class std::vector<float> &) --> const class std::vector<float>", pybind11::arg("input_tensor"));
 		cl.def("model_version_info", (const class VPUNN::ModelVersion & (VPUNN::Runtime::*)()) &VPUNN::Runtime::model_version_info, "provides version info for loaded model\n The provided reference is always up to date with the loaded model\n The info are conditioned(otherwise default) by the successful loading of the model.\n\n \n a long lived reference to the version information\n\nC++: VPUNN::Runtime::model_version_info() --> const class VPUNN::ModelVersion &", pybind11::return_value_policy::automatic);
 		cl.def("initialized", (bool (VPUNN::Runtime::*)() const) &VPUNN::Runtime::initialized, "Check if the NN model is initialized\n\n \n true if the NN model is initialized\n \n\n false if the NN model is not initialized\n\nC++: VPUNN::Runtime::initialized() const --> bool");
+		cl.def("is_memory_mapped", (bool (VPUNN::Runtime::*)() const) &VPUNN::Runtime::is_memory_mapped, "Check if the model file is memory mapped, see the memory_map parameter of the constructor\n\n \n true if the model data is a read-only mapping of the file\n\nC++: VPUNN::Runtime::is_memory_mapped() const --> bool");
 		cl.def("input_tensors", (class std::vector<class VPUNN::Tensor<float> *> (VPUNN::Runtime::*)()) &VPUNN::Runtime::input_tensors, "Get the model input tensors\n\n \n std::vector<Tensor<float>*>\n\nC++: VPUNN::Runtime::input_tensors() --> class std::vector<class VPUNN::Tensor<float> *>");
 		cl.def("output_tensors", (class std::vector<class VPUNN::Tensor<float> *> (VPUNN::Runtime::*)()) &VPUNN::Runtime::output_tensors, "Get the model output tensors\n\n \n std::vector<Tensor<float>*>\n\nC++: VPUNN::Runtime::output_tensors() --> class std::vector<class VPUNN::Tensor<float> *>");
 		cl.def("input_shapes", (class std::vector<class std::vector<unsigned int> > (VPUNN::Runtime::*)()) &VPUNN::Runtime::input_shapes, "Get the model input tensors shapes\n\n \n std::vector<std::vector<unsigned int>>\n\nC++: VPUNN::Runtime::input_shapes() --> class std::vector<class std::vector<unsigned int> >");
@@ -9428,8 +9432,8 @@ void bind_VPUNN_37(std::function< pybind11::module &(std::string const &namespac
 		cl.def( pybind11::init<const char *, unsigned long, bool, bool, const unsigned int, const unsigned int>(), pybind11::arg("model_data"), pybind11::arg("model_data_length"), pybind11::arg("copy_model_data"), pybind11::arg("profile"), pybind11::arg("cache_size"), pybind11::arg("batch_size") );
 
 		cl.def("get_NN_Valid_interval", (struct std::pair<float, float> (VPUNN::VPUCostModel::*)() const) &VPUNN::VPUCostModel::get_NN_Valid_interval, "provides the value interval where the NN raw outputs are considered valid and will be used to further\n compute information\n\n \n a pair containing (minimum_valid_value maximum_valid_value)\n\nC++: VPUNN::VPUCostModel::get_NN_Valid_interval() const --> struct std::pair<float, float>");
-		cl.def("run_NN", (float (VPUNN::VPUCostModel::*)(const struct VPUNN::DPUWorkload &)) &VPUNN::VPUCostModel::run_NN, "Compute the NN Output of a specific DPUWorkload\n takes in consideration the cache\n no sanitation is done\n no check if network exists\n\n \n a DPUWorkload\n \n\n float the NN raw output, not filtered\n\nC++: VPUNN::VPUCostModel::run_NN(const struct VPUNN::DPUWorkload &) --> float", pybind11::arg("workload"));
-		cl.def("run_NN", (const class std::vector<float> & (VPUNN::VPUCostModel::*)(const class std::vector<struct VPUNN::DPUWorkload> &)) &VPUNN::VPUCostModel::run_NN, "Compute the NN Output of multiple DPUWorkloads\n NOT taking in consideration the cache\n no sanitation is done\n no check if network exists\n\n \n a std::vector of DPUWorkloads\n \n\n a reference to the results vector. Do not store, will be invalid after next call to this method.\n\nC++: VPUNN::VPUCostModel::run_NN(const class std::vector<struct VPUNN::DPUWorkload> &) --> const class std::vector<float> &", pybind11::return_value_policy::automatic, pybind11::arg("workloads"));
+		cl.def("run_NN", (float (VPUNN::VPUCostModel::*)(const struct VPUNN::DPUWorkload &)) &VPUNN::VPUCostModel::run_NN, "Compute the NN Output of a specific DPUWorkload\n takes in consideration the cache: first the one keyed on the workload, then the one keyed on the descriptor\n no sanitation is done\n no check if network exists\n\n \n a DPUWorkload\n \n\n float the NN raw output, not filtered\n\nC++: VPUNN::VPUCostModel::run_NN(const struct VPUNN::DPUWorkload &) --> float", pybind11::arg("workload"));
+		cl.def("run_NN", (const class std::vector<float> & (VPUNN::VPUCostModel::*)(const class std::vector<struct VPUNN::DPUWorkload> &)) &VPUNN::VPUCostModel::run_NN, "Compute the NN Output of multiple DPUWorkloads\n takes in consideration the cache, like for a single workload. Only the distinct workloads not found in the\n caches are inferred, the repeated ones (e.g. equal tiles of a split) are computed once\n no sanitation is done\n no check if network exists\n\n \n a std::vector of DPUWorkloads\n \n\n a reference to the results vector. Do not store, will be invalid after next call to this method.\n\nC++: VPUNN::VPUCostModel::run_NN(const class std::vector<struct VPUNN::DPUWorkload> &) --> const class std::vector<float> &", pybind11::return_value_policy::automatic, pybind11::arg("workloads"));
 		cl.def("nn_initialized", (bool (VPUNN::VPUCostModel::*)() const) &VPUNN::VPUCostModel::nn_initialized, "Check if the internal VPUNN is initialized\n\n \n true the VPUNN neural network is initialized\n \n\n false the VPUNN neural network is not initialized\n\nC++: VPUNN::VPUCostModel::nn_initialized() const --> bool");
 		cl.def("DPU", (unsigned int (VPUNN::VPUCostModel::*)(struct VPUNN::DPUWorkload)) &VPUNN::VPUCostModel::DPU, "Return the number of cycles needed to compute a workload\n\n Important: If no NN is available it will return Theoretical cycles for the workload. Check if NN is loaded with\n nn_initialized()\n\n A sanity check will be performed on the workload and in case it is not suitable the method will return an error\n code without running the inference on the NN. \n\n DPU_OperationSanitizer::check_and_sanitize() explanations.\n Some checks examples:\n - if the device is supported\n - if workload fits in CMX memory\n - if the operation is supported\n\n List of Error codes is available in CyclesInterfaceType doc.\n\n A sanity check will be performed also on the NN output, in case the NN  raw value is not reliable it will not be\n returned but an error code will be given, e.g. ERROR_INVALID_OUTPUT_RANGE\n\n To see the limits of valid NN values interval , use \n get_NN_Valid_interval().  Zero is a value that will NOT\n be filtered out.\n\n Behind the DPU computation is a trained Neural Network that might give unexpected results in case is asked about\n a workload that is odd/(not well formed) or was not trained in that area or workloads.\n The workload passed as parameter for inference should be a valid one, a one that makes sense, we are checking\n some sanity, but ,for now, not a strict/extensive sanity check is performed. A workload with unrealistic\n combinations of  parameters (eg DW_CONV with 7 input/output channels ) will not be detected.\n\n In case the wl configuration is unrealistic the network will give undefined(aberrant) results (it was not trained\n on invalid data). The NN raw output is filtered for  generic valid interval (no negatives, no huge , e.g. 4bilion\n cycles) but the user can also be aware of this behavior and use its own narrower ranges\n\n e.g.  Depending on the wl a cycle values of 10 might be unrealistic, also a value of 100milion cycles (@1Ghz is\n ~100ms),  The user should be aware that not all aberrant/unrealistic NN outputs are handled inside.\n\n \n a DPUWorkload to be evaluated.\n \n\n unsigned int DPUWorkload execution cycles or an error code.\n\n \n out_of_range : cache problems, cannot pre-process data , generate the NN descriptor due to data unknown\n \n\n runtime_error: cannot generate the NN descriptor, e.g expected sizes do not match\n\n     \n\nC++: VPUNN::VPUCostModel::DPU(struct VPUNN::DPUWorkload) --> unsigned int", pybind11::arg("wl"));
 		cl.def("DPUMsg", (class std::tuple<unsigned int, std::string > (VPUNN::VPUCostModel::*)(struct VPUNN::DPUWorkload)) &VPUNN::VPUCostModel::DPUMsg, "same like  \n DPU(DPUWorkload wl) , the extra param is to have as output the textual errors/findings\n discovered when handling the workload\n \n\n the workload to infer on\n \n\n will collect error info regarding wl checking.\n\nC++: VPUNN::VPUCostModel::DPUMsg(struct VPUNN::DPUWorkload) --> class std::tuple<unsigned int, std::string >", pybind11::arg("wl"));
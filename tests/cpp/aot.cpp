@@ -0,0 +1,85 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+
+// the small model is always compiled ahead of time for the tests, the shipped ones only with VPUNN_BUILD_AOT_MODELS
+#ifdef VPUNN_AOT_FAST_TEST
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "VPU27FastAotModel.h"
+#include "common_helpers.h"
+#include "vpunn.h"
+
+#ifdef VPUNN_AOT_TEST
+#include "VPU20AotModel.h"
+#include "VPU27AotModel.h"
+#endif
+
+namespace VPUNN_unit_tests {
+
+class TestAotModel : public ::testing::Test {
+protected:
+    /// same outputs as the interpreted model, for several batches
+    void check_against_runtime(VPUNN::AotModel& aot, const std::string& filename) const {
+        VPUNN::Runtime runtime{filename, aot.max_batch()};
+        ASSERT_TRUE(runtime.initialized());
+        EXPECT_EQ(aot.network_name(), runtime.model_version_info().get_raw_name());
+        ASSERT_EQ(aot.input_shapes(), runtime.input_shapes());
+        ASSERT_EQ(aot.output_shapes(), runtime.output_shapes());
+
+        const unsigned int row_size{aot.input_shapes()[0][1]};
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> values(0.0f, 1.0f);
+        for (const unsigned int rows : {1U, 3U, aot.max_batch()}) {
+            std::vector<float> input(rows * row_size);
+            for (auto& value : input) {
+                value = values(generator);
+            }
+            const auto expected = runtime.predict(input);
+            const auto result = aot.predict(input);
+            ASSERT_EQ(result.size(), expected.size()) << "rows: " << rows;
+            for (size_t idx = 0; idx < result.size(); idx++) {
+                EXPECT_EQ(result[idx], expected[idx]) << "rows: " << rows << " output: " << idx;
+            }
+        }
+    }
+};
+
+TEST_F(TestAotModel, SmallModelSameResultsAsRuntime) {
+    VPUNN::VPU27FastAotModel model{8};
+    check_against_runtime(model, NameHelperNN::make_fast_version(VPU_2_7_MODEL_PATH));
+}
+
+TEST_F(TestAotModel, WrongInputSize) {
+    VPUNN::VPU27FastAotModel model{4};
+    const unsigned int row_size{model.input_shapes()[0][1]};
+    EXPECT_THROW(model.predict(std::vector<float>(row_size + 1)), std::runtime_error);
+    EXPECT_THROW(model.predict(std::vector<float>(row_size * 5)), std::runtime_error);
+    EXPECT_THROW(model.predict(std::vector<float>()), std::runtime_error);
+    EXPECT_NO_THROW(model.predict(std::vector<float>(row_size * 4)));
+}
+
+#ifdef VPUNN_AOT_TEST
+TEST_F(TestAotModel, SameResultsAsRuntime) {
+    VPUNN::VPU27AotModel vpu_2_7{8};
+    check_against_runtime(vpu_2_7, VPU_2_7_MODEL_PATH);
+
+    VPUNN::VPU20AotModel vpu_2_0{8};
+    check_against_runtime(vpu_2_0, VPU_2_0_MODEL_PATH);
+}
+#endif  // VPUNN_AOT_TEST
+
+}  // namespace VPUNN_unit_tests
+
+#endif  // VPUNN_AOT_FAST_TEST
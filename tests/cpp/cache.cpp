@@ -8,11 +8,28 @@
 // Software Package for additional details.
 
 #include "core/cache.h"
+#include "core/fingerprint.h"
+#include "core/persistent_cache.h"
+#include "core/shared_cache.h"
+#include "inference/preprop_factory.h"
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <ctime>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <random>
+#include <sstream>
+#include <thread>
 #include <vector>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "vpu/sample_generator/random_task_generator.h"
 #include "vpu_cost_model.h"
 
 /// @brief namespace for Unit tests of the C++ library
@@ -80,4 +97,723 @@ TEST_F(VPUNNCacheTest, CacheBasicTest) {
         EXPECT_EQ(*cache.get(v2), val2);
     }
 }
+TEST_F(VPUNNCacheTest, LRUOrderAndUpdate) {
+    VPUNN::LRUCache<float> cache(3);
+    const std::vector<float> a{1.0f, 0.0f}, b{0.0f, 1.0f}, c{1.0f, 1.0f}, d{2.0f, 0.0f};
+    cache.add(a, 1.0f);
+    cache.add(b, 2.0f);
+    cache.add(c, 3.0f);
+    EXPECT_EQ(cache.size(), 3u);
+
+    // a becomes the most recent, b is the next to be replaced
+    ASSERT_NE(cache.get(a), nullptr);
+    cache.add(d, 4.0f);
+    EXPECT_EQ(cache.size(), 3u);
+    EXPECT_EQ(cache.get(b), nullptr);
+    EXPECT_EQ(*cache.get(a), 1.0f);
+    EXPECT_EQ(*cache.get(c), 3.0f);
+    EXPECT_EQ(*cache.get(d), 4.0f);
+
+    // updating a present workload keeps its entry and makes it the most recent
+    cache.add(a, 10.0f);
+    EXPECT_EQ(cache.size(), 3u);
+    EXPECT_EQ(*cache.get(a), 10.0f);
+    cache.add(b, 2.0f);  // replaces c
+    EXPECT_EQ(cache.get(c), nullptr);
+    EXPECT_EQ(*cache.get(d), 4.0f);
+    EXPECT_EQ(*cache.get(a), 10.0f);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.get(a), nullptr);
+    EXPECT_EQ(cache.get(d), nullptr);
+    cache.add(c, 3.0f);
+    EXPECT_EQ(*cache.get(c), 3.0f);
+
+    VPUNN::LRUCache<float> disabled(0);
+    disabled.add(a, 1.0f);
+    EXPECT_EQ(disabled.get(a), nullptr);
+    EXPECT_EQ(disabled.size(), 0u);
+}
+
+TEST_F(VPUNNCacheTest, TinyLFUScanResistance) {
+    const size_t capacity{200};
+    auto key = [](const size_t idx) {
+        return VPUNN::fingerprint(std::vector<float>{static_cast<float>(idx)});
+    };
+    // a working set looked up again and again, then a sweep of one-off keys larger than the cache
+    auto hot_hits_after_scan = [&](VPUNN::LRUCache<float>& cache) {
+        auto lookup = [&](const size_t idx) {
+            if (cache.get(key(idx)) == nullptr) {
+                cache.add(key(idx), static_cast<float>(idx));
+            }
+        };
+        for (int round = 0; round < 5; ++round) {
+            for (size_t idx = 0; idx < 50; ++idx) {
+                lookup(idx);
+            }
+        }
+        for (size_t idx = 1000; idx < 1000 + 5 * capacity; ++idx) {
+            lookup(idx);
+        }
+        size_t hits{0};
+        for (size_t idx = 0; idx < 50; ++idx) {
+            const float* const value = cache.get(key(idx));
+            if (value != nullptr) {
+                EXPECT_EQ(*value, static_cast<float>(idx));
+                ++hits;
+            }
+        }
+        EXPECT_LE(cache.size(), capacity);
+        return hits;
+    };
+
+    VPUNN::LRUCache<float> lru(capacity);
+    EXPECT_EQ(lru.replacement_policy(), VPUNN::CachePolicy::LRU);
+    EXPECT_EQ(hot_hits_after_scan(lru), 0u) << "the sweep evicts the working set";
+
+    VPUNN::LRUCache<float> tiny_lfu(capacity, VPUNN::CachePolicy::TINY_LFU);
+    EXPECT_EQ(tiny_lfu.replacement_policy(), VPUNN::CachePolicy::TINY_LFU);
+    EXPECT_GE(hot_hits_after_scan(tiny_lfu), 45u) << "the one-off keys are not admitted over the working set";
+    EXPECT_GT(tiny_lfu.statistics().evictions, 0u);
+
+    tiny_lfu.clear();
+    EXPECT_EQ(tiny_lfu.size(), 0u);
+    EXPECT_EQ(tiny_lfu.get(key(0)), nullptr);
+}
+
+TEST_F(VPUNNCacheTest, TinyLFUConsistency) {
+    // random traffic against a reference: a hit always returns the last value added for the key
+    for (const size_t capacity : {1u, 2u, 7u, 100u, 1000u}) {
+        VPUNN::LRUCache<float> cache(capacity, VPUNN::CachePolicy::TINY_LFU);
+        std::vector<float> reference(3000, -1.0f);
+        std::mt19937 generator(static_cast<unsigned int>(capacity));
+        std::geometric_distribution<size_t> popular(0.01);
+        size_t hits{0}, inserts{0};
+        for (int op = 0; op < 20000; ++op) {
+            const size_t idx{std::min<size_t>(popular(generator), reference.size() - 1)};
+            const uint64_t key{VPUNN::fingerprint(std::vector<float>{static_cast<float>(idx)})};
+            const float* const value = cache.get(key);
+            if (value != nullptr) {
+                ASSERT_EQ(*value, reference[idx]);
+                ++hits;
+            }
+            if (value == nullptr || op % 3 == 0) {
+                reference[idx] = static_cast<float>(op);
+                if (value == nullptr) {
+                    ++inserts;
+                }
+                cache.add(key, reference[idx]);
+            }
+            ASSERT_LE(cache.size(), capacity);
+        }
+        const auto statistics = cache.statistics();
+        EXPECT_EQ(statistics.hits, hits);
+        EXPECT_EQ(statistics.inserts, inserts);
+        EXPECT_EQ(statistics.evictions, inserts - cache.size());
+    }
+
+    VPUNN::SharedLRUCache<float> shared(100, 4, VPUNN::CachePolicy::TINY_LFU);
+    float value{0.0f};
+    shared.add(1, 2.0f);
+    EXPECT_TRUE(shared.get(1, value));
+    EXPECT_EQ(value, 2.0f);
+}
+
+TEST_F(VPUNNCacheTest, MaxBytes) {
+    for (const auto policy : {VPUNN::CachePolicy::LRU, VPUNN::CachePolicy::TINY_LFU}) {
+        for (const size_t budget : {size_t{100}, size_t{4000}, size_t{65536}, size_t{1} << 20}) {
+            auto cache = VPUNN::LRUCache<float>::with_max_bytes(budget, policy);
+            const size_t capacity{cache.capacity()};
+            EXPECT_EQ(capacity, VPUNN::LRUCache<float>::capacity_for_bytes(budget, policy));
+            if (capacity > 0) {
+                EXPECT_LE(VPUNN::LRUCache<float>::memory_for(capacity, policy), budget);
+            }
+            EXPECT_GT(VPUNN::LRUCache<float>::memory_for(capacity + 1, policy), budget) << "the largest that fits";
+
+            for (size_t idx = 0; idx < 3 * capacity + 10; ++idx) {
+                cache.add(VPUNN::fingerprint(std::vector<float>{static_cast<float>(idx)}), 1.0f);
+            }
+            const auto statistics = cache.statistics();
+            EXPECT_EQ(statistics.size, capacity);
+            EXPECT_LE(statistics.bytes, budget) << "budget: " << budget;
+            if (capacity > 0) {
+                EXPECT_EQ(statistics.bytes, VPUNN::LRUCache<float>::memory_for(capacity, policy));
+            }
+        }
+        // compact keys: 1MB holds tens of thousands of values, each descriptor would need ~1KB as floats
+        EXPECT_GT(VPUNN::LRUCache<float>::capacity_for_bytes(size_t{1} << 20, policy), 20000u);
+
+        auto shared = VPUNN::SharedLRUCache<float>::with_max_bytes(size_t{1} << 20, 16, policy);
+        EXPECT_EQ(shared->shards_count(), 16u);
+        for (size_t idx = 0; idx < 100000; ++idx) {
+            shared->add(VPUNN::fingerprint(std::vector<float>{static_cast<float>(idx)}), 1.0f);
+        }
+        EXPECT_LE(shared->statistics().bytes, size_t{1} << 20);
+        EXPECT_GT(shared->size(), 20000u);
+
+        // a small budget is split over fewer shards
+        auto small = VPUNN::SharedLRUCache<float>::with_max_bytes(1000, 64, policy);
+        EXPECT_LT(small->shards_count(), 64u);
+        for (size_t idx = 0; idx < 1000; ++idx) {
+            small->add(VPUNN::fingerprint(std::vector<float>{static_cast<float>(idx)}), 1.0f);
+        }
+        EXPECT_GT(small->size(), 0u);
+        EXPECT_LE(small->statistics().bytes, 1000u);
+    }
+}
+
+TEST_F(VPUNNCacheTest, MaxBytesBelowOneEntry) {
+    // a budget too small for one entry disables the cache, it still never uses more than the budget
+    for (const auto policy : {VPUNN::CachePolicy::LRU, VPUNN::CachePolicy::TINY_LFU}) {
+        for (const size_t budget : {size_t{0}, size_t{10}, size_t{16}}) {
+            auto cache = VPUNN::LRUCache<float>::with_max_bytes(budget, policy);
+            EXPECT_EQ(cache.capacity(), 0u) << "budget: " << budget;
+            cache.add(1, 1.0f);
+            EXPECT_EQ(cache.get(1), nullptr);
+            EXPECT_EQ(cache.statistics().size, 0u);
+            EXPECT_LE(cache.statistics().bytes, budget);
+        }
+        EXPECT_EQ(VPUNN::LRUCache<float>::memory_for(0, policy), 0u) << "an empty cache";
+
+        auto shared = VPUNN::SharedLRUCache<float>::with_max_bytes(100, 64, policy);
+        float value{0.0f};
+        for (size_t idx = 0; idx < 100; ++idx) {
+            shared->add(VPUNN::fingerprint(std::vector<float>{static_cast<float>(idx)}), 1.0f);
+            shared->get(VPUNN::fingerprint(std::vector<float>{static_cast<float>(idx)}), value);
+        }
+        EXPECT_LE(shared->statistics().bytes, 100u);
+    }
+}
+
+TEST_F(VPUNNCacheTest, FingerprintKeys) {
+    const std::vector<float> descriptor{0.0f, 1.0f, 0.5f, 0.0f};
+    EXPECT_EQ(VPUNN::fingerprint(descriptor), VPUNN::fingerprint(std::vector<float>{-0.0f, 1.0f, 0.5f, 0.0f}));
+    EXPECT_NE(VPUNN::fingerprint(descriptor), VPUNN::fingerprint(std::vector<float>{1.0f, 0.0f, 0.5f, 0.0f}));
+    EXPECT_NE(VPUNN::fingerprint(descriptor), VPUNN::fingerprint(std::vector<float>{0.0f, 1.0f, 0.5f}));
+    EXPECT_NE(VPUNN::fingerprint(descriptor), VPUNN::fingerprint(descriptor, 1));
+
+    // the descriptor and its fingerprint address the same entry
+    VPUNN::LRUCache<float> cache(4);
+    cache.add(descriptor, 7.0f);
+    ASSERT_NE(cache.get(VPUNN::fingerprint(descriptor)), nullptr);
+    EXPECT_EQ(*cache.get(VPUNN::fingerprint(descriptor)), 7.0f);
+    cache.add(VPUNN::fingerprint(descriptor), 8.0f);
+    EXPECT_EQ(*cache.get(descriptor), 8.0f);
+    EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST_F(VPUNNCacheTest, ManyEntries) {
+    const size_t capacity{1000};
+    VPUNN::LRUCache<float> cache(capacity);
+    auto descriptor = [](size_t idx) {
+        return std::vector<float>{static_cast<float>(idx % 7), static_cast<float>(idx), 1.0f};
+    };
+    // fill it several times over, only the last ones added stay
+    const size_t total{5 * capacity + 123};
+    for (size_t idx = 0; idx < total; idx++) {
+        cache.add(descriptor(idx), static_cast<float>(idx));
+        ASSERT_LE(cache.size(), capacity);
+    }
+    EXPECT_EQ(cache.size(), capacity);
+    for (size_t idx = 0; idx < total; idx++) {
+        const float* value = cache.get(descriptor(idx));
+        if (idx < total - capacity) {
+            EXPECT_EQ(value, nullptr) << idx;
+        } else {
+            ASSERT_NE(value, nullptr) << idx;
+            EXPECT_EQ(*value, static_cast<float>(idx));
+        }
+    }
+}
+TEST_F(VPUNNCacheTest, WorkloadFingerprint) {
+    const VPUNN::DPUWorkload wl = {
+            VPUNN::VPUDevice::VPU_2_7,
+            VPUNN::Operation::CONVOLUTION,
+            {VPUNN::VPUTensor(56, 56, 16, 1, VPUNN::DataType::UINT8)},  // input dimensions
+            {VPUNN::VPUTensor(56, 56, 16, 1, VPUNN::DataType::UINT8)},  // output dimensions
+            {3, 3},                                                     // kernels
+            {1, 1},                                                     // strides
+            {1, 1},                                                     // padding
+            VPUNN::ExecutionMode::CUBOID_16x16                          // execution mode
+    };
+    const auto key = VPUNN::fingerprint(wl);
+
+    VPUNN::DPUWorkload same{wl};
+    same.offsets = {0, 8, 0, 0};  // another tile of the same layer
+    EXPECT_EQ(VPUNN::fingerprint(same), key);
+    // the offsets are left out of the fingerprint because no preprocessing reads them
+    const VPUNN::RuntimeProcessingFactory factory;
+    int interfaces{0};
+    for (int version = 0; version <= static_cast<int>(VPUNN::NNVersions::VERSION_11_VPU27_BETA); ++version) {
+        if (factory.exists_preprocessing(version)) {
+            auto preprocessing = factory.make_preprocessing(version);
+            const std::vector<float> descriptor{preprocessing->transform(wl)};
+            EXPECT_EQ(preprocessing->transform(same), descriptor) << "interface: " << version;
+            ++interfaces;
+        }
+    }
+    EXPECT_GE(interfaces, 4);
+
+    VPUNN::DPUWorkload other{wl};
+    other.outputs[0] = VPUNN::VPUTensor(56, 56, 32, 1, VPUNN::DataType::UINT8);
+    EXPECT_NE(VPUNN::fingerprint(other), key);
+    other = wl;
+    other.padding[VPUNN::Dim::BOTTOM] = 0;
+    EXPECT_NE(VPUNN::fingerprint(other), key);
+    other = wl;
+    other.act_sparsity = 0.5f;
+    EXPECT_NE(VPUNN::fingerprint(other), key);
+    other = wl;
+    other.output_write_tiles = 2;
+    EXPECT_NE(VPUNN::fingerprint(other), key);
+
+    // every variant gets its own value, a cached one is never reused for a different workload
+    VPUNN::VPUCostModel cached_model{std::string(VPU_2_7_MODEL_PATH), false, 4};
+    VPUNN::VPUCostModel uncached_model{std::string(VPU_2_7_MODEL_PATH), false, 0};
+    ASSERT_TRUE(cached_model.nn_initialized());
+    std::vector<VPUNN::DPUWorkload> variants;
+    for (const auto channels : {16u, 32u, 64u}) {
+        for (const auto sparsity : {0.0f, 0.3f}) {
+            VPUNN::DPUWorkload variant{wl};
+            variant.outputs[0] = VPUNN::VPUTensor(56, 56, channels, 1, VPUNN::DataType::UINT8);
+            variant.act_sparsity = sparsity;
+            variant.offsets = {0, channels, 0, 0};
+            variants.push_back(variant);
+        }
+    }
+    for (int repeat = 0; repeat < 3; repeat++) {
+        for (const auto& variant : variants) {
+            EXPECT_EQ(cached_model.DPU(variant), uncached_model.DPU(variant)) << variant;
+        }
+    }
+}
+TEST_F(VPUNNCacheTest, SharedCache) {
+    VPUNN::SharedLRUCache<float> cache(1000, 16);
+    EXPECT_EQ(cache.shards_count(), 16u);
+    float value{0.0f};
+    EXPECT_FALSE(cache.get(1, value));
+    cache.add(1, 5.0f);
+    ASSERT_TRUE(cache.get(1, value));
+    EXPECT_EQ(value, 5.0f);
+    cache.add(1, 6.0f);
+    ASSERT_TRUE(cache.get(1, value));
+    EXPECT_EQ(value, 6.0f);
+    EXPECT_EQ(cache.size(), 1u);
+    cache.clear();
+    EXPECT_FALSE(cache.get(1, value));
+
+    EXPECT_EQ(VPUNN::SharedLRUCache<float>(4, 64).shards_count(), 4u);
+    VPUNN::SharedLRUCache<float> disabled(0);
+    disabled.add(1, 5.0f);
+    EXPECT_FALSE(disabled.get(1, value));
+
+    // threads adding and reading overlapping keys, the value of a key is always its own
+    const unsigned int n_threads{8};
+    const uint64_t n_keys{4000};
+    std::vector<std::thread> threads;
+    std::vector<int> wrong(n_threads, 0);
+    for (unsigned int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (uint64_t idx = 0; idx < n_keys; ++idx) {
+                const std::vector<float> descriptor{static_cast<float>((idx * (t + 1)) % n_keys)};
+                const uint64_t key{VPUNN::fingerprint(descriptor)};
+                float found{0.0f};
+                if (cache.get(key, found)) {
+                    wrong[t] += (found != static_cast<float>(key % 1000)) ? 1 : 0;
+                } else {
+                    cache.add(key, static_cast<float>(key % 1000));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(std::count(wrong.begin(), wrong.end(), 0), static_cast<long>(n_threads));
+    EXPECT_LE(cache.size(), 1000u) << "at most the maximum size";
+    EXPECT_GT(cache.size(), 0u);
+
+    // the shards together hold exactly the maximum size
+    VPUNN::SharedLRUCache<float> uneven(1000, 16);
+    for (uint64_t key = 0; key < 100000; ++key) {
+        uneven.add(VPUNN::fingerprint(std::vector<float>{static_cast<float>(key)}), 1.0f);
+    }
+    EXPECT_EQ(uneven.size(), 1000u);
+}
+/// a file in the test temporary folder, with a name unique to this run: test runs in parallel do not share files
+std::string temporary_cache_file(const std::string& name) {
+    std::stringstream filename;
+    filename << ::testing::TempDir() << name << "_" << std::hex << std::random_device{}() << "_"
+             << std::chrono::steady_clock::now().time_since_epoch().count() << ".bin";
+    return filename.str();
+}
+
+TEST_F(VPUNNCacheTest, PersistentCacheFile) {
+    const std::string filename{temporary_cache_file("vpunn_test_persistent_cache")};
+    std::remove(filename.c_str());
+    {
+        VPUNN::PersistentCache writer(filename);
+        ASSERT_TRUE(writer.is_open());
+        EXPECT_TRUE(writer.is_writer());
+        for (uint64_t key = 1; key <= 100; ++key) {
+            writer.add(key, static_cast<float>(key) * 0.5f);
+        }
+
+        // another user of the file only reads, and sees what the writer appends later
+        VPUNN::PersistentCache reader(filename);
+        ASSERT_TRUE(reader.is_open());
+        EXPECT_FALSE(reader.is_writer());
+        EXPECT_EQ(reader.size(), 100u);
+        float value{0.0f};
+        ASSERT_TRUE(reader.get(7, value));
+        EXPECT_EQ(value, 3.5f);
+        EXPECT_FALSE(reader.get(1000, value));
+        writer.add(1000, 1.0f);
+        reader.set_refresh_interval(std::chrono::hours(1));
+        EXPECT_FALSE(reader.get(1000, value)) << "the misses do not read the file within the refresh interval";
+        EXPECT_EQ(reader.refresh(), 1u);
+        ASSERT_TRUE(reader.get(1000, value));
+        EXPECT_EQ(value, 1.0f);
+        writer.add(1001, 1.0f);
+        reader.set_refresh_interval(std::chrono::milliseconds(0));
+        EXPECT_TRUE(reader.get(1001, value)) << "every miss reads the file";
+        reader.add(2000, 2.0f);  // only in its memory
+        EXPECT_EQ(writer.size(), 102u);
+    }
+    {  // an interrupted record at the end is dropped by the next writer
+        std::ofstream file(filename, std::ios::binary | std::ios::app);
+        file.write("garbage", 7);
+    }
+    {
+        VPUNN::PersistentCache writer(filename);
+        ASSERT_TRUE(writer.is_writer());
+        EXPECT_EQ(writer.size(), 102u);
+        writer.add(3000, 3.0f);
+    }
+    {
+        VPUNN::PersistentCache reader(filename, false);
+        EXPECT_FALSE(reader.is_writer());
+        EXPECT_EQ(reader.size(), 103u);
+        float value{0.0f};
+        ASSERT_TRUE(reader.get(3000, value));
+        EXPECT_EQ(value, 3.0f);
+        EXPECT_FALSE(reader.get(2000, value));
+    }
+    std::remove(filename.c_str());
+
+    {  // not a cache file, left untouched
+        std::ofstream file(filename, std::ios::binary);
+        file << "this is not a cache file";
+    }
+    {
+        VPUNN::PersistentCache other(filename);
+        EXPECT_FALSE(other.is_open());
+        EXPECT_FALSE(other.is_writer());
+        other.add(1, 1.0f);
+    }
+    {
+        std::ifstream file(filename, std::ios::binary);
+        const std::string contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        EXPECT_EQ(contents, "this is not a cache file");
+    }
+    std::remove(filename.c_str());
+}
+
+/// a reader opened as writable becomes the writer when the writer is gone, an incomplete header is not final
+TEST_F(VPUNNCacheTest, PersistentCacheHandover) {
+    const std::string filename{temporary_cache_file("vpunn_test_persistent_handover")};
+    std::remove(filename.c_str());
+    {
+        auto writer = std::make_unique<VPUNN::PersistentCache>(filename);
+        ASSERT_TRUE(writer->is_writer());
+        writer->add(1, 1.0f);
+        VPUNN::PersistentCache reader(filename);
+        VPUNN::PersistentCache read_only(filename, false);
+        ASSERT_TRUE(reader.is_open());
+        EXPECT_FALSE(reader.is_writer());
+        EXPECT_EQ(reader.refresh(), 0u) << "the writer still holds the lock";
+        EXPECT_FALSE(reader.is_writer());
+
+        writer->add(2, 2.0f);
+        writer.reset();
+        EXPECT_EQ(reader.refresh(), 1u) << "the records of the previous writer are read first";
+        EXPECT_TRUE(reader.is_writer());
+        reader.add(3, 3.0f);
+        EXPECT_EQ(read_only.refresh(), 2u);
+        EXPECT_FALSE(read_only.is_writer());
+        float value{0.0f};
+        ASSERT_TRUE(read_only.get(3, value));
+        EXPECT_EQ(value, 3.0f);
+    }
+    std::remove(filename.c_str());
+
+    {  // a writer stopped while writing the header
+        std::ofstream file(filename, std::ios::binary);
+        file.write("VPUNN", 5);
+    }
+    {
+        VPUNN::PersistentCache reader(filename, false);
+        EXPECT_FALSE(reader.is_open()) << "no header yet";
+        VPUNN::PersistentCache writer(filename);
+        ASSERT_TRUE(writer.is_writer()) << "the next writer writes the header again";
+        writer.add(1, 1.0f);
+        EXPECT_EQ(reader.refresh(), 1u);
+        EXPECT_TRUE(reader.is_open());
+    }
+    std::remove(filename.c_str());
+}
+
+/// the file and the memory keep at most max_records, the writer compacts the file to the newest half
+TEST_F(VPUNNCacheTest, PersistentCacheCompaction) {
+    const std::string filename{temporary_cache_file("vpunn_test_persistent_compaction")};
+    std::remove(filename.c_str());
+    const size_t max_records{8};
+    auto file_size = [&filename]() {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        return static_cast<size_t>(file.tellg());
+    };
+    size_t full_size{0};
+    {
+        VPUNN::PersistentCache writer(filename, true, max_records);
+        VPUNN::PersistentCache reader(filename, false, max_records);
+        ASSERT_TRUE(writer.is_writer());
+        for (uint64_t key = 1; key <= max_records; ++key) {
+            writer.add(key, static_cast<float>(key));
+        }
+        EXPECT_EQ(writer.size(), max_records);
+        EXPECT_EQ(reader.refresh(), max_records);
+        full_size = file_size();
+
+        writer.add(100, 100.0f);  // full: compacted first
+        EXPECT_EQ(writer.size(), max_records / 2 + 1);
+        EXPECT_LT(file_size(), full_size);
+        float value{0.0f};
+        EXPECT_FALSE(writer.get(1, value)) << "the oldest are dropped";
+        ASSERT_TRUE(writer.get(max_records, value)) << "the newest are kept";
+        EXPECT_EQ(value, static_cast<float>(max_records));
+
+        EXPECT_EQ(reader.refresh(), max_records / 2 + 1) << "the rewritten file is read again";
+        EXPECT_EQ(reader.size(), max_records / 2 + 1);
+        ASSERT_TRUE(reader.get(100, value));
+        EXPECT_EQ(value, 100.0f);
+        EXPECT_FALSE(reader.get(1, value));
+
+        for (uint64_t key = 200; key < 300; ++key) {
+            writer.add(key, static_cast<float>(key));
+            ASSERT_LE(writer.size(), max_records);
+            ASSERT_LE(file_size(), full_size);
+        }
+        reader.refresh();
+        EXPECT_LE(reader.size(), max_records);
+        ASSERT_TRUE(reader.get(299, value));
+        EXPECT_EQ(value, 299.0f);
+    }
+    {  // a new writer finds more than half of the records: compacts when it takes over
+        VPUNN::PersistentCache writer(filename, true, max_records);
+        ASSERT_TRUE(writer.is_writer());
+        EXPECT_LE(writer.size(), max_records / 2);
+        EXPECT_LE(file_size(), full_size / 2 + 24);
+        float value{0.0f};
+        ASSERT_TRUE(writer.get(299, value));
+        EXPECT_EQ(value, 299.0f);
+    }
+    std::remove(filename.c_str());
+}
+
+#ifndef _WIN32
+/// the write lock, the records and the handover work across processes
+TEST_F(VPUNNCacheTest, PersistentCacheOtherProcess) {
+    const std::string filename{temporary_cache_file("vpunn_test_persistent_process")};
+    std::remove(filename.c_str());
+    // runs check in a child process, true if it returned true there
+    auto in_child_process = [](const std::function<bool()>& check) {
+        const pid_t child{fork()};
+        if (child == 0) {
+            _exit(check() ? 0 : 1);
+        }
+        int status{0};
+        return child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    };
+
+    auto writer = std::make_unique<VPUNN::PersistentCache>(filename);
+    ASSERT_TRUE(writer->is_writer());
+    for (uint64_t key = 1; key <= 100; ++key) {
+        writer->add(key, static_cast<float>(key) * 0.5f);
+    }
+    EXPECT_TRUE(in_child_process([&filename]() {
+        VPUNN::PersistentCache other(filename);
+        float value{0.0f};
+        return other.is_open() && !other.is_writer() && other.size() == 100u && other.refresh() == 0u &&
+               !other.is_writer() && other.get(7, value) && value == 3.5f;
+    })) << "the writer of the other process holds the lock, its records are read";
+
+    VPUNN::PersistentCache reader(filename);
+    EXPECT_FALSE(reader.is_writer());
+    writer.reset();
+    EXPECT_TRUE(in_child_process([&filename]() {
+        VPUNN::PersistentCache other(filename);
+        other.add(1000, 1.0f);
+        return other.is_writer() && other.size() == 101u;
+    })) << "the lock is free, the other process becomes the writer";
+
+    EXPECT_EQ(reader.refresh(), 1u) << "the record of the exited writer";
+    EXPECT_TRUE(reader.is_writer()) << "its lock was released at exit";
+    float value{0.0f};
+    ASSERT_TRUE(reader.get(1000, value));
+    EXPECT_EQ(value, 1.0f);
+    std::remove(filename.c_str());
+}
+#endif
+
+TEST_F(VPUNNCacheTest, PersistentCacheWarmStart) {
+    const std::string filename{temporary_cache_file("vpunn_test_warm_start")};
+    std::remove(filename.c_str());
+    std::vector<VPUNN::DPUWorkload> workloads(50);
+    std::generate_n(workloads.begin(), workloads.size(), VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_7));
+
+    std::vector<VPUNN::CyclesInterfaceType> expected;
+    {
+        VPUNN::VPUCostModel first_run{std::string(VPU_2_7_MODEL_PATH), false, 16384};
+        ASSERT_TRUE(first_run.use_persistent_cache(filename));
+        for (const auto& wl : workloads) {
+            expected.push_back(first_run.DPU(wl));
+        }
+    }
+    {  // like a new process: empty memory caches, but nothing to infer (batch of 1: one last layer run per row)
+        VPUNN::VPUCostModel second_run{std::string(VPU_2_7_MODEL_PATH), true, 16384};
+        ASSERT_TRUE(second_run.use_persistent_cache(filename));
+        EXPECT_GT(second_run.persistent_cache()->size(), 0u);
+        EXPECT_EQ(second_run.DPU(workloads), expected);
+        EXPECT_EQ(second_run.nn_runtime()->layer_profiles().back().kernel.calls, 0u);
+    }
+    {  // the keys include the model, another model does not use these values
+        VPUNN::VPUCostModel other_model{std::string(VPU_2_0_MODEL_PATH), true, 16384};
+        ASSERT_TRUE(other_model.use_persistent_cache(filename));
+        std::vector<VPUNN::DPUWorkload> workloads_2_0(5);
+        std::generate_n(workloads_2_0.begin(), workloads_2_0.size(),
+                        VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_0));
+        VPUNN::VPUCostModel reference{std::string(VPU_2_0_MODEL_PATH), false, 0};
+        EXPECT_EQ(other_model.DPU(workloads_2_0), reference.DPU(workloads_2_0));
+    }
+    std::remove(filename.c_str());
+}
+TEST_F(VPUNNCacheTest, Statistics) {
+    VPUNN::LRUCache<float> cache(2);
+    EXPECT_EQ(cache.capacity(), 2u);
+    const std::vector<float> a{1.0f}, b{2.0f}, c{3.0f};
+    EXPECT_EQ(cache.get(a), nullptr);
+    cache.add(a, 1.0f);
+    cache.add(b, 2.0f);
+    cache.add(b, 3.0f);  // update, not an insert
+    EXPECT_NE(cache.get(a), nullptr);
+    cache.add(c, 3.0f);  // evicts b
+    EXPECT_EQ(cache.get(b), nullptr);
+
+    auto statistics = cache.statistics();
+    EXPECT_EQ(statistics.hits, 1u);
+    EXPECT_EQ(statistics.misses, 2u);
+    EXPECT_EQ(statistics.inserts, 3u);
+    EXPECT_EQ(statistics.evictions, 1u);
+    EXPECT_EQ(statistics.size, 2u);
+    EXPECT_GT(statistics.bytes, 2 * (sizeof(uint64_t) + sizeof(float)));
+    EXPECT_DOUBLE_EQ(statistics.hit_rate(), 1.0 / 3.0);
+
+    cache.reset_statistics();
+    statistics = cache.statistics();
+    EXPECT_EQ(statistics.hits + statistics.misses + statistics.inserts + statistics.evictions, 0u);
+    EXPECT_EQ(statistics.size, 2u) << "the values stay";
+    EXPECT_EQ(statistics.hit_rate(), 0.0);
+
+    // the shared cache sums its shards
+    VPUNN::SharedLRUCache<float> shared(100, 4);
+    float value{0.0f};
+    for (uint64_t key = 0; key < 10; ++key) {
+        shared.add(VPUNN::fingerprint(std::vector<float>{static_cast<float>(key)}), 1.0f);
+    }
+    for (uint64_t key = 0; key < 20; ++key) {
+        shared.get(VPUNN::fingerprint(std::vector<float>{static_cast<float>(key)}), value);
+    }
+    const auto shared_statistics = shared.statistics();
+    EXPECT_EQ(shared_statistics.inserts, 10u);
+    EXPECT_EQ(shared_statistics.hits, 10u);
+    EXPECT_EQ(shared_statistics.misses, 10u);
+    EXPECT_EQ(shared_statistics.size, 10u);
+    shared.reset_statistics();
+    EXPECT_EQ(shared.statistics().hits, 0u);
+}
+
+TEST_F(VPUNNCacheTest, CostModelStatistics) {
+    std::vector<VPUNN::DPUWorkload> workloads(30);
+    std::generate_n(workloads.begin(), workloads.size(), VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_7));
+    VPUNN::VPUCostModel model{std::string(VPU_2_7_MODEL_PATH), false, 1000};
+    ASSERT_TRUE(model.nn_initialized());
+
+    for (int r = 0; r < 2; ++r) {
+        for (const auto& wl : workloads) {
+            model.run_NN(wl);
+        }
+    }
+    auto statistics = model.cache_statistics();
+    EXPECT_EQ(statistics.workloads.hits + statistics.workloads.misses, 2 * workloads.size());
+    EXPECT_EQ(statistics.workloads.hits, workloads.size()) << "the second round is all hits";
+    EXPECT_EQ(statistics.descriptors.hits + statistics.descriptors.misses, statistics.workloads.misses);
+    EXPECT_EQ(statistics.inferences, statistics.descriptors.misses);
+    EXPECT_EQ(statistics.persistent_hits, 0u);
+    EXPECT_EQ(statistics.workloads.size, workloads.size());
+    EXPECT_GT(statistics.descriptors.bytes, 0u);
+
+    model.reset_cache_statistics();
+    model.run_NN(workloads);
+    statistics = model.cache_statistics();
+    EXPECT_EQ(statistics.workloads.hits, workloads.size());
+    EXPECT_EQ(statistics.workloads.misses, 0u);
+    EXPECT_EQ(statistics.inferences, 0u);
+
+    model.set_cache_policy(VPUNN::CachePolicy::TINY_LFU);
+    EXPECT_EQ(model.cache_policy(), VPUNN::CachePolicy::TINY_LFU);
+    EXPECT_EQ(model.cache_statistics().workloads.size, 0u) << "emptied";
+    const auto first = model.run_NN(workloads);
+    EXPECT_EQ(model.run_NN(workloads), first);
+    EXPECT_EQ(model.cache_statistics().workloads.hits, workloads.size());
+
+    model.set_cache_memory(size_t{1} << 16);
+    EXPECT_EQ(model.cache_policy(), VPUNN::CachePolicy::TINY_LFU) << "the policy stays";
+    EXPECT_EQ(model.run_NN(workloads), first);
+    statistics = model.cache_statistics();
+    EXPECT_LE(statistics.workloads.bytes + statistics.descriptors.bytes, size_t{1} << 16);
+}
+
+/// a cost model giving access to its workload cache
+class WorkloadCacheProbe : public VPUNN::VPUCostModel {
+public:
+    using VPUNN::VPUCostModel::VPUCostModel;
+    using VPUNN::VPUCostModel::add_workload;
+    using VPUNN::VPUCostModel::find_workload;
+};
+
+/// a workload cache hit of another workload with the same key (a different check) is a miss
+TEST_F(VPUNNCacheTest, WorkloadCacheCollision) {
+    WorkloadCacheProbe model{std::string(VPU_2_7_MODEL_PATH), false, 100};
+    const uint64_t key{0x1234};
+    EXPECT_EQ(model.find_workload(key, 1), nullptr);
+
+    model.add_workload(key, 1, 10.0f);
+    ASSERT_NE(model.find_workload(key, 1), nullptr);
+    EXPECT_EQ(*model.find_workload(key, 1), 10.0f);
+    EXPECT_EQ(model.find_workload(key, 2), nullptr) << "same key, another workload";
+    EXPECT_EQ(model.find_workload(key + 1, 1), nullptr) << "same check, another key";
+
+    model.add_workload(key, 2, 20.0f);  // the colliding workload replaces the first one
+    EXPECT_EQ(model.find_workload(key, 1), nullptr);
+    ASSERT_NE(model.find_workload(key, 2), nullptr);
+    EXPECT_EQ(*model.find_workload(key, 2), 20.0f);
+
+    model.add_workload(key + 1, 1, 30.0f);
+    ASSERT_NE(model.find_workload(key + 1, 1), nullptr);
+    EXPECT_EQ(*model.find_workload(key + 1, 1), 30.0f);
+    ASSERT_NE(model.find_workload(key, 2), nullptr) << "another key does not collide";
+    EXPECT_EQ(*model.find_workload(key, 2), 20.0f);
+    EXPECT_EQ(model.cache_statistics().workloads.size, 2u);
+}
 }  // namespace VPUNN_unit_tests
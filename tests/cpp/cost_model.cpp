@@ -16,6 +16,7 @@
 #include "vpu/validation/interface_valid_values.h"
 
 #include <algorithm>
+#include <thread>
 #include <unordered_map>
 
 /// @brief namespace for Unit tests of the C++ library
@@ -1121,6 +1122,226 @@ TEST_F(TestCostModel, ComaparativeRuns) {
     std::cout << "----------------------------------------------------------\n";
 }
 
+/// reload swaps the NN in place: same configuration, cache emptied, bad models rejected with the old one kept
+TEST_F(TestCostModel, HotReload) {
+    std::vector<VPUNN::DPUWorkload> workloads(50);
+    std::generate_n(workloads.begin(), workloads.size(), VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_7));
+    auto cycles_of = [&workloads](VPUNN::VPUCostModel& model) {
+        std::vector<VPUNN::CyclesInterfaceType> cycles;
+        for (const auto& wl : workloads) {
+            cycles.push_back(model.DPU(wl));
+        }
+        return cycles;
+    };
+
+    const std::string fast_model{NameHelperNN::make_fast_version(VPU_2_7_MODEL_PATH)};
+    VPUNN::VPUCostModel model{std::string(VPU_2_7_MODEL_PATH), false, 1000, 4};
+    VPUNN::VPUCostModel fresh_fast{fast_model, false, 1000, 4};
+    ASSERT_TRUE(model.nn_initialized());
+    ASSERT_TRUE(fresh_fast.nn_initialized());
+    const auto original_cycles = cycles_of(model);  // now in the cache
+    EXPECT_EQ(model.nn_model_generation(), 0u);
+
+    const auto before_reload = model.nn_runtime();
+    model.reload(fast_model);
+    EXPECT_EQ(model.nn_model_generation(), 1u);
+    EXPECT_EQ(model.nn_runtime()->max_batch(), 4u) << "the configuration is kept";
+    EXPECT_EQ(model.nn_runtime()->weight_precision(), before_reload->weight_precision());
+    EXPECT_EQ(model.nn_runtime()->is_memory_mapped(), before_reload->is_memory_mapped());
+    EXPECT_NE(model.nn_runtime(), before_reload);
+    EXPECT_TRUE(before_reload->initialized()) << "a snapshot stays valid after the reload";
+    EXPECT_EQ(cycles_of(model), cycles_of(fresh_fast)) << "no value of the previous model is served from the cache";
+    EXPECT_EQ(model.DPU(workloads), cycles_of(fresh_fast));
+
+    auto pending = model.reload_async(VPU_2_7_MODEL_PATH);
+    for (int r = 0; r < 5; ++r) {
+        EXPECT_EQ(model.DPU(workloads).size(), workloads.size()) << "queries go on during the reload";
+    }
+    pending.get();
+    EXPECT_EQ(model.nn_model_generation(), 2u);
+    EXPECT_EQ(cycles_of(model), original_cycles);
+
+    // the unchanged file is not loaded again, its store stays shared with the other users of the file
+    auto registered = [&model]() {
+        return VPUNN::ModelRegistry::instance().get(VPU_2_7_MODEL_PATH, model.nn_runtime()->is_memory_mapped(),
+                                                    model.nn_runtime()->weight_precision());
+    };
+    const auto shared_store = registered();
+    ASSERT_NE(shared_store, nullptr);
+    model.reload(VPU_2_7_MODEL_PATH);
+    EXPECT_EQ(registered(), shared_store);
+    EXPECT_EQ(cycles_of(model), original_cycles);
+
+    // a model that cannot be used leaves the current one in place
+    EXPECT_THROW(model.reload("this_file_does_not_exist.vpunn"), std::runtime_error);
+    auto failing = model.reload_async("this_file_does_not_exist.vpunn");
+    EXPECT_THROW(failing.get(), std::runtime_error);
+    EXPECT_EQ(model.nn_model_generation(), 3u);
+    EXPECT_EQ(cycles_of(model), original_cycles);
+
+    // another interface version needs another preprocessing, it is rejected
+    VPUNN::Runtime other_interface{VPU_2_0_MODEL_PATH};
+    VPUNN::Runtime current_interface{VPU_2_7_MODEL_PATH};
+    if (other_interface.model_version_info().get_input_interface_version() !=
+        current_interface.model_version_info().get_input_interface_version()) {
+        EXPECT_THROW(model.reload(VPU_2_0_MODEL_PATH), std::runtime_error);
+        EXPECT_EQ(cycles_of(model), original_cycles);
+    }
+}
+
+/// Many threads computing at once, each with its own cost model, all preprocessing made by the shared factory: same
+/// results as a serial run
+TEST_F(TestCostModel, ConcurrentCostModels) {
+    std::vector<VPUNN::DPUWorkload> workloads(200);
+    std::generate_n(workloads.begin(), workloads.size(), VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_7));
+
+    VPUNN::VPUCostModel serial_model{std::string(VPU_2_7_MODEL_PATH), false, 0, 4};
+    ASSERT_TRUE(serial_model.nn_initialized());
+    std::vector<VPUNN::CyclesInterfaceType> expected;
+    for (const auto& wl : workloads) {
+        expected.push_back(serial_model.DPU(wl));
+    }
+    const auto expected_batch = serial_model.DPU(workloads);
+
+    constexpr unsigned int n_threads{8};
+    constexpr int repetitions{3};
+    std::vector<std::unique_ptr<VPUNN::VPUCostModel>> models;
+    for (unsigned int t = 0; t < n_threads; ++t) {
+        models.push_back(std::make_unique<VPUNN::VPUCostModel>(std::string(VPU_2_7_MODEL_PATH), false, 0, 4));
+    }
+    std::vector<std::vector<VPUNN::CyclesInterfaceType>> single_results(n_threads);
+    std::vector<std::vector<VPUNN::CyclesInterfaceType>> batch_results(n_threads);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int r = 0; r < repetitions; ++r) {
+                for (const auto& wl : workloads) {
+                    single_results[t].push_back(models[t]->DPU(wl));
+                }
+                batch_results[t] = models[t]->DPU(workloads);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (unsigned int t = 0; t < n_threads; ++t) {
+        ASSERT_EQ(single_results[t].size(), expected.size() * repetitions);
+        for (size_t idx = 0; idx < single_results[t].size(); ++idx) {
+            EXPECT_EQ(single_results[t][idx], expected[idx % expected.size()]) << "thread: " << t << " wl: " << idx;
+        }
+        EXPECT_EQ(batch_results[t], expected_batch) << "thread: " << t;
+    }
+}
+
+TEST_F(TestCostModel, BatchCacheAndDeduplication) {
+    std::vector<VPUNN::DPUWorkload> distinct(40);
+    std::generate_n(distinct.begin(), distinct.size(), VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_7));
+    // every workload three times, the last time as another tile of its layer
+    std::vector<VPUNN::DPUWorkload> workloads;
+    for (int r = 0; r < 3; ++r) {
+        for (auto wl : distinct) {
+            wl.offsets = {0, static_cast<unsigned int>(r), 0, 0};
+            workloads.push_back(wl);
+        }
+    }
+
+    VPUNN::VPUCostModel reference_model{std::string(VPU_2_7_MODEL_PATH), false, 0};
+    ASSERT_TRUE(reference_model.nn_initialized());
+    std::vector<VPUNN::CyclesInterfaceType> expected;
+    for (const auto& wl : workloads) {
+        expected.push_back(reference_model.DPU(wl));
+    }
+
+    // batch of 1: the last layer runs once per inferred row
+    auto inferred_rows = [](VPUNN::VPUCostModel& model) {
+        return model.nn_runtime()->layer_profiles().back().kernel.calls;
+    };
+
+    VPUNN::VPUCostModel cached_model{std::string(VPU_2_7_MODEL_PATH), true, 1000};
+    EXPECT_EQ(cached_model.DPU(workloads), expected);
+    EXPECT_GT(inferred_rows(cached_model), 0u);
+    EXPECT_LE(inferred_rows(cached_model), distinct.size());
+    cached_model.nn_runtime()->reset_profiling();
+    EXPECT_EQ(cached_model.DPU(workloads), expected);
+    EXPECT_EQ(inferred_rows(cached_model), 0u) << "all the values are cached";
+    for (size_t idx = 0; idx < workloads.size(); ++idx) {
+        EXPECT_EQ(cached_model.DPU(workloads[idx]), expected[idx]) << idx;
+    }
+    EXPECT_EQ(inferred_rows(cached_model), 0u) << "the batch also fills the single workload cache";
+
+    // without cache the repeated workloads of a batch are still inferred once
+    VPUNN::VPUCostModel uncached_model{std::string(VPU_2_7_MODEL_PATH), true, 0};
+    EXPECT_EQ(uncached_model.DPU(workloads), expected);
+    EXPECT_LE(inferred_rows(uncached_model), distinct.size());
+    EXPECT_EQ(uncached_model.DPU(workloads), expected);
+    EXPECT_LE(inferred_rows(uncached_model), 2 * distinct.size());
+}
+
+TEST_F(TestCostModel, SharedCacheBetweenModels) {
+    std::vector<VPUNN::DPUWorkload> workloads(100);
+    std::generate_n(workloads.begin(), workloads.size(), VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_7));
+
+    VPUNN::VPUCostModel reference_model{std::string(VPU_2_7_MODEL_PATH), false, 0};
+    std::vector<VPUNN::CyclesInterfaceType> expected;
+    for (const auto& wl : workloads) {
+        expected.push_back(reference_model.DPU(wl));
+    }
+
+    auto shared = std::make_shared<VPUNN::SharedLRUCache<float>>(16384);
+    VPUNN::VPUCostModel first_model{std::string(VPU_2_7_MODEL_PATH), false, 16384};
+    first_model.share_cache(shared);
+    EXPECT_EQ(first_model.shared_cache(), shared);
+    EXPECT_EQ(first_model.DPU(workloads), expected);
+    EXPECT_GT(shared->size(), 0u);
+
+    // another cost model finds the values inferred by the first one (batch of 1: one last layer run per row)
+    VPUNN::VPUCostModel second_model{std::string(VPU_2_7_MODEL_PATH), true, 16384};
+    second_model.share_cache(shared);
+    for (size_t idx = 0; idx < workloads.size(); ++idx) {
+        EXPECT_EQ(second_model.DPU(workloads[idx]), expected[idx]) << idx;
+    }
+    EXPECT_EQ(second_model.nn_runtime()->layer_profiles().back().kernel.calls, 0u);
+
+    // a different model sharing the cache does not see them
+    const size_t shared_size{shared->size()};
+    VPUNN::VPUCostModel other_model{std::string(VPU_2_0_MODEL_PATH), false, 16384};
+    other_model.share_cache(shared);
+    std::vector<VPUNN::DPUWorkload> workloads_2_0(20);
+    std::generate_n(workloads_2_0.begin(), workloads_2_0.size(), VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_0));
+    VPUNN::VPUCostModel reference_2_0{std::string(VPU_2_0_MODEL_PATH), false, 0};
+    EXPECT_EQ(other_model.DPU(workloads_2_0), reference_2_0.DPU(workloads_2_0));
+    EXPECT_GT(shared->size(), shared_size);
+
+    // threads with their own cost models on the same cache
+    constexpr unsigned int n_threads{8};
+    shared->clear();
+    std::vector<std::unique_ptr<VPUNN::VPUCostModel>> models;
+    for (unsigned int t = 0; t < n_threads; ++t) {
+        models.push_back(std::make_unique<VPUNN::VPUCostModel>(std::string(VPU_2_7_MODEL_PATH), false, 16384, 4));
+        models.back()->share_cache(shared);
+    }
+    std::vector<std::vector<VPUNN::CyclesInterfaceType>> single_results(n_threads);
+    std::vector<std::vector<VPUNN::CyclesInterfaceType>> batch_results(n_threads);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (const auto& wl : workloads) {
+                single_results[t].push_back(models[t]->DPU(wl));
+            }
+            batch_results[t] = models[t]->DPU(workloads);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (unsigned int t = 0; t < n_threads; ++t) {
+        EXPECT_EQ(single_results[t], expected) << "thread: " << t;
+        EXPECT_EQ(batch_results[t], expected) << "thread: " << t;
+    }
+}
+
 TEST_F(TestCostModel, OutputWriteTiles_multiple) {
     const VPUNN::DPUWorkload wl_ref_1x1_f = {
             VPUNN::VPUDevice::VPU_2_7,
@@ -30,10 +30,14 @@ protected:
 
     class DeviceValidValuesMock : public VPUNN::IDeviceValidValues {
     public:
-        const VPUNN::OperationsBehaviour specific_behaviours{};  ///< known behaviors
+        /// @brief known behaviors. Outside the object: a member would be passed to the base before being constructed
+        static const VPUNN::OperationsBehaviour& specific_behaviours() {
+            static const VPUNN::OperationsBehaviour behaviours{};
+            return behaviours;
+        }
 
         /// @brief non public constructor for initializing the reference
-        DeviceValidValuesMock(): VPUNN::IDeviceValidValues(specific_behaviours) {
+        DeviceValidValuesMock(): VPUNN::IDeviceValidValues(specific_behaviours()) {
         }
 
         const VPUNN::Channels& get_output_channels_range(const VPUNN::DPUOperation&) const override {
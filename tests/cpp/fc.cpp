@@ -8,12 +8,18 @@
 // Software Package for additional details.
 
 #include <gtest/gtest.h>
+#include <atomic>
 #include <cmath>
 #include <iostream>
 #include <numeric>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 #include "core/tensors.h"
+#include "kernels/bias.h"
 #include "kernels/fully_connected.h"
+#include "kernels/sigmoid.h"
+#include "kernels/vpunn_blas.h"
 
 /// @brief namespace for Unit tests of the C++ library
 namespace VPUNN_unit_tests {
@@ -47,6 +53,161 @@ protected:
             }
         }
     }
+
+    /// prepacked weights must give the same results as the plain Dense, and a row must not depend on the batch size
+    void packed_fc_test(unsigned int input_channels, unsigned int output_channels, unsigned int batch_size = 1) {
+        auto weights = VPUNN::random_uniform<float>({output_channels, input_channels}, -10.0f, 10.0f);
+        auto input = VPUNN::random_uniform<float>({batch_size, input_channels}, -10.0f, 10.0f);
+        auto output = VPUNN::zeros<float>({batch_size, output_channels});
+        auto expected_output = VPUNN::zeros<float>({batch_size, output_channels});
+
+        VPUNN::PackedDenseWeights packed;
+        packed.pack(&weights);
+        ASSERT_EQ(packed.get_output_channels(), (int)output_channels);
+        ASSERT_EQ(packed.get_input_channels(), (int)input_channels);
+
+        VPUNN::Dense(packed, &input, &output);
+        VPUNN::Dense(&weights, &input, &expected_output);
+
+        for (unsigned int batch_idx = 0; batch_idx < batch_size; batch_idx++) {
+            auto single_input = VPUNN::zeros<float>({1, input_channels});
+            single_input.assign(input.c_ptr() + batch_idx * input_channels, input_channels * sizeof(float));
+            auto single_output = VPUNN::zeros<float>({1, output_channels});
+            VPUNN::Dense(packed, &single_input, &single_output);
+
+            for (unsigned int outC = 0; outC < output_channels; outC++) {
+                auto idx = outC + batch_idx * output_channels;
+                EXPECT_EQ(single_output[outC], output[idx]) << "batch: " << batch_idx << " out: " << outC;
+                if (output[idx] != 0) {
+                    // Relative error less than 1%
+                    EXPECT_LE(std::abs(expected_output[idx] - output[idx]) / std::abs(output[idx]), 0.01f);
+                } else {
+                    EXPECT_FLOAT_EQ(expected_output[idx], 0.0);
+                }
+            }
+        }
+    }
+
+    /// the fused FC must give exactly the results of the separate Dense, Bias and activation passes
+    void fused_fc_test(unsigned int input_channels, unsigned int output_channels, unsigned int batch_size,
+                       VPUNN::DenseActivation activation, bool with_bias) {
+        auto weights = VPUNN::random_uniform<float>({output_channels, input_channels}, -1.0f, 1.0f);
+        auto bias = VPUNN::random_uniform<float>({1, output_channels}, -5.0f, 5.0f);
+        auto input = VPUNN::random_uniform<float>({batch_size, input_channels}, -1.0f, 1.0f);
+        auto output = VPUNN::zeros<float>({batch_size, output_channels});
+        auto expected_output = VPUNN::zeros<float>({batch_size, output_channels});
+
+        VPUNN::PackedDenseWeights packed;
+        packed.pack(&weights);
+        VPUNN::FusedDense(packed, with_bias ? &bias : nullptr, &input, &output, activation);
+
+        VPUNN::Dense(packed, &input, &expected_output);
+        if (with_bias) {
+            VPUNN::BiasOp bias_op;
+            bias_op.reserve_bias_space(batch_size);
+            bias_op.Bias(&bias, &expected_output);
+        }
+        if (activation == VPUNN::DenseActivation::RELU) {
+            for (int idx = 0; idx < expected_output.size(); idx++) {
+                if (expected_output[idx] < 0)
+                    expected_output[idx] = 0;
+            }
+        } else if (activation == VPUNN::DenseActivation::SIGMOID) {
+            VPUNN::Sigmoid(&expected_output);
+        }
+
+        for (int idx = 0; idx < output.size(); idx++) {
+            EXPECT_EQ(output[idx], expected_output[idx]) << "idx: " << idx << " batch: " << batch_size
+                                                         << " out: " << output_channels << " in: " << input_channels;
+        }
+    }
+
+#ifdef USE_INTERNAL_BLAS
+    /// the FC on the nonzero inputs of a row must give exactly the results of the FC on the dense row
+    void sparse_fc_test(unsigned int input_channels, unsigned int output_channels, unsigned int nonzero_every,
+                        VPUNN::DenseActivation activation) {
+        auto weights = VPUNN::random_uniform<float>({output_channels, input_channels}, -1.0f, 1.0f);
+        auto bias = VPUNN::random_uniform<float>({1, output_channels}, -5.0f, 5.0f);
+        auto input = VPUNN::random_uniform<float>({1, input_channels}, -1.0f, 1.0f);
+        std::vector<int> indexes;
+        std::vector<float> values;
+        for (unsigned int inC = 0; inC < input_channels; inC++) {
+            if (inC % nonzero_every == 0) {
+                indexes.push_back(static_cast<int>(inC));
+                values.push_back(input[inC]);
+            } else {
+                input[inC] = 0.0f;
+            }
+        }
+        auto output = VPUNN::zeros<float>({1, output_channels});
+        auto expected_output = VPUNN::zeros<float>({1, output_channels});
+
+        VPUNN::PackedDenseWeights packed;
+        packed.pack(&weights);
+        ASSERT_TRUE(packed.sparse_input());
+        VPUNN::FusedDense(packed, &bias, indexes.data(), values.data(), static_cast<int>(indexes.size()), &output,
+                          activation);
+        VPUNN::FusedDense(packed, &bias, &input, &expected_output, activation);
+        for (int idx = 0; idx < output.size(); idx++) {
+            EXPECT_EQ(output[idx], expected_output[idx]) << "idx: " << idx << " out: " << output_channels
+                                                         << " in: " << input_channels << " every: " << nonzero_every;
+        }
+    }
+
+    /// FP16 weights must give exactly the FP32 results of the same weights rounded to half, INT8 weights must be
+    /// within the float rounding of the dequantized weights
+    void reduced_precision_fc_test(unsigned int input_channels, unsigned int output_channels, unsigned int batch_size,
+                                   VPUNN::DenseActivation activation) {
+        auto weights = VPUNN::random_uniform<float>({output_channels, input_channels}, -1.0f, 1.0f);
+        auto bias = VPUNN::random_uniform<float>({1, output_channels}, -5.0f, 5.0f);
+        auto input = VPUNN::random_uniform<float>({batch_size, input_channels}, -1.0f, 1.0f);
+        auto output = VPUNN::zeros<float>({batch_size, output_channels});
+        auto expected_output = VPUNN::zeros<float>({batch_size, output_channels});
+
+        auto half_weights = weights;
+        for (int idx = 0; idx < half_weights.size(); idx++) {
+            half_weights[idx] = vpunn_half_to_float(vpunn_float_to_half(weights[idx]));
+        }
+        VPUNN::PackedDenseWeights packed_f16, packed_reference;
+        packed_f16.pack(&weights, VPUNN::WeightPrecision::FP16);
+        packed_reference.pack(&half_weights);
+        EXPECT_EQ(packed_f16.get_precision(), VPUNN::WeightPrecision::FP16);
+        EXPECT_EQ(packed_f16.size_in_bytes() * 2, packed_reference.size_in_bytes());
+        VPUNN::FusedDense(packed_f16, &bias, &input, &output, activation);
+        VPUNN::FusedDense(packed_reference, &bias, &input, &expected_output, activation);
+        for (int idx = 0; idx < output.size(); idx++) {
+            EXPECT_EQ(output[idx], expected_output[idx]) << "FP16 idx: " << idx << " batch: " << batch_size
+                                                         << " out: " << output_channels << " in: " << input_channels;
+        }
+
+        VPUNN::PackedDenseWeights packed_s8;
+        packed_s8.pack(&weights, VPUNN::WeightPrecision::INT8);
+        EXPECT_EQ(packed_s8.get_precision(), VPUNN::WeightPrecision::INT8);
+        VPUNN::FusedDense(packed_s8, &bias, &input, &output, VPUNN::DenseActivation::NONE);
+        for (unsigned int outC = 0; outC < output_channels; outC++) {
+            float max_abs{0.0f};
+            for (unsigned int inC = 0; inC < input_channels; inC++) {
+                max_abs = std::max(max_abs, std::fabs(weights[inC + input_channels * outC]));
+            }
+            const float scale{max_abs / 127.0f};
+            for (unsigned int batch_idx = 0; batch_idx < batch_size; batch_idx++) {
+                double expected{bias[outC]};
+                double magnitude{std::fabs(bias[outC])};
+                for (unsigned int inC = 0; inC < input_channels; inC++) {
+                    const float w{weights[inC + input_channels * outC]};
+                    const double dequantized{std::nearbyint(w / scale) * scale};
+                    const double a{input[inC + batch_idx * input_channels]};
+                    expected += dequantized * a;
+                    magnitude += std::fabs(dequantized * a);
+                }
+                const auto idx = outC + batch_idx * output_channels;
+                EXPECT_NEAR(output[idx], expected, 1e-5 * magnitude + 1e-6)
+                        << "INT8 idx: " << idx << " batch: " << batch_size << " out: " << output_channels
+                        << " in: " << input_channels;
+            }
+        }
+    }
+#endif
 };
 // Demonstrate some basic assertions.
 TEST_F(TestFCLayer, BasicAssertions) {
@@ -58,4 +219,230 @@ TEST_F(TestFCLayer, BasicAssertions) {
         }
     }
 }
+
+TEST_F(TestFCLayer, PackedWeightsAssertions) {
+    for (auto batch_size : {1, 2, 3, 4, 5, 9, 17}) {
+        for (auto output_channels : {1, 15, 16, 17, 33, 64, 100}) {
+            for (auto input_channels : {1, 10, 64, 250}) {
+                packed_fc_test(input_channels, output_channels, batch_size);
+            }
+        }
+    }
+}
+
+TEST_F(TestFCLayer, FusedBiasActivationAssertions) {
+    for (auto activation :
+         {VPUNN::DenseActivation::NONE, VPUNN::DenseActivation::RELU, VPUNN::DenseActivation::SIGMOID}) {
+        for (auto with_bias : {true, false}) {
+            for (auto batch_size : {1, 3, 5}) {
+                for (auto output_channels : {1, 16, 17, 40, 64}) {
+                    for (auto input_channels : {1, 13, 64}) {
+                        fused_fc_test(input_channels, output_channels, batch_size, activation, with_bias);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// weights packed into external memory and viewed give the same results as owned packed weights, without a copy
+TEST_F(TestFCLayer, PackedWeightsViewAssertions) {
+    const unsigned int input_channels{33}, output_channels{40}, batch_size{5};
+    auto weights = VPUNN::random_uniform<float>({output_channels, input_channels}, -1.0f, 1.0f);
+    auto bias = VPUNN::random_uniform<float>({1, output_channels}, -5.0f, 5.0f);
+    auto input = VPUNN::random_uniform<float>({batch_size, input_channels}, -1.0f, 1.0f);
+    for (auto precision : {VPUNN::WeightPrecision::FP32, VPUNN::WeightPrecision::FP16, VPUNN::WeightPrecision::INT8}) {
+        VPUNN::PackedDenseWeights owned, viewed;
+        owned.pack(&weights, precision);
+        EXPECT_FALSE(owned.is_view());
+
+        const size_t size{VPUNN::PackedDenseWeights::storage_size(output_channels, input_channels, precision)};
+        ASSERT_EQ(size % sizeof(float), 0u);
+        EXPECT_EQ(size, owned.size_in_bytes());
+        std::vector<float> storage(size / sizeof(float));
+        VPUNN::PackedDenseWeights::pack_to(&weights, precision, storage.data());
+        viewed.view(output_channels, input_channels, precision, storage.data());
+        EXPECT_TRUE(viewed.is_view());
+        EXPECT_EQ(viewed.get_precision(), owned.get_precision());
+        EXPECT_EQ(viewed.size_in_bytes(), owned.size_in_bytes());
+        EXPECT_EQ(viewed.sparse_input(), owned.sparse_input());
+        const bool with_scales{viewed.get_precision() == VPUNN::WeightPrecision::INT8};  // stored first
+        EXPECT_EQ(static_cast<const void*>(viewed.c_ptr()),
+                  static_cast<const void*>(storage.data() + (with_scales ? output_channels : 0)))
+                << "the weights must not be copied";
+
+        auto output = VPUNN::zeros<float>({batch_size, output_channels});
+        auto expected_output = VPUNN::zeros<float>({batch_size, output_channels});
+        VPUNN::FusedDense(viewed, &bias, &input, &output, VPUNN::DenseActivation::RELU);
+        VPUNN::FusedDense(owned, &bias, &input, &expected_output, VPUNN::DenseActivation::RELU);
+        for (int idx = 0; idx < output.size(); idx++) {
+            EXPECT_EQ(output[idx], expected_output[idx]) << "idx: " << idx << " precision: " << (int)precision;
+        }
+    }
+}
+
+#ifdef USE_INTERNAL_BLAS
+/// all instruction set paths available on this machine must give the same results as the reference
+TEST_F(TestFCLayer, AllInstructionSetsAssertions) {
+    const VPUNN_BLAS_ISA detected{vpunn_blas_detected_isa()};
+    for (int isa = VpunnBlasScalar; isa <= detected; ++isa) {
+        ASSERT_EQ(vpunn_blas_select_isa(static_cast<VPUNN_BLAS_ISA>(isa)), isa);
+        for (auto batch_size : {1, 3, 8}) {
+            for (auto output_channels : {1, 3, 4, 17, 64}) {
+                for (auto input_channels : {1, 7, 8, 16, 33, 200}) {
+                    fc_test(input_channels, output_channels, batch_size);
+                    packed_fc_test(input_channels, output_channels, batch_size);
+                    fused_fc_test(input_channels, output_channels, batch_size, VPUNN::DenseActivation::RELU, true);
+                    fused_fc_test(input_channels, output_channels, batch_size, VPUNN::DenseActivation::SIGMOID,
+                                  true);
+                }
+            }
+        }
+    }
+    EXPECT_EQ(vpunn_blas_select_isa(detected), detected);
+}
+
+/// sparse input rows, on all instruction set paths available on this machine
+TEST_F(TestFCLayer, SparseInputAssertions) {
+    const VPUNN_BLAS_ISA detected{vpunn_blas_detected_isa()};
+    for (int isa = VpunnBlasScalar; isa <= detected; ++isa) {
+        ASSERT_EQ(vpunn_blas_select_isa(static_cast<VPUNN_BLAS_ISA>(isa)), isa);
+        for (auto output_channels : {1, 16, 17, 64, 100}) {
+            for (auto input_channels : {1, 33, 93, 200}) {
+                for (auto nonzero_every : {1, 3, 10}) {
+                    for (auto activation : {VPUNN::DenseActivation::NONE, VPUNN::DenseActivation::RELU,
+                                            VPUNN::DenseActivation::SIGMOID}) {
+                        sparse_fc_test(input_channels, output_channels, nonzero_every, activation);
+                    }
+                }
+            }
+        }
+    }
+    EXPECT_EQ(vpunn_blas_select_isa(detected), detected);
+
+    // no nonzero input: the bias only. Reduced precision weights and indexes outside the input are refused
+    auto weights = VPUNN::random_uniform<float>({20, 10}, -1.0f, 1.0f);
+    auto bias = VPUNN::random_uniform<float>({1, 20}, -5.0f, 5.0f);
+    auto output = VPUNN::zeros<float>({1, 20});
+    VPUNN::PackedDenseWeights packed, packed_f16;
+    packed.pack(&weights);
+    VPUNN::FusedDense(packed, &bias, nullptr, nullptr, 0, &output, VPUNN::DenseActivation::NONE);
+    for (int idx = 0; idx < output.size(); idx++) {
+        EXPECT_EQ(output[idx], bias[idx]);
+    }
+    const int out_of_range{10};
+    const float one{1.0f};
+    EXPECT_THROW(VPUNN::FusedDense(packed, &bias, &out_of_range, &one, 1, &output, VPUNN::DenseActivation::NONE),
+                 std::runtime_error);
+    packed_f16.pack(&weights, VPUNN::WeightPrecision::FP16);
+    EXPECT_FALSE(packed_f16.sparse_input());
+    EXPECT_THROW(VPUNN::FusedDense(packed_f16, &bias, nullptr, nullptr, 0, &output, VPUNN::DenseActivation::NONE),
+                 std::runtime_error);
+}
+
+/// reduced precision weights, on all instruction set paths available on this machine
+TEST_F(TestFCLayer, ReducedPrecisionAssertions) {
+    const VPUNN_BLAS_ISA detected{vpunn_blas_detected_isa()};
+    for (int isa = VpunnBlasScalar; isa <= detected; ++isa) {
+        ASSERT_EQ(vpunn_blas_select_isa(static_cast<VPUNN_BLAS_ISA>(isa)), isa);
+        for (auto batch_size : {1, 3, 8}) {
+            for (auto output_channels : {1, 17, 64}) {
+                for (auto input_channels : {1, 33, 200}) {
+                    reduced_precision_fc_test(input_channels, output_channels, batch_size,
+                                              VPUNN::DenseActivation::RELU);
+                    reduced_precision_fc_test(input_channels, output_channels, batch_size,
+                                              VPUNN::DenseActivation::SIGMOID);
+                }
+            }
+        }
+    }
+    EXPECT_EQ(vpunn_blas_select_isa(detected), detected);
+}
+
+/// the instruction set can be changed while other threads run GEMMs, each call runs with one whole set of kernels
+TEST_F(TestFCLayer, SelectInstructionSetWhileRunningAssertions) {
+    const VPUNN_BLAS_ISA detected{vpunn_blas_detected_isa()};
+    const unsigned int input_channels{64}, output_channels{40}, batch_size{8};
+    auto weights = VPUNN::random_uniform<float>({output_channels, input_channels}, -1.0f, 1.0f);
+    auto input = VPUNN::random_uniform<float>({batch_size, input_channels}, -1.0f, 1.0f);
+    auto expected_output = VPUNN::zeros<float>({batch_size, output_channels});
+    VPUNN::PackedDenseWeights packed;
+    packed.pack(&weights);
+    VPUNN::Dense(&weights, &input, &expected_output);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&]() {
+            auto output = VPUNN::zeros<float>({batch_size, output_channels});
+            while (!done) {
+                VPUNN::Dense(packed, &input, &output);
+                for (int idx = 0; idx < output.size(); idx++) {
+                    if (std::abs(expected_output[idx] - output[idx]) > 1e-4f) {
+                        ++mismatches;
+                    }
+                }
+            }
+        });
+    }
+    for (int round = 0; round < 200; ++round) {
+        const auto isa = static_cast<VPUNN_BLAS_ISA>(round % (detected + 1));
+        EXPECT_EQ(vpunn_blas_select_isa(isa), isa);
+        std::this_thread::yield();
+    }
+    done = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    EXPECT_EQ(mismatches, 0);
+    EXPECT_EQ(vpunn_blas_select_isa(detected), detected);
+}
+
+/// the scalar conversions round to nearest even and keep the special values
+TEST_F(TestFCLayer, HalfConversionAssertions) {
+    EXPECT_EQ(vpunn_float_to_half(1.0f), 0x3C00);
+    EXPECT_EQ(vpunn_float_to_half(-2.0f), 0xC000);
+    EXPECT_EQ(vpunn_float_to_half(65504.0f), 0x7BFF);
+    EXPECT_EQ(vpunn_float_to_half(65520.0f), 0x7C00);               // rounds up to inf
+    EXPECT_EQ(vpunn_float_to_half(1.0f + 1.0f / 2048), 0x3C00);     // tie, to even
+    EXPECT_EQ(vpunn_float_to_half(1.0f + 3.0f / 2048), 0x3C02);     // tie, to even
+    EXPECT_EQ(vpunn_float_to_half(std::ldexp(1.0f, -24)), 0x0001);  // smallest subnormal
+    EXPECT_EQ(vpunn_float_to_half(std::ldexp(1.0f, -25)), 0x0000);  // tie, to even
+    EXPECT_EQ(vpunn_float_to_half(std::ldexp(1.5f, -25)), 0x0001);
+    EXPECT_EQ(vpunn_float_to_half(INFINITY), 0x7C00);
+    EXPECT_TRUE(std::isnan(vpunn_half_to_float(vpunn_float_to_half(NAN))));
+    for (int bits = 0; bits < 0x10000; ++bits) {
+        const float value{vpunn_half_to_float(static_cast<uint16_t>(bits))};
+        if (!std::isnan(value)) {
+            EXPECT_EQ(vpunn_float_to_half(value), bits) << bits;  // every half survives the round trip
+        }
+    }
+}
+
+/// every FP16 weight (subnormals, zeros and infinities included) is converted by the GEMM as by the scalar conversion,
+/// on all instruction set paths available on this machine
+TEST_F(TestFCLayer, HalfWeightsAllValuesAssertions) {
+    constexpr unsigned int values{0x10000};
+    auto weights = VPUNN::zeros<float>({values, 1});
+    for (unsigned int bits = 0; bits < values; ++bits) {
+        const float value{vpunn_half_to_float(static_cast<uint16_t>(bits))};
+        weights[bits] = std::isnan(value) ? 0.0f : value;
+    }
+    auto input = VPUNN::zeros<float>({1, 1});
+    input[0] = 1.0f;
+    auto output = VPUNN::zeros<float>({1, values});
+    VPUNN::PackedDenseWeights packed_f16;
+    packed_f16.pack(&weights, VPUNN::WeightPrecision::FP16);
+    const VPUNN_BLAS_ISA detected{vpunn_blas_detected_isa()};
+    for (int isa = VpunnBlasScalar; isa <= detected; ++isa) {
+        ASSERT_EQ(vpunn_blas_select_isa(static_cast<VPUNN_BLAS_ISA>(isa)), isa);
+        VPUNN::FusedDense(packed_f16, nullptr, &input, &output, VPUNN::DenseActivation::NONE);
+        for (unsigned int bits = 0; bits < values; ++bits) {
+            EXPECT_EQ(output[bits], weights[bits]) << "bits: " << bits << " isa: " << isa;  // 0 + 1 * w is w
+        }
+    }
+    EXPECT_EQ(vpunn_blas_select_isa(detected), detected);
+}
+#endif
 }  // namespace VPUNN_unit_tests
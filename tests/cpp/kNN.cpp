@@ -9,7 +9,12 @@
 
 #include "kernels/kNN.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <utility>
+#include <vector>
+#include "core/parallel.h"
 #include "core/tensors.h"
 
 /// @brief namespace for Unit tests of the C++ library
@@ -56,4 +61,101 @@ TEST_F(TestkNNOneHot, BasicAssertions) {
     }
 }
 
+
+/// random database, several batch rows and outputs, against a brute force full sort
+class TestkNNRandom : public testing::Test {
+protected:
+    void random_test(unsigned int db_items, unsigned int embedding_size, unsigned int batch_size,
+                     unsigned int n_neighbours, unsigned int output_size) {
+        const auto weights = VPUNN::random_uniform<float>({db_items, embedding_size}, -1.0f, 1.0f);
+        const auto targets = VPUNN::random_uniform<float>({db_items, output_size}, 10.0f, 100.0f);
+        auto input = VPUNN::random_uniform<float>({batch_size, embedding_size}, -1.0f, 1.0f);
+        auto output = VPUNN::zeros<float>({batch_size, output_size});
+
+        kNN(&weights, &targets, &input, &output, n_neighbours);
+
+        const unsigned int k{std::min(n_neighbours, db_items)};
+        for (unsigned int b = 0; b < batch_size; ++b) {
+            std::vector<std::pair<double, unsigned int>> all;
+            for (unsigned int item = 0; item < db_items; ++item) {
+                double dot{0.0};
+                for (unsigned int e = 0; e < embedding_size; ++e) {
+                    dot += static_cast<double>(input[b * embedding_size + e]) *
+                           static_cast<double>(weights[item * embedding_size + e]);
+                }
+                all.emplace_back(1.0 - dot, item);
+            }
+            std::sort(all.begin(), all.end());
+            for (unsigned int o = 0; o < output_size; ++o) {
+                double sum{0.0}, prediction{0.0};
+                for (unsigned int n = 0; n < k; ++n) {
+                    const double weight{1.0 / (all[n].first + 1e-12)};
+                    prediction += static_cast<double>(targets[all[n].second * output_size + o]) * weight;
+                    sum += weight;
+                }
+                const double expected{prediction / sum};
+                EXPECT_NEAR(static_cast<double>(output[b * output_size + o]), expected, std::fabs(expected) * 1e-4)
+                        << "row: " << b << " output: " << o << " items: " << db_items << " k: " << n_neighbours;
+            }
+        }
+    }
+};
+
+TEST_F(TestkNNRandom, BruteForceReference) {
+    for (auto db_items : {1U, 7U, 100U, 2000U}) {
+        for (auto batch_size : {1U, 3U, 17U}) {
+            for (auto n_neighbours : {1U, 5U, 10U}) {
+                random_test(db_items, 16, batch_size, n_neighbours, 1);
+            }
+        }
+    }
+    random_test(500, 24, 5, 3, 4);  // more than one target per item
+}
+
+/// the rows split between threads must not change the results
+TEST_F(TestkNNRandom, ThreadsIndependence) {
+    const unsigned int db_items{2000}, embedding_size{16}, batch_size{64};
+    auto weights = VPUNN::random_uniform<float>({db_items, embedding_size}, -1.0f, 1.0f);
+    auto targets = VPUNN::random_uniform<float>({db_items, 1}, 10.0f, 100.0f);
+    auto input = VPUNN::random_uniform<float>({batch_size, embedding_size}, -1.0f, 1.0f);
+    auto output_serial = VPUNN::zeros<float>({batch_size, 1});
+    auto output_parallel = VPUNN::zeros<float>({batch_size, 1});
+
+    const unsigned int max_threads{VPUNN::parallel_max_threads()};
+    VPUNN::set_parallel_max_threads(1);
+    kNN(&weights, &targets, &input, &output_serial, 5);
+    VPUNN::set_parallel_max_threads(8);
+    kNN(&weights, &targets, &input, &output_parallel, 5);
+    VPUNN::set_parallel_max_threads(max_threads);
+
+    for (unsigned int b = 0; b < batch_size; ++b) {
+        EXPECT_EQ(output_serial[b], output_parallel[b]) << "row: " << b;
+    }
+}
+
+/// a workspace reused across calls gives the same results as a fresh one, and is not reallocated for smaller batches
+TEST_F(TestkNNRandom, WorkspaceReuse) {
+    const unsigned int db_items{500}, embedding_size{16}, batch_size{9};
+    auto weights = VPUNN::random_uniform<float>({db_items, embedding_size}, -1.0f, 1.0f);
+    auto targets = VPUNN::random_uniform<float>({db_items, 1}, 10.0f, 100.0f);
+    auto input = VPUNN::random_uniform<float>({batch_size, embedding_size}, -1.0f, 1.0f);
+    auto output_expected = VPUNN::zeros<float>({batch_size, 1});
+    kNN(&weights, &targets, &input, &output_expected, 5);
+
+    VPUNN::KNNWorkspace workspace;
+    workspace.reserve(batch_size, db_items, 5);
+    const float* const distances{workspace.distances.data()};
+    const auto* const neighbours{workspace.neighbours.data()};
+    for (unsigned int batch : {batch_size, 1U, 4U, batch_size}) {
+        auto rows = VPUNN::Tensor<float>::view({batch, embedding_size}, input.data());
+        auto output = VPUNN::zeros<float>({batch, 1});
+        kNN(&weights, &targets, &rows, &output, 5, workspace);
+        for (unsigned int b = 0; b < batch; ++b) {
+            EXPECT_EQ(output[b], output_expected[b]) << "batch: " << batch << " row: " << b;
+        }
+        EXPECT_EQ(workspace.distances.data(), distances) << "no reallocation, batch: " << batch;
+        EXPECT_EQ(workspace.neighbours.data(), neighbours) << "no reallocation, batch: " << batch;
+    }
+}
+
 }  // namespace VPUNN_unit_tests
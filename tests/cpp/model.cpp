@@ -13,9 +13,22 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <numeric>
+#include <string>
+#include <thread>
 #include <vector>
+#include "common_helpers.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <utime.h>
+#endif
 
 namespace VPUNN_unit_tests {
 using namespace VPUNN;
@@ -118,4 +131,270 @@ TEST_F(PostProcessChecker, BasicOutputSupport) {
         EXPECT_EQ(support_config.is_output_supported(), tst.support) << tst.info << " is expected as " << tst.support;
     }
 }
+
+/// @brief instances created from the same file share one immutable store, and keep private activations
+TEST_F(TestModel, SharedModelStore) {
+    std::weak_ptr<const VPUNN::ModelStore> released_store;
+    {
+        VPUNN::InferenceModel first(VPU_2_7_MODEL_PATH, true);
+        VPUNN::InferenceModel second(VPU_2_7_MODEL_PATH, true);
+        ASSERT_TRUE(first.is_initialized());
+        ASSERT_TRUE(second.is_initialized());
+        EXPECT_EQ(first.model_store(), second.model_store()) << "the file must be loaded only once";
+        EXPECT_GE(VPUNN::ModelRegistry::instance().size(), 1u);
+
+        VPUNN::InferenceModel private_copy(first.model_store());  // explicit sharing of a store
+        EXPECT_EQ(first.model_store(), private_copy.model_store());
+
+        VPUNN::InferenceModel not_mapped(VPU_2_7_MODEL_PATH, false);
+        EXPECT_NE(first.model_store(), not_mapped.model_store()) << "a different loading mode is a different store";
+
+        first.allocate_tensors(1);
+        second.allocate_tensors(3);
+        ASSERT_NE(first.input_tensors()[0]->data(), second.input_tensors()[0]->data()) << "activations are private";
+
+        const auto input_size = first.input_tensors()[0]->size();
+        std::vector<float> input_a(input_size, 0.25F);
+        std::vector<float> input_b(input_size * 3, 0.75F);
+        first.set_inputs(input_a.data(), input_size);
+        second.set_inputs(input_b.data(), input_size * 3);
+        first.predict();
+        second.predict();
+        const auto out_a = first.get_outputs_vector<float>();
+        first.set_inputs(input_a.data(), input_size);
+        first.predict();
+        EXPECT_EQ(out_a, first.get_outputs_vector<float>()) << "the other instance must not interfere";
+
+        released_store = first.model_store();
+    }
+    EXPECT_TRUE(released_store.expired()) << "the store is released with its last user";
+
+    VPUNN::InferenceModel missing("this_file_does_not_exist.vpunn", true);
+    EXPECT_FALSE(missing.is_initialized());
+    EXPECT_EQ(missing.model_store(), nullptr);
+}
+
+#ifndef _WIN32
+/// @brief a file rewritten in place, with the same size and in the same second, is loaded again
+TEST_F(TestModel, RegistryRewrittenFile) {
+    std::ifstream source(VPU_2_7_MODEL_PATH, std::ios::binary);
+    const std::vector<char> bytes{std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>()};
+    const std::string filename{"registry_rewritten_test.vpunn"};
+    auto write = [&]() {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    };
+    write();
+    VPUNN::InferenceModel first(filename.c_str(), false);
+    ASSERT_TRUE(first.is_initialized());
+    EXPECT_EQ(VPUNN::InferenceModel(filename.c_str(), false).model_store(), first.model_store()) << "not changed";
+
+    struct stat before;
+    ASSERT_EQ(stat(filename.c_str(), &before), 0);
+    write();
+    struct utimbuf same_second {
+        before.st_atime, before.st_mtime
+    };
+    ASSERT_EQ(utime(filename.c_str(), &same_second), 0);  // keeps the modification time in seconds
+    VPUNN::InferenceModel second(filename.c_str(), false);
+    ASSERT_TRUE(second.is_initialized());
+    EXPECT_NE(second.model_store(), first.model_store()) << "the rewrite must be seen";
+
+    // forget: the next load reads the file whatever its times
+    VPUNN::ModelRegistry::instance().forget(filename);
+    VPUNN::InferenceModel third(filename.c_str(), false);
+    ASSERT_TRUE(third.is_initialized());
+    EXPECT_NE(third.model_store(), second.model_store());
+    EXPECT_EQ(VPUNN::InferenceModel(filename.c_str(), false).model_store(), third.model_store());
+
+    std::remove(filename.c_str());
+}
+#endif
+
+/// @brief a mapped model packs its FC weights in memory, or once in a file of the packed weights directory mapped by
+/// this and the next loads. Nothing is written next to the model. A damaged file is packed again
+TEST_F(TestModel, PackedWeightsFile) {
+    std::ifstream source(VPU_2_7_MODEL_PATH, std::ios::binary);
+    const std::vector<char> bytes{std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>()};
+    const std::string filename{::testing::TempDir() + "packed_weights_test.vpunn"};
+    const std::string directory{::testing::TempDir()};
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    const auto read = VPUNN::ModelStore::from_file(filename.c_str(), false);
+    ASSERT_NE(read, nullptr);
+    EXPECT_FALSE(read->is_dense_weights_mapped());
+    auto predict = [](std::shared_ptr<const VPUNN::ModelStore> store) {
+        VPUNN::InferenceModel model(std::move(store));
+        model.allocate_tensors(1);
+        const auto input_size = model.input_tensors()[0]->size();
+        std::vector<float> input(input_size);
+        for (int idx = 0; idx < input_size; ++idx) {
+            input[idx] = static_cast<float>(idx % 5) / 5.0F;
+        }
+        model.set_inputs(input.data(), input_size);
+        model.predict();
+        return model.get_outputs_vector<float>();
+    };
+    const auto expected = predict(read);
+
+    const auto in_memory = VPUNN::ModelStore::from_file(filename.c_str(), true);
+    ASSERT_NE(in_memory, nullptr);
+    EXPECT_TRUE(in_memory->is_memory_mapped());
+    EXPECT_FALSE(in_memory->is_dense_weights_mapped()) << "no directory: packed in memory";
+    EXPECT_TRUE(in_memory->packed_weights_filename().empty());
+    EXPECT_FALSE(std::ifstream(filename + ".fp32.packed").good()) << "nothing written next to the model";
+    EXPECT_EQ(predict(in_memory), expected);
+
+    auto mapped = VPUNN::ModelStore::from_file(filename.c_str(), true, WeightPrecision::FP32, directory);
+    ASSERT_NE(mapped, nullptr);
+    EXPECT_EQ(mapped->packed_weights_directory(), directory);
+    const std::string packed_filename{mapped->packed_weights_filename()};
+    if (VPUNN::PackedDenseWeights::repacked_layout()) {
+        EXPECT_TRUE(mapped->is_dense_weights_mapped());
+        EXPECT_EQ(packed_filename.compare(0, directory.size(), directory), 0) << packed_filename;
+        EXPECT_TRUE(std::ifstream(packed_filename).good()) << "packed once, in the file";
+    }
+    size_t dense_layers{0};
+    for (flatbuffers::uoffset_t idx = 0; idx < mapped->get_model()->operators()->size(); idx++) {
+        if (!mapped->packed_dense_weights(idx).empty()) {
+            EXPECT_TRUE(mapped->packed_dense_weights(idx).is_view()) << "layer " << idx << " must not be copied";
+            ++dense_layers;
+        }
+    }
+    EXPECT_GT(dense_layers, 0u);
+    EXPECT_EQ(predict(mapped), expected);
+
+    auto again = VPUNN::ModelStore::from_file(filename.c_str(), true, WeightPrecision::FP32, directory);
+    ASSERT_NE(again, nullptr);
+    EXPECT_EQ(again->is_dense_weights_mapped(), mapped->is_dense_weights_mapped()) << "the file is used as it is";
+    EXPECT_EQ(again->packed_weights_filename(), packed_filename);
+    EXPECT_EQ(predict(again), expected);
+    mapped.reset();
+    again.reset();
+
+    if (VPUNN::PackedDenseWeights::repacked_layout()) {
+        {  // damaged: the last byte changed
+            std::fstream file(packed_filename, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(-1, std::ios::end);
+            file.put('\x7f');
+        }
+        const auto repacked = VPUNN::ModelStore::from_file(filename.c_str(), true, WeightPrecision::FP32, directory);
+        ASSERT_NE(repacked, nullptr);
+        EXPECT_TRUE(repacked->is_dense_weights_mapped());
+        EXPECT_EQ(predict(repacked), expected) << "the damaged file must be packed again";
+    }
+
+    if (!packed_filename.empty()) {
+        std::remove(packed_filename.c_str());
+    }
+    std::remove(filename.c_str());
+}
+
+/// @brief the threads getting the same files at once share one store per file, loaded once
+TEST_F(TestModel, RegistryConcurrentLoads) {
+    const std::vector<std::string> files{VPU_2_7_MODEL_PATH, VPU_2_0_MODEL_PATH};
+    const size_t n_threads{8};
+    std::vector<std::shared_ptr<const VPUNN::ModelStore>> stores(n_threads);
+    std::vector<std::thread> threads;
+    for (size_t idx = 0; idx < n_threads; ++idx) {
+        threads.emplace_back([&stores, &files, idx]() {
+            stores[idx] = VPUNN::ModelRegistry::instance().get(files[idx % files.size()], false);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t idx = 0; idx < n_threads; ++idx) {
+        ASSERT_NE(stores[idx], nullptr);
+        EXPECT_EQ(stores[idx], stores[idx % files.size()]) << "thread " << idx;
+    }
+    EXPECT_NE(stores[0], stores[1]);
+    EXPECT_EQ(VPUNN::ModelRegistry::instance().get("this_file_does_not_exist.vpunn", false), nullptr);
+}
+
+/// @brief the plan is compiled at allocation, copies get their own activations and plan, moves keep them
+TEST_F(TestModel, CompiledPlan) {
+    VPUNN::InferenceModel original(VPU_2_7_MODEL_PATH, true);
+    ASSERT_TRUE(original.is_initialized());
+    EXPECT_EQ(original.plan_size(), 0u) << "nothing to run before allocation";
+    original.allocate_tensors(4);
+    EXPECT_EQ(original.plan_size(), original.model_store()->get_model()->operators()->size());
+
+    const auto row_size = original.input_tensors()[0]->size() / 4;
+    std::vector<float> input(row_size * 2);
+    for (size_t idx = 0; idx < input.size(); ++idx) {
+        input[idx] = static_cast<float>((idx * 5) % 11) / 11.0F;
+    }
+    original.set_inputs(input.data(), static_cast<unsigned int>(input.size()));
+    original.predict();
+    const auto expected = original.get_outputs_vector<float>();
+
+    std::unique_ptr<VPUNN::InferenceModel> copy{std::make_unique<VPUNN::InferenceModel>(original)};
+    EXPECT_EQ(copy->get_batch(), 2u);
+    EXPECT_EQ(copy->get_max_batch(), 4u);
+    EXPECT_NE(copy->input_tensors()[0]->data(), original.input_tensors()[0]->data()) << "activations are private";
+    EXPECT_EQ(copy->get_outputs_vector<float>(), expected) << "the copy has the same values";
+
+    VPUNN::InferenceModel moved{std::move(*copy)};
+    copy.reset();  // the moved model must not depend on the released instance
+    moved.set_inputs(input.data(), static_cast<unsigned int>(input.size()));
+    moved.predict();
+    EXPECT_EQ(moved.get_outputs_vector<float>(), expected);
+
+    VPUNN::InferenceModel assigned(VPU_2_0_MODEL_PATH, true);
+    assigned = original;
+    original.set_inputs(input.data(), static_cast<unsigned int>(row_size));
+    original.predict();  // changes the original activations only
+    assigned.set_inputs(input.data(), static_cast<unsigned int>(input.size()));
+    assigned.predict();
+    EXPECT_EQ(assigned.get_outputs_vector<float>(), expected);
+}
+
+/// @brief the activations are packed in one aligned arena, no bigger than separate tensors, inputs are not overwritten
+TEST_F(TestModel, ActivationArena) {
+    for (const char* filename : {VPU_2_7_MODEL_PATH, VPU_2_0_MODEL_PATH}) {
+        VPUNN::InferenceModel model(filename, true);
+        ASSERT_TRUE(model.is_initialized());
+        EXPECT_EQ(model.activations_size_in_bytes(), 0u);
+        constexpr unsigned int batch{100};
+        model.allocate_tensors(batch);
+
+        // every activation in its own tensor, as much memory as the arena can take at most
+        const auto tensors = model.model_store()->get_model()->tensors();
+        size_t separate_floats{0};
+        for (flatbuffers::uoffset_t idx = 0; idx < tensors->size(); idx++) {
+            if (model.model_store()->constant_tensor(idx) == nullptr) {
+                size_t size{1};
+                const auto shape = tensors->Get(idx)->shape();
+                for (flatbuffers::uoffset_t dim = 0; dim < shape->size(); dim++) {
+                    size *= (dim == 0 && shape->Get(dim) == 1) ? batch : shape->Get(dim);
+                }
+                separate_floats += (size + 15) / 16 * 16;
+            }
+        }
+        EXPECT_GT(model.activations_size_in_bytes(), 0u) << filename;
+        EXPECT_LE(model.activations_size_in_bytes(), separate_floats * sizeof(float)) << filename;
+
+        const float* begin{model.activations_data()};
+        const float* end{begin + model.activations_size_in_bytes() / sizeof(float)};
+        for (const auto tensor : {model.input_tensors()[0], model.output_tensors()[0]}) {
+            EXPECT_TRUE(tensor->c_ptr() >= begin && tensor->c_ptr() + tensor->size() <= end) << filename;
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(tensor->c_ptr()) % 64, 0u) << filename;
+        }
+
+        const auto row_size = model.input_tensors()[0]->size() / batch;
+        std::vector<float> input(row_size * batch);
+        for (size_t idx = 0; idx < input.size(); ++idx) {
+            input[idx] = static_cast<float>((idx * 7) % 13) / 13.0F;
+        }
+        model.set_inputs(input.data(), static_cast<unsigned int>(input.size()));
+        model.predict();
+        const auto expected = model.get_outputs_vector<float>();
+        model.predict();  // the input is still there
+        EXPECT_EQ(model.get_outputs_vector<float>(), expected) << filename;
+    }
+}
 }  // namespace VPUNN_unit_tests
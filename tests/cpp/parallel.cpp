@@ -0,0 +1,98 @@
+// Copyright © 2023 Intel Corporation
+// SPDX-License-Identifier: Apache 2.0
+// LEGAL NOTICE: Your use of this software and any required dependent software (the “Software Package”)
+// is subject to the terms and conditions of the software license agreements for the Software Package,
+// which may also include notices, disclaimers, or license terms for third party or open source software
+// included in or with the Software Package, and your use indicates your acceptance of all such terms.
+// Please refer to the “third-party-programs.txt” or other similarly-named text file included with the
+// Software Package for additional details.
+#include "core/parallel.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "vpu/sample_generator/random_task_generator.h"
+#include "vpu_cost_model.h"
+
+namespace VPUNN_unit_tests {
+
+class TestParallel : public ::testing::Test {
+protected:
+    unsigned int saved_threads{1};
+
+    void SetUp() override {
+        saved_threads = VPUNN::parallel_max_threads();
+    }
+    void TearDown() override {
+        VPUNN::set_parallel_max_threads(saved_threads);
+    }
+};
+
+/// every element is processed exactly once, in aligned chunks, whatever the thread count
+TEST_F(TestParallel, ParallelForCoversRange) {
+    for (const unsigned int threads : {1U, 2U, 3U, 8U}) {
+        VPUNN::set_parallel_max_threads(threads);
+        for (const size_t count : {0U, 1U, 5U, 64U, 1001U}) {
+            std::vector<std::atomic<int>> visits(count);
+            std::atomic<int> misaligned{0};
+            VPUNN::parallel_for(
+                    0, count, 1,
+                    [&](const size_t chunk_begin, const size_t chunk_end) {
+                        if (chunk_begin % 4 != 0) {
+                            ++misaligned;
+                        }
+                        for (size_t idx = chunk_begin; idx < chunk_end; ++idx) {
+                            ++visits[idx];
+                        }
+                    },
+                    4);
+            EXPECT_EQ(misaligned, 0) << "threads: " << threads << " count: " << count;
+            EXPECT_TRUE(std::all_of(visits.begin(), visits.end(),
+                                    [](const std::atomic<int>& v) {
+                                        return v == 1;
+                                    }))
+                    << "threads: " << threads << " count: " << count;
+        }
+    }
+}
+
+/// a region started from inside a task runs serially, without deadlock
+TEST_F(TestParallel, NestedRegions) {
+    VPUNN::set_parallel_max_threads(4);
+    std::atomic<int> total{0};
+    VPUNN::ThreadPool::instance().run(4, [&](const size_t) {
+        VPUNN::parallel_for(0, 100, 1, [&](const size_t chunk_begin, const size_t chunk_end) {
+            total += static_cast<int>(chunk_end - chunk_begin);
+        });
+    });
+    EXPECT_EQ(total, 400);
+    EXPECT_GE(VPUNN::ThreadPool::instance().workers_count(), 3u);
+}
+
+/// a big batch of workloads gives bit identical results with any number of threads
+TEST_F(TestParallel, CostModelBatchDeterminism) {
+    std::vector<VPUNN::DPUWorkload> workloads(1000);
+    std::generate_n(workloads.begin(), workloads.size(), VPUNN::randDPUWorkload(VPUNN::VPUDevice::VPU_2_7));
+
+    VPUNN::set_parallel_max_threads(1);
+    VPUNN::VPUCostModel serial_model{std::string(VPU_2_7_MODEL_PATH), false, 0, 64};
+    ASSERT_TRUE(serial_model.nn_initialized());
+    const auto expected = serial_model.DPU(workloads);
+
+    for (const unsigned int threads : {2U, 4U, 7U}) {
+        VPUNN::set_parallel_max_threads(threads);
+        VPUNN::VPUCostModel model{std::string(VPU_2_7_MODEL_PATH), false, 0, 64};
+        EXPECT_EQ(model.DPU(workloads), expected) << "threads: " << threads;
+        EXPECT_EQ(model.DPU(workloads), expected) << "threads: " << threads << ", second run";
+    }
+
+    // one batch holding everything: the rows of the GEMMs are split between the threads instead
+    VPUNN::set_parallel_max_threads(4);
+    VPUNN::VPUCostModel wide_model{std::string(VPU_2_7_MODEL_PATH), false, 0, 1000};
+    EXPECT_EQ(wide_model.DPU(workloads), expected);
+}
+
+}  // namespace VPUNN_unit_tests
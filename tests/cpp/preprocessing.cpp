@@ -9,6 +9,7 @@
 
 #include "inference/preprocessing.h"
 #include <gtest/gtest.h>
+#include "core/parallel.h"
 #include "vpu/compatibility/types01.h"
 #include "vpu/compatibility/types11.h"
 
@@ -57,6 +58,48 @@ TEST_F(TestPreprocessingLatest, MultipleWLTestPreprocessing) {
     }
 }
 
+/// the batch descriptors are written in place, serially or by several threads, as the single workload ones
+template <class PP>
+void check_batch_transform(const std::vector<VPUNN::DPUWorkload>& workloads, const unsigned int pad) {
+    PP pp;
+    PP reference;
+    const size_t size{pp.output_size()};
+    for (const unsigned int threads : {1U, 4U, 1U}) {
+        VPUNN::set_parallel_max_threads(threads);
+        const std::vector<float> result = pp.transform(workloads, pad);
+        ASSERT_EQ(result.size(), VPUNN::round_up(static_cast<unsigned int>(workloads.size()), pad) * size);
+        for (size_t wl_idx = 0; wl_idx < workloads.size(); wl_idx++) {
+            const std::vector<float> expected = reference.transform(workloads[wl_idx]);
+            ASSERT_TRUE(std::equal(expected.begin(), expected.end(), result.begin() + wl_idx * size))
+                    << "workload: " << wl_idx << " threads: " << threads;
+        }
+        EXPECT_TRUE(std::all_of(result.begin() + workloads.size() * size, result.end(), [](const float value) {
+            return value == 0.0f;
+        })) << "padding";
+    }
+    VPUNN::set_parallel_max_threads(1);
+}
+
+TEST_F(TestPreprocessingLatest, BatchInPlaceAndParallel) {
+    std::vector<VPUNN::DPUWorkload> workloads;
+    for (unsigned int idx = 0; idx < 301; idx++) {
+        auto workload = wl;
+        workload.inputs[0] = VPUNN::VPUTensor(7 + idx % 50, 3 + idx % 17, 16 * (1 + idx % 4), 1,
+                                              (idx % 3 == 0) ? VPUNN::DataType::FLOAT16 : VPUNN::DataType::UINT8);
+        workload.outputs[0] = VPUNN::VPUTensor(7 + idx % 50, 3 + idx % 17, 16 * (1 + idx % 5), 1,
+                                               VPUNN::DataType::UINT8);
+        workload.op = (idx % 2 == 0) ? VPUNN::Operation::CONVOLUTION : VPUNN::Operation::ELTWISE;
+        workload.execution_order =
+                (idx % 5 == 0) ? VPUNN::ExecutionMode::CUBOID_4x16 : VPUNN::ExecutionMode::CUBOID_16x16;
+        workloads.push_back(workload);
+    }
+    check_batch_transform<VPUNN::PreprocessingLatest<float>>(workloads, 1);
+    check_batch_transform<VPUNN::PreprocessingLatest<float>>(workloads, 16);
+    check_batch_transform<VPUNN::Preprocessing_Interface11<float>>(workloads, 8);
+    check_batch_transform<VPUNN::Preprocessing_Interface01<float>>(workloads, 1);
+    check_batch_transform<VPUNN::PreprocessingLatest<float>>({}, 4);
+}
+
 // Demonstrate basic creation and size
 TEST_F(TestPreprocessingLatest, CreationAndSize) {
     auto pp = VPUNN::PreprocessingLatest<float>();
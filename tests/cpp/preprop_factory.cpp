@@ -45,26 +45,26 @@ TEST_F(RuntimeProcessingFactoryTest, SimpleChecks) {
     {
         int v = (int)VPUNN::NNVersions::VERSION_00_LATEST_NONE;
         ASSERT_NO_THROW(factory.make_preprocessing(v););
-        auto& pp = factory.make_preprocessing(v);
-        EXPECT_EQ(pp.interface_version(), v);
+        auto pp = factory.make_preprocessing(v);
+        EXPECT_EQ(pp->interface_version(), v);
     }
     {
         int v = (int)VPUNN::NNVersions::VERSION_01_BASE;
         ASSERT_NO_THROW(factory.make_preprocessing(v););
-        auto& pp = factory.make_preprocessing(v);
-        EXPECT_EQ(pp.interface_version(), v);
+        auto pp = factory.make_preprocessing(v);
+        EXPECT_EQ(pp->interface_version(), v);
     }
     {
         int v = (int)VPUNN::NNVersions::VERSION_10_ENUMS_SAME;
         ASSERT_NO_THROW(factory.make_preprocessing(v););
-        auto& pp = factory.make_preprocessing(v);
-        EXPECT_EQ(pp.interface_version(), v);
+        auto pp = factory.make_preprocessing(v);
+        EXPECT_EQ(pp->interface_version(), v);
     }
     {
         int v = (int)VPUNN::NNVersions::VERSION_11_VPU27_BETA;
         ASSERT_NO_THROW(factory.make_preprocessing(v););
-        auto& pp = factory.make_preprocessing(v);
-        EXPECT_EQ(pp.interface_version(), v);
+        auto pp = factory.make_preprocessing(v);
+        EXPECT_EQ(pp->interface_version(), v);
     }
     {
         int v = 2;
@@ -74,4 +74,32 @@ TEST_F(RuntimeProcessingFactoryTest, SimpleChecks) {
     }
 }
 
+/// Each request gets its own preprocessor: a descriptor is not changed by the others, even from the same factory
+TEST_F(RuntimeProcessingFactoryTest, IndependentInstances) {
+    const auto& factory = VPUNN::RuntimeProcessingFactory::instance();
+    const int v = (int)VPUNN::NNVersions::VERSION_11_VPU27_BETA;
+    auto first = factory.make_preprocessing(v);
+    auto second = factory.make_preprocessing(v);
+    ASSERT_NE(first.get(), second.get());
+
+    const VPUNN::DPUWorkload wl_a{VPUNN::VPUDevice::VPU_2_7,
+                                  VPUNN::Operation::CONVOLUTION,
+                                  {VPUNN::VPUTensor(56, 56, 16, 1, VPUNN::DataType::UINT8)},
+                                  {VPUNN::VPUTensor(56, 56, 16, 1, VPUNN::DataType::UINT8)},
+                                  {3, 3},
+                                  {1, 1},
+                                  {1, 1, 1, 1},
+                                  VPUNN::ExecutionMode::CUBOID_16x16};
+    auto wl_b = wl_a;
+    wl_b.op = VPUNN::Operation::ELTWISE;
+    wl_b.inputs[0] = VPUNN::VPUTensor(7, 7, 64, 1, VPUNN::DataType::FLOAT16);
+
+    const auto& descriptor_a = first->transform(wl_a);
+    const std::vector<float> expected_a = descriptor_a;
+    const std::vector<float> expected_b = second->transform(wl_b);
+    EXPECT_NE(expected_a, expected_b);
+    EXPECT_EQ(descriptor_a, expected_a) << "not overwritten by the other instance";
+    EXPECT_EQ(factory.make_preprocessing(v)->transform(wl_b), expected_b);
+}
+
 }  // namespace VPUNN_unit_tests
@@ -13,7 +13,9 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <numeric>
 #include <vector>
 #include "common_helpers.h"
@@ -117,4 +119,194 @@ TEST_F(TestRuntime, CreationBasicTest) {
     }
 }
 
+/// A memory mapped model must give the same results as a read one. Mapping is opt-in
+TEST_F(TestRuntime, MemoryMappedModel) {
+    for (const std::string vpunn_file : {VPU_2_0_MODEL_PATH, VPU_2_7_MODEL_PATH}) {
+        auto runtime_mapped{VPUNN::Runtime(vpunn_file, 1, false, true)};
+        auto runtime_read{VPUNN::Runtime(vpunn_file, 1, false, false)};
+        ASSERT_TRUE(runtime_mapped.initialized());
+        ASSERT_TRUE(runtime_read.initialized());
+        EXPECT_TRUE(runtime_mapped.is_memory_mapped());
+        EXPECT_FALSE(runtime_read.is_memory_mapped());
+        EXPECT_FALSE(VPUNN::Runtime(vpunn_file).is_memory_mapped()) << "read by default";
+
+        EXPECT_EQ(runtime_mapped.model_version_info().get_raw_name(),
+                  runtime_read.model_version_info().get_raw_name());
+        ASSERT_EQ(runtime_mapped.input_shapes(), runtime_read.input_shapes());
+
+        const auto input_size = runtime_mapped.input_tensors()[0]->size();
+        std::vector<float> input(input_size);
+        for (int idx = 0; idx < input_size; ++idx) {
+            input[idx] = static_cast<float>(idx % 7) / 7.0F;
+        }
+        EXPECT_EQ(runtime_mapped.predict(input), runtime_read.predict(input)) << vpunn_file;
+    }
+
+    {  // the weights are views on the mapped file
+        VPUNN::InferenceModel mapped(VPU_2_7_MODEL_PATH, true);
+        ASSERT_TRUE(mapped.is_initialized());
+        EXPECT_TRUE(mapped.is_memory_mapped());
+        mapped.allocate_tensors(1);
+        const float* activations{mapped.activations_data()};
+        const float* input{mapped.input_tensors()[0]->c_ptr()};
+        EXPECT_TRUE(input >= activations && input < activations + mapped.activations_size_in_bytes() / sizeof(float))
+                << "activations are in the model own memory";
+
+        VPUNN::InferenceModel read(VPU_2_7_MODEL_PATH, false);
+        ASSERT_TRUE(read.is_initialized());
+        EXPECT_FALSE(read.is_memory_mapped());
+    }
+    {  // missing file
+        VPUNN::InferenceModel mapped("this_file_does_not_exist.vpunn", true);
+        EXPECT_FALSE(mapped.is_initialized());
+    }
+}
+
+/// The same model contents have the same fingerprint, however they are loaded
+TEST_F(TestRuntime, ModelFingerprint) {
+    const VPUNN::Runtime mapped{std::string(VPU_2_7_MODEL_PATH), 1, false, true};
+    const VPUNN::Runtime read{std::string(VPU_2_7_MODEL_PATH), 4, false, false};
+    ASSERT_TRUE(mapped.initialized());
+    EXPECT_NE(mapped.model_fingerprint(), 0u);
+    EXPECT_EQ(mapped.model_fingerprint(), read.model_fingerprint());
+
+    std::ifstream file(VPU_2_7_MODEL_PATH, std::ios::binary);
+    const std::vector<char> bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    const VPUNN::Runtime from_buffer{bytes.data(), bytes.size(), true};
+    ASSERT_TRUE(from_buffer.initialized());
+    EXPECT_EQ(from_buffer.model_fingerprint(), mapped.model_fingerprint());
+
+    const VPUNN::Runtime other{std::string(VPU_2_0_MODEL_PATH)};
+    ASSERT_TRUE(other.initialized());
+    EXPECT_NE(other.model_fingerprint(), mapped.model_fingerprint());
+
+    // other weights precision, other results
+    const VPUNN::Runtime f16{std::string(VPU_2_7_MODEL_PATH), 1, false, true, VPUNN::WeightPrecision::FP16};
+    if (f16.weight_precision() != mapped.weight_precision()) {
+        EXPECT_NE(f16.model_fingerprint(), mapped.model_fingerprint());
+    }
+
+    const VPUNN::Runtime missing{std::string("this_file_does_not_exist.vpunn")};
+    EXPECT_EQ(missing.model_fingerprint(), 0u);
+}
+
+/// One runtime allocated for a maximum batch runs any batch up to it, with the same results as a batch 1 runtime
+TEST_F(TestRuntime, VariableBatch) {
+    const std::string vpunn_file = VPU_2_7_MODEL_PATH;
+    constexpr unsigned int max_batch{10};
+    auto runtime_single{VPUNN::Runtime(vpunn_file, 1)};
+    auto runtime_batch{VPUNN::Runtime(vpunn_file, max_batch)};
+    ASSERT_TRUE(runtime_single.initialized());
+    ASSERT_TRUE(runtime_batch.initialized());
+    EXPECT_EQ(runtime_batch.max_batch(), max_batch);
+
+    const auto row_size = runtime_single.input_tensors()[0]->size();
+    const auto output_row_size = runtime_single.output_tensors()[0]->size();
+    std::vector<float> input(row_size * max_batch);
+    for (size_t idx = 0; idx < input.size(); ++idx) {
+        input[idx] = static_cast<float>((idx * 7) % 13) / 13.0F;
+    }
+    std::vector<float> expected;
+    for (unsigned int row = 0; row < max_batch; ++row) {
+        const auto output = runtime_single.predict(
+                std::vector<float>(input.begin() + row * row_size, input.begin() + (row + 1) * row_size));
+        expected.insert(expected.end(), output.begin(), output.end());
+    }
+
+    const float* const input_memory{runtime_batch.input_tensors()[0]->c_ptr()};
+    for (const unsigned int batch : {1U, 3U, max_batch, 7U, 1U}) {
+        const auto output = runtime_batch.predict(std::vector<float>(input.begin(), input.begin() + batch * row_size));
+        ASSERT_EQ(output.size(), batch * output_row_size) << "only the rows of the batch are computed";
+        EXPECT_EQ(output, std::vector<float>(expected.begin(), expected.begin() + batch * output_row_size))
+                << "batch: " << batch;
+        EXPECT_EQ(runtime_batch.input_tensors()[0]->shape()[0], batch);
+        EXPECT_EQ(runtime_batch.input_tensors()[0]->c_ptr(), input_memory) << "no reallocation";
+    }
+
+    EXPECT_THROW(runtime_batch.predict(std::vector<float>(row_size * (max_batch + 1))), std::runtime_error);
+    EXPECT_THROW(runtime_batch.predict(std::vector<float>(row_size + 1)), std::runtime_error);
+    EXPECT_THROW(runtime_single.predict(std::vector<float>(row_size * 2)), std::runtime_error);
+}
+
+/// A row given by its nonzero elements gives the results of the dense row, sparse or not, profiled or not
+TEST_F(TestRuntime, SparseInput) {
+    const std::string vpunn_file = VPU_2_7_MODEL_PATH;
+    auto runtime{VPUNN::Runtime(vpunn_file, 4)};
+    ASSERT_TRUE(runtime.initialized());
+    const size_t row_size = static_cast<size_t>(runtime.input_tensors()[0]->size()) / 4;
+    const size_t output_row_size = static_cast<size_t>(runtime.output_tensors()[0]->size()) / 4;
+
+    for (const size_t nonzero_every : {7U, 2U, 1U}) {  // one-hot like, at the limit, dense
+        std::vector<float> input(row_size, 0.0F);
+        std::vector<int> indexes;
+        std::vector<float> values;
+        for (size_t idx = 0; idx < row_size; idx += nonzero_every) {
+            input[idx] = static_cast<float>((idx * 7) % 13 + 1) / 13.0F;
+            indexes.push_back(static_cast<int>(idx));
+            values.push_back(input[idx]);
+        }
+        const auto expected = runtime.predict(input);
+        for (const bool profiling : {false, true}) {
+            runtime.set_profiling(profiling);
+            runtime.predict(std::vector<float>(row_size * 3, 0.5F));  // the batch and the input change
+            const float* output =
+                    runtime.predict_sparse(indexes.data(), values.data(), static_cast<int>(indexes.size()));
+            EXPECT_EQ(std::vector<float>(output, output + output_row_size), expected)
+                    << "every: " << nonzero_every << " profiling: " << profiling;
+            EXPECT_EQ(runtime.input_tensors()[0]->shape()[0], 1u);
+        }
+        runtime.set_profiling(false);
+    }
+
+    const int outside{static_cast<int>(row_size)};
+    const float one{1.0F};
+    EXPECT_THROW(runtime.predict_sparse(&outside, &one, 1), std::runtime_error);
+}
+
+/// Per layer profiling: off by default, counts every layer when enabled, resettable
+TEST_F(TestRuntime, LayerProfiling) {
+    const std::string vpunn_file = VPU_2_7_MODEL_PATH;
+    auto runtime{VPUNN::Runtime(vpunn_file, 4)};
+    ASSERT_TRUE(runtime.initialized());
+    const auto row_size = runtime.input_tensors()[0]->size() / 4;
+    const std::vector<float> input(row_size * 2, 0.5F);
+
+    runtime.predict(input);
+    EXPECT_FALSE(runtime.is_profiling());
+    EXPECT_EQ(runtime.inference_profile().calls, 0u);
+    const auto idle_profiles = runtime.layer_profiles();
+    ASSERT_FALSE(idle_profiles.empty());
+    for (const auto& layer : idle_profiles) {
+        EXPECT_EQ(layer.kernel.calls, 0u);
+    }
+
+    runtime.set_profiling(true);
+    const auto expected = runtime.predict(input);
+    runtime.predict(input);
+    EXPECT_EQ(runtime.predict(input), expected) << "profiling must not change the results";
+    EXPECT_EQ(runtime.inference_profile().calls, 3u);
+    bool has_fc{false};
+    for (const auto& layer : runtime.layer_profiles()) {
+        EXPECT_EQ(layer.kernel.calls, 3u) << "layer " << layer.layer;
+        EXPECT_LE(layer.kernel.min_ms, layer.kernel.average_ms());
+        EXPECT_LE(layer.kernel.average_ms(), layer.kernel.max_ms);
+        EXPECT_EQ(layer.activation_pass.calls,
+                  (layer.fused_activation || layer.activation == "None") ? 0u : 3u);
+        has_fc = has_fc || (layer.operation == "FullyConnected");
+    }
+    EXPECT_TRUE(has_fc);
+    EXPECT_NE(runtime.profiling_report().find("FullyConnected"), std::string::npos);
+
+    runtime.reset_profiling();
+    EXPECT_EQ(runtime.inference_profile().calls, 0u);
+    for (const auto& layer : runtime.layer_profiles()) {
+        EXPECT_EQ(layer.kernel.calls, 0u);
+        EXPECT_EQ(layer.kernel.total_ms, 0.0);
+    }
+
+    runtime.set_profiling(false);
+    runtime.predict(input);
+    EXPECT_EQ(runtime.inference_profile().calls, 0u);
+}
+
 }  // namespace VPUNN_unit_tests
@@ -142,6 +142,76 @@ TEST_F(TestTensor, CreationExternalData) {
     }
 }
 
+/// Tests the views on external memory, they do not own it
+TEST_F(TestTensor, CreationView) {
+    std::vector<unsigned int> dimensions{3U, 5U};
+    std::vector<float> memory(3 * 5, 2.5F);
+    {
+        auto view{VPUNN::Tensor<float>::view(dimensions, memory.data())};
+        EXPECT_TRUE(view.is_view());
+        EXPECT_EQ(view.size(), 3 * 5);
+        ASSERT_EQ(view.shape(), dimensions);
+        EXPECT_EQ(view.data(), memory.data()) << "no copy must be done";
+
+        VPUNN::Tensor<float> copy{view};
+        EXPECT_FALSE(copy.is_view()) << "a copy owns its memory";
+        EXPECT_NE(copy.data(), memory.data());
+        EXPECT_EQ(copy[7], 2.5F);
+
+        VPUNN::Tensor<float> moved{std::move(view)};
+        EXPECT_TRUE(moved.is_view());
+        EXPECT_EQ(moved.data(), memory.data());
+
+        VPUNN::Tensor<float> assigned(dimensions, 1.0F);
+        assigned = std::move(moved);
+        EXPECT_TRUE(assigned.is_view());
+        EXPECT_EQ(assigned.data(), memory.data());
+
+        copy = assigned;
+        EXPECT_FALSE(copy.is_view());
+        EXPECT_NE(copy.data(), memory.data());
+    }  // views destroyed, memory not released
+    EXPECT_EQ(memory[14], 2.5F);
+
+    VPUNN::Tensor<float> owner(dimensions);
+    EXPECT_FALSE(owner.is_view());
+}
+
+/// Tests the change of the first dimension inside the allocated memory
+TEST_F(TestTensor, ResizeFirstDimension) {
+    VPUNN::Tensor<float> tensor({10U, 4U}, 1.5F);
+    const float* memory{tensor.c_ptr()};
+    EXPECT_EQ(tensor.capacity(), 40);
+
+    tensor.resize_first_dimension(3);
+    EXPECT_EQ(tensor.shape(), (std::vector<unsigned int>{3U, 4U}));
+    EXPECT_EQ(tensor.size(), 12);
+    EXPECT_EQ(tensor.capacity(), 40);
+    EXPECT_EQ(tensor.c_ptr(), memory) << "no reallocation";
+    EXPECT_EQ(tensor[11], 1.5F);
+
+    EXPECT_THROW(tensor.assign(std::vector<float>(40).data(), 40 * sizeof(float)), std::runtime_error);
+    tensor.assign(std::vector<float>(12, 2.0F).data(), 12 * sizeof(float));
+
+    tensor.resize_first_dimension(10);
+    EXPECT_EQ(tensor.size(), 40);
+    EXPECT_EQ(tensor.c_ptr(), memory);
+    EXPECT_EQ(tensor[11], 2.0F);
+    EXPECT_EQ(tensor[12], 1.5F) << "content is kept";
+
+    EXPECT_THROW(tensor.resize_first_dimension(11), std::runtime_error);
+    EXPECT_THROW(tensor.resize_first_dimension(0), std::runtime_error);
+    EXPECT_EQ(tensor.size(), 40);
+
+    tensor.resize_first_dimension(2);
+    VPUNN::Tensor<float> copy{tensor};
+    EXPECT_EQ(copy.size(), 8);
+    EXPECT_EQ(copy.capacity(), 8) << "a copy holds only the used part";
+    VPUNN::Tensor<float> moved{std::move(tensor)};
+    EXPECT_EQ(moved.capacity(), 40);
+    EXPECT_NO_THROW(moved.resize_first_dimension(10));
+}
+
 /// Tests the copy operations
 TEST_F(TestTensor, ObjectCopyConstructor) {
     {